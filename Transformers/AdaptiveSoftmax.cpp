@@ -0,0 +1,320 @@
+﻿#include "AdaptiveSoftmax.h"
+#include "ThreadPool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+extern int paramCount;
+
+namespace {
+    // log-softmax строк z на месте
+    void log_softmax_rows(TensorView z) {
+        const size_t cols = z.cols();
+        ThreadPool::instance().parallel_for(0, z.rows(), ThreadPool::grain_size(z.rows(), 16 * cols), [&](size_t row_begin, size_t row_end) {
+            for (size_t i = row_begin; i < row_end; ++i) {
+                float* zi = z[i];
+                float max_val = *std::max_element(zi, zi + cols);
+                float sum = 0.0f;
+                for (size_t j = 0; j < cols; ++j) sum += std::exp(zi[j] - max_val);
+                float log_sum = max_val + std::log(sum);
+                for (size_t j = 0; j < cols; ++j) zi[j] -= log_sum;
+            }
+        });
+    }
+
+    // Cross-entropy строк z с целевыми индексами targets (< 0 — строка без метки): z заменяется градиентом
+    // (softmax - y) * scale (нулевым у строк без метки). Возвращает сумму loss = log-sum-exp - z[target]
+    double softmax_cross_entropy(TensorView z, const std::vector<int>& targets, float scale) {
+        const size_t cols = z.cols();
+        std::vector<double> row_loss(z.rows(), 0.0);
+        ThreadPool::instance().parallel_for(0, z.rows(), ThreadPool::grain_size(z.rows(), 16 * cols), [&](size_t row_begin, size_t row_end) {
+            for (size_t i = row_begin; i < row_end; ++i) {
+                float* zi = z[i];
+                int target = targets[i];
+                if (target < 0) {
+                    std::fill(zi, zi + cols, 0.0f);
+                    continue;
+                }
+                float max_val = *std::max_element(zi, zi + cols);
+                float sum = 0.0f;
+                for (size_t j = 0; j < cols; ++j) sum += std::exp(zi[j] - max_val);
+                float log_sum = max_val + std::log(sum);
+                row_loss[i] = log_sum - zi[target];
+                for (size_t j = 0; j < cols; ++j) zi[j] = std::exp(zi[j] - log_sum) * scale;
+                zi[target] -= scale;
+            }
+        });
+        // Сумма по порядку строк: результат не зависит от числа потоков
+        return std::accumulate(row_loss.begin(), row_loss.end(), 0.0);
+    }
+
+    Tensor gather_rows(ConstTensorView M, const std::vector<size_t>& rows) {
+        Tensor result(rows.size(), M.cols());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            std::copy(M[rows[i]], M[rows[i]] + M.cols(), result[i]);
+        }
+        return result;
+    }
+}
+
+AdaptiveSoftmax::AdaptiveSoftmax(int input_dim, int vocab_size, const std::vector<int>& cutoffs, int shrink)
+    : input_dim_(input_dim), vocab_size_(vocab_size), shrink_(shrink), cutoffs_(cutoffs) {
+    if (input_dim <= 0 || vocab_size <= 0 || shrink <= 0) {
+        throw std::invalid_argument("input_dim, vocab_size и shrink должны быть положительными");
+    }
+    if (cutoffs.empty() || cutoffs.front() <= 0 || cutoffs.back() >= vocab_size
+        || !std::is_sorted(cutoffs.begin(), cutoffs.end(), std::less_equal<int>())) {
+        throw std::invalid_argument("cutoffs должны строго возрастать в пределах (0, vocab_size)");
+    }
+    head_size_ = cutoffs.front() + static_cast<int>(cutoffs.size());
+    head_W_.assign(input_dim, head_size_, 0.0f);
+    paramCount += input_dim * head_size_;
+
+    clusters_.resize(cutoffs.size());
+    int dim = input_dim;
+    for (size_t c = 0; c < clusters_.size(); ++c) {
+        Cluster& cluster = clusters_[c];
+        cluster.begin = cutoffs[c];
+        cluster.end = c + 1 < cutoffs.size() ? cutoffs[c + 1] : vocab_size;
+        dim = std::max(1, dim / shrink);
+        cluster.projection.assign(input_dim, dim, 0.0f);
+        cluster.W.assign(dim, cluster.end - cluster.begin, 0.0f);
+        paramCount += input_dim * dim + dim * (cluster.end - cluster.begin);
+    }
+}
+
+int AdaptiveSoftmax::cluster_of(int token) const {
+    if (token < cutoffs_.front()) {
+        return -1;
+    }
+    return static_cast<int>(std::upper_bound(cutoffs_.begin(), cutoffs_.end(), token) - cutoffs_.begin()) - 1;
+}
+
+Tensor AdaptiveSoftmax::cluster_logits(const Tensor& input, const Cluster& cluster, Tensor* hidden) const {
+    Tensor h = utils::matrix_multiply(input, weight_operand(cluster.projection, cluster.projection_half));
+    Tensor logits = utils::matrix_multiply(h, weight_operand(cluster.W, cluster.W_half));
+    if (hidden) *hidden = std::move(h);
+    return logits;
+}
+
+void AdaptiveSoftmax::apply(Tensor& W, Tensor& grad, const MatrixOperand& A, const Tensor& G, float learning_rate) {
+    // Градиент по W = A^T * G: сразу в буфер накопления или в сами веса с -learning_rate
+    if (accumulate_gradients_) {
+        utils::gemm(true, false, 1.0f, A, G, 1.0f, grad);
+    }
+    else {
+        utils::gemm(true, false, -learning_rate, A, G, 1.0f, W);
+    }
+}
+
+float AdaptiveSoftmax::cross_entropy(const Tensor& input, const std::vector<int>& labels, float scale, float learning_rate, Tensor& grad_input) {
+    if (input.empty() || input.cols() != static_cast<size_t>(input_dim_)) {
+        throw std::invalid_argument("Input dimensions do not match expected input_dim");
+    }
+    if (labels.size() != input.rows()) {
+        throw std::invalid_argument("labels size does not match input rows");
+    }
+    const size_t rows = input.rows();
+
+    // Цель головы — сам частый токен или логит его кластера; строки хвостовых токенов собираются по кластерам
+    std::vector<int> head_targets(rows, -1);
+    std::vector<std::vector<size_t>> cluster_rows(clusters_.size());
+    for (size_t i = 0; i < rows; ++i) {
+        int label = labels[i];
+        if (label < 0) continue;
+        if (label >= vocab_size_) {
+            throw std::out_of_range("label is out of vocabulary range");
+        }
+        int c = cluster_of(label);
+        head_targets[i] = c < 0 ? label : cutoffs_.front() + c;
+        if (c >= 0) cluster_rows[c].push_back(i);
+    }
+
+    // Голова. Все градиенты по входу считаются до шага SGD по соответствующим весам
+    const MatrixOperand head_W = weight_operand(head_W_, head_W_half_);
+    Tensor head = utils::matrix_multiply(input, head_W);
+    double loss = softmax_cross_entropy(head, head_targets, scale);
+    grad_input = utils::matrix_multiply(head, head_W, false, true);
+    apply(head_W_, grad_head_W_, input, head, learning_rate);
+
+    // Хвосты — только для строк со своими токенами
+    for (size_t c = 0; c < clusters_.size(); ++c) {
+        const std::vector<size_t>& cluster_row = cluster_rows[c];
+        if (cluster_row.empty()) continue;
+        Cluster& cluster = clusters_[c];
+        std::vector<int> targets(cluster_row.size());
+        for (size_t k = 0; k < cluster_row.size(); ++k) {
+            targets[k] = labels[cluster_row[k]] - cluster.begin;
+        }
+        Tensor x = gather_rows(input, cluster_row);
+        Tensor hidden;
+        Tensor logits = cluster_logits(x, cluster, &hidden);
+        loss += softmax_cross_entropy(logits, targets, scale);
+
+        Tensor grad_hidden = utils::matrix_multiply(logits, weight_operand(cluster.W, cluster.W_half), false, true);
+        apply(cluster.W, cluster.grad_W, hidden, logits, learning_rate);
+        Tensor grad_x = utils::matrix_multiply(grad_hidden, weight_operand(cluster.projection, cluster.projection_half), false, true);
+        apply(cluster.projection, cluster.grad_projection, x, grad_hidden, learning_rate);
+
+        for (size_t k = 0; k < cluster_row.size(); ++k) {
+            float* dst = grad_input[cluster_row[k]];
+            const float* src = grad_x[k];
+            for (int j = 0; j < input_dim_; ++j) dst[j] += src[j];
+        }
+    }
+    return static_cast<float>(loss);
+}
+
+Tensor AdaptiveSoftmax::log_probabilities(const Tensor& input) const {
+    if (input.empty() || input.cols() != static_cast<size_t>(input_dim_)) {
+        throw std::invalid_argument("Input dimensions do not match expected input_dim");
+    }
+    const size_t rows = input.rows();
+    const int head_tokens = cutoffs_.front();
+    Tensor head = utils::matrix_multiply(input, weight_operand(head_W_, head_W_half_));
+    log_softmax_rows(head);
+
+    Tensor result(rows, vocab_size_);
+    for (size_t i = 0; i < rows; ++i) {
+        std::copy(head[i], head[i] + head_tokens, result[i]);
+    }
+    for (size_t c = 0; c < clusters_.size(); ++c) {
+        const Cluster& cluster = clusters_[c];
+        Tensor logits = cluster_logits(input, cluster);
+        log_softmax_rows(logits);
+        for (size_t i = 0; i < rows; ++i) {
+            float cluster_log_p = head[i][head_tokens + c];
+            float* dst = result[i] + cluster.begin;
+            for (size_t j = 0; j < logits.cols(); ++j) dst[j] = logits[i][j] + cluster_log_p;
+        }
+    }
+    return result;
+}
+
+Tensor AdaptiveSoftmax::probabilities(const Tensor& input) const {
+    Tensor result = log_probabilities(input);
+    for (size_t i = 0; i < result.size(); ++i) {
+        result.data()[i] = std::exp(result.data()[i]);
+    }
+    return result;
+}
+
+std::vector<int> AdaptiveSoftmax::predict(const Tensor& input) const {
+    if (input.empty() || input.cols() != static_cast<size_t>(input_dim_)) {
+        throw std::invalid_argument("Input dimensions do not match expected input_dim");
+    }
+    const size_t rows = input.rows();
+    const int head_tokens = cutoffs_.front();
+    Tensor head = utils::matrix_multiply(input, weight_operand(head_W_, head_W_half_));
+    log_softmax_rows(head);
+
+    std::vector<int> best_token(rows);
+    std::vector<float> best_log_p(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        const float* it = std::max_element(head[i], head[i] + head_tokens);
+        best_token[i] = static_cast<int>(it - head[i]);
+        best_log_p[i] = *it;
+    }
+    // log p токена кластера не больше log p самого кластера: кластер с меньшей вероятностью, чем лучший
+    // найденный токен, пропускается. Кластеры идут по убыванию частоты, поэтому лучший токен растёт быстро
+    for (size_t c = 0; c < clusters_.size(); ++c) {
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < rows; ++i) {
+            if (head[i][head_tokens + c] > best_log_p[i]) candidates.push_back(i);
+        }
+        if (candidates.empty()) continue;
+        const Cluster& cluster = clusters_[c];
+        Tensor logits = cluster_logits(gather_rows(input, candidates), cluster);
+        log_softmax_rows(logits);
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            size_t i = candidates[k];
+            const float* it = std::max_element(logits[k], logits[k] + logits.cols());
+            float log_p = *it + head[i][head_tokens + c];
+            if (log_p > best_log_p[i]) {
+                best_log_p[i] = log_p;
+                best_token[i] = cluster.begin + static_cast<int>(it - logits[k]);
+            }
+        }
+    }
+    return best_token;
+}
+
+void AdaptiveSoftmax::initialize_random() {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    auto init = [&](Tensor& W) {
+        std::normal_distribution<float> dist(0.0f, 1.0f / std::sqrt(static_cast<float>(W.rows())));
+        for (size_t i = 0; i < W.size(); ++i) W.data()[i] = dist(gen);
+    };
+    init(head_W_);
+    for (auto& cluster : clusters_) {
+        init(cluster.projection);
+        init(cluster.W);
+    }
+}
+
+void AdaptiveSoftmax::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенные буферы не перевыделяются: они могут жить в общей области параметров
+    auto setup = [enabled](Tensor& grad, const Tensor& value) {
+        if (!enabled) grad = Tensor();
+        else if (grad.empty()) grad.assign(value.rows(), value.cols(), 0.0f);
+    };
+    setup(grad_head_W_, head_W_);
+    for (auto& cluster : clusters_) {
+        setup(cluster.grad_projection, cluster.projection);
+        setup(cluster.grad_W, cluster.W);
+    }
+}
+
+void AdaptiveSoftmax::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &head_W_, &grad_head_W_, &head_W_half_, "head.W" });
+    for (size_t c = 0; c < clusters_.size(); ++c) {
+        Cluster& cluster = clusters_[c];
+        std::string prefix = "tail." + std::to_string(c) + ".";
+        params.push_back({ &cluster.projection, &cluster.grad_projection, &cluster.projection_half, prefix + "projection" });
+        params.push_back({ &cluster.W, &cluster.grad_W, &cluster.W_half, prefix + "W" });
+    }
+}
+
+void AdaptiveSoftmax::save_weights(std::ofstream& out) const {
+    utils::write_matrix(out, head_W_);
+    for (const auto& cluster : clusters_) {
+        utils::write_matrix(out, cluster.projection);
+        utils::write_matrix(out, cluster.W);
+    }
+}
+
+void AdaptiveSoftmax::load_weights(std::ifstream& in) {
+    auto read = [&in](Tensor& W) {
+        size_t rows = W.rows(), cols = W.cols();
+        utils::read_matrix(in, W);
+        if (W.rows() != rows || W.cols() != cols)
+            throw std::runtime_error("Неверный размер параметров в AdaptiveSoftmax при загрузке");
+    };
+    read(head_W_);
+    for (auto& cluster : clusters_) {
+        read(cluster.projection);
+        read(cluster.W);
+    }
+}
+
+std::vector<int> AdaptiveSoftmax::frequency_order(const std::vector<std::vector<int>>& sequences, int vocab_size) {
+    std::vector<size_t> counts(vocab_size, 0);
+    for (const auto& sequence : sequences) {
+        for (int token : sequence) {
+            if (token >= 0 && token < vocab_size) ++counts[token];
+        }
+    }
+    std::vector<int> by_frequency(vocab_size);
+    std::iota(by_frequency.begin(), by_frequency.end(), 0);
+    std::stable_sort(by_frequency.begin(), by_frequency.end(), [&](int a, int b) { return counts[a] > counts[b]; });
+    std::vector<int> new_id(vocab_size);
+    for (int rank = 0; rank < vocab_size; ++rank) {
+        new_id[by_frequency[rank]] = rank;
+    }
+    return new_id;
+}
\ No newline at end of file
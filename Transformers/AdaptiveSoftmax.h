@@ -0,0 +1,68 @@
+﻿#pragma once
+#include "Tensor.h"
+#include "Parameter.h"
+#include <fstream>
+#include <vector>
+
+// Адаптивный softmax (Grave et al.) — выходной слой для больших словарей вместо Linear + Softmax.
+// Id токенов должны идти по убыванию частоты (см. frequency_order): границы cutoffs делят словарь на голову
+// [0, cutoffs[0]) и хвостовые кластеры [cutoffs[i], cutoffs[i + 1]). Голова — проекция во все частые токены
+// и по одному логиту на кластер; кластер i — проекция в размерность input_dim / shrink^(i + 1), затем в свои токены.
+// log p(t) = log p_head(t) для частых токенов и log p_head(кластер) + log p_cluster(t) для остальных,
+// поэтому позиция с частым токеном платит только за голову
+class AdaptiveSoftmax {
+public:
+    AdaptiveSoftmax(int input_dim, int vocab_size, const std::vector<int>& cutoffs, int shrink = 4);
+
+    // Обучение: loss и градиент за один вызов, без матриц seq x vocab (контракт как у Linear::cross_entropy_head).
+    // labels[i] < 0 — строка заполнения. Градиенты весов (* scale) накапливаются или применяются SGD,
+    // grad_input — градиент по input. Возвращает сумму -log p(label)
+    float cross_entropy(const Tensor& input, const std::vector<int>& labels, float scale, float learning_rate, Tensor& grad_input);
+
+    // Полное распределение (rows x vocab): log p и p. Хвосты считаются для всех строк — для beam search и отладки
+    Tensor log_probabilities(const Tensor& input) const;
+    Tensor probabilities(const Tensor& input) const;
+    // Жадный выбор (argmax p) по строкам: хвостовой кластер считается только для строк, где его вероятность
+    // больше лучшего уже найденного токена (иначе ни один его токен не может выиграть)
+    std::vector<int> predict(const Tensor& input) const;
+
+    void initialize_random();
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    void save_weights(std::ofstream& out) const;
+    void load_weights(std::ifstream& in);
+
+    // Перенумерация словаря по убыванию частоты в sequences: new_id[old_id] (при равной частоте порядок id сохраняется)
+    static std::vector<int> frequency_order(const std::vector<std::vector<int>>& sequences, int vocab_size);
+
+    const std::vector<int>& cutoffs() const { return cutoffs_; }
+    int shrink() const { return shrink_; }
+
+private:
+    // Хвостовой кластер: токены [begin, end), проекция input_dim -> dim, затем dim -> end - begin
+    struct Cluster {
+        int begin = 0;
+        int end = 0;
+        Tensor projection, W;
+        HalfView projection_half, W_half;
+        Tensor grad_projection, grad_W;
+    };
+
+    // Кластер токена: -1 — голова, иначе индекс хвоста
+    int cluster_of(int token) const;
+    // Логиты кластера для строк input; hidden (если задан) получает проекцию input в размерность кластера
+    Tensor cluster_logits(const Tensor& input, const Cluster& cluster, Tensor* hidden = nullptr) const;
+    // Градиент весов W (накопление в grad или шаг SGD)
+    void apply(Tensor& W, Tensor& grad, const MatrixOperand& A, const Tensor& G, float learning_rate);
+
+    int input_dim_;
+    int vocab_size_;
+    int shrink_;
+    std::vector<int> cutoffs_;
+    int head_size_;             // cutoffs_[0] частых токенов + по логиту на хвостовой кластер
+    Tensor head_W_;             // input_dim x head_size_
+    HalfView head_W_half_;
+    Tensor grad_head_W_;
+    std::vector<Cluster> clusters_;
+    bool accumulate_gradients_ = false;
+};
\ No newline at end of file
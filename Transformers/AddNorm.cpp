@@ -1,5 +1,6 @@
 #include "AddNorm.h"
 #include "utils.h"
+#include "ThreadPool.h"
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
@@ -8,109 +9,138 @@ extern int paramCount;
 
 AddNorm::AddNorm(int embedding_dim, float epsilon)
     : embedding_dim_(embedding_dim), epsilon_(epsilon),
-    gamma_(embedding_dim), beta_(embedding_dim) {
+    gamma_(1, embedding_dim), beta_(1, embedding_dim) {
 
     paramCount += 2 * embedding_dim_;
 }
 
-std::vector<std::vector<float>> AddNorm::forward_an(const std::vector<std::vector<float>>& input,
-    const std::vector<std::vector<float>>& residual) {
-    size_t seq_len = input.size();
-    //      
-    add_.resize(seq_len, std::vector<float>(embedding_dim_));
-    mean_.resize(seq_len, 0.0f);
-    stddev_.resize(seq_len, 0.0f);
-    norm_.resize(seq_len, std::vector<float>(embedding_dim_));
-
-    //  1:  add
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            add_[i][j] = input[i][j] + residual[i][j];
+Tensor AddNorm::forward_an(const Tensor& input, const Tensor& residual) {
+    size_t seq_len = input.rows();
+    stddev_.assign(seq_len, 0.0f);
+    Tensor norm(seq_len, embedding_dim_);
+    Tensor output(seq_len, embedding_dim_);
+    const float* gamma = gamma_.data();
+    const float* beta = beta_.data();
+
+    // Строки независимы: каждая задача проходит шаги 1-3 для своего диапазона строк
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallel_for(0, seq_len, ThreadPool::grain_size(seq_len, 8 * embedding_dim_), [&](size_t row_begin, size_t row_end) {
+        std::vector<float> add(embedding_dim_);
+        for (size_t i = row_begin; i < row_end; ++i) {
+            // Шаг 1: Вычисление add
+            for (int j = 0; j < embedding_dim_; ++j) {
+                add[j] = input[i][j] + residual[i][j];
+            }
+
+            // Шаг 2: Вычисление mean и stddev
+            float mean = 0.0f;
+            for (int j = 0; j < embedding_dim_; ++j) {
+                mean += add[j];
+            }
+            mean /= embedding_dim_;
+
+            for (int j = 0; j < embedding_dim_; ++j) {
+                stddev_[i] += (add[j] - mean) * (add[j] - mean);
+            }
+            stddev_[i] = std::sqrt(stddev_[i] / embedding_dim_) + epsilon_;
+
+            // Шаг 3: Нормализация и выход
+            for (int j = 0; j < embedding_dim_; ++j) {
+                norm[i][j] = (add[j] - mean) / stddev_[i];
+                output[i][j] = gamma[j] * norm[i][j] + beta[j];
+            }
         }
-    }
-
-    //  2:  mean  stddev
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            mean_[i] += add_[i][j];
-        }
-        mean_[i] /= embedding_dim_;
-
-        for (int j = 0; j < embedding_dim_; ++j) {
-            stddev_[i] += (add_[i][j] - mean_[i]) * (add_[i][j] - mean_[i]);
-        }
-        stddev_[i] = std::sqrt(stddev_[i] / embedding_dim_) + epsilon_;
-    }
-
-    //  3:   
-    std::vector<std::vector<float>> output(seq_len, std::vector<float>(embedding_dim_));
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            norm_[i][j] = (add_[i][j] - mean_[i]) / stddev_[i];
-            output[i][j] = gamma_[j] * norm_[i][j] + beta_[j];
-        }
-    }
+    });
+    norm_.store(norm, activation_precision_);
 
     return output;
 }
 
-std::vector<std::vector<float>> AddNorm::backward_an(const std::vector<std::vector<float>>& grad_output,
-    float learning_rate) {
-    size_t seq_len = add_.size();
+Tensor AddNorm::backward_an(const Tensor& grad_output, float learning_rate) {
+    size_t seq_len = norm_.rows();
     if (seq_len == 0) {
-        throw std::runtime_error("    ");
+        throw std::runtime_error("Прямой проход не был выполнен");
     }
 
-    //   add_, mean_, stddev_, norm_   
-    std::vector<float> grad_gamma(embedding_dim_, 0.0f);
-    std::vector<float> grad_beta(embedding_dim_, 0.0f);
-    std::vector<std::vector<float>> grad_norm(seq_len, std::vector<float>(embedding_dim_));
-
-    //    gamma, beta  norm
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            grad_norm[i][j] = grad_output[i][j] * gamma_[j];
-            grad_gamma[j] += grad_output[i][j] * norm_[i][j];
-            grad_beta[j] += grad_output[i][j];
-        }
-    }
-
-    //   add
-    std::vector<std::vector<float>> grad_add(seq_len, std::vector<float>(embedding_dim_));
-    for (size_t i = 0; i < seq_len; ++i) {
-        float sum_grad_norm = 0.0f;
-        float sum_grad_norm_x = 0.0f;
-        for (int j = 0; j < embedding_dim_; ++j) {
-            sum_grad_norm += grad_norm[i][j];
-            sum_grad_norm_x += grad_norm[i][j] * (add_[i][j] - mean_[i]);
-        }
-        for (int j = 0; j < embedding_dim_; ++j) {
-            grad_add[i][j] = (grad_norm[i][j] - sum_grad_norm / embedding_dim_ -
-                (add_[i][j] - mean_[i]) * sum_grad_norm_x / (embedding_dim_ * stddev_[i] * stddev_[i])) / stddev_[i];
-        }
-    }
-
-    //  
-    for (int j = 0; j < embedding_dim_; ++j) {
-        gamma_[j] -= learning_rate * grad_gamma[j];
-        beta_[j] -= learning_rate * grad_beta[j];
-    }
+    // Используем сохранённые norm_ и stddev_ для вычисления градиентов (add - mean = norm * stddev).
+    // Строки обрабатываются параллельно; градиенты gamma и beta (первая и вторая половины вектора)
+    // суммируются по кускам строк и складываются в порядке кусков
+    Tensor grad_add(seq_len, embedding_dim_);
+    const float* gamma = gamma_.data();
+    ThreadPool& pool = ThreadPool::instance();
+    std::vector<float> grad_params = pool.parallel_reduce(0, seq_len, ThreadPool::grain_size(seq_len, 12 * embedding_dim_),
+        std::vector<float>(2 * embedding_dim_, 0.0f),
+        [&](size_t row_begin, size_t row_end) {
+            std::vector<float> partial(2 * embedding_dim_, 0.0f);
+            float* grad_gamma = partial.data();
+            float* grad_beta = partial.data() + embedding_dim_;
+            std::vector<float> grad_norm(embedding_dim_);
+            std::vector<float> norm(embedding_dim_);
+            for (size_t i = row_begin; i < row_end; ++i) {
+                norm_.row_to_float(i, norm.data());
+                // Вычисление градиентов по gamma, beta и norm
+                for (int j = 0; j < embedding_dim_; ++j) {
+                    grad_norm[j] = grad_output[i][j] * gamma[j];
+                    grad_gamma[j] += grad_output[i][j] * norm[j];
+                    grad_beta[j] += grad_output[i][j];
+                }
+
+                // Градиент по add
+                float sum_grad_norm = 0.0f;
+                float sum_grad_norm_x = 0.0f;
+                for (int j = 0; j < embedding_dim_; ++j) {
+                    sum_grad_norm += grad_norm[j];
+                    sum_grad_norm_x += grad_norm[j] * norm[j];
+                }
+                for (int j = 0; j < embedding_dim_; ++j) {
+                    grad_add[i][j] = (grad_norm[j] - sum_grad_norm / embedding_dim_ -
+                        norm[j] * sum_grad_norm_x / embedding_dim_) / stddev_[i];
+                }
+            }
+            return partial;
+        },
+        [](std::vector<float> acc, const std::vector<float>& partial) {
+            for (size_t j = 0; j < acc.size(); ++j) acc[j] += partial[j];
+            return acc;
+        });
+    const float* grad_gamma = grad_params.data();
+    const float* grad_beta = grad_params.data() + embedding_dim_;
+
+    // Обновление параметров (или накопление градиентов)
+    utils::apply_gradient(gamma_.data(), grad_gamma_.data(), grad_gamma, embedding_dim_, learning_rate, accumulate_gradients_);
+    utils::apply_gradient(beta_.data(), grad_beta_.data(), grad_beta, embedding_dim_, learning_rate, accumulate_gradients_);
 
     return grad_add;
 }
 
-std::vector<std::vector<float>> AddNorm::backward_an(const std::vector<std::vector<float>>& grad_output,
-    const std::vector<std::vector<float>>& grad_residual,
-    float learning_rate) {
+Tensor AddNorm::backward_an(const Tensor& grad_output, const Tensor& grad_residual, float learning_rate) {
     auto sum_grad_ff_add = utils::add_embeddings(grad_output, grad_residual);
     auto grad_add_crose = backward_an(sum_grad_ff_add, learning_rate);
 
     return grad_add_crose;
 }
 
+void AddNorm::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенные буферы не перевыделяются: они могут жить в общей области параметров
+    if (!enabled) {
+        grad_gamma_ = Tensor();
+        grad_beta_ = Tensor();
+    }
+    else if (grad_gamma_.empty()) {
+        grad_gamma_.assign(1, embedding_dim_, 0.0f);
+        grad_beta_.assign(1, embedding_dim_, 0.0f);
+    }
+}
+
+void AddNorm::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &gamma_, &grad_gamma_, nullptr, "gamma" });
+    params.push_back({ &beta_, &grad_beta_, nullptr, "beta" });
+}
+
 void AddNorm::initialize_random() {
-    std::fill(gamma_.begin(), gamma_.end(), 1.0f);
-    std::fill(beta_.begin(), beta_.end(), 0.0f);
+    gamma_.fill(1.0f);
+    beta_.fill(0.0f);
 }
 
 void AddNorm::save_weights(std::ofstream& out) const {
@@ -122,5 +152,5 @@ void AddNorm::load_weights(std::ifstream& in) {
     utils::read_vector(in, gamma_);
     utils::read_vector(in, beta_);
     if ((int)gamma_.size() != embedding_dim_ || (int)beta_.size() != embedding_dim_)
-        throw std::runtime_error("  gamma_/beta_   AddNorm");
+        throw std::runtime_error("Неверный размер gamma_/beta_ при загрузке AddNorm");
 }
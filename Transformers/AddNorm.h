@@ -1,4 +1,7 @@
 #pragma once
+#include "Tensor.h"
+#include "Parameter.h"
+#include "Precision.h"
 #include <vector>
 #include <fstream>
 
@@ -6,27 +9,34 @@ class AddNorm {
 public:
     AddNorm(int embedding_dim, float epsilon = 1e-5);
 
-    std::vector<std::vector<float>> forward_an(const std::vector<std::vector<float>>& input, const std::vector<std::vector<float>>& residual);
+    Tensor forward_an(const Tensor& input, const Tensor& residual);
 
-    //    
-    std::vector<std::vector<float>> backward_an(const std::vector<std::vector<float>>& grad_output, float learning_rate);
+    // Версия с одним градиентом
+    Tensor backward_an(const Tensor& grad_output, float learning_rate);
 
-    //    
-    std::vector<std::vector<float>> backward_an(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& grad_residual, float learning_rate);
+    // Версия с двумя градиентами
+    Tensor backward_an(const Tensor& grad_output, const Tensor& grad_residual, float learning_rate);
 
-    //  ( ),  ( )    add&norm
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров add&norm
     void initialize_random();
     void save_weights(std::ofstream& out) const;
     void load_weights(std::ifstream& in);
 
+    // Режим накопления: backward_an складывает градиенты в буферы вместо шага SGD
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    // Формат сохраняемого для backward нормализованного входа
+    void set_activation_precision(Precision format) { activation_precision_ = format; }
+
 private:
     int embedding_dim_;
     float epsilon_;
-    std::vector<float> gamma_;
-    std::vector<float> beta_;
-    //     
-    std::vector<std::vector<float>> add_;
-    std::vector<float> mean_;
+    Tensor gamma_;            // 1 x embedding_dim
+    Tensor beta_;             // 1 x embedding_dim
+    Tensor grad_gamma_, grad_beta_; // Накопленные градиенты (только в режиме накопления)
+    bool accumulate_gradients_ = false;
+    Precision activation_precision_ = Precision::Float32;
+    // Для backward сохраняются norm и stddev строк: add - mean = norm * stddev, поэтому сам add не нужен
     std::vector<float> stddev_;
-    std::vector<std::vector<float>> norm_;
+    SavedActivation norm_;
 };
\ No newline at end of file
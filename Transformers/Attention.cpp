@@ -0,0 +1,192 @@
+﻿#include "Attention.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace attention {
+    namespace {
+        void zero(TensorView M) {
+            for (size_t i = 0; i < M.rows(); ++i) {
+                std::fill(M[i], M[i] + M.cols(), 0.0f);
+            }
+        }
+
+        // Число видимых ключей тайла [k_pos0, k_pos0 + bk) для запроса с абсолютной позицией q_pos.
+        // При маске всё, что правее, не вычисляется и не экспонируется
+        size_t visible_cols(bool causal, size_t q_pos, size_t k_pos0, size_t bk) {
+            if (!causal) return bk;
+            if (q_pos < k_pos0) return 0;
+            return std::min(bk, q_pos - k_pos0 + 1);
+        }
+
+        // Тайл scores: S = scale * Q_blk * K_blk^T
+        void compute_tile(ConstTensorView Q_blk, ConstTensorView K_blk, float scale, Tensor& S) {
+            S.resize(Q_blk.rows(), K_blk.rows());
+            utils::gemm(false, true, scale, Q_blk, K_blk, 0.0f, S);
+        }
+
+        void check_shapes(ConstTensorView Q, ConstTensorView K, ConstTensorView V, ConstTensorView O) {
+            if (Q.cols() != K.cols() || K.rows() != V.rows() || O.rows() != Q.rows() || O.cols() != V.cols()) {
+                throw std::invalid_argument("attention: matrix dimensions do not match");
+            }
+        }
+    }
+
+    void forward(ConstTensorView Q, ConstTensorView K, ConstTensorView V, float scale,
+        bool causal, size_t q_offset, TensorView O, float* lse) {
+        check_shapes(Q, K, V, O);
+        size_t n_q = Q.rows();
+        size_t n_kv = K.rows();
+        size_t d_v = V.cols();
+
+        thread_local Tensor S;
+        thread_local std::vector<float> row_max, row_sum;
+
+        for (size_t q0 = 0; q0 < n_q; q0 += kBlockQ) {
+            size_t bq = std::min(kBlockQ, n_q - q0);
+            ConstTensorView Q_blk = Q.block(q0, 0, bq, Q.cols());
+            TensorView O_blk = O.block(q0, 0, bq, d_v);
+            zero(O_blk);
+            row_max.assign(bq, -INFINITY);
+            row_sum.assign(bq, 0.0f);
+
+            // При маске тайлы ключей правее последнего запроса блока полностью закрыты и пропускаются
+            size_t kv_end = causal ? std::min(n_kv, q_offset + q0 + bq) : n_kv;
+            for (size_t k0 = 0; k0 < kv_end; k0 += kBlockKV) {
+                // Ширина тайла ограничена видимой частью для последней строки блока
+                size_t bk = std::min(kBlockKV, kv_end - k0);
+                compute_tile(Q_blk, K.block(k0, 0, bk, K.cols()), scale, S);
+
+                // Онлайн softmax: при росте максимума уже накопленные сумма и выход домножаются на поправку
+                for (size_t i = 0; i < bq; ++i) {
+                    float* s = S[i];
+                    size_t visible = visible_cols(causal, q_offset + q0 + i, k0, bk);
+                    if (visible == 0) {
+                        std::fill(s, s + bk, 0.0f);
+                        continue;
+                    }
+                    float new_max = std::max(row_max[i], *std::max_element(s, s + visible));
+                    float correction = std::exp(row_max[i] - new_max);
+                    float sum = 0.0f;
+                    for (size_t j = 0; j < visible; ++j) {
+                        s[j] = std::exp(s[j] - new_max);
+                        sum += s[j];
+                    }
+                    std::fill(s + visible, s + bk, 0.0f);
+                    row_sum[i] = row_sum[i] * correction + sum;
+                    row_max[i] = new_max;
+                    if (correction != 1.0f) {
+                        float* o = O_blk[i];
+                        for (size_t c = 0; c < d_v; ++c) o[c] *= correction;
+                    }
+                }
+                utils::gemm(false, false, 1.0f, S, V.block(k0, 0, bk, d_v), 1.0f, O_blk);
+            }
+
+            for (size_t i = 0; i < bq; ++i) {
+                float inv_sum = 1.0f / row_sum[i];
+                float* o = O_blk[i];
+                for (size_t c = 0; c < d_v; ++c) o[c] *= inv_sum;
+                if (lse) lse[q0 + i] = row_max[i] + std::log(row_sum[i]);
+            }
+        }
+    }
+
+    void backward_delta(ConstTensorView O, ConstTensorView dO, float* D) {
+        for (size_t i = 0; i < O.rows(); ++i) {
+            float acc = 0.0f;
+            for (size_t c = 0; c < O.cols(); ++c) acc += dO[i][c] * O[i][c];
+            D[i] = acc;
+        }
+    }
+
+    void backward_range(ConstTensorView Q, ConstTensorView K, ConstTensorView V, ConstTensorView dO,
+        const float* lse, const float* D, float scale, bool causal, size_t q_offset,
+        size_t q_begin, size_t q_end, size_t k_begin, size_t k_end,
+        TensorView dQ, TensorView dK, TensorView dV) {
+        size_t d_k = Q.cols();
+        size_t d_v = V.cols();
+        bool need_dQ = !dQ.empty();
+        bool need_dKV = !dK.empty();
+
+        thread_local Tensor P, dP, dQ_tile;
+
+        // При маске ключи правее последнего запроса диапазона никому не видны
+        if (causal) {
+            k_end = std::min(k_end, q_offset + q_end);
+        }
+
+        // Внешний цикл по тайлам K/V: dK и dV тайла накапливаются, пока он в кэше
+        for (size_t k0 = k_begin; k0 < k_end; k0 += kBlockKV) {
+            size_t bk = std::min(kBlockKV, k_end - k0);
+            ConstTensorView K_blk = K.block(k0, 0, bk, d_k);
+            ConstTensorView V_blk = V.block(k0, 0, bk, d_v);
+
+            // При маске тайл ключей видят только запросы с позицией >= k0: блоки выше диагонали пропускаются
+            size_t q_first = q_begin;
+            if (causal && k0 > q_offset + q_begin) {
+                q_first = q_begin + (k0 - q_offset - q_begin) / kBlockQ * kBlockQ;
+            }
+            for (size_t q0 = q_first; q0 < q_end; q0 += kBlockQ) {
+                size_t bq = std::min(kBlockQ, q_end - q0);
+                ConstTensorView Q_blk = Q.block(q0, 0, bq, d_k);
+                ConstTensorView dO_blk = dO.block(q0, 0, bq, d_v);
+
+                // Восстановление весов внимания: P = exp(S - lse), замаскированные позиции — нули без exp
+                compute_tile(Q_blk, K_blk, scale, P);
+                for (size_t i = 0; i < bq; ++i) {
+                    float row_lse = lse[q0 + i];
+                    size_t visible = visible_cols(causal, q_offset + q0 + i, k0, bk);
+                    for (size_t j = 0; j < visible; ++j) P[i][j] = std::exp(P[i][j] - row_lse);
+                    std::fill(P[i] + visible, P[i] + bk, 0.0f);
+                }
+
+                // dV += P^T dO
+                if (need_dKV) {
+                    utils::gemm(true, false, 1.0f, P, dO_blk, 1.0f, dV.block(k0, 0, bk, d_v));
+                }
+
+                // dS = P * (dO V^T - D)
+                dP.resize(bq, bk);
+                utils::gemm(false, true, 1.0f, dO_blk, V_blk, 0.0f, dP);
+                for (size_t i = 0; i < bq; ++i) {
+                    float d = D[q0 + i];
+                    for (size_t j = 0; j < bk; ++j) dP[i][j] = P[i][j] * (dP[i][j] - d);
+                }
+
+                // Масштаб 1/sqrt(d) учитывается коэффициентом alpha. Вклад тайла в dQ считается отдельно
+                // и прибавляется: dQ — сумма вкладов в порядке блоков ключей, побитно та же, если блоки ключей
+                // считаются разными задачами в свои буферы (GEMM малых тайлов накапливает прямо в C)
+                if (need_dQ) {
+                    dQ_tile.resize(bq, d_k);
+                    utils::gemm(false, false, scale, dP, K_blk, 0.0f, dQ_tile);
+                    TensorView dQ_blk = dQ.block(q0, 0, bq, d_k);
+                    for (size_t i = 0; i < bq; ++i) {
+                        for (size_t c = 0; c < d_k; ++c) dQ_blk[i][c] += dQ_tile[i][c];
+                    }
+                }
+                if (need_dKV) {
+                    utils::gemm(true, false, scale, dP, Q_blk, 1.0f, dK.block(k0, 0, bk, d_k));
+                }
+            }
+        }
+    }
+
+    void backward(ConstTensorView Q, ConstTensorView K, ConstTensorView V,
+        ConstTensorView O, ConstTensorView dO, const float* lse, float scale,
+        bool causal, size_t q_offset, TensorView dQ, TensorView dK, TensorView dV) {
+        check_shapes(Q, K, V, O);
+
+        thread_local std::vector<float> D;
+        D.resize(Q.rows());
+        backward_delta(O, dO, D.data());
+
+        zero(dQ);
+        zero(dK);
+        zero(dV);
+        backward_range(Q, K, V, dO, lse, D.data(), scale, causal, q_offset,
+            0, Q.rows(), 0, K.rows(), dQ, dK, dV);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+﻿#pragma once
+#include "Tensor.h"
+#include <cstddef>
+
+// Слитное (fused) внимание одной головы в стиле flash-attention: K/V обходятся тайлами,
+// softmax считается онлайн (текущий максимум и сумма по строке), матрица scores seq_Q x seq_KV не хранится.
+// Память — O(seq_len): кроме выхода сохраняется только логарифм суммы экспонент по строкам (lse)
+namespace attention {
+    // Размеры тайлов по запросам и по ключам
+    constexpr size_t kBlockQ = 64;
+    constexpr size_t kBlockKV = 64;
+
+    // O = softmax(scale * Q K^T + маска) V.
+    // causal: запрос i (абсолютная позиция q_offset + i) видит только ключи j <= q_offset + i;
+    // закрытые маской тайлы и позиции не вычисляются и не экспонируются (примерно вдвое меньше работы).
+    // lse — массив из Q.rows() элементов для обратного прохода; может быть nullptr (инференс)
+    void forward(ConstTensorView Q, ConstTensorView K, ConstTensorView V, float scale,
+        bool causal, size_t q_offset, TensorView O, float* lse);
+
+    // Обратный проход: веса внимания пересчитываются по тайлам из Q, K и lse.
+    // dQ, dK, dV перезаписываются
+    void backward(ConstTensorView Q, ConstTensorView K, ConstTensorView V,
+        ConstTensorView O, ConstTensorView dO, const float* lse, float scale,
+        bool causal, size_t q_offset, TensorView dQ, TensorView dK, TensorView dV);
+
+    // Части обратного прохода для распараллеливания одной головы.
+    // D_i = dO_i . O_i — член производной softmax, общий для всех тайлов строки i
+    void backward_delta(ConstTensorView O, ConstTensorView dO, float* D);
+    // Тайлы запросов [q_begin, q_end) x ключей [k_begin, k_end): градиенты добавляются (+=) в те из dQ, dK, dV,
+    // что не пусты (dK и dV — вместе). Задачи по блокам ключей пишут dK/dV только своих строк, а вклад в dQ
+    // (общий для всех блоков ключей) — каждая в свой буфер: так каждый тайл P/dP считается один раз
+    void backward_range(ConstTensorView Q, ConstTensorView K, ConstTensorView V, ConstTensorView dO,
+        const float* lse, const float* D, float scale, bool causal, size_t q_offset,
+        size_t q_begin, size_t q_end, size_t k_begin, size_t k_end,
+        TensorView dQ, TensorView dK, TensorView dV);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <algorithm>
+#include <vector>
+
+// Разметка мини-батча по строкам матриц: последовательность b занимает строки
+// [b * max_len, (b + 1) * max_len), из них первые lengths[b] — реальные токены, остальные — заполнение (padding).
+// Пустая разметка означает одну последовательность без заполнения (все строки матрицы)
+struct BatchLayout {
+    int max_len = 0;
+    std::vector<int> lengths;
+
+    static BatchLayout from_lengths(const std::vector<int>& lengths) {
+        BatchLayout layout;
+        layout.lengths = lengths;
+        layout.max_len = lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end());
+        return layout;
+    }
+
+    bool empty() const { return lengths.empty(); }
+    int batch_size() const { return static_cast<int>(lengths.size()); }
+    int rows() const { return batch_size() * max_len; }
+};
\ No newline at end of file
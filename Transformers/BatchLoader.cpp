@@ -0,0 +1,100 @@
+﻿#include "BatchLoader.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+BatchLoader::BatchLoader(const Dataset& dataset, const BatchLoaderConfig& config)
+    : dataset_(dataset), config_(config) {
+    if (config_.batch_size == 0) {
+        throw std::invalid_argument("BatchLoader: размер батча должен быть положительным");
+    }
+    if (config_.queue_capacity == 0) config_.queue_capacity = 1;
+    thread_ = std::thread(&BatchLoader::loader_loop, this);
+}
+
+BatchLoader::~BatchLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    space_cv_.notify_all();
+    thread_.join();
+}
+
+bool BatchLoader::next(Batch& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (queue_.empty()) {
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+        return false;
+    }
+    batch = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    space_cv_.notify_one();
+    return true;
+}
+
+bool BatchLoader::push(Batch&& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this] { return queue_.size() < config_.queue_capacity || stopping_; });
+    if (stopping_) return false;
+    queue_.push_back(std::move(batch));
+    lock.unlock();
+    ready_cv_.notify_one();
+    return true;
+}
+
+void BatchLoader::loader_loop() {
+    try {
+        std::vector<size_t> shard_order(dataset_.shard_count());
+        std::vector<size_t> pairs;
+        std::vector<int> source, target;
+        for (long long epoch = config_.first_epoch; epoch < config_.num_epochs && dataset_.size() > 0; ++epoch) {
+            // Порядок эпохи зависит только от seed и её номера
+            std::mt19937_64 rng(config_.seed * 0x9E3779B97F4A7C15ull + static_cast<unsigned long long>(epoch));
+            std::iota(shard_order.begin(), shard_order.end(), size_t(0));
+            if (config_.shuffle) std::shuffle(shard_order.begin(), shard_order.end(), rng);
+
+            Batch batch;
+            size_t remaining = dataset_.size();
+            for (size_t shard : shard_order) {
+                pairs.resize(dataset_.shard_begin(shard + 1) - dataset_.shard_begin(shard));
+                std::iota(pairs.begin(), pairs.end(), dataset_.shard_begin(shard));
+                if (config_.shuffle) std::shuffle(pairs.begin(), pairs.end(), rng);
+
+                for (size_t pair : pairs) {
+                    dataset_.read_pair(pair, source, target);
+                    if (target.size() < 2) {
+                        throw std::runtime_error("BatchLoader: в target пары " + std::to_string(pair) + " меньше двух токенов");
+                    }
+                    batch.source.push_back(source);
+                    batch.target.emplace_back(target.begin(), target.end() - 1);
+                    batch.labels.emplace_back(target.begin() + 1, target.end());
+                    --remaining;
+                    if (batch.source.size() == config_.batch_size || remaining == 0) {
+                        batch.epoch = epoch;
+                        batch.last_in_epoch = remaining == 0;
+                        if (!push(std::move(batch))) return;
+                        batch = Batch();
+                    }
+                }
+            }
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    ready_cv_.notify_all();
+}
\ No newline at end of file
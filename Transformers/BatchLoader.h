@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "Dataset.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BatchLoaderConfig {
+    size_t batch_size = 32;
+    size_t queue_capacity = 4;    // Готовых батчей впереди обучения
+    bool shuffle = true;
+    unsigned long long seed = 0;
+    long long first_epoch = 0;    // Эпохи [first_epoch, num_epochs)
+    long long num_epochs = 1;
+};
+
+// Мини-батч в формате DataParallelTrainer::train_step: target — вход декодера (без последнего токена),
+// labels — target, сдвинутый на один токен
+struct Batch {
+    std::vector<std::vector<int>> source;
+    std::vector<std::vector<int>> target;
+    std::vector<std::vector<int>> labels;
+    long long epoch = 0;
+    bool last_in_epoch = false;   // Последний батч эпохи
+};
+
+// Загрузчик батчей в отдельном потоке: читает пары из набора, перемешивает и складывает готовые батчи
+// в ограниченную очередь, пока обучение считает предыдущие; чтение шардов и подготовка идут параллельно с шагами.
+// Перемешивание двухуровневое, чтобы чтение оставалось локальным: порядок шардов случаен, внутри шарда —
+// случайная перестановка пар. Перестановки определяются seed и номером эпохи, поэтому при продолжении
+// с first_epoch порядок тот же, что и без перерыва. Батч может захватывать пары соседних шардов
+class BatchLoader {
+public:
+    BatchLoader(const Dataset& dataset, const BatchLoaderConfig& config);
+    // Останавливает поток, не дожидаясь конца эпох
+    ~BatchLoader();
+    BatchLoader(const BatchLoader&) = delete;
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    // Следующий батч (ждёт, пока он будет готов); false — эпохи закончились.
+    // Ошибка чтения набора в потоке загрузчика пробрасывается здесь
+    bool next(Batch& batch);
+
+private:
+    void loader_loop();
+    // Кладёт батч в очередь (ждёт места); false — загрузчик останавливают
+    bool push(Batch&& batch);
+
+    const Dataset& dataset_;
+    BatchLoaderConfig config_;
+
+    std::deque<Batch> queue_;
+    bool done_ = false;       // Поток положил последний батч или завершился с ошибкой
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable ready_cv_;   // В очереди появился батч или поток закончил
+    std::condition_variable space_cv_;   // В очереди освободилось место или загрузчик останавливают
+    std::thread thread_;
+};
\ No newline at end of file
@@ -0,0 +1,122 @@
+﻿#include "BeamSearch.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+    // Кандидат продолжения: луч-родитель, токен и суммарный log p
+    struct Candidate {
+        float log_prob;
+        int beam;
+        int token;
+
+        bool operator>(const Candidate& other) const { return log_prob > other.log_prob; }
+    };
+}
+
+BeamSearch::BeamSearch(const BeamSearchConfig& config) : config_(config) {
+    if (config.beam_width <= 0 || config.max_length <= 0 || config.length_penalty < 0.0f) {
+        throw std::invalid_argument("beam_width и max_length должны быть положительными, length_penalty — неотрицательным");
+    }
+}
+
+float BeamSearch::length_normalized(float log_prob, size_t length) const {
+    return log_prob / std::pow((5.0f + static_cast<float>(length)) / 6.0f, config_.length_penalty);
+}
+
+std::vector<BeamHypothesis> BeamSearch::search(Transformer& model, const EncoderMemory& memory,
+    const std::vector<int>& prefix, int eos_id) const {
+    if (prefix.empty()) {
+        throw std::invalid_argument("Префикс лучевого поиска не может быть пустым");
+    }
+    const size_t width = static_cast<size_t>(config_.beam_width);
+
+    // Префикс (кроме последнего токена) проходит декодер один раз — до ветвления лучей
+    model.reset_decode_cache();
+    for (size_t i = 0; i + 1 < prefix.size(); ++i) {
+        model.decode_step(prefix[i], memory);
+    }
+
+    // Сначала один луч; после первого шага их становится beam_width
+    std::vector<BeamHypothesis> beams(1);
+    std::vector<int> last_tokens = { prefix.back() };
+    std::vector<BeamHypothesis> finished;
+
+    for (int step = 0; step < config_.max_length; ++step) {
+        const Tensor& probabilities = model.decode_beam_step(last_tokens, memory);
+        const size_t vocab_size = probabilities.cols();
+
+        // 2 * width лучших продолжений по всем лучам (min-куча): даже если width из них закончатся EOS,
+        // живых лучей останется width
+        const size_t keep = 2 * width;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> best;
+        for (size_t b = 0; b < beams.size(); ++b) {
+            const float* row = probabilities[b];
+            for (size_t token = 0; token < vocab_size; ++token) {
+                float log_prob = beams[b].log_prob + std::log(std::max(row[token], FLT_MIN));
+                if (best.size() < keep) {
+                    best.push({ log_prob, static_cast<int>(b), static_cast<int>(token) });
+                }
+                else if (log_prob > best.top().log_prob) {
+                    best.pop();
+                    best.push({ log_prob, static_cast<int>(b), static_cast<int>(token) });
+                }
+            }
+        }
+        std::vector<Candidate> candidates;
+        while (!best.empty()) {
+            candidates.push_back(best.top());
+            best.pop();
+        }
+        std::reverse(candidates.begin(), candidates.end());
+
+        std::vector<BeamHypothesis> next_beams;
+        std::vector<int> parents;
+        for (const Candidate& candidate : candidates) {
+            if (next_beams.size() == width) break;
+            BeamHypothesis hypothesis;
+            hypothesis.tokens = beams[candidate.beam].tokens;
+            hypothesis.tokens.push_back(candidate.token);
+            hypothesis.log_prob = candidate.log_prob;
+            hypothesis.score = length_normalized(candidate.log_prob, hypothesis.tokens.size());
+            if (candidate.token == eos_id) {
+                hypothesis.finished = true;
+                finished.push_back(std::move(hypothesis));
+                continue;
+            }
+            next_beams.push_back(std::move(hypothesis));
+            parents.push_back(candidate.beam);
+        }
+        beams = std::move(next_beams);
+        if (beams.empty()) break;
+
+        // Остановка: набрано width завершённых гипотез, и лучший живой луч уже не обгоняет худшую из них
+        // (log p только убывает; при length_penalty > 0 это оценка по текущей длине, как в GNMT)
+        if (finished.size() >= width) {
+            std::sort(finished.begin(), finished.end(), [](const BeamHypothesis& a, const BeamHypothesis& b) { return a.score > b.score; });
+            finished.resize(width);
+            if (beams.empty() || beams.front().score < finished.back().score) {
+                beams.clear();
+                break;
+            }
+        }
+        if (step + 1 == config_.max_length) break;
+
+        model.reorder_decode_cache(parents);
+        last_tokens.clear();
+        for (const auto& beam : beams) {
+            last_tokens.push_back(beam.tokens.back());
+        }
+    }
+
+    // Незавершённые лучи (ограничение max_length) — тоже кандидаты
+    for (auto& beam : beams) {
+        finished.push_back(std::move(beam));
+    }
+    std::sort(finished.begin(), finished.end(), [](const BeamHypothesis& a, const BeamHypothesis& b) { return a.score > b.score; });
+    if (finished.size() > width) finished.resize(width);
+    return finished;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include "Transformer.h"
+#include <vector>
+
+struct BeamSearchConfig {
+    int beam_width = 4;
+    // Штраф длины GNMT: score = log p / ((5 + длина) / 6)^length_penalty. 0 — без нормировки (короткие гипотезы
+    // выигрывают), больше — длинные гипотезы штрафуются меньше
+    float length_penalty = 0.6f;
+    int max_length = 200;    // Число порождаемых токенов (без префикса)
+};
+
+struct BeamHypothesis {
+    std::vector<int> tokens;  // Порождённые токены (без префикса; EOS включён, если гипотеза завершена)
+    float log_prob = 0.0f;
+    float score = 0.0f;       // log_prob с учётом штрафа длины
+    bool finished = false;    // Гипотеза закончилась EOS, а не ограничением max_length
+};
+
+// Лучевой поиск поверх пошагового декодера Transformer с кэшем K/V.
+// Все живые лучи продвигаются вместе одним батчевым проходом декодера за шаг (Transformer::decode_beam_step),
+// память энкодера (K/V cross-attention) у лучей общая. После выбора продолжений кэш self-attention
+// переставляется по лучам-родителям. Живых лучей всегда beam_width: завершённые (EOS) гипотезы откладываются,
+// их место занимают следующие по вероятности кандидаты
+class BeamSearch {
+public:
+    explicit BeamSearch(const BeamSearchConfig& config = BeamSearchConfig());
+
+    // prefix — начало целевой последовательности (обычно { <BOS> }). Кэш декодера model сбрасывается.
+    // Возвращает до beam_width гипотез по убыванию score
+    std::vector<BeamHypothesis> search(Transformer& model, const EncoderMemory& memory,
+        const std::vector<int>& prefix, int eos_id) const;
+
+    const BeamSearchConfig& config() const { return config_; }
+
+private:
+    float length_normalized(float log_prob, size_t length) const;
+
+    BeamSearchConfig config_;
+};
\ No newline at end of file
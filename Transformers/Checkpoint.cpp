@@ -0,0 +1,282 @@
+﻿#include "Checkpoint.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kMagic[4] = { 'T', 'C', 'K', 'P' };
+    const uint32_t kVersion = 1;
+
+    struct CheckpointHeader {
+        char magic[4];
+        uint32_t version;
+        int32_t vocab_size;
+        int32_t embedding_dim;
+        int32_t num_layers;
+        int32_t num_heads;
+        int32_t hidden_dim;
+        uint32_t optimizer_type; // Значение OptimizerType
+        int64_t epoch;
+        int64_t optimizer_steps;
+        uint64_t values_size;    // Элементов в области и в каждом буфере состояния
+        uint32_t state_count;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(CheckpointHeader) == 64, "Заголовок контрольной точки занимает 64 байта");
+
+    CheckpointHeader make_header(const ModelConfig& config, OptimizerType type, long long epoch, long long steps,
+        size_t values_size, size_t state_count) {
+        CheckpointHeader header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.vocab_size = config.vocab_size;
+        header.embedding_dim = config.embedding_dim;
+        header.num_layers = config.num_layers;
+        header.num_heads = config.num_heads;
+        header.hidden_dim = config.hidden_dim;
+        header.optimizer_type = static_cast<uint32_t>(type);
+        header.epoch = epoch;
+        header.optimizer_steps = steps;
+        header.values_size = values_size;
+        header.state_count = static_cast<uint32_t>(state_count);
+        return header;
+    }
+
+    // Буферы состояния, которые есть у оптимизатора (у SGD и до первого шага — ни одного)
+    std::vector<const Tensor*> optimizer_states(const Optimizer& optimizer) {
+        std::vector<const Tensor*> states;
+        if (!optimizer.state1().empty()) states.push_back(&optimizer.state1());
+        if (!optimizer.state2().empty()) states.push_back(&optimizer.state2());
+        return states;
+    }
+
+    using Part = std::pair<const void*, size_t>;
+
+    // Пишет части во временный файл path + ".tmp", сбрасывает его на диск и атомарно переименовывает в path
+    void write_durably(const std::string& path, const std::vector<Part>& parts) {
+        const std::string tmp_path = path + ".tmp";
+#ifdef _WIN32
+        HANDLE file = CreateFileA(tmp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + tmp_path);
+        }
+        bool ok = true;
+        for (const Part& part : parts) {
+            const char* data = static_cast<const char*>(part.first);
+            size_t left = part.second;
+            while (ok && left > 0) {
+                DWORD chunk = static_cast<DWORD>(std::min<size_t>(left, 1u << 30));
+                DWORD written = 0;
+                ok = WriteFile(file, data, chunk, &written, nullptr) && written == chunk;
+                data += written;
+                left -= written;
+            }
+        }
+        ok = ok && FlushFileBuffers(file);
+        CloseHandle(file);
+        if (!ok || !MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            DeleteFileA(tmp_path.c_str());
+            throw std::runtime_error("Ошибка записи контрольной точки: " + path);
+        }
+#else
+        int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + tmp_path);
+        }
+        bool ok = true;
+        for (const Part& part : parts) {
+            const char* data = static_cast<const char*>(part.first);
+            size_t left = part.second;
+            while (ok && left > 0) {
+                ssize_t written = ::write(fd, data, left);
+                if (written < 0 && errno == EINTR) continue;
+                ok = written > 0;
+                if (ok) {
+                    data += written;
+                    left -= static_cast<size_t>(written);
+                }
+            }
+        }
+        ok = ::fsync(fd) == 0 && ok;
+        ok = ::close(fd) == 0 && ok;
+        if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            ::unlink(tmp_path.c_str());
+            throw std::runtime_error("Ошибка записи контрольной точки: " + path);
+        }
+        // Переименование становится устойчивым к сбою после сброса каталога
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int dir_fd = ::open(dir.c_str(), O_RDONLY);
+        if (dir_fd >= 0) {
+            ::fsync(dir_fd);
+            ::close(dir_fd);
+        }
+#endif
+    }
+}
+
+namespace checkpoint {
+    void save(const std::string& path, const ModelConfig& config, const ParameterArena& arena,
+        const Optimizer& optimizer, long long epoch) {
+        std::vector<const Tensor*> states = optimizer_states(optimizer);
+        CheckpointHeader header = make_header(config, optimizer.config().type, epoch, optimizer.steps(), arena.size(), states.size());
+        std::vector<Part> parts = { { &header, sizeof(header) }, { arena.values(), arena.size() * sizeof(float) } };
+        for (const Tensor* state : states) {
+            parts.push_back({ state->data(), state->size() * sizeof(float) });
+        }
+        write_durably(path, parts);
+    }
+
+    long long load(const std::string& path, const ModelConfig& config, ParameterArena& arena, Optimizer& optimizer) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
+        const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+
+        CheckpointHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+            throw std::runtime_error("Файл не является контрольной точкой поддерживаемой версии: " + path);
+        }
+        ModelConfig saved_config;
+        saved_config.vocab_size = header.vocab_size;
+        saved_config.embedding_dim = header.embedding_dim;
+        saved_config.num_layers = header.num_layers;
+        saved_config.num_heads = header.num_heads;
+        saved_config.hidden_dim = header.hidden_dim;
+        // Границы адаптивного softmax в заголовке не хранятся: другое разбиение словаря меняет размер параметров
+        saved_config.adaptive_cutoffs = config.adaptive_cutoffs;
+        saved_config.adaptive_shrink = config.adaptive_shrink;
+        if (saved_config != config || header.values_size != arena.size()) {
+            throw std::runtime_error("Контрольная точка сохранена для другой архитектуры: " + path);
+        }
+        if (header.optimizer_type != static_cast<uint32_t>(optimizer.config().type) || header.state_count > 2) {
+            throw std::runtime_error("Контрольная точка сохранена с другим типом оптимизатора: " + path);
+        }
+        const uint64_t values_bytes = header.values_size * sizeof(float);
+        if (file_size != sizeof(header) + (1 + header.state_count) * values_bytes) {
+            throw std::runtime_error("Размер контрольной точки не совпадает с заголовком (файл повреждён): " + path);
+        }
+
+        // Читаем всё до изменения модели, чтобы ошибка не оставила её наполовину загруженной
+        Tensor values(1, arena.size());
+        Tensor states[2];
+        in.read(reinterpret_cast<char*>(values.data()), values_bytes);
+        for (uint32_t s = 0; s < header.state_count; ++s) {
+            states[s].resize(1, arena.size());
+            in.read(reinterpret_cast<char*>(states[s].data()), values_bytes);
+        }
+        if (!in) throw std::runtime_error("Ошибка чтения контрольной точки: " + path);
+
+        optimizer.restore_state(header.optimizer_steps, std::move(states[0]), std::move(states[1]));
+        std::memcpy(arena.values(), values.data(), values_bytes);
+        arena.refresh_low_precision();
+        return header.epoch;
+    }
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path, std::chrono::seconds interval)
+    : path_(path), interval_(interval), last_save_(std::chrono::steady_clock::now()) {
+    thread_ = std::thread(&CheckpointWriter::writer_loop, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+bool CheckpointWriter::due() const {
+    return std::chrono::steady_clock::now() - last_save_ >= interval_;
+}
+
+void CheckpointWriter::save(const ModelConfig& config, const ParameterArena& arena, const Optimizer& optimizer, long long epoch) {
+    std::vector<const Tensor*> states = optimizer_states(optimizer);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rethrow_error();
+        // Буфер, который сейчас не пишется; ещё не начатый снимок в нём заменяется более свежим
+        int index = writing_ == 0 ? 1 : 0;
+        Snapshot& snapshot = buffers_[index];
+        snapshot.config = config;
+        snapshot.optimizer_type = optimizer.config().type;
+        snapshot.epoch = epoch;
+        snapshot.optimizer_steps = optimizer.steps();
+        snapshot.values_size = arena.size();
+        snapshot.state_count = states.size();
+        // Ёмкость буфера сохраняется между снимками: после первого раза копирование не выделяет память
+        snapshot.data.resize((1 + states.size()) * arena.size());
+        std::memcpy(snapshot.data.data(), arena.values(), arena.size() * sizeof(float));
+        for (size_t s = 0; s < states.size(); ++s) {
+            std::memcpy(snapshot.data.data() + (1 + s) * arena.size(), states[s]->data(), arena.size() * sizeof(float));
+        }
+        pending_ = index;
+    }
+    last_save_ = std::chrono::steady_clock::now();
+    cv_.notify_all();
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_ < 0 && writing_ < 0; });
+    rethrow_error();
+}
+
+void CheckpointWriter::rethrow_error() {
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void CheckpointWriter::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this] { return pending_ >= 0 || stopping_; });
+        if (pending_ < 0) {
+            return; // stopping_ и очередь пуста
+        }
+        writing_ = pending_;
+        pending_ = -1;
+        const Snapshot& snapshot = buffers_[writing_];
+        lock.unlock();
+
+        // Буфер writing_ не трогает никто, кроме этого потока, до сброса writing_
+        try {
+            CheckpointHeader header = make_header(snapshot.config, snapshot.optimizer_type, snapshot.epoch,
+                snapshot.optimizer_steps, snapshot.values_size, snapshot.state_count);
+            write_durably(path_, { { &header, sizeof(header) }, { snapshot.data.data(), snapshot.data.size() * sizeof(float) } });
+        }
+        catch (...) {
+            lock.lock();
+            error_ = std::current_exception();
+            lock.unlock();
+        }
+
+        lock.lock();
+        writing_ = -1;
+        cv_.notify_all();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include "ModelFile.h"
+#include "Optimizer.h"
+#include "ParameterArena.h"
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Контрольная точка обучения: значения области параметров, состояние оптимизатора и номер эпохи.
+// Формат: заголовок (64 байта: сигнатура "TCKP", версия, ModelConfig, тип оптимизатора, эпоха, число шагов
+// оптимизатора, размер области, число буферов состояния), затем значения области и буферы состояния (float).
+// Раскладка области определяется архитектурой, поэтому точка восстанавливается в модель той же архитектуры.
+// Файл пишется во временный рядом, сбрасывается на диск (fsync) и атомарно заменяет прежний:
+// при сбое на диске остаётся либо старая, либо новая точка целиком
+namespace checkpoint {
+    // Синхронная запись
+    void save(const std::string& path, const ModelConfig& config, const ParameterArena& arena,
+        const Optimizer& optimizer, long long epoch);
+    // Загружает значения в arena (той же раскладки) и состояние в optimizer (того же типа); возвращает эпоху
+    long long load(const std::string& path, const ModelConfig& config, ParameterArena& arena, Optimizer& optimizer);
+}
+
+// Фоновая запись контрольных точек с двойной буферизацией. save копирует веса и состояние оптимизатора
+// в свободный буфер снимка и сразу возвращается; поток записи сохраняет снимок, пока обучение идёт дальше.
+// Пока пишется один снимок, новый ставится в очередь во второй буфер (более свежий заменяет ещё не начатый),
+// поэтому обучение ждёт только копирования в память
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const std::string& path, std::chrono::seconds interval = std::chrono::minutes(5));
+    // Дописывает поставленный в очередь снимок и останавливает поток
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // С последнего снимка (или создания) прошло не меньше interval
+    bool due() const;
+    void save(const ModelConfig& config, const ParameterArena& arena, const Optimizer& optimizer, long long epoch);
+    // Ждёт записи всех снимков. Ошибка фоновой записи пробрасывается здесь или в следующем save
+    void wait();
+
+    const std::string& path() const { return path_; }
+
+private:
+    struct Snapshot {
+        ModelConfig config;
+        OptimizerType optimizer_type = OptimizerType::Sgd;
+        long long epoch = 0;
+        long long optimizer_steps = 0;
+        size_t values_size = 0;
+        size_t state_count = 0;
+        std::vector<float> data; // Значения области, затем буферы состояния
+    };
+
+    void writer_loop();
+    void rethrow_error();
+
+    std::string path_;
+    std::chrono::seconds interval_;
+    std::chrono::steady_clock::time_point last_save_;
+
+    Snapshot buffers_[2];
+    int writing_ = -1;      // Буфер, который пишет поток (-1 — нет)
+    int pending_ = -1;      // Буфер в очереди на запись (-1 — нет)
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
\ No newline at end of file
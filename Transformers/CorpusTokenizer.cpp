@@ -0,0 +1,105 @@
+﻿#include "CorpusTokenizer.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace corpus {
+
+    std::vector<std::string_view> split_chunks(std::string_view text, size_t target_chunks, size_t min_chunk_bytes) {
+        std::vector<std::string_view> chunks;
+        if (text.empty()) return chunks;
+        target_chunks = std::max<size_t>(target_chunks, 1);
+        size_t chunk_bytes = std::max(min_chunk_bytes, (text.size() + target_chunks - 1) / target_chunks);
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = text.size();
+            if (text.size() - begin > chunk_bytes) {
+                // Кусок продлевается до ближайшего перевода строки (включительно)
+                size_t newline = text.find('\n', begin + chunk_bytes - 1);
+                if (newline != std::string_view::npos) end = newline + 1;
+            }
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return chunks;
+    }
+
+    static std::vector<std::string_view> pool_chunks(std::string_view text) {
+        return split_chunks(text, ThreadPool::instance().num_threads() * ThreadPool::kChunksPerThread);
+    }
+
+    std::vector<int> tokenize(const BPETokenizer& tokenizer, std::string_view text) {
+        std::vector<std::string_view> chunks = pool_chunks(text);
+        std::vector<int> token_ids;
+        if (chunks.size() <= 1) {
+            BPEWordCache cache;
+            tokenizer.tokenize_into(text, token_ids, cache);
+            return token_ids;
+        }
+
+        ThreadPool& pool = ThreadPool::instance();
+        std::vector<std::vector<int>> parts(chunks.size());
+        pool.parallel_for(chunks.size(), [&](size_t i) {
+            BPEWordCache cache;
+            tokenizer.tokenize_into(chunks[i], parts[i], cache);
+        });
+
+        // Склейка: смещения кусков известны заранее, копирование тоже идёт параллельно
+        std::vector<size_t> offsets(parts.size() + 1, 0);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            offsets[i + 1] = offsets[i] + parts[i].size();
+        }
+        token_ids.resize(offsets.back());
+        pool.parallel_for(parts.size(), [&](size_t i) {
+            if (!parts[i].empty()) {
+                std::memcpy(token_ids.data() + offsets[i], parts[i].data(), parts[i].size() * sizeof(int));
+            }
+            std::vector<int>().swap(parts[i]);
+        });
+        return token_ids;
+    }
+
+    std::vector<int> tokenize_file(const BPETokenizer& tokenizer, const std::string& path) {
+        MappedFile file(path);
+        return tokenize(tokenizer, std::string_view(file.data(), file.size()));
+    }
+
+    std::vector<std::string_view> split_lines(std::string_view text) {
+        std::vector<std::string_view> lines;
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t end = text.find('\n', begin);
+            if (end == std::string_view::npos) end = text.size();
+            std::string_view line = text.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty()) lines.push_back(line);
+            begin = end + 1;
+        }
+        return lines;
+    }
+
+    std::vector<std::vector<int>> tokenize_lines(const BPETokenizer& tokenizer, const std::vector<std::string_view>& lines) {
+        if (lines.size() == 1) {
+            return { tokenize(tokenizer, lines[0]) };
+        }
+        std::vector<std::vector<int>> token_ids(lines.size());
+        if (lines.empty()) return token_ids;
+
+        size_t total_bytes = 0;
+        for (std::string_view line : lines) total_bytes += line.size();
+        size_t average_bytes = std::max<size_t>(total_bytes / lines.size(), 1);
+        size_t target_chunks = ThreadPool::instance().num_threads() * ThreadPool::kChunksPerThread;
+        size_t grain = std::max((lines.size() + target_chunks - 1) / target_chunks,
+            (kMinChunkBytes + average_bytes - 1) / average_bytes);
+
+        // Кэш слов общий для строк одного куска
+        ThreadPool::instance().parallel_for(0, lines.size(), grain, [&](size_t first, size_t last) {
+            BPEWordCache cache;
+            for (size_t i = first; i < last; ++i) {
+                tokenizer.tokenize_into(lines[i], token_ids[i], cache);
+            }
+        });
+        return token_ids;
+    }
+}
\ No newline at end of file
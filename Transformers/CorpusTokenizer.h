@@ -0,0 +1,30 @@
+﻿#pragma once
+#include "bpe_tokenizer.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Параллельная токенизация больших корпусов. Текст режется на куски по границам строк и куски токенизируются
+// в пуле потоков без копирования (string_view), у каждого куска свой кэш слов; результаты склеиваются по порядку.
+// Слово не переходит через '\n', поэтому склейка совпадает с BPETokenizer::tokenize по всему тексту,
+// включая <NL> и "</w>". Предупреждения о неизвестных символах при нескольких кусках могут идти не по порядку текста
+namespace corpus {
+    // Меньшие тексты токенизируются одним куском в вызывающем потоке
+    constexpr size_t kMinChunkBytes = 256 * 1024;
+
+    // Делит текст примерно на target_chunks кусков не меньше min_chunk_bytes; каждый кусок, кроме последнего,
+    // заканчивается '\n'
+    std::vector<std::string_view> split_chunks(std::string_view text, size_t target_chunks,
+        size_t min_chunk_bytes = kMinChunkBytes);
+
+    // То же, что tokenizer.tokenize(text), но параллельно
+    std::vector<int> tokenize(const BPETokenizer& tokenizer, std::string_view text);
+    // Файл отображается в память (MappedFile) и токенизируется без чтения в строку
+    std::vector<int> tokenize_file(const BPETokenizer& tokenizer, const std::string& path);
+    // Непустые строки текста без копирования (завершающий '\r' отбрасывается)
+    std::vector<std::string_view> split_lines(std::string_view text);
+    // Каждая строка отдельно (пары source/target для обучения): строки делятся между потоками кусками
+    // не меньше kMinChunkBytes, единственная строка токенизируется как tokenize
+    std::vector<std::vector<int>> tokenize_lines(const BPETokenizer& tokenizer, const std::vector<std::string_view>& lines);
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+﻿#include "DataParallelTrainer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+DataParallelTrainer::DataParallelTrainer(int vocab_size, int embedding_dim, int num_layers, int num_heads, int hidden_dim, int num_replicas)
+    : DataParallelTrainer(ModelConfig::make(vocab_size, embedding_dim, num_layers, num_heads, hidden_dim), num_replicas) {
+}
+
+DataParallelTrainer::DataParallelTrainer(const ModelConfig& config, int num_replicas) {
+    if (num_replicas < 0) {
+        throw std::invalid_argument("num_replicas не может быть отрицательным");
+    }
+    size_t count = num_replicas > 0 ? static_cast<size_t>(num_replicas) : ThreadPool::instance().num_threads();
+
+    for (size_t r = 0; r < count; ++r) {
+        replicas_.push_back(std::make_unique<Transformer>(config));
+    }
+}
+
+size_t DataParallelTrainer::parameter_count() const {
+    if (!ready_) {
+        throw std::runtime_error("Веса не инициализированы: вызовите initialize_random или load_weights");
+    }
+    return replicas_[0]->parameter_arena().size();
+}
+
+void DataParallelTrainer::initialize_random() {
+    // Инициализируются все реплики (это задаёт формы всех весов), затем веса реплики 0 расходятся по остальным
+    for (auto& replica : replicas_) {
+        replica->initialize_random();
+    }
+    broadcast_parameters();
+}
+
+void DataParallelTrainer::load_weights(const std::string& path) {
+    for (auto& replica : replicas_) {
+        replica->initialize_random();
+    }
+    replicas_[0]->load_weights(path);
+    broadcast_parameters();
+}
+
+void DataParallelTrainer::save_checkpoint(CheckpointWriter& writer, long long epoch) {
+    if (!ready_) {
+        throw std::runtime_error("Веса не инициализированы: вызовите initialize_random или load_weights");
+    }
+    writer.save(replicas_[0]->config(), replicas_[0]->parameter_arena(), optimizer_, epoch);
+}
+
+long long DataParallelTrainer::load_checkpoint(const std::string& path) {
+    // Формы весов задаёт инициализация; раскладка области реплики 0 — та же, что при сохранении
+    for (auto& replica : replicas_) {
+        replica->initialize_random();
+    }
+    replicas_[0]->build_parameter_arena();
+    Optimizer restored(optimizer_.config());
+    long long epoch = checkpoint::load(path, replicas_[0]->config(), replicas_[0]->parameter_arena(), restored);
+    broadcast_parameters();
+    optimizer_ = std::move(restored); // broadcast_parameters сбрасывает оптимизатор
+    return epoch;
+}
+
+void DataParallelTrainer::broadcast_parameters() {
+    // У каждой реплики все параметры и градиенты лежат в одной области; раскладка областей одинакова
+    for (auto& replica : replicas_) {
+        replica->build_parameter_arena();
+    }
+    const ParameterArena& source = replicas_[0]->parameter_arena();
+    for (size_t r = 1; r < replicas_.size(); ++r) {
+        ParameterArena& arena = replicas_[r]->parameter_arena();
+        if (arena.size() != source.size()) {
+            throw std::runtime_error("Реплики имеют разные размеры параметров");
+        }
+        std::memcpy(arena.values(), source.values(), source.size() * sizeof(float));
+    }
+    for (auto& replica : replicas_) {
+        replica->set_precision(precision_);
+    }
+    optimizer_.reset();
+    ready_ = true;
+}
+
+void DataParallelTrainer::set_precision(Precision format) {
+    precision_ = format;
+    if (!ready_) {
+        return; // Применится в broadcast_parameters
+    }
+    for (auto& replica : replicas_) {
+        replica->set_precision(format);
+    }
+}
+
+float DataParallelTrainer::train_step(const std::vector<std::vector<int>>& source_batch, const std::vector<std::vector<int>>& target_batch,
+    const std::vector<std::vector<int>>& label_batch, float learning_rate) {
+    if (!ready_) {
+        throw std::runtime_error("Веса не инициализированы: вызовите initialize_random или load_weights");
+    }
+    if (source_batch.empty() || source_batch.size() != target_batch.size() || label_batch.size() != target_batch.size()) {
+        throw std::invalid_argument("source_batch, target_batch и label_batch должны быть непустыми и одного размера");
+    }
+
+    // Реплика r получает последовательности [B * r / active, B * (r + 1) / active)
+    size_t batch_size = source_batch.size();
+    size_t active = std::min(replicas_.size(), batch_size);
+    std::vector<float> weights(active), losses(active);
+    std::vector<size_t> tokens(active);
+
+    ThreadPool::instance().parallel_for(0, active, 1, [&](size_t replica_begin, size_t replica_end) {
+        for (size_t r = replica_begin; r < replica_end; ++r) {
+            size_t begin = batch_size * r / active;
+            size_t end = batch_size * (r + 1) / active;
+            std::vector<std::vector<int>> source(source_batch.begin() + begin, source_batch.begin() + end);
+            std::vector<std::vector<int>> target(target_batch.begin() + begin, target_batch.begin() + end);
+            std::vector<std::vector<int>> labels(label_batch.begin() + begin, label_batch.begin() + end);
+
+            replicas_[r]->parameter_arena().zero_grad();
+            replicas_[r]->forward_batch(source, target);
+            losses[r] = replicas_[r]->backward_batch(labels, learning_rate);
+
+            // backward_batch усредняет градиент по своей части; вес части возвращает среднее по всему батчу.
+            // Часть без реальных токенов даёт нулевой loss и нулевой градиент (см. Transformer::backward_batch)
+            weights[r] = static_cast<float>(end - begin) / batch_size;
+            tokens[r] = 0;
+            for (const auto& sequence : labels) {
+                tokens[r] += std::count_if(sequence.begin(), sequence.end(), [](int label) { return label >= 0; });
+            }
+        }
+    });
+
+    // Средний loss на реальный токен по всему батчу: loss реплики взвешивается числом её реальных токенов
+    double loss_sum = 0.0;
+    size_t token_count = 0;
+    for (size_t r = 0; r < active; ++r) {
+        if (tokens[r] > 0) {
+            loss_sum += static_cast<double>(losses[r]) * tokens[r];
+            token_count += tokens[r];
+        }
+    }
+    // Во всём батче нет реальных токенов — шага нет, как и в Transformer::backward_batch
+    if (token_count == 0) {
+        return 0.0f;
+    }
+
+    all_reduce_and_update(weights, active, learning_rate);
+    return static_cast<float>(loss_sum / token_count);
+}
+
+void DataParallelTrainer::all_reduce_and_update(const std::vector<float>& weights, size_t active_replicas, float learning_rate) {
+    // Области параметров реплик — плоские векторы одинаковой раскладки, которые режутся на сегменты.
+    // Сначала каждый сегмент суммируется по репликам в буфер реплики 0 (reduce-scatter), затем оптимизатор
+    // делает шаг по области реплики 0, и обновлённые веса копируются в остальные реплики (all-gather).
+    // В общей памяти этапы кольцевого all-reduce сводятся к параллельным проходам по сегментам без промежуточных обменов.
+    // Порядок суммирования реплик фиксирован, поэтому результат не зависит от числа потоков
+    ParameterArena& target = replicas_[0]->parameter_arena();
+    const size_t size = target.size();
+    const size_t replicas = replicas_.size();
+    ThreadPool& pool = ThreadPool::instance();
+
+    pool.parallel_for(0, size, ThreadPool::grain_size(size, 2 * active_replicas), [&](size_t begin, size_t end) {
+        float* grad_sum = target.grads();
+        for (size_t i = begin; i < end; ++i) {
+            grad_sum[i] *= weights[0];
+        }
+        for (size_t r = 1; r < active_replicas; ++r) {
+            const float* grad = replicas_[r]->parameter_arena().grads();
+            for (size_t i = begin; i < end; ++i) {
+                grad_sum[i] += weights[r] * grad[i];
+            }
+        }
+    });
+
+    optimizer_.step(target, learning_rate);
+    target.refresh_low_precision();
+    const bool low_precision = target.precision() != Precision::Float32;
+
+    pool.parallel_for(0, size, ThreadPool::grain_size(size, replicas), [&](size_t begin, size_t end) {
+        for (size_t r = 1; r < replicas; ++r) {
+            ParameterArena& arena = replicas_[r]->parameter_arena();
+            std::memcpy(arena.values() + begin, target.values() + begin, (end - begin) * sizeof(float));
+            if (low_precision) {
+                std::memcpy(arena.low_precision_values() + begin, target.low_precision_values() + begin, (end - begin) * sizeof(uint16_t));
+            }
+        }
+    });
+}
\ No newline at end of file
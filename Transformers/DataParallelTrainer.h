@@ -0,0 +1,58 @@
+﻿#pragma once
+#include "Transformer.h"
+#include "Optimizer.h"
+#include "Checkpoint.h"
+#include <memory>
+#include <vector>
+
+// Обучение с параллелизмом по данным: N реплик одной модели, каждая считает forward/backward
+// своей части мини-батча в отдельном потоке пула и только накапливает градиенты.
+// Затем градиенты сводятся (all-reduce) и применяется один общий шаг оптимизатора, после чего веса всех реплик совпадают.
+// Ядра внутри реплики при этом выполняются в одном потоке (вложенный parallel_for), параллелизм — между репликами
+class DataParallelTrainer {
+public:
+    // num_replicas = 0 — по числу потоков пула
+    DataParallelTrainer(int vocab_size, int embedding_dim, int num_layers, int num_heads, int hidden_dim, int num_replicas = 0);
+    explicit DataParallelTrainer(const ModelConfig& config, int num_replicas = 0);
+
+    // Случайная инициализация реплики 0 и копирование её весов в остальные
+    void initialize_random();
+    // Загрузка весов в реплику 0 и копирование в остальные
+    void load_weights(const std::string& path);
+
+    // Один шаг обучения на мини-батче пар (source, target) с метками (см. Transformer::backward_batch).
+    // Батч делится между репликами непрерывными частями; градиент равен градиенту backward_batch на всём батче.
+    // Возвращает средний loss на реальный токен; батч без реальных токенов возвращает 0 и не меняет веса
+    float train_step(const std::vector<std::vector<int>>& source_batch, const std::vector<std::vector<int>>& target_batch,
+        const std::vector<std::vector<int>>& label_batch, float learning_rate);
+
+    // Оптимизатор общего шага (по умолчанию SGD); состояние сбрасывается
+    void set_optimizer(const OptimizerConfig& config) { optimizer_ = Optimizer(config); }
+    // Смешанная точность всех реплик (см. Transformer::set_precision). 16-битная копия весов пересчитывается
+    // один раз в реплике 0 после шага и копируется в остальные вместе с float-весами
+    void set_precision(Precision format);
+
+    // Контрольные точки (см. Checkpoint.h): снимок весов реплики 0 и состояния оптимизатора уходит в фоновую
+    // запись writer, обучение продолжается сразу. epoch — число завершённых эпох (с неё продолжится обучение)
+    void save_checkpoint(CheckpointWriter& writer, long long epoch);
+    // Восстанавливает веса всех реплик и состояние оптимизатора (того же типа, что задан set_optimizer);
+    // возвращает эпоху из контрольной точки
+    long long load_checkpoint(const std::string& path);
+
+    // Реплика 0 — для инференса, сохранения весов и отладки
+    Transformer& model() { return *replicas_[0]; }
+    size_t num_replicas() const { return replicas_.size(); }
+    // Число параметров одной модели (размер области параметров реплики 0)
+    size_t parameter_count() const;
+
+private:
+    // Собирает области параметров реплик и копирует веса реплики 0 во все остальные
+    void broadcast_parameters();
+    // Сведение градиентов с весами weights[r], шаг оптимизатора по реплике 0, веса расходятся по всем репликам
+    void all_reduce_and_update(const std::vector<float>& weights, size_t active_replicas, float learning_rate);
+
+    std::vector<std::unique_ptr<Transformer>> replicas_;
+    Optimizer optimizer_;
+    Precision precision_ = Precision::Float32;
+    bool ready_ = false;   // Области параметров собраны и веса реплик совпадают
+};
\ No newline at end of file
@@ -0,0 +1,216 @@
+﻿#include "Dataset.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    const char kIndexMagic[4] = { 'T', 'F', 'D', 'I' };
+    const char kShardMagic[4] = { 'T', 'F', 'D', 'S' };
+
+    struct IndexHeader {
+        char magic[4];
+        uint32_t version;
+        int32_t vocab_size;
+        uint32_t shard_count;
+        uint64_t pair_count;
+        uint64_t token_count;
+    };
+    static_assert(sizeof(IndexHeader) == 32, "Заголовок индекса набора занимает 32 байта");
+
+    struct ShardHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t pair_count;
+        uint64_t token_count;
+        uint64_t file_size;   // Для проверки целостности (обрезанный файл)
+    };
+    static_assert(sizeof(ShardHeader) == 32, "Заголовок шарда занимает 32 байта");
+
+    // Смещения сразу за заголовком, токены сразу за смещениями (обе границы кратны 8)
+    size_t offsets_bytes(uint64_t pair_count) {
+        return (2 * pair_count + 1) * sizeof(uint64_t);
+    }
+}
+
+namespace dataset {
+    std::string index_path(const std::string& directory) {
+        return (std::filesystem::path(directory) / "index.bin").string();
+    }
+
+    std::string shard_path(const std::string& directory, size_t shard) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "shard_%05zu.bin", shard);
+        return (std::filesystem::path(directory) / name).string();
+    }
+}
+
+DatasetWriter::DatasetWriter(const std::string& directory, int vocab_size, size_t pairs_per_shard)
+    : directory_(directory), vocab_size_(vocab_size), pairs_per_shard_(pairs_per_shard == 0 ? 1 : pairs_per_shard) {
+    if (vocab_size <= 0) {
+        throw std::invalid_argument("DatasetWriter: размер словаря должен быть положительным");
+    }
+    std::filesystem::create_directories(directory_);
+    // Без индекса недописанный набор не откроется
+    std::filesystem::remove(dataset::index_path(directory_));
+}
+
+void DatasetWriter::add(const std::vector<int>& source, const std::vector<int>& target) {
+    if (finished_) {
+        throw std::logic_error("DatasetWriter: набор уже записан");
+    }
+    // Пустой source или target короче двух токенов не дают ни входа декодера, ни меток (см. BatchLoader)
+    if (source.empty()) {
+        throw std::invalid_argument("DatasetWriter: пустой source");
+    }
+    if (target.size() < 2) {
+        throw std::invalid_argument("DatasetWriter: в target меньше двух токенов");
+    }
+    // Сначала проверка обеих последовательностей: отклонённая пара не должна оставить в шарде половину
+    for (const auto* sequence : { &source, &target }) {
+        for (int token : *sequence) {
+            if (token < 0 || token >= vocab_size_) {
+                throw std::invalid_argument("DatasetWriter: id токена " + std::to_string(token) + " вне словаря");
+            }
+        }
+    }
+    for (const auto* sequence : { &source, &target }) {
+        tokens_.insert(tokens_.end(), sequence->begin(), sequence->end());
+        offsets_.push_back(tokens_.size());
+    }
+    ++pair_count_;
+    if (offsets_.size() / 2 >= pairs_per_shard_) {
+        flush_shard();
+    }
+}
+
+void DatasetWriter::flush_shard() {
+    const uint64_t pairs = offsets_.size() / 2;
+    if (pairs == 0) return;
+    const std::string path = dataset::shard_path(directory_, shard_pairs_.size());
+
+    ShardHeader header = {};
+    std::memcpy(header.magic, kShardMagic, sizeof(kShardMagic));
+    header.version = dataset::kVersion;
+    header.pair_count = pairs;
+    header.token_count = tokens_.size();
+    header.file_size = sizeof(ShardHeader) + offsets_bytes(pairs) + tokens_.size() * sizeof(int32_t);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets_.data()), offsets_bytes(pairs));
+    out.write(reinterpret_cast<const char*>(tokens_.data()), tokens_.size() * sizeof(int32_t));
+    out.close();
+    if (!out) throw std::runtime_error("Ошибка записи шарда набора: " + path);
+
+    shard_pairs_.push_back(pairs);
+    shard_tokens_.push_back(tokens_.size());
+    offsets_.assign(1, 0);
+    tokens_.clear();
+}
+
+void DatasetWriter::finish() {
+    if (finished_) return;
+    flush_shard();
+
+    // Шарды прежнего, более длинного набора больше не нужны
+    for (size_t shard = shard_pairs_.size(); std::filesystem::remove(dataset::shard_path(directory_, shard)); ++shard) {}
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = dataset::kVersion;
+    header.vocab_size = vocab_size_;
+    header.shard_count = static_cast<uint32_t>(shard_pairs_.size());
+    header.pair_count = pair_count_;
+    for (uint64_t count : shard_tokens_) header.token_count += count;
+
+    const std::string path = dataset::index_path(directory_);
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t shard = 0; shard < shard_pairs_.size(); ++shard) {
+        out.write(reinterpret_cast<const char*>(&shard_pairs_[shard]), sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(&shard_tokens_[shard]), sizeof(uint64_t));
+    }
+    out.close();
+    if (!out) throw std::runtime_error("Ошибка записи индекса набора: " + path);
+    finished_ = true;
+}
+
+bool Dataset::exists(const std::string& directory) {
+    return std::filesystem::exists(dataset::index_path(directory));
+}
+
+Dataset::Dataset(const std::string& directory) {
+    const std::string path = dataset::index_path(directory);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
+    IndexHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header.version != dataset::kVersion) {
+        throw std::runtime_error("Файл не является индексом набора поддерживаемой версии: " + path);
+    }
+    vocab_size_ = header.vocab_size;
+
+    uint64_t total_tokens = 0;
+    for (uint32_t s = 0; s < header.shard_count; ++s) {
+        uint64_t counts[2];
+        if (!in.read(reinterpret_cast<char*>(counts), sizeof(counts))) {
+            throw std::runtime_error("Индекс набора обрезан: " + path);
+        }
+        Shard shard;
+        const std::string file_path = dataset::shard_path(directory, s);
+        shard.file = std::make_unique<MappedFile>(file_path);
+        const char* data = shard.file->data();
+        ShardHeader shard_header;
+        if (shard.file->size() < sizeof(ShardHeader)) {
+            throw std::runtime_error("Файл не является шардом набора: " + file_path);
+        }
+        std::memcpy(&shard_header, data, sizeof(shard_header));
+        if (std::memcmp(shard_header.magic, kShardMagic, sizeof(kShardMagic)) != 0 || shard_header.version != dataset::kVersion
+            || shard_header.pair_count != counts[0] || shard_header.token_count != counts[1]
+            || shard_header.file_size != shard.file->size()
+            || shard_header.file_size != sizeof(ShardHeader) + offsets_bytes(counts[0]) + counts[1] * sizeof(int32_t)) {
+            throw std::runtime_error("Шард не совпадает с индексом набора (файл повреждён): " + file_path);
+        }
+        shard.offsets = reinterpret_cast<const uint64_t*>(data + sizeof(ShardHeader));
+        shard.tokens = reinterpret_cast<const int32_t*>(data + sizeof(ShardHeader) + offsets_bytes(counts[0]));
+        // Смещения не убывают и не выходят за токены: дальше read_pair их не проверяет
+        const uint64_t sequences = 2 * counts[0];
+        bool valid = shard.offsets[0] == 0 && shard.offsets[sequences] == counts[1];
+        for (uint64_t k = 0; valid && k < sequences; ++k) {
+            valid = shard.offsets[k] <= shard.offsets[k + 1];
+        }
+        if (!valid) throw std::runtime_error("Повреждённые смещения в шарде набора: " + file_path);
+
+        shards_.push_back(std::move(shard));
+        pair_begin_.push_back(pair_begin_.back() + counts[0]);
+        total_tokens += counts[1];
+    }
+    if (pair_begin_.back() != header.pair_count || total_tokens != header.token_count) {
+        throw std::runtime_error("Повреждённый индекс набора: " + path);
+    }
+}
+
+void Dataset::read_pair(size_t pair, std::vector<int>& source, std::vector<int>& target) const {
+    if (pair >= size()) {
+        throw std::out_of_range("Dataset::read_pair: номер пары вне набора");
+    }
+    size_t shard_index = std::upper_bound(pair_begin_.begin(), pair_begin_.end(), pair) - pair_begin_.begin() - 1;
+    const Shard& shard = shards_[shard_index];
+    size_t sequence = 2 * (pair - pair_begin_[shard_index]);
+    for (auto* out : { &source, &target }) {
+        const int32_t* begin = shard.tokens + shard.offsets[sequence];
+        const int32_t* end = shard.tokens + shard.offsets[sequence + 1];
+        out->assign(begin, end);
+        for (int token : *out) {
+            if (token < 0 || token >= vocab_size_) {
+                throw std::runtime_error("Шард набора содержит id токена вне словаря: " + std::to_string(token));
+            }
+        }
+        ++sequence;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+﻿#pragma once
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Предварительно токенизированный набор пар (source, target) в каталоге:
+//   index.bin — заголовок (32 байта: сигнатура "TFDI", версия, размер словаря, число шардов, число пар и токенов),
+//               затем для каждого шарда число пар и токенов (uint64);
+//   shard_00000.bin, ... — заголовок (32 байта: сигнатура "TFDS", версия, число пар, число токенов, размер файла),
+//               смещения последовательностей (uint64, 2 * пар + 1: source и target поочерёдно), токены (int32).
+// Шарды отображаются в память и читаются на месте, поэтому набор может быть больше оперативной памяти.
+// target хранится целиком (с <BOS> и <EOS>); сдвиг на вход декодера и метки делает загрузчик (см. BatchLoader).
+// Числа — little-endian, как и в остальных бинарных файлах проекта
+namespace dataset {
+    constexpr uint32_t kVersion = 1;
+    constexpr size_t kDefaultPairsPerShard = 1 << 16;
+
+    // Путь файла индекса набора в каталоге directory
+    std::string index_path(const std::string& directory);
+    std::string shard_path(const std::string& directory, size_t shard);
+}
+
+// Запись набора: пары копятся в текущем шарде и сбрасываются на диск по pairs_per_shard штук.
+// Индекс пишется последним в finish, до этого прежний индекс удалён и набор в каталоге не открывается
+class DatasetWriter {
+public:
+    DatasetWriter(const std::string& directory, int vocab_size, size_t pairs_per_shard = dataset::kDefaultPairsPerShard);
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+
+    // Пара с пустым source или target короче двух токенов (<BOS> ... <EOS>) отклоняется std::invalid_argument
+    void add(const std::vector<int>& source, const std::vector<int>& target);
+    // Записывает последний шард и индекс
+    void finish();
+
+    size_t size() const { return pair_count_; }
+
+private:
+    void flush_shard();
+
+    std::string directory_;
+    int vocab_size_;
+    size_t pairs_per_shard_;
+    size_t pair_count_ = 0;
+    std::vector<uint64_t> offsets_ = { 0 };   // Смещения последовательностей текущего шарда
+    std::vector<int32_t> tokens_;             // Токены текущего шарда
+    std::vector<uint64_t> shard_pairs_;
+    std::vector<uint64_t> shard_tokens_;
+    bool finished_ = false;
+};
+
+// Набор, открытый для чтения: индекс проверяется, шарды отображаются в память
+class Dataset {
+public:
+    explicit Dataset(const std::string& directory);
+
+    // В каталоге есть индекс набора
+    static bool exists(const std::string& directory);
+
+    size_t size() const { return pair_begin_.back(); }
+    int vocab_size() const { return vocab_size_; }
+    size_t shard_count() const { return shards_.size(); }
+    // Пары шарда shard имеют номера [shard_begin(shard), shard_begin(shard + 1))
+    size_t shard_begin(size_t shard) const { return pair_begin_[shard]; }
+
+    // Копирует пару с номером pair
+    void read_pair(size_t pair, std::vector<int>& source, std::vector<int>& target) const;
+
+private:
+    struct Shard {
+        std::unique_ptr<MappedFile> file;
+        const uint64_t* offsets = nullptr;
+        const int32_t* tokens = nullptr;
+    };
+
+    int vocab_size_ = 0;
+    std::vector<Shard> shards_;
+    std::vector<size_t> pair_begin_ = { 0 };  // Номер первой пары шарда; последний элемент — число пар
+};
\ No newline at end of file
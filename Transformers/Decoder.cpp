@@ -1,6 +1,6 @@
 #include "Decoder.h"
 
-// 
+// Конструктор
 Decoder::Decoder(int num_layers, int num_heads, int embedding_dim, int hidden_dim)
     : num_layers_(num_layers) {
     for (int i = 0; i < num_layers; ++i) {
@@ -8,13 +8,14 @@ Decoder::Decoder(int num_layers, int num_heads, int embedding_dim, int hidden_di
     }
 }
 
-//    
-std::vector<std::vector<float>> Decoder::forward_decoder(const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output) {
+// Прямой проход через декодер
+Tensor Decoder::forward_decoder(const Tensor& target_input, const Tensor& encoder_output,
+    const BatchLayout& target_layout, const BatchLayout& source_layout) {
     decoder_inputs_.clear();
     auto current_input = target_input;
     for (int i = 0; i < num_layers_; ++i) {
         decoder_inputs_.push_back(current_input);
-        current_input = layers_[i].forward_decoder_layer(current_input, encoder_output);
+        current_input = layers_[i].forward_decoder_layer(current_input, encoder_output, target_layout, source_layout);
 
         /*std::cout << "decoder_inputs_:\n";
         for (size_t i = 0; i < 10 && i < decoder_inputs_.size(); ++i) {
@@ -32,10 +33,54 @@ std::vector<std::vector<float>> Decoder::forward_decoder(const std::vector<std::
     return current_input;
 }
 
-//    
-std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> Decoder::backward_decoder(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& encoder_output, float learning_rate) {
+void Decoder::project_memory(EncoderMemory& memory) const {
+    memory.cross_K.resize(num_layers_);
+    memory.cross_V.resize(num_layers_);
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i].project_memory(memory.encoder_output, memory.cross_K[i], memory.cross_V[i]);
+    }
+}
+
+// Прямой проход для инференса: промежуточные входы слоёв не сохраняются
+Tensor Decoder::forward_decoder(const Tensor& target_input, const EncoderMemory& memory) {
+    Tensor current_input = target_input;
+    for (int i = 0; i < num_layers_; ++i) {
+        current_input = layers_[i].forward_decoder_layer(current_input, memory.cross_K[i], memory.cross_V[i]);
+    }
+    return current_input;
+}
+
+// Пошаговый прямой проход через декодер
+Tensor Decoder::forward_decoder_step(const Tensor& target_new, const EncoderMemory& memory) {
+    Tensor current_input = target_new;
+    for (int i = 0; i < num_layers_; ++i) {
+        current_input = layers_[i].forward_decoder_layer_step(current_input, memory.cross_K[i], memory.cross_V[i]);
+    }
+    return current_input;
+}
+
+void Decoder::reset_cache() {
+    for (auto& layer : layers_) {
+        layer.reset_cache();
+    }
+}
+
+void Decoder::truncate_cache(size_t length) {
+    for (auto& layer : layers_) {
+        layer.truncate_cache(length);
+    }
+}
+
+void Decoder::reorder_cache(const std::vector<int>& beams) {
+    for (auto& layer : layers_) {
+        layer.reorder_cache(beams);
+    }
+}
+
+// Обратный проход через декодер
+std::pair<Tensor, Tensor> Decoder::backward_decoder(const Tensor& grad_output, const Tensor& encoder_output, float learning_rate) {
     auto current_grad_decoder = grad_output;
-    std::vector<std::vector<float>> current_grad_encoder;
+    Tensor current_grad_encoder;
     for (int i = num_layers_ - 1; i >= 0; --i) {
         const auto& saved_decoder_input = decoder_inputs_[i];
         auto [grad_target, grad_KV] = layers_[i].backward_decoder_layer(current_grad_decoder, saved_decoder_input, encoder_output, learning_rate);
@@ -45,5 +90,5 @@ std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> Deco
     return { current_grad_decoder, current_grad_encoder };
 }
 
-//   :   
+// Метод для отладки: возвращает слои декодера
 std::vector<DecoderLayer>& Decoder::get_layers() { return layers_; }
\ No newline at end of file
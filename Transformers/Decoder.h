@@ -1,20 +1,32 @@
 #pragma once
 #include "DecoderLayer.h"
+#include "EncoderMemory.h"
 #include <vector>
 
 class Decoder {
 public:
     Decoder(int num_layers, int num_heads, int embedding_dim, int hidden_dim);
 
-    std::vector<std::vector<float>> forward_decoder(const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output);
-    std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> backward_decoder(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& encoder_output, float learning_rate);
+    Tensor forward_decoder(const Tensor& target_input, const Tensor& encoder_output,
+        const BatchLayout& target_layout = BatchLayout(), const BatchLayout& source_layout = BatchLayout());
+    // Заполняет memory.cross_K / cross_V для всех слоёв по memory.encoder_output
+    void project_memory(EncoderMemory& memory) const;
+    // Прямой проход для инференса с готовой памятью энкодера
+    Tensor forward_decoder(const Tensor& target_input, const EncoderMemory& memory);
+    // Пошаговый проход для генерации с кэшем K/V в каждом слое
+    // (после reorder_cache — по строке на луч; память энкодера у всех лучей общая)
+    Tensor forward_decoder_step(const Tensor& target_new, const EncoderMemory& memory);
+    void reset_cache();
+    void reorder_cache(const std::vector<int>& beams);
+    void truncate_cache(size_t length);
+    std::pair<Tensor, Tensor> backward_decoder(const Tensor& grad_output, const Tensor& encoder_output, float learning_rate);
 
-    //    
+    // Вывод весов для отладки
     std::vector<DecoderLayer>& get_layers();
     const std::vector<DecoderLayer>& get_layers() const { return layers_; }
 
 private:
-    int num_layers_;                //   (, 6)
-    std::vector<DecoderLayer> layers_; //   
-    std::vector<std::vector<std::vector<float>>> decoder_inputs_;
+    int num_layers_;                // Количество слоев (например, 6)
+    std::vector<DecoderLayer> layers_; // Стек слоев декодера
+    std::vector<Tensor> decoder_inputs_;
 };
\ No newline at end of file
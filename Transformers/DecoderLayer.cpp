@@ -10,13 +10,14 @@ DecoderLayer::DecoderLayer(int num_heads, int embedding_dim, int hidden_dim)
     add_norm_ff_(embedding_dim) {
 }
 
-std::vector<std::vector<float>> DecoderLayer::forward_decoder_layer(const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output) {
+Tensor DecoderLayer::forward_decoder_layer(const Tensor& target_input, const Tensor& encoder_output,
+    const BatchLayout& target_layout, const BatchLayout& source_layout) {
     // Masked Multi-Head Attention + Add & Norm
-    auto masked_mha_output = masked_mha_.forward_mha(target_input, true); //  
+    auto masked_mha_output = masked_mha_.forward_mha(target_input, true, target_layout); // с маской
     layer_norm_masked_mha = add_norm_masked_mha_.forward_an(masked_mha_output, target_input);
 
     // Cross-Attention
-    auto cross_mha_output = cross_mha_.forward_mha(layer_norm_masked_mha, encoder_output);
+    auto cross_mha_output = cross_mha_.forward_mha(layer_norm_masked_mha, encoder_output, target_layout, source_layout);
     auto layer_norm_cross_mha = add_norm_cross_mha_.forward_an(cross_mha_output, layer_norm_masked_mha);
 
     // Feed-Forward + Add & Norm
@@ -26,27 +27,50 @@ std::vector<std::vector<float>> DecoderLayer::forward_decoder_layer(const std::v
     return layer_norm_ff;
 }
 
-//     
-std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> DecoderLayer::backward_decoder_layer(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output, float learning_rate) {
-    //    Add & Norm  Feed-Forward
+Tensor DecoderLayer::forward_decoder_layer(const Tensor& target_input, const Tensor& cross_K, const Tensor& cross_V) {
+    auto masked_mha_output = masked_mha_.forward_mha(target_input, true);
+    auto layer_norm_masked = add_norm_masked_mha_.forward_an(masked_mha_output, target_input);
+
+    auto cross_mha_output = cross_mha_.forward_mha(layer_norm_masked, cross_K, cross_V);
+    auto layer_norm_cross_mha = add_norm_cross_mha_.forward_an(cross_mha_output, layer_norm_masked);
+
+    auto ff_output = ff_.forward_ff(layer_norm_cross_mha);
+    return add_norm_ff_.forward_an(ff_output, layer_norm_cross_mha);
+}
+
+// Все блоки, кроме masked MHA, обрабатывают строки независимо, поэтому достаточно новых позиций
+Tensor DecoderLayer::forward_decoder_layer_step(const Tensor& target_new, const Tensor& cross_K, const Tensor& cross_V) {
+    auto masked_mha_output = masked_mha_.forward_mha_step(target_new);
+    auto layer_norm_masked = add_norm_masked_mha_.forward_an(masked_mha_output, target_new);
+
+    auto cross_mha_output = cross_mha_.forward_mha(layer_norm_masked, cross_K, cross_V);
+    auto layer_norm_cross_mha = add_norm_cross_mha_.forward_an(cross_mha_output, layer_norm_masked);
+
+    auto ff_output = ff_.forward_ff(layer_norm_cross_mha);
+    return add_norm_ff_.forward_an(ff_output, layer_norm_cross_mha);
+}
+
+// Обратный проход через слой декодера
+std::pair<Tensor, Tensor> DecoderLayer::backward_decoder_layer(const Tensor& grad_output, const Tensor& target_input, const Tensor& encoder_output, float learning_rate) {
+    // Обратный проход через Add & Norm после Feed-Forward
     auto grad_add_ff = add_norm_ff_.backward_an(grad_output, learning_rate);
 
-    //    Feed-Forward
+    // Обратный проход через Feed-Forward
     auto grad_ff = ff_.backward_ff(grad_add_ff, learning_rate);
 
-    //    Add & Norm  Cross-Attention
+    // Обратный проход через Add & Norm после Cross-Attention
     auto grad_add_cross_mha = add_norm_cross_mha_.backward_an(grad_add_ff, grad_ff, learning_rate);
 
-    //    Cross-MHA
+    // Обратный проход через Cross-MHA
     auto [grad_layer_norm_masked_mha, grad_encoder_output] = cross_mha_.backward_mha(grad_add_cross_mha, layer_norm_masked_mha, encoder_output, learning_rate);
 
-    //    Add & Norm  Masked-Attention
+    // Обратный проход через Add & Norm после Masked-Attention
     auto grad_add_masked_mha = add_norm_masked_mha_.backward_an(grad_add_cross_mha, grad_layer_norm_masked_mha, learning_rate);
 
-    //    Masked-Attention
+    // Обратный проход через Masked-Attention
     auto grad_masked_mha = masked_mha_.backward_mha(grad_add_masked_mha, target_input, learning_rate);
 
-    //    masked mha  Add & Norm  
+    // Сложение градиентов от masked mha и Add & Norm после него
     auto grad_target_output = utils::add_embeddings(grad_add_masked_mha, grad_masked_mha);
 
     return { grad_target_output, grad_encoder_output };
@@ -61,6 +85,43 @@ void DecoderLayer::initialize_random() {
     add_norm_ff_.initialize_random();
 }
 
+void DecoderLayer::set_gradient_accumulation(bool enabled) {
+    masked_mha_.set_gradient_accumulation(enabled);
+    add_norm_masked_mha_.set_gradient_accumulation(enabled);
+    cross_mha_.set_gradient_accumulation(enabled);
+    add_norm_cross_mha_.set_gradient_accumulation(enabled);
+    ff_.set_gradient_accumulation(enabled);
+    add_norm_ff_.set_gradient_accumulation(enabled);
+}
+
+void DecoderLayer::set_activation_precision(Precision format) {
+    ff_.set_activation_precision(format);
+    add_norm_masked_mha_.set_activation_precision(format);
+    add_norm_cross_mha_.set_activation_precision(format);
+    add_norm_ff_.set_activation_precision(format);
+}
+
+void DecoderLayer::collect_parameters(std::vector<ParameterRef>& params) {
+    size_t first = params.size();
+    masked_mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "masked_mha.");
+    first = params.size();
+    add_norm_masked_mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "add_norm_masked_mha.");
+    first = params.size();
+    cross_mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "cross_mha.");
+    first = params.size();
+    add_norm_cross_mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "add_norm_cross_mha.");
+    first = params.size();
+    ff_.collect_parameters(params);
+    prefix_parameter_names(params, first, "ff.");
+    first = params.size();
+    add_norm_ff_.collect_parameters(params);
+    prefix_parameter_names(params, first, "add_norm_ff.");
+}
+
 void DecoderLayer::save_weights(std::ofstream& out) const {
     masked_mha_.save_weights(out);
     add_norm_masked_mha_.save_weights(out);
@@ -77,4 +138,34 @@ void DecoderLayer::load_weights(std::ifstream& in) {
     add_norm_cross_mha_.load_weights(in);
     ff_.load_weights(in);
     add_norm_ff_.load_weights(in);
+}
+
+void DecoderLayer::set_calibration(bool enabled) {
+    masked_mha_.set_calibration(enabled);
+    cross_mha_.set_calibration(enabled);
+    ff_.set_calibration(enabled);
+}
+
+void DecoderLayer::quantize_int8() {
+    masked_mha_.quantize_int8();
+    cross_mha_.quantize_int8();
+    ff_.quantize_int8();
+}
+
+void DecoderLayer::save_quantized(std::ofstream& out) const {
+    masked_mha_.save_quantized(out);
+    add_norm_masked_mha_.save_weights(out);
+    cross_mha_.save_quantized(out);
+    add_norm_cross_mha_.save_weights(out);
+    ff_.save_quantized(out);
+    add_norm_ff_.save_weights(out);
+}
+
+void DecoderLayer::load_quantized(std::ifstream& in) {
+    masked_mha_.load_quantized(in);
+    add_norm_masked_mha_.load_weights(in);
+    cross_mha_.load_quantized(in);
+    add_norm_cross_mha_.load_weights(in);
+    ff_.load_quantized(in);
+    add_norm_ff_.load_weights(in);
 }
\ No newline at end of file
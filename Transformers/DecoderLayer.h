@@ -8,14 +8,36 @@ class DecoderLayer {
 public:
     DecoderLayer(int num_heads, int embedding_dim, int hidden_dim);
 
-    std::vector<std::vector<float>> forward_decoder_layer(const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output);
-    std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> backward_decoder_layer(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& target_input, const std::vector<std::vector<float>>& encoder_output, float learning_rate);
+    // target_layout и source_layout — разметки мини-батча декодера и энкодера (по умолчанию одна последовательность)
+    Tensor forward_decoder_layer(const Tensor& target_input, const Tensor& encoder_output,
+        const BatchLayout& target_layout = BatchLayout(), const BatchLayout& source_layout = BatchLayout());
+    // Прямой проход для инференса с готовыми проекциями K/V cross-attention (см. project_memory)
+    Tensor forward_decoder_layer(const Tensor& target_input, const Tensor& cross_K, const Tensor& cross_V);
+    // Пошаговый прямой проход для генерации: target_new — только новые позиции,
+    // предыдущие берутся из кэша K/V masked MHA
+    Tensor forward_decoder_layer_step(const Tensor& target_new, const Tensor& cross_K, const Tensor& cross_V);
+    void project_memory(const Tensor& encoder_output, Tensor& cross_K, Tensor& cross_V) const { cross_mha_.project_kv(encoder_output, cross_K, cross_V); }
+    void reset_cache() { masked_mha_.reset_cache(); }
+    void reorder_cache(const std::vector<int>& beams) { masked_mha_.reorder_cache(beams); }
+    void truncate_cache(size_t length) { masked_mha_.truncate_cache(length); }
+    std::pair<Tensor, Tensor> backward_decoder_layer(const Tensor& grad_output, const Tensor& target_input, const Tensor& encoder_output, float learning_rate);
 
-    //  ( ),  ( )    MHA, add&norm, feed forward
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров MHA, add&norm, feed forward
     void initialize_random();
     void save_weights(std::ofstream& out) const;
     void load_weights(std::ifstream& in);
 
+    // Режим накопления градиентов и список параметров всех блоков слоя (в порядке сохранения)
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    // Формат сохраняемых для backward активаций (bf16/fp16 в режиме пониженной точности)
+    void set_activation_precision(Precision format);
+    // Int8-квантование матриц весов MHA и FeedForward слоя для инференса (нормализации остаются float)
+    void set_calibration(bool enabled);
+    void quantize_int8();
+    void save_quantized(std::ofstream& out) const;
+    void load_quantized(std::ifstream& in);
+
     const MultiHeadAttention& get_masked_mha() const { return masked_mha_; }
     const MultiHeadAttention& get_cross_mha() const { return cross_mha_; }
     const FeedForward& get_ff() const { return ff_; }
@@ -27,5 +49,5 @@ private:
     AddNorm add_norm_cross_mha_;
     FeedForward ff_;
     AddNorm add_norm_ff_;
-    std::vector<std::vector<float>> layer_norm_masked_mha;
+    Tensor layer_norm_masked_mha;
 };
\ No newline at end of file
@@ -1,95 +1,118 @@
 #include "Embedding.h"
 #include <iostream>
+#include <cstring>
 #include "utils.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <numeric>
 
 extern int paramCount;
 
 Embedding::Embedding(int vocab_size, int embedding_dim) {
     if (vocab_size <= 0 || embedding_dim <= 0) {
-        throw std::invalid_argument("vocab_size  embedding_dim   ");
+        throw std::invalid_argument("vocab_size и embedding_dim должны быть положительными");
     }
-    embeddings_.resize(vocab_size, std::vector<float>(embedding_dim));
+    embeddings_.assign(vocab_size, embedding_dim, 0.0f);
     embedding_dim_ = embedding_dim;
 
-    paramCount += embeddings_.size() * embedding_dim_;
+    paramCount += embeddings_.rows() * embedding_dim_;
 }
 
-std::vector<std::vector<float>> Embedding::forward_emd(const std::vector<int>& token_ids) {
-    std::vector<std::vector<float>> result;
-    for (int id : token_ids) {
-        if (id < 0 || id >= embeddings_.size()) {
-            throw std::out_of_range("ID    ");
+Tensor Embedding::forward_emd(const std::vector<int>& token_ids) {
+    Tensor result(token_ids.size(), embedding_dim_);
+    for (size_t pos = 0; pos < token_ids.size(); ++pos) {
+        int id = token_ids[pos];
+        if (id < 0 || static_cast<size_t>(id) >= embeddings_.rows()) {
+            throw std::out_of_range("ID токена вне допустимого диапазона");
+        }
+        if (embeddings_half_.empty()) {
+            std::memcpy(result[pos], embeddings_[id], sizeof(float) * embedding_dim_);
+        }
+        else {
+            embeddings_half_.row_to_float(id, result[pos]);
         }
-        result.push_back(embeddings_[id]);
     }
     return result;
 }
 
 void Embedding::backward_emd(const std::vector<int>& target_tokens,
-    const std::vector<std::vector<float>>& grad_mha_input,
+    const Tensor& grad_mha_input,
     float learning_rate) {
-    //    
-    if (target_tokens.size() != grad_mha_input.size()) {
-        throw std::invalid_argument("target_tokens  grad_input_to_mha    ");
+    // Проверка на соответствие размеров
+    if (target_tokens.size() != grad_mha_input.rows()) {
+        throw std::invalid_argument("target_tokens и grad_input_to_mha должны иметь одинаковую длину");
     }
-    if (grad_mha_input.size() > 0 && grad_mha_input[0].size() != embedding_dim_) {
-        throw std::invalid_argument("grad_input_to_mha    embedding_dim");
+    if (grad_mha_input.rows() > 0 && grad_mha_input.cols() != static_cast<size_t>(embedding_dim_)) {
+        throw std::invalid_argument("grad_input_to_mha должен иметь размерность embedding_dim");
     }
 
-    //       
-    std::map<int, std::vector<float>> token_grads;
+    // Позиции группируются по токену (устойчивая сортировка индексов, порядок внутри группы — по позиции),
+    // затем уникальные токены обрабатываются параллельно: задача суммирует градиенты позиций своего токена
+    // и обновляет только его строку embeddings_, поэтому записи задач не пересекаются
+    std::vector<size_t> order(target_tokens.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return target_tokens[a] < target_tokens[b]; });
 
-    //      
-    for (size_t pos = 0; pos < target_tokens.size(); ++pos) {
-        int token_idx = target_tokens[pos]; //  
-        if (token_grads.find(token_idx) == token_grads.end()) {
-            token_grads[token_idx] = std::vector<float>(embedding_dim_, 0.0f);
-        }
-        //      
-        for (size_t dim = 0; dim < embedding_dim_; ++dim) {
-            token_grads[token_idx][dim] += grad_mha_input[pos][dim];
+    std::vector<size_t> group_begin;
+    for (size_t k = 0; k < order.size(); ++k) {
+        if (k == 0 || target_tokens[order[k]] != target_tokens[order[k - 1]]) {
+            group_begin.push_back(k);
         }
     }
+    group_begin.push_back(order.size());
+    size_t groups = group_begin.size() - 1;
 
-    //    embeddings_
-    for (const auto& pair : token_grads) {
-        int token_idx = pair.first;
-        const auto& grad = pair.second;
-        for (size_t dim = 0; dim < embedding_dim_; ++dim) {
-            embeddings_[token_idx][dim] -= learning_rate * grad[dim];
-        }
-    }
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallel_for(0, groups, ThreadPool::grain_size(groups, embedding_dim_ * (order.size() / std::max<size_t>(groups, 1) + 1)),
+        [&](size_t group_first, size_t group_last) {
+            std::vector<float> grad(embedding_dim_);
+            for (size_t g = group_first; g < group_last; ++g) {
+                // Суммируем градиенты для каждого измерения эмбеддинга
+                std::fill(grad.begin(), grad.end(), 0.0f);
+                for (size_t k = group_begin[g]; k < group_begin[g + 1]; ++k) {
+                    const float* row = grad_mha_input[order[k]];
+                    for (int dim = 0; dim < embedding_dim_; ++dim) {
+                        grad[dim] += row[dim];
+                    }
+                }
+
+                // Обновляем строку токена в embeddings_ (или накапливаем её градиент)
+                int token = target_tokens[order[group_begin[g]]];
+                utils::apply_gradient(embeddings_[token], accumulate_gradients_ ? grad_embeddings_[token] : nullptr,
+                    grad.data(), embedding_dim_, learning_rate, accumulate_gradients_);
+            }
+        });
+}
+
+void Embedding::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенный буфер не перевыделяется: он может жить в общей области параметров
+    if (!enabled) grad_embeddings_ = Tensor();
+    else if (grad_embeddings_.empty()) grad_embeddings_.assign(embeddings_.rows(), embeddings_.cols(), 0.0f);
+}
+
+void Embedding::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &embeddings_, &grad_embeddings_, &embeddings_half_, "embeddings" });
 }
 
 void Embedding::initialize_random() {
-    //      
-    std::random_device rd;              //      
-    std::mt19937 gen(rd());             //    (Mersenne Twister)
-    std::normal_distribution<float> dist(0.0f, 0.01f); //  :  0,   0.01
+    // Инициализация случайными значениями из нормального распределения
+    std::random_device rd;              // Устройство для генерации случайного начального значения
+    std::mt19937 gen(rd());             // Генератор псевдослучайных чисел (Mersenne Twister)
+    std::normal_distribution<float> dist(0.0f, 0.01f); // Нормальное распределение: среднее 0, стандартное отклонение 0.01
 
-    for (auto& row : embeddings_) {
-        for (auto& val : row) {
-            val = dist(gen);            //     
-        }
+    for (size_t i = 0; i < embeddings_.size(); ++i) {
+        embeddings_.data()[i] = dist(gen); // Заполняем каждый элемент случайным значением
     }
 }
 
 void Embedding::load_weights(std::ifstream& in) {
-    int rows = 0, cols = 0;
-    in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
-    in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
-    embeddings_.assign(rows, std::vector<float>(cols));
-    for (auto& row : embeddings_) {
-        in.read(reinterpret_cast<char*>(row.data()), sizeof(float) * cols);
-    }
+    // Таблица хранится одним непрерывным блоком — читаем за один вызов
+    utils::read_matrix(in, embeddings_);
+    if ((int)embeddings_.cols() != embedding_dim_)
+        throw std::runtime_error("Неверный размер эмбеддингов при загрузке");
 }
 
 void Embedding::save_weights(std::ofstream& out) const {
-    int rows = embeddings_.size();
-    int cols = embedding_dim_;
-    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
-    out.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
-    for (const auto& row : embeddings_) {
-        out.write(reinterpret_cast<const char*>(row.data()), sizeof(float) * cols);
-    }
+    utils::write_matrix(out, embeddings_);
 }
\ No newline at end of file
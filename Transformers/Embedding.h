@@ -1,4 +1,7 @@
 #pragma once
+#include "Tensor.h"
+#include "Parameter.h"
+#include "Precision.h"
 #include <vector>
 #include <map>
 #include <stdexcept>
@@ -8,16 +11,23 @@ class Embedding {
 public:
     Embedding(int vocab_size, int embedding_dim);
 
-    //    
-    std::vector<std::vector<float>> forward_emd(const std::vector<int>& token_ids);
-    void backward_emd(const std::vector<int>& target_tokens, const std::vector<std::vector<float>>& grad_mha_input, float learning_rate);
+    // Прямой и обратный проход
+    Tensor forward_emd(const std::vector<int>& token_ids);
+    void backward_emd(const std::vector<int>& target_tokens, const Tensor& grad_mha_input, float learning_rate);
 
-    //  ( ),  ( )    Embedding
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров Embedding
     void initialize_random();
     void load_weights(std::ifstream& in);
     void save_weights(std::ofstream& out) const;
 
+    // Режим накопления: backward_emd складывает градиенты строк в буфер вместо шага SGD
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+
 private:
-    std::vector<std::vector<float>> embeddings_;
+    Tensor embeddings_;
+    HalfView embeddings_half_; // 16-битная копия таблицы (только в режиме пониженной точности)
+    Tensor grad_embeddings_; // Накопленный градиент (только в режиме накопления)
+    bool accumulate_gradients_ = false;
     int embedding_dim_;
 };
\ No newline at end of file
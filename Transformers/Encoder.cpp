@@ -7,18 +7,18 @@ Encoder::Encoder(int num_layers, int num_heads, int embedding_dim, int hidden_di
     }
 }
 
-std::vector<std::vector<float>> Encoder::forward_encoder(const std::vector<std::vector<float>>& source_input) {
+Tensor Encoder::forward_encoder(const Tensor& source_input, const BatchLayout& layout) {
     encoder_inputs_.clear();
     auto current_input = source_input;
     for (int i = 0; i < num_layers_; ++i) {
         encoder_inputs_.push_back(current_input);
-        current_input = layers_[i].forward_encoder_layer(current_input);
+        current_input = layers_[i].forward_encoder_layer(current_input, layout);
     }
     return current_input;
 }
 
-//    
-std::vector<std::vector<float>> Encoder::backward_encoder(const std::vector<std::vector<float>>& grad_output, float learning_rate) {
+// Обратный проход через энкодер
+Tensor Encoder::backward_encoder(const Tensor& grad_output, float learning_rate) {
     auto current_grad = grad_output;
     for (int i = num_layers_ - 1; i >= 0; --i) {
         const auto& saved_encoder_input = encoder_inputs_[i];
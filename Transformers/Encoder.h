@@ -6,15 +6,15 @@ class Encoder {
 public:
     Encoder(int num_layers, int num_heads, int embedding_dim, int hidden_dim);
 
-    std::vector<std::vector<float>> forward_encoder(const std::vector<std::vector<float>>& source_input);
-    std::vector<std::vector<float>> backward_encoder(const std::vector<std::vector<float>>& grad_output, float learning_rate);
+    Tensor forward_encoder(const Tensor& source_input, const BatchLayout& layout = BatchLayout());
+    Tensor backward_encoder(const Tensor& grad_output, float learning_rate);
 
-    //    
+    // Вывод весов для отладки
     std::vector<EncoderLayer>& get_layers();
     const std::vector<EncoderLayer>& get_layers() const { return layers_; }
 
 private:
-    int num_layers_;                //   (, 6)
-    std::vector<EncoderLayer> layers_; //  
-    std::vector<std::vector<std::vector<float>>> encoder_inputs_;
+    int num_layers_;                // Количество слоев (например, 6)
+    std::vector<EncoderLayer> layers_; // Стек слоев
+    std::vector<Tensor> encoder_inputs_;
 };
\ No newline at end of file
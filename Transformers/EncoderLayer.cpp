@@ -7,9 +7,9 @@ EncoderLayer::EncoderLayer(int num_heads, int embedding_dim, int hidden_dim)
     ff_(embedding_dim, hidden_dim),
     add_norm_ff_(embedding_dim) {}
 
-std::vector<std::vector<float>> EncoderLayer::forward_encoder_layer(const std::vector<std::vector<float>>& source_input) {
+Tensor EncoderLayer::forward_encoder_layer(const Tensor& source_input, const BatchLayout& layout) {
     // Multi-Head Attention + Add & Norm
-    auto mha_output = mha_.forward_mha(source_input, false); //  
+    auto mha_output = mha_.forward_mha(source_input, false, layout); // без маски (кроме заполнения)
     auto layer_norm_mha = add_norm_mha_.forward_an(mha_output, source_input);
 
     // Feed Forward + Add & Norm
@@ -19,20 +19,20 @@ std::vector<std::vector<float>> EncoderLayer::forward_encoder_layer(const std::v
     return layer_norm_ff;
 }
 
-std::vector<std::vector<float>> EncoderLayer::backward_encoder_layer(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& source_input, float learning_rate) {
-    //    Add & Norm  Cross MHA
+Tensor EncoderLayer::backward_encoder_layer(const Tensor& grad_output, const Tensor& source_input, float learning_rate) {
+    // Обратный проход через Add & Norm после Cross MHA
     auto grad_add_ff = add_norm_ff_.backward_an(grad_output, learning_rate);
 
-    //    Feed-Forward
+    // Обратный проход через Feed-Forward
     auto grad_ff = ff_.backward_ff(grad_add_ff, learning_rate);
 
-    //    Add & Norm  MHA
+    // Обратный проход через Add & Norm после MHA
     auto grad_add_mha = add_norm_ff_.backward_an(grad_add_ff, grad_ff, learning_rate);
 
-    //    MHA
+    // Обратный проход через MHA
     auto grad_mha = mha_.backward_mha(grad_add_mha, source_input, learning_rate);
 
-    //    mha  Add & Norm  
+    // Сложение градиентов от mha и Add & Norm после него
     auto grad_source_input = utils::add_embeddings(grad_add_mha, grad_mha);
 
     return grad_source_input;
@@ -53,6 +53,34 @@ void EncoderLayer::initialize_random() {
     add_norm_ff_.initialize_random();
 }
 
+void EncoderLayer::set_gradient_accumulation(bool enabled) {
+    mha_.set_gradient_accumulation(enabled);
+    add_norm_mha_.set_gradient_accumulation(enabled);
+    ff_.set_gradient_accumulation(enabled);
+    add_norm_ff_.set_gradient_accumulation(enabled);
+}
+
+void EncoderLayer::set_activation_precision(Precision format) {
+    ff_.set_activation_precision(format);
+    add_norm_mha_.set_activation_precision(format);
+    add_norm_ff_.set_activation_precision(format);
+}
+
+void EncoderLayer::collect_parameters(std::vector<ParameterRef>& params) {
+    size_t first = params.size();
+    mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "mha.");
+    first = params.size();
+    add_norm_mha_.collect_parameters(params);
+    prefix_parameter_names(params, first, "add_norm_mha.");
+    first = params.size();
+    ff_.collect_parameters(params);
+    prefix_parameter_names(params, first, "ff.");
+    first = params.size();
+    add_norm_ff_.collect_parameters(params);
+    prefix_parameter_names(params, first, "add_norm_ff.");
+}
+
 void EncoderLayer::save_weights(std::ofstream& out) const {
     mha_.save_weights(out);
     add_norm_mha_.save_weights(out);
@@ -65,4 +93,28 @@ void EncoderLayer::load_weights(std::ifstream& in) {
     add_norm_mha_.load_weights(in);
     ff_.load_weights(in);
     add_norm_ff_.load_weights(in);
+}
+
+void EncoderLayer::set_calibration(bool enabled) {
+    mha_.set_calibration(enabled);
+    ff_.set_calibration(enabled);
+}
+
+void EncoderLayer::quantize_int8() {
+    mha_.quantize_int8();
+    ff_.quantize_int8();
+}
+
+void EncoderLayer::save_quantized(std::ofstream& out) const {
+    mha_.save_quantized(out);
+    add_norm_mha_.save_weights(out);
+    ff_.save_quantized(out);
+    add_norm_ff_.save_weights(out);
+}
+
+void EncoderLayer::load_quantized(std::ifstream& in) {
+    mha_.load_quantized(in);
+    add_norm_mha_.load_weights(in);
+    ff_.load_quantized(in);
+    add_norm_ff_.load_weights(in);
 }
\ No newline at end of file
@@ -8,23 +8,35 @@ class EncoderLayer {
 public:
     EncoderLayer(int num_heads, int embedding_dim, int hidden_dim);
 
-    std::vector<std::vector<float>> forward_encoder_layer(const std::vector<std::vector<float>>& source_input);
-    std::vector<std::vector<float>> backward_encoder_layer(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& source_input, float learning_rate);
+    // layout — разметка мини-батча (по умолчанию одна последовательность)
+    Tensor forward_encoder_layer(const Tensor& source_input, const BatchLayout& layout = BatchLayout());
+    Tensor backward_encoder_layer(const Tensor& grad_output, const Tensor& source_input, float learning_rate);
 
-    //  ( ),  ( )    MHA, add&norm, feed forward
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров MHA, add&norm, feed forward
     void initialize_random();
     void save_weights(std::ofstream& out) const;
     void load_weights(std::ifstream& in);
 
-    //    
+    // Режим накопления градиентов и список параметров всех блоков слоя (в порядке сохранения)
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    // Формат сохраняемых для backward активаций (bf16/fp16 в режиме пониженной точности)
+    void set_activation_precision(Precision format);
+    // Int8-квантование матриц весов MHA и FeedForward слоя для инференса (нормализации остаются float)
+    void set_calibration(bool enabled);
+    void quantize_int8();
+    void save_quantized(std::ofstream& out) const;
+    void load_quantized(std::ifstream& in);
+
+    // Вывод весов для отладки
     /*const MultiHeadAttention& get_mha() const;
     const FeedForward& get_ff() const;*/
 
 private:
-    MultiHeadAttention mha_;    //  
-    AddNorm add_norm_mha_;      //   MHA
-    FeedForward ff_;            //  
-    AddNorm add_norm_ff_;       //   Feed Forward
+    MultiHeadAttention mha_;    // Многоголовое внимание
+    AddNorm add_norm_mha_;      // Нормализация после MHA
+    FeedForward ff_;            // Полносвязная сеть
+    AddNorm add_norm_ff_;       // Нормализация после Feed Forward
 
-    //std::vector<std::vector<float>> layer_norm_mha;
+    //Tensor layer_norm_mha;
 };
\ No newline at end of file
@@ -0,0 +1,11 @@
+﻿#pragma once
+#include "Tensor.h"
+#include <vector>
+
+// Результат энкодера для одного запроса: выход энкодера и спроецированные K/V cross-attention
+// каждого слоя декодера. Считается один раз (Transformer::encode) и переиспользуется на всех шагах генерации
+struct EncoderMemory {
+    Tensor encoder_output;
+    std::vector<Tensor> cross_K; // По одному на слой декодера: seq_len_src x embedding_dim, голова h — столбцы [h * head_dim, (h + 1) * head_dim)
+    std::vector<Tensor> cross_V;
+};
\ No newline at end of file
@@ -1,17 +1,17 @@
 ﻿#include "ErrorPlot.h"
 
-void ErrorPlot::ComputeAndAddLoss(const std::vector<std::vector<float>>& probabilities,
-	const std::vector<std::vector<float>>& target_one_hot)
+void ErrorPlot::ComputeAndAddLoss(const Tensor& probabilities,
+	const Tensor& target_one_hot)
 {
 	float loss = compute_cross_entropy_loss(probabilities, target_one_hot);
 	train_losses_.push_back(loss);
 }
 
-float ErrorPlot::compute_cross_entropy_loss(const std::vector<std::vector<float>>& probabilities,
-	const std::vector<std::vector<float>>& target_one_hot)
+float ErrorPlot::compute_cross_entropy_loss(const Tensor& probabilities,
+	const Tensor& target_one_hot)
 {
-	const size_t N = probabilities.size();
-	const size_t C = probabilities[0].size();
+	const size_t N = probabilities.rows();
+	const size_t C = probabilities.cols();
 	float sum = 0.0f;
 	for (size_t i = 0; i < N; ++i) {
 		for (size_t j = 0; j < C; ++j) {
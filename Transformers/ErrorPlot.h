@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include "Tensor.h"
 #include <vector>
 #include <cmath>
 #include <algorithm>
@@ -8,8 +9,10 @@
 class ErrorPlot {
 public:
 	// Вычислить и сохранить новый loss
-	void ComputeAndAddLoss(const std::vector<std::vector<float>>& probabilities,
-		const std::vector<std::vector<float>>& target_one_hot);
+	void ComputeAndAddLoss(const Tensor& probabilities,
+		const Tensor& target_one_hot);
+	// Сохранить уже посчитанный loss (например, возвращённый тренером)
+	void AddLoss(float loss) { train_losses_.push_back(loss); }
 
 	// Нарисовать накопленный график
 	void Render(const char* title);
@@ -18,7 +21,7 @@ public:
 	int Count() const { return static_cast<int>(train_losses_.size()); }
 	std::vector<float> Epochs() const {
 		std::vector<float> e(train_losses_.size());
-		for (int i = 0; i < e.size(); ++i) e[i] = float(i + 1);
+		for (size_t i = 0; i < e.size(); ++i) e[i] = float(i + 1);
 		return e;
 	}
 	const std::vector<float>& Losses() const { return train_losses_; }
@@ -27,6 +30,6 @@ private:
 	std::vector<float> train_losses_; // Сохранённые значения loss по эпохам
 
 	// Внутренняя утилита: вычисляет cross‑entropy от всей батчи
-	float compute_cross_entropy_loss(const std::vector<std::vector<float>>& probabilities,
-		const std::vector<std::vector<float>>& target_one_hot);
+	float compute_cross_entropy_loss(const Tensor& probabilities,
+		const Tensor& target_one_hot);
 };
\ No newline at end of file
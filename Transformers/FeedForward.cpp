@@ -3,114 +3,134 @@
 
 extern int paramCount;
 
-// 
+// Конструктор
 FeedForward::FeedForward(int embedding_dim, int hidden_dim)
     : embedding_dim_(embedding_dim), hidden_dim_(hidden_dim) {
 
     paramCount += embedding_dim_ * hidden_dim_ + hidden_dim_ * embedding_dim_ + hidden_dim_ + embedding_dim_;
 }
 
-//  forward_ff
-std::vector<std::vector<float>> FeedForward::forward_ff(const std::vector<std::vector<float>>& input) {
-    last_input_ = input;                         //  
-    ff1_ = linear(input, W1_, b1_);              //  
-    relu_ = apply_relu(ff1_);                    // ReLU
-    ff2_ = linear(relu_, W2_, b2_);              //  
-    return ff2_;
+// Метод forward_ff
+Tensor FeedForward::forward_ff(const Tensor& input) {
+    last_input_.store(input, activation_precision_);                              // Сохраняем вход
+    Tensor ff1 = linear(input, W1_int8_, weight_operand(W1_, W1_half_), b1_);     // Первый слой
+    Tensor relu = apply_relu(ff1);                                                // ReLU
+    relu_.store(relu, activation_precision_);
+    return linear(relu, W2_int8_, weight_operand(W2_, W2_half_), b2_);            // Второй слой
 }
 
-//  backward_ff
-std::vector<std::vector<float>> FeedForward::backward_ff(const std::vector<std::vector<float>>& grad_output, float learning_rate) {
-    size_t seq_len = last_input_.size();
+// Метод backward_ff
+Tensor FeedForward::backward_ff(const Tensor& grad_output, float learning_rate) {
+    size_t seq_len = last_input_.rows();
+    if (W1_.empty()) {
+        throw std::runtime_error("FeedForward: веса загружены только в int8, обратный проход недоступен");
+    }
 
-    //     : grad_relu = grad_output * W2_.transpose()
-    auto W2_T = utils::transpose(W2_);
-    auto grad_relu = utils::matrix_multiply(grad_output, W2_T);
+    // Градиент через второй линейный слой: grad_relu = grad_output * W2_^T
+    auto grad_relu = utils::matrix_multiply(grad_output, weight_operand(W2_, W2_half_), false, true);
 
-    //   ReLU
-    std::vector<std::vector<float>> grad_ff1(seq_len, std::vector<float>(hidden_dim_, 0.0f));
+    // Градиент через ReLU: выход ReLU положителен ровно там, где положителен её вход
+    Tensor grad_ff1(seq_len, hidden_dim_);
+    std::vector<float> relu_row(hidden_dim_);
     for (size_t i = 0; i < seq_len; ++i) {
-        for (size_t j = 0; j < hidden_dim_; ++j) {
-            grad_ff1[i][j] = (ff1_[i][j] > 0) ? grad_relu[i][j] : 0.0f;
+        relu_.row_to_float(i, relu_row.data());
+        for (int j = 0; j < hidden_dim_; ++j) {
+            grad_ff1[i][j] = (relu_row[j] > 0) ? grad_relu[i][j] : 0.0f;
         }
     }
 
-    //     : grad_input = grad_ff1 * W1_.transpose()
-    auto W1_T = utils::transpose(W1_);
-    auto grad_input = utils::matrix_multiply(grad_ff1, W1_T);
-
-    //   
-    auto input_T = utils::transpose(last_input_);
-    auto grad_W1 = utils::matrix_multiply(input_T, grad_ff1);
-    auto grad_b1 = std::vector<float>(hidden_dim_, 0.0f);
-    for (size_t j = 0; j < hidden_dim_; ++j) {
-        for (size_t i = 0; i < seq_len; ++i) {
-            grad_b1[j] += grad_ff1[i][j];
-        }
-    }
+    // Градиент через первый линейный слой: grad_input = grad_ff1 * W1_^T
+    auto grad_input = utils::matrix_multiply(grad_ff1, weight_operand(W1_, W1_half_), false, true);
 
-    auto relu_T = utils::transpose(relu_);
-    auto grad_W2 = utils::matrix_multiply(relu_T, grad_output);
-    auto grad_b2 = std::vector<float>(embedding_dim_, 0.0f);
-    for (size_t j = 0; j < embedding_dim_; ++j) {
-        for (size_t i = 0; i < seq_len; ++i) {
-            grad_b2[j] += grad_output[i][j];
-        }
-    }
+    // Градиенты по параметрам
+    auto grad_W1 = utils::matrix_multiply(last_input_.operand(), grad_ff1, true, false);
+    auto grad_b1 = utils::column_sums(grad_ff1);
 
-    //  
-    for (size_t i = 0; i < embedding_dim_; ++i) {
-        for (size_t j = 0; j < hidden_dim_; ++j) {
-            W1_[i][j] -= learning_rate * grad_W1[i][j];
-        }
-    }
-    for (size_t j = 0; j < hidden_dim_; ++j) {
-        b1_[j] -= learning_rate * grad_b1[j];
-    }
-    for (size_t i = 0; i < hidden_dim_; ++i) {
-        for (size_t j = 0; j < embedding_dim_; ++j) {
-            W2_[i][j] -= learning_rate * grad_W2[i][j];
-        }
+    auto grad_W2 = utils::matrix_multiply(relu_.operand(), grad_output, true, false);
+    auto grad_b2 = utils::column_sums(grad_output);
+
+    // Обновление параметров (или накопление градиентов)
+    utils::apply_gradient(W1_.data(), grad_W1_.data(), grad_W1.data(), W1_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(b1_.data(), grad_b1_.data(), grad_b1.data(), b1_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(W2_.data(), grad_W2_.data(), grad_W2.data(), W2_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(b2_.data(), grad_b2_.data(), grad_b2.data(), b2_.size(), learning_rate, accumulate_gradients_);
+
+    return grad_input;
+}
+
+void FeedForward::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенные буферы не перевыделяются: они могут жить в общей области параметров
+    if (!enabled) {
+        grad_W1_ = Tensor();
+        grad_W2_ = Tensor();
+        grad_b1_ = Tensor();
+        grad_b2_ = Tensor();
     }
-    for (size_t j = 0; j < embedding_dim_; ++j) {
-        b2_[j] -= learning_rate * grad_b2[j];
+    else if (grad_W1_.empty()) {
+        grad_W1_.assign(embedding_dim_, hidden_dim_, 0.0f);
+        grad_W2_.assign(hidden_dim_, embedding_dim_, 0.0f);
+        grad_b1_.assign(1, hidden_dim_, 0.0f);
+        grad_b2_.assign(1, embedding_dim_, 0.0f);
     }
+}
 
-    return grad_input;
+void FeedForward::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &W1_, &grad_W1_, &W1_half_, "W1" });
+    params.push_back({ &b1_, &grad_b1_, nullptr, "b1" });
+    params.push_back({ &W2_, &grad_W2_, &W2_half_, "W2" });
+    params.push_back({ &b2_, &grad_b2_, nullptr, "b2" });
 }
 
-//   
-const std::vector<std::vector<float>>& FeedForward::get_W1() const {
+void FeedForward::set_calibration(bool enabled) {
+    W1_int8_.set_calibration(enabled);
+    W2_int8_.set_calibration(enabled);
+}
+
+void FeedForward::quantize_int8() {
+    W1_int8_.quantize(W1_);
+    W2_int8_.quantize(W2_);
+}
+
+void FeedForward::save_quantized(std::ofstream& out) const {
+    W1_int8_.matrix.save(out);
+    utils::write_vector(out, b1_);
+    W2_int8_.matrix.save(out);
+    utils::write_vector(out, b2_);
+}
+
+void FeedForward::load_quantized(std::ifstream& in) {
+    W1_int8_.matrix.load(in);
+    utils::read_vector(in, b1_);
+    W2_int8_.matrix.load(in);
+    utils::read_vector(in, b2_);
+    if ((int)W1_int8_.matrix.rows() != embedding_dim_ || (int)W1_int8_.matrix.cols() != hidden_dim_
+        || (int)W2_int8_.matrix.rows() != hidden_dim_ || (int)W2_int8_.matrix.cols() != embedding_dim_
+        || (int)b1_.size() != hidden_dim_ || (int)b2_.size() != embedding_dim_)
+        throw std::runtime_error("Неверный размер int8-параметров в FeedForward при загрузке");
+    W1_ = Tensor();
+    W2_ = Tensor();
+}
+
+// Геттеры для весов
+const Tensor& FeedForward::get_W1() const {
     return W1_;
 }
 
-const std::vector<std::vector<float>>& FeedForward::get_W2() const {
+const Tensor& FeedForward::get_W2() const {
     return W2_;
 }
 
-//  
-std::vector<std::vector<float>> FeedForward::linear(const std::vector<std::vector<float>>& X,
-    const std::vector<std::vector<float>>& W,
-    const std::vector<float>& b) {
-    size_t rows = X.size();
-    size_t cols = W[0].size();
-    std::vector<std::vector<float>> result(rows, std::vector<float>(cols, 0.0f));
-    for (size_t i = 0; i < rows; ++i) {
-        for (size_t j = 0; j < cols; ++j) {
-            for (size_t k = 0; k < X[0].size(); ++k) {
-                result[i][j] += X[i][k] * W[k][j];
-            }
-            result[i][j] += b[j];
-        }
-    }
-    return result;
+// Линейное преобразование
+Tensor FeedForward::linear(const Tensor& X, const Int8Weight& W_int8, const MatrixOperand& W, const Tensor& bias) {
+    return W_int8.multiply(X, W, bias.data());
 }
 
-//  ReLU
-std::vector<std::vector<float>> FeedForward::apply_relu(const std::vector<std::vector<float>>& X) {
-    size_t rows = X.size();
-    size_t cols = X[0].size();
-    std::vector<std::vector<float>> result(rows, std::vector<float>(cols));
+// Применение ReLU
+Tensor FeedForward::apply_relu(const Tensor& X) {
+    size_t rows = X.rows();
+    size_t cols = X.cols();
+    Tensor result(rows, cols);
     for (size_t i = 0; i < rows; ++i) {
         for (size_t j = 0; j < cols; ++j) {
             result[i][j] = std::max(0.0f, X[i][j]);
@@ -120,23 +140,23 @@ std::vector<std::vector<float>> FeedForward::apply_relu(const std::vector<std::v
 }
 
 void FeedForward::initialize_random() {
-    //    
+    // Инициализация весов и смещений
     std::random_device rd;
     std::mt19937 gen(rd());
     std::normal_distribution<float> dist(0.0f, 1.0f / std::sqrt(static_cast<float>(embedding_dim_)));
 
-    W1_.resize(embedding_dim_, std::vector<float>(hidden_dim_));
-    b1_.resize(hidden_dim_, 0.0f);
-    W2_.resize(hidden_dim_, std::vector<float>(embedding_dim_));
-    b2_.resize(embedding_dim_, 0.0f);
+    W1_.resize(embedding_dim_, hidden_dim_);
+    b1_.assign(1, hidden_dim_, 0.0f);
+    W2_.resize(hidden_dim_, embedding_dim_);
+    b2_.assign(1, embedding_dim_, 0.0f);
 
-    //  W1
+    // Инициализация W1
     for (int i = 0; i < embedding_dim_; ++i) {
         for (int j = 0; j < hidden_dim_; ++j) {
             W1_[i][j] = dist(gen);
         }
     }
-    //  W2
+    // Инициализация W2
     for (int i = 0; i < hidden_dim_; ++i) {
         for (int j = 0; j < embedding_dim_; ++j) {
             W2_[i][j] = dist(gen);
@@ -156,9 +176,9 @@ void FeedForward::load_weights(std::ifstream& in) {
     utils::read_vector(in, b1_);
     utils::read_matrix(in, W2_);
     utils::read_vector(in, b2_);
-    //  
-    if ((int)W1_.size() != embedding_dim_ || (int)W1_[0].size() != hidden_dim_
-        || (int)W2_.size() != hidden_dim_ || (int)W2_[0].size() != embedding_dim_
+    // Проверим размеры
+    if ((int)W1_.rows() != embedding_dim_ || (int)W1_.cols() != hidden_dim_
+        || (int)W2_.rows() != hidden_dim_ || (int)W2_.cols() != embedding_dim_
         || (int)b1_.size() != hidden_dim_ || (int)b2_.size() != embedding_dim_)
-        throw std::runtime_error("    FeedForward  ");
+        throw std::runtime_error("Неверный размер параметров в FeedForward при загрузке");
 }
\ No newline at end of file
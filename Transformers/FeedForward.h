@@ -1,5 +1,7 @@
 #pragma once
 #include "utils.h"
+#include "Parameter.h"
+#include "Quantization.h"
 #include <vector>
 #include <cmath>
 #include <random>
@@ -8,35 +10,53 @@
 
 class FeedForward {
 public:
-    // 
+    // Конструктор
     FeedForward(int embedding_dim, int hidden_dim);
 
-    //  forward  backward
-    std::vector<std::vector<float>> forward_ff(const std::vector<std::vector<float>>& input);
-    std::vector<std::vector<float>> backward_ff(const std::vector<std::vector<float>>& grad_output, float learning_rate);
+    // Методы forward и backward
+    Tensor forward_ff(const Tensor& input);
+    Tensor backward_ff(const Tensor& grad_output, float learning_rate);
 
-    //  ( ),  ( )    MHA, add&norm, feed forward
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров MHA, add&norm, feed forward
     void initialize_random();
     void save_weights(std::ofstream& out) const;
     void load_weights(std::ifstream& in);
 
-    //   
-    const std::vector<std::vector<float>>& get_W1() const;
-    const std::vector<std::vector<float>>& get_W2() const;
+    // Режим накопления: backward_ff складывает градиенты в буферы вместо шага SGD
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    // Формат сохраняемых для backward активаций (вход и выход ReLU)
+    void set_activation_precision(Precision format) { activation_precision_ = format; }
+
+    // Int8-квантование W1_ и W2_ для инференса (см. Linear); смещения остаются float и прибавляются при деквантизации
+    void set_calibration(bool enabled);
+    void quantize_int8();
+    void save_quantized(std::ofstream& out) const;
+    void load_quantized(std::ifstream& in);
+
+    // Геттеры для весов
+    const Tensor& get_W1() const;
+    const Tensor& get_W2() const;
 
 private:
-    //  
-    std::vector<std::vector<float>> linear(const std::vector<std::vector<float>>& X,
-        const std::vector<std::vector<float>>& W,
-        const std::vector<float>& b);
+    // Линейное преобразование
+    Tensor linear(const Tensor& X, const Int8Weight& W_int8, const MatrixOperand& W, const Tensor& b);
 
-    //  ReLU
-    std::vector<std::vector<float>> apply_relu(const std::vector<std::vector<float>>& X);
+    // Применение ReLU
+    Tensor apply_relu(const Tensor& X);
 
-    //  
+    // Поля класса
     int embedding_dim_;
     int hidden_dim_;
-    std::vector<std::vector<float>> W1_, W2_;
-    std::vector<float> b1_, b2_;
-    std::vector<std::vector<float>> last_input_, ff1_, relu_, ff2_;
+    Tensor W1_, W2_;
+    HalfView W1_half_, W2_half_; // 16-битные копии весов (только в режиме пониженной точности)
+    Int8Weight W1_int8_, W2_int8_; // Int8-копии весов (после квантования)
+    Tensor b1_, b2_;          // Смещения, векторы-строки
+    // Накопленные градиенты (только в режиме накопления)
+    Tensor grad_W1_, grad_W2_;
+    Tensor grad_b1_, grad_b2_;
+    bool accumulate_gradients_ = false;
+    Precision activation_precision_ = Precision::Float32;
+    // Для backward сохраняются вход и выход ReLU (маска ReLU восстанавливается по relu_ > 0)
+    SavedActivation last_input_, relu_;
 };
@@ -0,0 +1,440 @@
+﻿#include "Gemm.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+namespace gemm {
+    namespace {
+        // Размеры блоков: панель B (KC x NC) живёт в L3, панель A (MC x KC) — в L2, микротайл — в регистрах
+        constexpr size_t KC = 256;
+        constexpr size_t MC = 96;    // Кратно MR всех ядер
+        constexpr size_t NC = 3072;  // Кратно NR всех ядер
+        constexpr size_t MAX_TILE = 6 * 32;
+        // Для совсем маленьких задач упаковка не окупается
+        constexpr size_t SMALL_WORK = 8 * 1024;
+        // Меньшие задачи считаются в одном потоке; минимальные размеры части C при распараллеливании
+        constexpr size_t PARALLEL_WORK = 256 * 1024;
+        constexpr size_t MIN_PART_ROWS = 48;
+        constexpr size_t MIN_PART_COLS = 64;
+
+        // Микроядро: C[mr x nr] = alpha * (упакованная A) * (упакованная B) + beta * C
+        using KernelFn = void (*)(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta);
+
+        struct Kernel {
+            size_t mr;
+            size_t nr;
+            KernelFn fn;
+        };
+
+        // Выровненный буфер упаковки; у каждого потока свой
+        struct PackBuffer {
+            float* data = nullptr;
+            size_t capacity = 0;
+
+            ~PackBuffer() {
+                if (data) ::operator delete(data, std::align_val_t(64));
+            }
+
+            float* get(size_t count) {
+                if (count > capacity) {
+                    if (data) ::operator delete(data, std::align_val_t(64));
+                    data = static_cast<float*>(::operator new(count * sizeof(float), std::align_val_t(64)));
+                    capacity = count;
+                }
+                return data;
+            }
+        };
+
+        void kernel_scalar_6x16(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta) {
+            constexpr size_t MR = 6, NR = 16;
+            float acc[MR][NR] = {};
+            for (size_t k = 0; k < kc; ++k) {
+                for (size_t i = 0; i < MR; ++i) {
+                    float av = a[i];
+                    for (size_t j = 0; j < NR; ++j) {
+                        acc[i][j] += av * b[j];
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+            for (size_t i = 0; i < MR; ++i) {
+                float* row = c + i * ldc;
+                for (size_t j = 0; j < NR; ++j) {
+                    row[j] = (beta == 0.0f) ? alpha * acc[i][j] : alpha * acc[i][j] + beta * row[j];
+                }
+            }
+        }
+
+#if SIMD_X86
+        SIMD_TARGET_AVX2
+        inline void store_avx2(float* c, __m256 acc, __m256 valpha, float beta) {
+            __m256 r = _mm256_mul_ps(acc, valpha);
+            if (beta != 0.0f) {
+                r = _mm256_fmadd_ps(_mm256_set1_ps(beta), _mm256_loadu_ps(c), r);
+            }
+            _mm256_storeu_ps(c, r);
+        }
+
+        // 6 x 16: 12 аккумуляторов ymm + 2 под строку B + 1 под broadcast A
+        SIMD_TARGET_AVX2
+        void kernel_avx2_6x16(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta) {
+            __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+            __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+            __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+            __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+            __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+            __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+            for (size_t k = 0; k < kc; ++k) {
+                __m256 b0 = _mm256_load_ps(b);
+                __m256 b1 = _mm256_load_ps(b + 8);
+                __m256 av;
+                av = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+                av = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+                av = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+                av = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+                av = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+                av = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+                a += 6;
+                b += 16;
+            }
+            __m256 valpha = _mm256_set1_ps(alpha);
+            store_avx2(c + 0 * ldc, c00, valpha, beta); store_avx2(c + 0 * ldc + 8, c01, valpha, beta);
+            store_avx2(c + 1 * ldc, c10, valpha, beta); store_avx2(c + 1 * ldc + 8, c11, valpha, beta);
+            store_avx2(c + 2 * ldc, c20, valpha, beta); store_avx2(c + 2 * ldc + 8, c21, valpha, beta);
+            store_avx2(c + 3 * ldc, c30, valpha, beta); store_avx2(c + 3 * ldc + 8, c31, valpha, beta);
+            store_avx2(c + 4 * ldc, c40, valpha, beta); store_avx2(c + 4 * ldc + 8, c41, valpha, beta);
+            store_avx2(c + 5 * ldc, c50, valpha, beta); store_avx2(c + 5 * ldc + 8, c51, valpha, beta);
+        }
+
+        SIMD_TARGET_AVX512
+        inline void store_avx512(float* c, __m512 acc, __m512 valpha, float beta) {
+            __m512 r = _mm512_mul_ps(acc, valpha);
+            if (beta != 0.0f) {
+                r = _mm512_fmadd_ps(_mm512_set1_ps(beta), _mm512_loadu_ps(c), r);
+            }
+            _mm512_storeu_ps(c, r);
+        }
+
+        // 6 x 32: 12 аккумуляторов zmm
+        SIMD_TARGET_AVX512
+        void kernel_avx512_6x32(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta) {
+            __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+            __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+            __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+            __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+            __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+            __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+            for (size_t k = 0; k < kc; ++k) {
+                __m512 b0 = _mm512_load_ps(b);
+                __m512 b1 = _mm512_load_ps(b + 16);
+                __m512 av;
+                av = _mm512_set1_ps(a[0]); c00 = _mm512_fmadd_ps(av, b0, c00); c01 = _mm512_fmadd_ps(av, b1, c01);
+                av = _mm512_set1_ps(a[1]); c10 = _mm512_fmadd_ps(av, b0, c10); c11 = _mm512_fmadd_ps(av, b1, c11);
+                av = _mm512_set1_ps(a[2]); c20 = _mm512_fmadd_ps(av, b0, c20); c21 = _mm512_fmadd_ps(av, b1, c21);
+                av = _mm512_set1_ps(a[3]); c30 = _mm512_fmadd_ps(av, b0, c30); c31 = _mm512_fmadd_ps(av, b1, c31);
+                av = _mm512_set1_ps(a[4]); c40 = _mm512_fmadd_ps(av, b0, c40); c41 = _mm512_fmadd_ps(av, b1, c41);
+                av = _mm512_set1_ps(a[5]); c50 = _mm512_fmadd_ps(av, b0, c50); c51 = _mm512_fmadd_ps(av, b1, c51);
+                a += 6;
+                b += 32;
+            }
+            __m512 valpha = _mm512_set1_ps(alpha);
+            store_avx512(c + 0 * ldc, c00, valpha, beta); store_avx512(c + 0 * ldc + 16, c01, valpha, beta);
+            store_avx512(c + 1 * ldc, c10, valpha, beta); store_avx512(c + 1 * ldc + 16, c11, valpha, beta);
+            store_avx512(c + 2 * ldc, c20, valpha, beta); store_avx512(c + 2 * ldc + 16, c21, valpha, beta);
+            store_avx512(c + 3 * ldc, c30, valpha, beta); store_avx512(c + 3 * ldc + 16, c31, valpha, beta);
+            store_avx512(c + 4 * ldc, c40, valpha, beta); store_avx512(c + 4 * ldc + 16, c41, valpha, beta);
+            store_avx512(c + 5 * ldc, c50, valpha, beta); store_avx512(c + 5 * ldc + 16, c51, valpha, beta);
+        }
+#endif
+
+        Isa detect() {
+#if SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+            int r[4];
+            __cpuid(r, 0);
+            if (r[0] < 7) return Isa::Scalar;
+            __cpuid(r, 1);
+            bool fma = (r[2] & (1 << 12)) != 0;
+            bool osxsave = (r[2] & (1 << 27)) != 0;
+            bool avx = (r[2] & (1 << 28)) != 0;
+            if (!fma || !osxsave || !avx) return Isa::Scalar;
+            unsigned long long xcr0 = _xgetbv(0);
+            if ((xcr0 & 0x6) != 0x6) return Isa::Scalar;
+            __cpuidex(r, 7, 0);
+            bool avx2 = (r[1] & (1 << 5)) != 0;
+            bool avx512f = (r[1] & (1 << 16)) != 0;
+            if (avx512f && (xcr0 & 0xE6) == 0xE6) return Isa::Avx512;
+            return avx2 ? Isa::Avx2 : Isa::Scalar;
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return Isa::Avx512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::Avx2;
+            return Isa::Scalar;
+#endif
+#else
+            return Isa::Scalar;
+#endif
+        }
+
+        std::atomic<int>& active_isa_storage() {
+            static std::atomic<int> isa(static_cast<int>(detected_isa()));
+            return isa;
+        }
+
+        Kernel select_kernel() {
+            switch (active_isa()) {
+#if SIMD_X86
+            case Isa::Avx512: return { 6, 32, kernel_avx512_6x32 };
+            case Isa::Avx2: return { 6, 16, kernel_avx2_6x16 };
+#endif
+            default: return { 6, 16, kernel_scalar_6x16 };
+            }
+        }
+
+        // Непрерывный участок строки row матрицы X начиная со столбца col. Для float — указатель прямо в X,
+        // для bf16/fp16 — участок, преобразованный в scratch
+        inline const float* load_run(const Operand& X, size_t row, size_t col, size_t count, float* scratch) {
+            size_t offset = row * X.ld + col;
+            if (X.format == Precision::Float32) {
+                return static_cast<const float*>(X.data) + offset;
+            }
+            precision::to_float(X.format, static_cast<const uint16_t*>(X.data) + offset, scratch, count);
+            return scratch;
+        }
+
+        Operand offset_operand(const Operand& X, size_t row, size_t col) {
+            const char* base = static_cast<const char*>(X.data);
+            return { base + (row * X.ld + col) * precision::element_size(X.format), X.ld, X.format };
+        }
+
+        // Упаковка блока op(A)[ic.., pc..] (mc x kc) в панели по mr строк; внутри панели — подряд по k,
+        // недостающие строки — нули. При trans_a строки op(A) — это столбцы A
+        void pack_a(bool trans_a, size_t ic, size_t pc, size_t mc, size_t kc, const Operand& A, size_t mr, float* dst) {
+            alignas(64) float scratch[KC];
+            for (size_t i0 = 0; i0 < mc; i0 += mr) {
+                size_t rows = std::min(mr, mc - i0);
+                if (trans_a) {
+                    // op(A)(i, k) = A[k][i]: строка A даёт сразу mr соседних элементов панели
+                    for (size_t k = 0; k < kc; ++k) {
+                        const float* src = load_run(A, pc + k, ic + i0, rows, scratch);
+                        std::memcpy(dst + k * mr, src, rows * sizeof(float));
+                        std::fill(dst + k * mr + rows, dst + (k + 1) * mr, 0.0f);
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < rows; ++i) {
+                        const float* src = load_run(A, ic + i0 + i, pc, kc, scratch);
+                        for (size_t k = 0; k < kc; ++k) {
+                            dst[k * mr + i] = src[k];
+                        }
+                    }
+                    for (size_t i = rows; i < mr; ++i) {
+                        for (size_t k = 0; k < kc; ++k) {
+                            dst[k * mr + i] = 0.0f;
+                        }
+                    }
+                }
+                dst += mr * kc;
+            }
+        }
+
+        // Упаковка блока op(B)[pc.., jc..] (kc x nc) в панели по nr столбцов; недостающие столбцы — нули.
+        // При trans_b столбцы op(B) — это строки B
+        void pack_b(bool trans_b, size_t pc, size_t jc, size_t kc, size_t nc, const Operand& B, size_t nr, float* dst) {
+            alignas(64) float scratch[KC];
+            for (size_t j0 = 0; j0 < nc; j0 += nr) {
+                size_t cols = std::min(nr, nc - j0);
+                if (trans_b) {
+                    for (size_t j = 0; j < cols; ++j) {
+                        const float* src = load_run(B, jc + j0 + j, pc, kc, scratch);
+                        for (size_t k = 0; k < kc; ++k) {
+                            dst[k * nr + j] = src[k];
+                        }
+                    }
+                    for (size_t k = 0; k < kc; ++k) {
+                        std::fill(dst + k * nr + cols, dst + (k + 1) * nr, 0.0f);
+                    }
+                }
+                else {
+                    for (size_t k = 0; k < kc; ++k) {
+                        std::memcpy(dst + k * nr, load_run(B, pc + k, jc + j0, cols, scratch), cols * sizeof(float));
+                        std::fill(dst + k * nr + cols, dst + (k + 1) * nr, 0.0f);
+                    }
+                }
+                dst += nr * kc;
+            }
+        }
+
+        void scale_c(size_t M, size_t N, float beta, float* C, size_t ldc) {
+            for (size_t i = 0; i < M; ++i) {
+                float* row = C + i * ldc;
+                if (beta == 0.0f) {
+                    std::fill(row, row + N, 0.0f);
+                }
+                else if (beta != 1.0f) {
+                    for (size_t j = 0; j < N; ++j) row[j] *= beta;
+                }
+            }
+        }
+
+        // Маленькие задачи без упаковки. Без trans_b — порядок i-k-j (строки B и C подряд),
+        // с trans_b — скалярные произведения строк op(A) и строк B
+        void small_gemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, float alpha, const float* A, size_t lda,
+            const float* B, size_t ldb, float beta, float* C, size_t ldc) {
+            if (trans_b) {
+                for (size_t i = 0; i < M; ++i) {
+                    float* c = C + i * ldc;
+                    for (size_t j = 0; j < N; ++j) {
+                        const float* b = B + j * ldb;
+                        float acc = 0.0f;
+                        for (size_t k = 0; k < K; ++k) {
+                            acc += (trans_a ? A[k * lda + i] : A[i * lda + k]) * b[k];
+                        }
+                        c[j] = (beta == 0.0f) ? alpha * acc : alpha * acc + beta * c[j];
+                    }
+                }
+                return;
+            }
+            scale_c(M, N, beta, C, ldc);
+            for (size_t i = 0; i < M; ++i) {
+                float* c = C + i * ldc;
+                for (size_t k = 0; k < K; ++k) {
+                    float a = alpha * (trans_a ? A[k * lda + i] : A[i * lda + k]);
+                    const float* b = B + k * ldb;
+                    for (size_t j = 0; j < N; ++j) {
+                        c[j] += a * b[j];
+                    }
+                }
+            }
+        }
+    }
+
+    Isa detected_isa() {
+        static const Isa isa = detect();
+        return isa;
+    }
+
+    Isa active_isa() {
+        return static_cast<Isa>(active_isa_storage().load(std::memory_order_relaxed));
+    }
+
+    void set_isa(Isa isa) {
+        int requested = std::min(static_cast<int>(isa), static_cast<int>(detected_isa()));
+        active_isa_storage().store(requested, std::memory_order_relaxed);
+    }
+
+    const char* isa_name(Isa isa) {
+        switch (isa) {
+        case Isa::Avx512: return "AVX-512";
+        case Isa::Avx2: return "AVX2/FMA";
+        default: return "scalar";
+        }
+    }
+
+    // Однопоточный блочный алгоритм; упаковочные буферы — свои у каждого потока
+    static void sgemm_blocked(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+        float alpha, const Operand& A, const Operand& B,
+        float beta, float* C, size_t ldc) {
+        const Kernel kernel = select_kernel();
+        thread_local PackBuffer buffer_a, buffer_b;
+        float* packed_a = buffer_a.get(MC * KC);
+        float* packed_b = buffer_b.get(KC * NC);
+        alignas(64) float tile[MAX_TILE];
+
+        for (size_t jc = 0; jc < N; jc += NC) {
+            size_t nc = std::min(NC, N - jc);
+            for (size_t pc = 0; pc < K; pc += KC) {
+                size_t kc = std::min(KC, K - pc);
+                // Первый блок по K применяет beta пользователя, следующие накапливают
+                float beta_block = (pc == 0) ? beta : 1.0f;
+                pack_b(trans_b, pc, jc, kc, nc, B, kernel.nr, packed_b);
+
+                for (size_t ic = 0; ic < M; ic += MC) {
+                    size_t mc = std::min(MC, M - ic);
+                    pack_a(trans_a, ic, pc, mc, kc, A, kernel.mr, packed_a);
+
+                    for (size_t jr = 0; jr < nc; jr += kernel.nr) {
+                        size_t nr = std::min(kernel.nr, nc - jr);
+                        const float* b_panel = packed_b + jr * kc;
+                        for (size_t ir = 0; ir < mc; ir += kernel.mr) {
+                            size_t mr = std::min(kernel.mr, mc - ir);
+                            const float* a_panel = packed_a + ir * kc;
+                            float* c = C + (ic + ir) * ldc + jc + jr;
+                            if (mr == kernel.mr && nr == kernel.nr) {
+                                kernel.fn(kc, a_panel, b_panel, c, ldc, alpha, beta_block);
+                                continue;
+                            }
+                            // Краевой тайл: считаем во временный буфер и переносим только нужную часть
+                            kernel.fn(kc, a_panel, b_panel, tile, kernel.nr, 1.0f, 0.0f);
+                            for (size_t i = 0; i < mr; ++i) {
+                                float* row = c + i * ldc;
+                                const float* t = tile + i * kernel.nr;
+                                for (size_t j = 0; j < nr; ++j) {
+                                    row[j] = (beta_block == 0.0f) ? alpha * t[j] : alpha * t[j] + beta_block * row[j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void sgemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+        float alpha, const float* A, size_t lda,
+        const float* B, size_t ldb,
+        float beta, float* C, size_t ldc) {
+        sgemm(trans_a, trans_b, M, N, K, alpha, Operand{ A, lda }, Operand{ B, ldb }, beta, C, ldc);
+    }
+
+    void sgemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+        float alpha, Operand A, Operand B,
+        float beta, float* C, size_t ldc) {
+        if (M == 0 || N == 0) {
+            return;
+        }
+        if (K == 0 || alpha == 0.0f) {
+            scale_c(M, N, beta, C, ldc);
+            return;
+        }
+        bool float_operands = A.format == Precision::Float32 && B.format == Precision::Float32;
+        if (float_operands && M * N * K <= SMALL_WORK) {
+            small_gemm(trans_a, trans_b, M, N, K, alpha, static_cast<const float*>(A.data), A.ld,
+                static_cast<const float*>(B.data), B.ld, beta, C, ldc);
+            return;
+        }
+
+        // Распараллеливание: C делится на полосы строк (при малом M — ещё и столбцов), каждая задача —
+        // независимый блочный GEMM своей части. Записи задач в C не пересекаются
+        ThreadPool& pool = ThreadPool::instance();
+        size_t threads = pool.num_threads();
+        if (threads == 1 || M * N * K < PARALLEL_WORK) {
+            sgemm_blocked(trans_a, trans_b, M, N, K, alpha, A, B, beta, C, ldc);
+            return;
+        }
+        size_t target_parts = threads * 2;
+        size_t row_parts = std::min(target_parts, (M + MIN_PART_ROWS - 1) / MIN_PART_ROWS);
+        size_t col_parts = std::min((target_parts + row_parts - 1) / row_parts, (N + MIN_PART_COLS - 1) / MIN_PART_COLS);
+        size_t rows_per_part = (M + row_parts - 1) / row_parts;
+        size_t cols_per_part = (N + col_parts - 1) / col_parts;
+        // Границы кратны высоте микроядра и ширине панели, чтобы не плодить краевые тайлы
+        rows_per_part = (rows_per_part + 5) / 6 * 6;
+        cols_per_part = (cols_per_part + 31) / 32 * 32;
+        row_parts = (M + rows_per_part - 1) / rows_per_part;
+        col_parts = (N + cols_per_part - 1) / cols_per_part;
+
+        pool.parallel_for(row_parts * col_parts, [&](size_t part) {
+            size_t i0 = (part / col_parts) * rows_per_part;
+            size_t j0 = (part % col_parts) * cols_per_part;
+            size_t m = std::min(rows_per_part, M - i0);
+            size_t n = std::min(cols_per_part, N - j0);
+            Operand A_part = trans_a ? offset_operand(A, 0, i0) : offset_operand(A, i0, 0);
+            Operand B_part = trans_b ? offset_operand(B, j0, 0) : offset_operand(B, 0, j0);
+            sgemm_blocked(trans_a, trans_b, m, n, K, alpha, A_part, B_part, beta, C + i0 * ldc + j0, ldc);
+        });
+    }
+}
\ No newline at end of file
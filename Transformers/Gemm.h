@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "Precision.h"
+#include <cstddef>
+
+// Блочное умножение матриц (SGEMM) с упаковкой панелей и SIMD микроядрами.
+// Все матрицы хранятся по строкам; ld* — шаг строки в элементах.
+namespace gemm {
+    // Набор инструкций микроядра. Выбирается автоматически по возможностям процессора
+    enum class Isa { Scalar, Avx2, Avx512 };
+
+    Isa detected_isa();          // Лучший набор, поддерживаемый процессором
+    Isa active_isa();            // Набор, используемый сейчас
+    void set_isa(Isa isa);       // Ограничить набор (для отладки и замеров); выше detected_isa() не поднимается
+    const char* isa_name(Isa isa);
+
+    // C = alpha * op(A) * op(B) + beta * C, где op(X) = X или X^T (как в BLAS),
+    // op(A) — M x K, op(B) — K x N, C — M x N. Транспонированная копия не создаётся:
+    // транспонирование выполняется при упаковке панелей.
+    // При beta == 0 содержимое C не читается
+    void sgemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+        float alpha, const float* A, size_t lda,
+        const float* B, size_t ldb,
+        float beta, float* C, size_t ldc);
+
+    // Операнд смешанной точности: float или 16-битная (bf16/fp16) матрица с шагом строки ld в элементах
+    struct Operand {
+        const void* data;
+        size_t ld;
+        Precision format = Precision::Float32;
+    };
+
+    // То же, но A и B могут храниться в bf16/fp16. Элементы преобразуются во float при упаковке панелей,
+    // микроядра и накопление остаются float32
+    void sgemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+        float alpha, Operand A, Operand B,
+        float beta, float* C, size_t ldc);
+}
\ No newline at end of file
@@ -1,22 +1,107 @@
 ﻿#include "InferenceModel.h"
 #include "utils.h"
 #include "bpe_tokenizer.h"
+#include "BeamSearch.h"
+#include "SpeculativeDecoder.h"
+#include <filesystem>
+#include <sstream>
 
 int paramCount = 0;
 
-void InferenceModel::RunInference() {
+// Непустые строки текста
+static std::vector<std::string> split_lines(const std::string& text)
+{
+	std::vector<std::string> lines;
+	std::string line;
+	std::istringstream stream(text);
+	while (std::getline(stream, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (!line.empty()) lines.push_back(line);
+	}
+	return lines;
+}
+
+// Текст из id токенов: BPE-метка "</w>" — конец слова, <NL> — перевод строки, <BOS>/<EOS> не печатаются
+static std::string tokens_to_text(BPETokenizer& tokenizer, const std::vector<int>& ids)
+{
+	std::string text;
+	for (const auto& token : tokenizer.decode(ids)) {
+		if (token == "<BOS>" || token == "<EOS>") continue;
+		if (token == "<NL>") {
+			text += '\n';
+		}
+		else if (token.size() >= 4 && token.substr(token.size() - 4) == "</w>") {
+			text += token.substr(0, token.size() - 4) + " ";
+		}
+		else {
+			text += token;
+		}
+	}
+	return text;
+}
+
+// Int8-модель: берётся готовая model_int8.bin, если она новее model.bin и её архитектура совпадает
+// с конфигурацией модели; иначе model.bin квантуется с калибровкой на первых парах строк
+// source.txt / target.txt и результат сохраняется
+static void load_int8_model(Transformer& model, const Vocabulary& vocab)
+{
+	namespace fs = std::filesystem;
+	const std::string float_path = "model.bin";
+	const std::string int8_path = "model_int8.bin";
+	if (fs::exists(int8_path) && fs::last_write_time(int8_path) >= fs::last_write_time(float_path)) {
+		bool same_config = false;
+		try {
+			same_config = Transformer::read_quantized_config(int8_path) == model.config();
+		}
+		catch (const std::runtime_error&) {
+			// Файл прежней версии или повреждённый — квантуем заново
+		}
+		if (same_config) {
+			model.load_quantized(int8_path);
+			return;
+		}
+	}
+	model.load_weights(float_path);
+
+	TextReader reader;
+	auto source_lines = split_lines(reader.read_filename("source.txt"));
+	auto target_lines = split_lines(reader.read_filename("target.txt"));
+	if (source_lines.size() != target_lines.size() || source_lines.empty()) {
+		source_lines = { reader.read_filename("source.txt") };
+		target_lines = { reader.read_filename("target.txt") };
+	}
+	const size_t max_samples = 16;
+	DataPreparer preparer(vocab);
+	std::vector<std::vector<int>> source_samples, target_samples;
+	for (size_t i = 0; i < source_lines.size() && i < max_samples; ++i) {
+		source_samples.push_back(preparer.prepare_source(source_lines[i]));
+		auto full_target = preparer.prepare_target(target_lines[i], "<BOS>", "<EOS>");
+		target_samples.emplace_back(full_target.begin(), full_target.end() - 1);
+	}
+	model.quantize_int8(source_samples, target_samples);
+	model.save_quantized(int8_path);
+}
+
+void InferenceModel::RunInference(const InferenceConfig& inference_config) {
 	setlocale(LC_ALL, "Russian");
 
 	// 1) Считаем source.txt
 	TextReader reader;
 	std::string source_text = reader.read_filename("source.txt");
 
-	// 2) Восстановим словарь
-	BPETrainer trainer;
-	trainer.load_vocab("vocab.txt");
-	auto vocab = trainer.get_vocab();
-	for (auto& p : vocab)
-		std::cout << "Токен: " << p.first << ", ID: " << p.second << "\n";
+	// 2) Восстановим словарь: двоичный vocab.bin отображается в память как есть, текстовый vocab.txt
+	//    (от прежних запусков обучения) разбирается и переводится в тот же вид
+	Vocabulary vocab;
+	const std::string vocab_path = std::filesystem::exists("vocab.bin") ? "vocab.bin" : "vocab.txt";
+	if (vocab_path == "vocab.bin") {
+		vocab = Vocabulary::open(vocab_path);
+	}
+	else {
+		BPETrainer trainer;
+		trainer.load_vocab(vocab_path);
+		vocab = trainer.get_vocabulary();
+	}
+	std::cout << "Vocabulary: " << vocab.size() << " tokens from " << vocab_path << "\n";
 
 	// 3) Токенизируем source
 	DataPreparer preparer(vocab);
@@ -24,8 +109,8 @@ void InferenceModel::RunInference() {
 
 	// 4) Готовим initial target_tokens = { <BOS> }
 	std::vector<int> target_tokens;
-	if (vocab.count("<BOS>")) {
-		target_tokens.push_back(vocab.at("<BOS>"));
+	if (vocab.contains("<BOS>")) {
+		target_tokens.push_back(vocab.find("<BOS>"));
 	}
 	else {
 		std::cerr << "BOS token not found in vocab!\n";
@@ -41,29 +126,74 @@ void InferenceModel::RunInference() {
 	for (int id : target_tokens) std::cout << id << ' ';
 	std::cout << '\n';
 
-	// 5) Создаём модель и грузим веса
-	Transformer model(vocab.size(), 32, 2, 4, 64);
-	model.load_weights("model.bin");
+	// 5) Создаём модель по архитектуре из заголовка model.bin (в файлах прежнего формата её нет —
+	//    для них остаются размеры, с которыми такие файлы обучались) и грузим веса
+	ModelConfig config;
+	config.vocab_size = int(vocab.size());
+	config.embedding_dim = 32;
+	config.num_layers = 2;
+	config.num_heads = 4;
+	config.hidden_dim = 64;
+	if (model_file::is_model_file("model.bin")) {
+		config = model_file::read_config("model.bin");
+	}
+	if (config.vocab_size != int(vocab.size())) {
+		std::cerr << "Model vocab size " << config.vocab_size << " does not match " << vocab_path << " (" << vocab.size() << ")\n";
+		return;
+	}
+	Transformer model(config);
+	if (inference_config.use_int8) {
+		// Матрицы весов — в int8 (вчетверо меньше памяти, целочисленные ядра), эмбеддинги и нормализации — float32
+		load_int8_model(model, vocab);
+	}
+	else {
+		model.load_weights("model.bin");
+		// Веса для инференса — в bf16 (вдвое меньше памяти и трафика), вычисления остаются во float32
+		model.set_precision(Precision::BFloat16);
+	}
 
-	model.forward_propagation(source_tokens, target_tokens);
 	std::cout << "Total parameters: " << paramCount << "\n";
 
+	// Энкодер и проекции K/V cross-attention считаются один раз,
+	// декодер дальше работает по одному токену с кэшем K/V
     BPETokenizer tokenizer(vocab); // создаём один раз
-    std::cout << "=== Inference output ===\n";
-    std::string current_word; // для аккумулирования субслов
-    for (int step = 0; step < 1000; ++step) {
-        model.forward_propagation(source_tokens, target_tokens);
-        const auto& probs = model.get_probabilities();
-        if (probs.empty()) break;
 
-        // 1) Берём только последнюю строку (эффективно)
-        const auto& last_row = probs.back();
+	// Рядом лежит малая модель-черновик — спекулятивное декодирование: текст тот же, что у жадного вывода,
+	// но за один проход основной модели порождается несколько токенов
+	const std::string draft_path = "draft_model.bin";
+	if (std::filesystem::exists(draft_path) && vocab.contains("<EOS>")) {
+		SpeculativeConfig speculative_config;
+		speculative_config.max_length = 1000;
+		SpeculativeDecoder speculative(model, draft_path, speculative_config);
+		auto generated = speculative.generate(source_tokens, target_tokens, vocab.find("<EOS>"));
+		std::cout << "=== Inference output (speculative) ===\n";
+		std::cout << tokens_to_text(tokenizer, generated) << std::endl;
+		const SpeculativeStats& stats = speculative.stats();
+		std::cout << "Draft acceptance rate: " << stats.acceptance_rate() << ", tokens per pass: " << stats.tokens_per_pass() << "\n";
+		return;
+	}
 
-        // 2) Нахождение argmax по последней строке
-        auto it = std::max_element(last_row.begin(), last_row.end());
-        int next_id = int(std::distance(last_row.begin(), it));
+	EncoderMemory memory = model.encode(source_tokens);
 
-        // 3) Декодируем id -> токен (строка)
+	// Лучевой поиск: beam_width лучей за один батчевый проход декодера на шаг. beam_width = 1 — жадный вывод ниже
+	if (inference_config.beam_width > 1 && vocab.contains("<EOS>")) {
+		BeamSearchConfig beam_config;
+		beam_config.beam_width = inference_config.beam_width;
+		beam_config.max_length = 1000;
+		auto hypotheses = BeamSearch(beam_config).search(model, memory, target_tokens, vocab.find("<EOS>"));
+		std::cout << "=== Inference output (beam " << beam_config.beam_width << ") ===\n";
+		std::cout << tokens_to_text(tokenizer, hypotheses.front().tokens) << std::endl;
+		return;
+	}
+
+	// decode_step_greedy сразу даёт argmax (с адаптивным softmax — без полного распределения по словарю)
+	model.reset_decode_cache();
+	int next_id = model.decode_step_greedy(target_tokens.back(), memory);
+
+    std::cout << "=== Inference output ===\n";
+    std::string current_word; // для аккумулирования субслов
+    for (int step = 0; step < 1000; ++step) {
+        // 1-3) next_id — argmax распределения следующего токена; декодируем id -> токен (строка)
         std::string token_str = tokenizer.decode({ next_id })[0];
 
         // 4) Если EOS — завершаем (и ничего не печатаем)
@@ -92,8 +222,9 @@ void InferenceModel::RunInference() {
             std::cout << '\n' << std::flush;
 
             // Добавляем токен в target_tokens, чтобы модель видела его в следующей итерации.
-            // Если не нужно — удалить следующую строку.
+            // Если не нужно — удалить следующие две строки.
             target_tokens.push_back(next_id);
+            next_id = model.decode_step_greedy(next_id, memory);
             continue;
         }
 
@@ -114,6 +245,7 @@ void InferenceModel::RunInference() {
 
         // 7) Добавляем ID в target_tokens (для следующей итерации)
         target_tokens.push_back(next_id);
+        next_id = model.decode_step_greedy(next_id, memory);
     }
 	std::cout << std::endl;
 }
\ No newline at end of file
@@ -6,8 +6,17 @@
 #include <iostream>
 #include <vector>
 
+// Параметры вывода
+struct InferenceConfig {
+	// Матрицы весов в int8: берётся model_int8.bin или model.bin квантуется с калибровкой и сохраняется рядом.
+	// По умолчанию веса из model.bin в bf16 (вычисления во float32)
+	bool use_int8 = false;
+	// Лучей лучевого поиска (BeamSearch); 1 — жадный вывод
+	int beam_width = 1;
+};
+
 class InferenceModel {
 public:
 	// Запускает inference: читает source.txt, загружает словарь, модель и печатает
-	void RunInference();
+	void RunInference(const InferenceConfig& config = InferenceConfig());
 };
\ No newline at end of file
@@ -1,45 +1,47 @@
 #include "Linear.h"
 #include "utils.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <random>
 #include <stdexcept>
 #include <iostream>
 
 extern int paramCount;
 
-Linear::Linear(int input_dim, int output_dim) : W_(input_dim, std::vector<float>(output_dim)), input_dim_(input_dim), output_dim_(output_dim) {
+Linear::Linear(int input_dim, int output_dim) : W_(input_dim, output_dim), input_dim_(input_dim), output_dim_(output_dim) {
     paramCount += input_dim_ * output_dim_ + output_dim_;
 }
 
-std::vector<std::vector<float>> Linear::forward_linear(const std::vector<std::vector<float>> & input) {
-    if (input.empty() || input[0].size() != input_dim_) {
+Tensor Linear::forward_linear(const Tensor& input) {
+    if (input.empty() || input.cols() != static_cast<size_t>(input_dim_)) {
         throw std::invalid_argument("Input dimensions do not match expected input_dim");
     }
-    last_input_ = input;
+    last_input_.store(input, activation_precision_);
 
-    std::vector<std::vector<float>> logits = utils::matrix_multiply(input, W_);
+    Tensor logits = W_int8_.multiply(input, weight_operand(W_, W_half_));
     return logits;
 }
 
-std::vector<std::vector<float>> Linear::backward_linear(const std::vector<std::vector<float>>& grad_logits, float learning_rate) {
-    if (grad_logits.empty() || grad_logits[0].size() != output_dim_) {
+Tensor Linear::backward_linear(const Tensor& grad_logits, float learning_rate) {
+    if (grad_logits.empty() || grad_logits.cols() != static_cast<size_t>(output_dim_)) {
         throw std::invalid_argument("grad_output dimensions do not match output_dim");
     }
     if (last_input_.empty()) {
         throw std::runtime_error("No input saved from forward_linear pass");
     }
-    auto W_T = utils::transpose(W_);
-    auto grad_decoder_output = utils::matrix_multiply(grad_logits, W_T);
-    auto input_T = utils::transpose(last_input_);
-    auto grad_W = utils::matrix_multiply(input_T, grad_logits);
-    for (size_t i = 0; i < input_dim_; ++i) {
-        for (size_t j = 0; j < output_dim_; ++j) {
-            W_[i][j] -= learning_rate * grad_W[i][j];
-        }
+    if (W_.empty()) {
+        throw std::runtime_error("Linear: веса загружены только в int8, обратный проход недоступен");
     }
+    // grad_logits * W^T и input^T * grad_logits без транспонированных копий
+    auto grad_decoder_output = utils::matrix_multiply(grad_logits, weight_operand(W_, W_half_), false, true);
+    auto grad_W = utils::matrix_multiply(last_input_.operand(), grad_logits, true, false);
+    utils::apply_gradient(W_.data(), grad_W_.data(), grad_W.data(), W_.size(), learning_rate, accumulate_gradients_);
 
-    /*std::cout << "  :\n";
-    for (size_t i = 0; i < grad_W.size(); ++i) {
-        for (size_t j = 0; j < grad_W[0].size(); ++j) {
+    /*std::cout << "Градиент по весам:\n";
+    for (size_t i = 0; i < grad_W.rows(); ++i) {
+        for (size_t j = 0; j < grad_W.cols(); ++j) {
             std::cout << grad_W[i][j] << ", ";
         }
         std::cout << "\n";
@@ -49,15 +51,127 @@ std::vector<std::vector<float>> Linear::backward_linear(const std::vector<std::v
     return grad_decoder_output;
 }
 
+float Linear::cross_entropy_head(const Tensor& input, const std::vector<int>& labels, float scale, float learning_rate, Tensor& grad_input) {
+    if (input.empty() || input.cols() != static_cast<size_t>(input_dim_)) {
+        throw std::invalid_argument("Input dimensions do not match expected input_dim");
+    }
+    if (labels.size() != input.rows()) {
+        throw std::invalid_argument("labels size does not match input rows");
+    }
+    if (W_.empty()) {
+        throw std::runtime_error("Linear: веса загружены только в int8, обратный проход недоступен");
+    }
+    for (int label : labels) {
+        if (label >= output_dim_) {
+            throw std::out_of_range("label is out of vocabulary range");
+        }
+    }
+    const size_t rows = input.rows();
+    const size_t vocab = output_dim_;
+    // Логиты куска (rows x chunk) помещаются в L2; ширина куска кратна 16 столбцам
+    const size_t chunk_floats = 256 * 1024;
+    const size_t chunk = std::min(vocab, std::max<size_t>(16, chunk_floats / rows / 16 * 16));
+    const MatrixOperand W = weight_operand(W_, W_half_);
+    ThreadPool& pool = ThreadPool::instance();
+
+    Tensor logits(rows, chunk);
+    std::vector<float> row_max(rows, -std::numeric_limits<float>::infinity());
+    std::vector<float> row_sum(rows, 0.0f);
+    std::vector<float> label_logit(rows, 0.0f);
+
+    // Проход 1: онлайн log-sum-exp — при росте максимума строки накопленная сумма масштабируется exp(старый - новый)
+    for (size_t c0 = 0; c0 < vocab; c0 += chunk) {
+        const size_t width = std::min(chunk, vocab - c0);
+        TensorView z = logits.block(0, 0, rows, width);
+        utils::gemm(false, false, 1.0f, input, W.block(0, c0, input_dim_, width), 0.0f, z);
+        pool.parallel_for(0, rows, ThreadPool::grain_size(rows, 16 * width), [&](size_t row_begin, size_t row_end) {
+            for (size_t i = row_begin; i < row_end; ++i) {
+                int label = labels[i];
+                if (label < 0) continue;
+                const float* zi = z[i];
+                float new_max = std::max(row_max[i], *std::max_element(zi, zi + width));
+                float sum = 0.0f;
+                for (size_t j = 0; j < width; ++j) {
+                    sum += std::exp(zi[j] - new_max);
+                }
+                row_sum[i] = row_sum[i] * std::exp(row_max[i] - new_max) + sum;
+                row_max[i] = new_max;
+                if (static_cast<size_t>(label) >= c0 && static_cast<size_t>(label) < c0 + width) {
+                    label_logit[i] = zi[label - c0];
+                }
+            }
+        });
+    }
+
+    // loss = log-sum-exp - логит метки: без log(p) и без защиты от p = 0
+    double loss = 0.0;
+    std::vector<float>& log_sum_exp = row_max; // Максимумы больше не нужны — log-sum-exp на их месте
+    for (size_t i = 0; i < rows; ++i) {
+        if (labels[i] < 0) continue;
+        log_sum_exp[i] = row_max[i] + std::log(row_sum[i]);
+        loss += log_sum_exp[i] - label_logit[i];
+    }
+
+    // Проход 2: логиты куска пересчитываются и сразу превращаются в градиент (p - y) * scale.
+    // Куски идут в обратном порядке: логиты последнего ещё лежат в буфере после прохода 1 (если словарь
+    // помещается в один кусок, пересчёта нет вовсе)
+    grad_input.resize(rows, input_dim_);
+    const size_t last_chunk = (vocab - 1) / chunk * chunk;
+    for (size_t c0 = last_chunk + chunk; c0 > 0;) {
+        c0 -= chunk;
+        const size_t width = std::min(chunk, vocab - c0);
+        const MatrixOperand W_chunk = W.block(0, c0, input_dim_, width);
+        TensorView g = logits.block(0, 0, rows, width);
+        if (c0 != last_chunk) {
+            utils::gemm(false, false, 1.0f, input, W_chunk, 0.0f, g);
+        }
+        pool.parallel_for(0, rows, ThreadPool::grain_size(rows, 16 * width), [&](size_t row_begin, size_t row_end) {
+            for (size_t i = row_begin; i < row_end; ++i) {
+                float* gi = g[i];
+                int label = labels[i];
+                if (label < 0) {
+                    std::fill(gi, gi + width, 0.0f);
+                    continue;
+                }
+                for (size_t j = 0; j < width; ++j) {
+                    gi[j] = std::exp(gi[j] - log_sum_exp[i]) * scale;
+                }
+                if (static_cast<size_t>(label) >= c0 && static_cast<size_t>(label) < c0 + width) {
+                    gi[label - c0] -= scale;
+                }
+            }
+        });
+        // Градиент по входу — с весами куска до их обновления; куски W не пересекаются,
+        // поэтому шаг SGD по этому куску не влияет на следующие
+        utils::gemm(false, true, 1.0f, g, W_chunk, c0 == last_chunk ? 0.0f : 1.0f, grad_input);
+        if (accumulate_gradients_) {
+            utils::gemm(true, false, 1.0f, input, g, 1.0f, grad_W_.block(0, c0, input_dim_, width));
+        }
+        else {
+            utils::gemm(true, false, -learning_rate, input, g, 1.0f, W_.block(0, c0, input_dim_, width));
+        }
+    }
+    return static_cast<float>(loss);
+}
+
+void Linear::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенный буфер не перевыделяется: он может жить в общей области параметров
+    if (!enabled) grad_W_ = Tensor();
+    else if (grad_W_.empty()) grad_W_.assign(input_dim_, output_dim_, 0.0f);
+}
+
+void Linear::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &W_, &grad_W_, &W_half_, "W" });
+}
+
 void Linear::initialize_random() {
-    //    
+    // Инициализация весов случайными значениями
     std::random_device rd;
     std::mt19937 gen(rd());
     std::normal_distribution<float> dist(0.0f, 1.0f / std::sqrt(static_cast<float>(input_dim_)));
-    for (auto& row : W_) {
-        for (auto& val : row) {
-            val = dist(gen);
-        }
+    for (size_t i = 0; i < W_.size(); ++i) {
+        W_.data()[i] = dist(gen);
     }
 }
 
@@ -67,6 +181,17 @@ void Linear::save_weights(std::ofstream& out) const {
 
 void Linear::load_weights(std::ifstream& in) {
     utils::read_matrix(in, W_);
-    if ((int)W_.size() != input_dim_ || (int)W_[0].size() != output_dim_)
-        throw std::runtime_error("    Linear  ");
+    if ((int)W_.rows() != input_dim_ || (int)W_.cols() != output_dim_)
+        throw std::runtime_error("Неверный размер параметров в Linear при загрузке");
+}
+
+void Linear::save_quantized(std::ofstream& out) const {
+    W_int8_.matrix.save(out);
+}
+
+void Linear::load_quantized(std::ifstream& in) {
+    W_int8_.matrix.load(in);
+    if ((int)W_int8_.matrix.rows() != input_dim_ || (int)W_int8_.matrix.cols() != output_dim_)
+        throw std::runtime_error("Неверный размер int8-параметров в Linear при загрузке");
+    W_ = Tensor();
 }
\ No newline at end of file
@@ -1,25 +1,54 @@
 #pragma once
 #include "utils.h"
+#include "Parameter.h"
+#include "Quantization.h"
 #include <random>
 
 class Linear {
 public:
     Linear(int input_dim, int output_dim);
-    std::vector<std::vector<float>>forward_linear(const std::vector<std::vector<float>>& input);
-    std::vector<std::vector<float>>backward_linear(const std::vector<std::vector<float>>& grad_output, float learning_rate);
+    Tensor forward_linear(const Tensor& input);
+    Tensor backward_linear(const Tensor& grad_output, float learning_rate);
 
-    ///  ( ),  ( )    Linear
+    // Обучающая голова: проекция в словарь, softmax и cross-entropy за два потоковых прохода по кускам словаря,
+    // матрицы логитов и вероятностей seq x vocab не создаются. Первый проход считает log-sum-exp строк онлайн,
+    // второй пересчитывает логиты куска, получает градиент (p - y) * scale и сразу отдаёт его в градиент по W
+    // (накопление или шаг SGD, как в backward_linear) и в grad_input (градиент по input).
+    // labels[i] — метка строки i; < 0 — строка заполнения (ни loss, ни градиента).
+    // Возвращает сумму -log p(label) по строкам с метками
+    float cross_entropy_head(const Tensor& input, const std::vector<int>& labels, float scale, float learning_rate, Tensor& grad_input);
+
+    /// Инициализация (для обучения), загрузк (для инференса) и сохранение параметров Linear
     void initialize_random();
     void save_weights(std::ofstream& out) const;
     void load_weights(std::ifstream& in);
 
+    // Режим накопления: backward_linear складывает градиенты в буферы вместо шага SGD
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+    // Формат сохраняемого для backward входа (веса в bf16/fp16 задаёт область параметров, см. ParameterArena)
+    void set_activation_precision(Precision format) { activation_precision_ = format; }
+
+    // Int8-квантование для инференса: калибровка собирает диапазон входа в прямых проходах,
+    // quantize_int8 переводит W_ в int8 (после этого forward_linear идёт через int8, backward недоступен).
+    // save_quantized / load_quantized — int8-форма весов (load освобождает float-веса)
+    void set_calibration(bool enabled) { W_int8_.set_calibration(enabled); }
+    void quantize_int8() { W_int8_.quantize(W_); }
+    void save_quantized(std::ofstream& out) const;
+    void load_quantized(std::ifstream& in);
+
 
-    //    
-    const std::vector<std::vector<float>>& get_W() const { return W_; }
+    // Вывод весов для отладки
+    const Tensor& get_W() const { return W_; }
 
 private:
-    std::vector<std::vector<float>> W_; //  
-    std::vector<std::vector<float>> last_input_; //     
+    Tensor W_; // Матрица весов
+    HalfView W_half_; // 16-битная копия весов (только в режиме пониженной точности)
+    Int8Weight W_int8_; // Int8-копия весов (после квантования)
+    Tensor grad_W_; // Накопленный градиент (только в режиме накопления)
+    bool accumulate_gradients_ = false;
+    Precision activation_precision_ = Precision::Float32;
+    SavedActivation last_input_; // Сохранение входа для обратного прохода
     int input_dim_;
     int output_dim_;
 };
\ No newline at end of file
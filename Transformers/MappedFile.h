@@ -0,0 +1,27 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+// Файл, отображённый в память целиком (mmap / MapViewOfFile). Отображение копирующее при записи:
+// пока страницы только читаются, они берутся из страничного кэша и общие для всех процессов, открывших файл;
+// запись в них создаёт частную копию страницы и в файл не попадает
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr; // HANDLE объекта отображения
+#endif
+};
\ No newline at end of file
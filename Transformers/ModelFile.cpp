@@ -0,0 +1,203 @@
+﻿#include "ModelFile.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace model_file {
+    namespace {
+        const char kMagic[4] = { 'T', 'F', 'M', 'D' };
+
+        struct FileHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t header_size;
+            uint32_t tensor_count;
+            int32_t vocab_size;
+            int32_t embedding_dim;
+            int32_t num_layers;
+            int32_t num_heads;
+            int32_t hidden_dim;
+            uint32_t dtype;        // Значение Precision
+            uint64_t table_offset;
+            uint64_t file_size;    // Для проверки целостности (обрезанный файл)
+            uint32_t cutoff_count;  // Число границ адаптивного softmax сразу за заголовком (в версии 1 — всегда 0)
+            uint32_t adaptive_shrink;
+        };
+        static_assert(sizeof(FileHeader) == 64, "Заголовок файла модели занимает 64 байта");
+
+        struct FileTensorEntry {
+            char name[kMaxNameLength + 1]; // Дополняется нулями
+            uint64_t rows;
+            uint64_t cols;
+            uint64_t offset;
+            uint64_t reserved;
+        };
+        static_assert(sizeof(FileTensorEntry) == 96, "Запись таблицы тензоров занимает 96 байт");
+
+        size_t align_up(size_t value) {
+            return (value + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        // Архитектура из заголовка; границы адаптивного softmax читаются отдельно
+        ModelConfig config_from(const FileHeader& header) {
+            ModelConfig config;
+            config.vocab_size = header.vocab_size;
+            config.embedding_dim = header.embedding_dim;
+            config.num_layers = header.num_layers;
+            config.num_heads = header.num_heads;
+            config.hidden_dim = header.hidden_dim;
+            if (header.cutoff_count > 0) config.adaptive_shrink = static_cast<int>(header.adaptive_shrink);
+            return config;
+        }
+
+        size_t cutoffs_bytes(size_t count) {
+            return count * sizeof(int32_t);
+        }
+
+        void check_header(const FileHeader& header, const std::string& path) {
+            if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+                throw std::runtime_error("Файл не является файлом модели: " + path);
+            }
+            if (header.version < 1 || header.version > kVersion || header.header_size != sizeof(FileHeader)) {
+                throw std::runtime_error("Неподдерживаемая версия файла модели (" + std::to_string(header.version) + "): " + path);
+            }
+            if (header.cutoff_count > 0 && header.version < 2) {
+                throw std::runtime_error("Повреждённый заголовок файла модели: " + path);
+            }
+            // По архитектуре из заголовка строится Transformer: размеры должны быть положительными,
+            // embedding_dim — делиться на число голов, границ адаптивного softmax — меньше, чем токенов
+            if (header.vocab_size <= 0 || header.embedding_dim <= 0 || header.num_layers <= 0 || header.num_heads <= 0
+                || header.hidden_dim <= 0 || header.embedding_dim % header.num_heads != 0
+                || header.cutoff_count >= static_cast<uint32_t>(header.vocab_size)
+                || (header.cutoff_count > 0 && header.adaptive_shrink == 0)) {
+                throw std::runtime_error("Повреждённый заголовок файла модели: " + path);
+            }
+        }
+    }
+
+    bool is_model_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(kMagic)];
+        in.read(magic, sizeof(magic));
+        return in && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+    }
+
+    ModelConfig read_config(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
+        FileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            throw std::runtime_error("Файл не является файлом модели: " + path);
+        }
+        check_header(header, path);
+        ModelConfig config = config_from(header);
+        config.adaptive_cutoffs.resize(header.cutoff_count);
+        if (!in.read(reinterpret_cast<char*>(config.adaptive_cutoffs.data()), cutoffs_bytes(header.cutoff_count))) {
+            throw std::runtime_error("Повреждённый заголовок файла модели: " + path);
+        }
+        return config;
+    }
+
+    void save(const std::string& path, const ModelConfig& config, const std::vector<ParameterRef>& params) {
+        FileHeader header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.header_size = sizeof(FileHeader);
+        header.tensor_count = static_cast<uint32_t>(params.size());
+        header.vocab_size = config.vocab_size;
+        header.embedding_dim = config.embedding_dim;
+        header.num_layers = config.num_layers;
+        header.num_heads = config.num_heads;
+        header.hidden_dim = config.hidden_dim;
+        header.dtype = static_cast<uint32_t>(Precision::Float32);
+        header.cutoff_count = static_cast<uint32_t>(config.adaptive_cutoffs.size());
+        header.adaptive_shrink = config.adaptive_cutoffs.empty() ? 0 : static_cast<uint32_t>(config.adaptive_shrink);
+        // Раскладка: границы кластеров сразу за заголовком, затем таблица (с 8-байтной границы),
+        // данные — с выровненных смещений
+        header.table_offset = (sizeof(FileHeader) + cutoffs_bytes(config.adaptive_cutoffs.size()) + 7) / 8 * 8;
+
+        std::vector<FileTensorEntry> table(params.size());
+        size_t offset = align_up(header.table_offset + table.size() * sizeof(FileTensorEntry));
+        for (size_t i = 0; i < params.size(); ++i) {
+            const std::string& name = params[i].name;
+            if (name.empty() || name.size() > kMaxNameLength) {
+                throw std::invalid_argument("Недопустимое имя параметра для файла модели: '" + name + "'");
+            }
+            FileTensorEntry& entry = table[i];
+            std::memset(&entry, 0, sizeof(entry));
+            std::memcpy(entry.name, name.data(), name.size());
+            entry.rows = params[i].value->rows();
+            entry.cols = params[i].value->cols();
+            entry.offset = offset;
+            offset = align_up(offset + params[i].value->size() * sizeof(float));
+        }
+        header.file_size = offset;
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out) throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+        const char zeros[kAlignment] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(config.adaptive_cutoffs.data()), cutoffs_bytes(config.adaptive_cutoffs.size()));
+        out.write(zeros, header.table_offset - sizeof(FileHeader) - cutoffs_bytes(config.adaptive_cutoffs.size()));
+        out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(FileTensorEntry));
+
+        size_t position = header.table_offset + table.size() * sizeof(FileTensorEntry);
+        for (size_t i = 0; i < params.size(); ++i) {
+            out.write(zeros, table[i].offset - position);
+            size_t bytes = params[i].value->size() * sizeof(float);
+            out.write(reinterpret_cast<const char*>(params[i].value->data()), bytes);
+            position = table[i].offset + bytes;
+        }
+        out.write(zeros, offset - position);
+        if (!out) throw std::runtime_error("Ошибка записи файла модели: " + path);
+    }
+
+    MappedModel open(const std::string& path) {
+        MappedModel model;
+        model.file = std::make_shared<MappedFile>(path);
+        const MappedFile& file = *model.file;
+
+        FileHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("Файл не является файлом модели: " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        check_header(header, path);
+        if (header.file_size != file.size()) {
+            throw std::runtime_error("Размер файла модели не совпадает с заголовком (файл повреждён или обрезан): " + path);
+        }
+        if (header.dtype != static_cast<uint32_t>(Precision::Float32)) {
+            throw std::runtime_error("Неподдерживаемый тип элементов в файле модели: " + path);
+        }
+        model.config = config_from(header);
+        model.dtype = Precision::Float32;
+        if (header.cutoff_count > (file.size() - sizeof(header)) / sizeof(int32_t)) {
+            throw std::runtime_error("Повреждённый заголовок файла модели: " + path);
+        }
+        model.config.adaptive_cutoffs.resize(header.cutoff_count);
+        std::memcpy(model.config.adaptive_cutoffs.data(), file.data() + sizeof(header), cutoffs_bytes(header.cutoff_count));
+
+        if (header.table_offset > file.size()
+            || header.tensor_count > (file.size() - header.table_offset) / sizeof(FileTensorEntry)) {
+            throw std::runtime_error("Таблица тензоров выходит за пределы файла: " + path);
+        }
+        model.tensors.resize(header.tensor_count);
+        for (size_t i = 0; i < model.tensors.size(); ++i) {
+            FileTensorEntry entry;
+            std::memcpy(&entry, file.data() + header.table_offset + i * sizeof(FileTensorEntry), sizeof(entry));
+            bool valid = entry.name[kMaxNameLength] == '\0' && entry.offset % kAlignment == 0 && entry.offset <= file.size();
+            if (valid && entry.cols != 0) {
+                valid = entry.rows <= (file.size() - entry.offset) / sizeof(float) / entry.cols;
+            }
+            if (!valid) {
+                throw std::runtime_error("Повреждённая запись таблицы тензоров в файле модели: " + path);
+            }
+            TensorEntry& tensor = model.tensors[i];
+            tensor.name = entry.name;
+            tensor.rows = static_cast<size_t>(entry.rows);
+            tensor.cols = static_cast<size_t>(entry.cols);
+            tensor.offset = static_cast<size_t>(entry.offset);
+        }
+        return model;
+    }
+}
\ No newline at end of file
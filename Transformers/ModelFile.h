@@ -0,0 +1,75 @@
+﻿#pragma once
+#include "MappedFile.h"
+#include "Parameter.h"
+#include "Precision.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Архитектура модели — аргументы конструктора Transformer
+struct ModelConfig {
+    int vocab_size = 0;
+    int embedding_dim = 0;
+    int num_layers = 0;
+    int num_heads = 0;
+    int hidden_dim = 0;
+    // Границы кластеров адаптивного softmax (см. AdaptiveSoftmax); пусто — обычный выходной слой Linear + Softmax
+    std::vector<int> adaptive_cutoffs;
+    int adaptive_shrink = 4;
+
+    // Архитектура с обычным выходным слоем (аргументы конструктора Transformer без адаптивного softmax)
+    static ModelConfig make(int vocab_size, int embedding_dim, int num_layers, int num_heads, int hidden_dim) {
+        ModelConfig config;
+        config.vocab_size = vocab_size;
+        config.embedding_dim = embedding_dim;
+        config.num_layers = num_layers;
+        config.num_heads = num_heads;
+        config.hidden_dim = hidden_dim;
+        return config;
+    }
+
+    bool operator==(const ModelConfig& other) const {
+        return vocab_size == other.vocab_size && embedding_dim == other.embedding_dim && num_layers == other.num_layers
+            && num_heads == other.num_heads && hidden_dim == other.hidden_dim
+            && adaptive_cutoffs == other.adaptive_cutoffs && (adaptive_cutoffs.empty() || adaptive_shrink == other.adaptive_shrink);
+    }
+    bool operator!=(const ModelConfig& other) const { return !(*this == other); }
+};
+
+// Самоописываемый файл модели, который можно отображать в память и использовать веса на месте:
+//   заголовок (64 байта): сигнатура "TFMD", версия, ModelConfig, тип элементов, число тензоров, смещение таблицы;
+//   границы кластеров адаптивного softmax (int32, с версии 2);
+//   таблица тензоров: имя, форма и смещение данных;
+//   данные тензоров, каждый с начала 64-байтной границы (выравнивание Tensor).
+// Числа — little-endian, как и в остальных бинарных файлах проекта
+namespace model_file {
+    constexpr uint32_t kVersion = 2;          // Версия 1 — без адаптивного softmax, читается как есть
+    constexpr size_t kAlignment = 64;
+    constexpr size_t kMaxNameLength = 63;
+
+    struct TensorEntry {
+        std::string name;
+        size_t rows = 0;
+        size_t cols = 0;
+        size_t offset = 0; // От начала файла
+    };
+
+    // Файл начинается с сигнатуры формата (у файлов прежнего формата без заголовка её нет)
+    bool is_model_file(const std::string& path);
+    // Только архитектура из заголовка, без отображения весов
+    ModelConfig read_config(const std::string& path);
+    // Записывает значения параметров в порядке params под их именами
+    void save(const std::string& path, const ModelConfig& config, const std::vector<ParameterRef>& params);
+
+    // Отображённый в память файл с проверенным заголовком и таблицей
+    struct MappedModel {
+        std::shared_ptr<MappedFile> file;
+        ModelConfig config;
+        Precision dtype = Precision::Float32;
+        std::vector<TensorEntry> tensors;
+
+        float* data(const TensorEntry& entry) const { return reinterpret_cast<float*>(file->data() + entry.offset); }
+    };
+    MappedModel open(const std::string& path);
+}
\ No newline at end of file
@@ -1,394 +1,447 @@
 #include "MultiHeadAttention.h"
 #include "utils.h"
+#include "Attention.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <functional>
 #include <random>
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
 #include <numeric>
 #include <iostream>
 
 extern int paramCount;
 
-// 
-MultiHeadAttention::MultiHeadAttention(int num_heads, int embedding_dim) : num_heads_(num_heads), embedding_dim_(embedding_dim), softmax_() {
+// Конструктор
+MultiHeadAttention::MultiHeadAttention(int num_heads, int embedding_dim) : num_heads_(num_heads), embedding_dim_(embedding_dim) {
     if (embedding_dim % num_heads != 0) {
         throw std::invalid_argument("embedding_dim must be divisible by num_heads");
     }
 
-    W_q_.resize(embedding_dim, std::vector<float>(embedding_dim));
-    W_k_.resize(embedding_dim, std::vector<float>(embedding_dim));
-    W_v_.resize(embedding_dim, std::vector<float>(embedding_dim));
-    W_o_.resize(embedding_dim, std::vector<float>(embedding_dim));
+    W_q_.resize(embedding_dim, embedding_dim);
+    W_k_.resize(embedding_dim, embedding_dim);
+    W_v_.resize(embedding_dim, embedding_dim);
+    W_o_.resize(embedding_dim, embedding_dim);
 
     paramCount += 4 * embedding_dim_ * embedding_dim_;
 }
 
-//     Q, K, V
-std::vector<std::vector<float>> MultiHeadAttention::compute_Q(const std::vector<std::vector<float>>& input) {
-    return utils::matrix_multiply(input, W_q_);
+// Вспомогательные методы для вычисления Q, K, V
+Tensor MultiHeadAttention::compute_Q(const Tensor& input) {
+    return W_q_int8_.multiply(input, weight_operand(W_q_, W_q_half_));
 }
 
-std::vector<std::vector<float>> MultiHeadAttention::compute_K(const std::vector<std::vector<float>>& input) {
-    return utils::matrix_multiply(input, W_k_);
+Tensor MultiHeadAttention::compute_K(const Tensor& input) {
+    return W_k_int8_.multiply(input, weight_operand(W_k_, W_k_half_));
 }
 
-std::vector<std::vector<float>> MultiHeadAttention::compute_V(const std::vector<std::vector<float>>& input) {
-    return utils::matrix_multiply(input, W_v_);
+Tensor MultiHeadAttention::compute_V(const Tensor& input) {
+    return W_v_int8_.multiply(input, weight_operand(W_v_, W_v_half_));
 }
 
-//   
-std::vector<std::vector<std::vector<std::vector<float>>>> MultiHeadAttention::split_heads(const std::vector<std::vector<float>>& Q, const std::vector<std::vector<float>>& K, const std::vector<std::vector<float>>& V) {
-    size_t seq_len_Q = Q.size();                   //    Q (T_target)
-    size_t seq_len_KV = K.size();                //    K  V (T_source)
-    int head_dim_ = embedding_dim_ / num_heads_; //   
+// Разделение на головы: голова h — это столбцы [h * head_dim, (h + 1) * head_dim) исходной матрицы,
+// поэтому возвращаем представления без копирования
+std::vector<ConstTensorView> MultiHeadAttention::split_heads(const Tensor& M) const {
+    int head_dim_ = embedding_dim_ / num_heads_; // Размерность одной головы
 
-    // ,   embedding 
-    if (Q[0].size() != embedding_dim_ || K[0].size() != embedding_dim_ || V[0].size() != embedding_dim_) {
+    // Проверяем, что размерность embedding совпадает
+    if (M.cols() != static_cast<size_t>(embedding_dim_)) {
         throw std::invalid_argument("Input matrices must have the same embedding dimension");
     }
 
-    std::vector<std::vector<std::vector<float>>> Q_heads(num_heads_, std::vector<std::vector<float>>(seq_len_Q, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> K_heads(num_heads_, std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> V_heads(num_heads_, std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(head_dim_)));
-
-    //  Q  
+    std::vector<ConstTensorView> heads(num_heads_);
     for (int h = 0; h < num_heads_; ++h) {
-        for (size_t i = 0; i < seq_len_Q; ++i) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                Q_heads[h][i][d] = Q[i][idx];
-            }
-        }
-    }
-
-    //  K  
-    for (int h = 0; h < num_heads_; ++h) {
-        for (size_t i = 0; i < seq_len_KV; ++i) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                K_heads[h][i][d] = K[i][idx];
-            }
-        }
+        heads[h] = M.block(0, h * head_dim_, M.rows(), head_dim_);
     }
+    return heads;
+}
 
-    //  V  
-    for (int h = 0; h < num_heads_; ++h) {
-        for (size_t i = 0; i < seq_len_KV; ++i) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                V_heads[h][i][d] = V[i][idx];
-            }
+// Пустая разметка — одна последовательность из всех строк
+static BatchLayout resolve_layout(const BatchLayout& layout, size_t rows) {
+    if (!layout.empty()) {
+        if (static_cast<size_t>(layout.rows()) != rows) {
+            throw std::invalid_argument("Batch layout does not match the number of rows");
         }
+        return layout;
     }
+    return BatchLayout::from_lengths({ static_cast<int>(rows) });
+}
 
-    return {Q_heads, K_heads, V_heads};
+// Задачи по индексам; размер куска — по эвристике пула, поэтому мелкие задачи
+// (например, шаг генерации) выполняются в текущем потоке
+static void for_each_task(size_t count, size_t work, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    ThreadPool::instance().parallel_for(0, count, ThreadPool::grain_size(count, work / count), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) fn(i);
+    });
 }
 
-//  scores
-void MultiHeadAttention::compute_scores(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads) {
+// Вычисление внимания для всех голов слитным ядром: выход головы h записывается прямо в её столбцы concat_,
+// для обратного прохода сохраняется только lse_ (num_heads x seq_len_Q).
+// Последовательности батча обрабатываются независимо; ключи ограничены реальной длиной (маска заполнения).
+// Задачи (последовательность, голова, блок строк запросов) пишут в непересекающиеся части concat_ и lse_
+void MultiHeadAttention::compute_attention(const Tensor& Q, const Tensor& K, const Tensor& V, bool causal) {
     int head_dim_ = embedding_dim_ / num_heads_;
-    //  scores  
-    scores_.resize(num_heads_, std::vector<std::vector<float>>(Q_heads[0].size(), std::vector<float>(K_heads[0].size())));
-
-    for (int h = 0; h < num_heads_; ++h) {
-        auto K_T = utils::transpose(K_heads[h]);
-        scores_[h] = utils::matrix_multiply(Q_heads[h], K_T);
-        float scale = 1.0f / std::sqrt(static_cast<float>(head_dim_));
-        for (auto& row : scores_[h]) {
-            for (auto& val : row) {
-                val *= scale;
-            }
-        }
-    }
+    float scale = 1.0f / std::sqrt(static_cast<float>(head_dim_));
+    concat_.resize(Q.rows(), embedding_dim_);
+    lse_.resize(num_heads_, Q.rows());
+    causal_ = causal;
+
+    size_t q_rows = q_layout_.max_len;
+    size_t q_blocks = (q_rows + attention::kBlockQ - 1) / attention::kBlockQ;
+    size_t tasks = q_layout_.batch_size() * num_heads_ * q_blocks;
+    size_t work = Q.rows() * kv_layout_.max_len * embedding_dim_;
+
+    for_each_task(tasks, work, [&](size_t task) {
+        size_t block = task % q_blocks;
+        size_t h = (task / q_blocks) % num_heads_;
+        size_t b = task / (q_blocks * num_heads_);
+
+        size_t q0 = b * q_layout_.max_len;
+        size_t k0 = b * kv_layout_.max_len;
+        size_t kv_len = kv_layout_.lengths[b];
+        size_t r0 = block * attention::kBlockQ;
+        size_t rows = std::min(attention::kBlockQ, q_rows - r0);
+        size_t col0 = h * head_dim_;
+        // r0 — позиция первой строки блока для маски
+        attention::forward(Q.block(q0 + r0, col0, rows, head_dim_), K.block(k0, col0, kv_len, head_dim_),
+            V.block(k0, col0, kv_len, head_dim_), scale, causal, r0,
+            concat_.block(q0 + r0, col0, rows, head_dim_), lse_[h] + q0 + r0);
+    });
 }
 
-//     
-std::vector<std::vector<std::vector<float>>> MultiHeadAttention::compute_attention(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads, const std::vector<std::vector<std::vector<float>>>& V_heads) {
-    int head_dim_ = embedding_dim_ / num_heads_;
-    std::vector<std::vector<std::vector<float>>> attention_heads(num_heads_, std::vector<std::vector<float>>(Q_heads[0].size(), std::vector<float>(head_dim_)));
+// Основной метод forward_mha с поддержкой маски
+Tensor MultiHeadAttention::forward_mha(const Tensor& X, bool use_mask, const BatchLayout& layout) {
+    q_layout_ = resolve_layout(layout, X.rows());
+    kv_layout_ = q_layout_;
+    Q_ = compute_Q(X);
+    K_ = compute_K(X);
+    V_ = compute_V(X);
 
-    //  attention_weights  
-    attention_weights_.resize(num_heads_);
+    // При use_mask каждая позиция видит только себя и предыдущие
+    compute_attention(Q_, K_, V_, use_mask);
 
-    //  scores
-    compute_scores(Q_heads, K_heads);
+    // Головы уже лежат в concat_ — остаётся линейный слой
+    return W_o_int8_.multiply(concat_, weight_operand(W_o_, W_o_half_));
+}
 
-    //     
-    for (int h = 0; h < num_heads_; ++h) {
-        attention_weights_[h] = softmax_.forward_softmax(scores_[h]);
-        attention_heads[h] = utils::matrix_multiply(attention_weights_[h], V_heads[h]);
+// Cross-Attention
+Tensor MultiHeadAttention::forward_mha(const Tensor& Q_input, const Tensor& KV_input, const BatchLayout& q_layout, const BatchLayout& kv_layout) {
+    q_layout_ = resolve_layout(q_layout, Q_input.rows());
+    kv_layout_ = resolve_layout(kv_layout, KV_input.rows());
+    if (q_layout_.batch_size() != kv_layout_.batch_size()) {
+        throw std::invalid_argument("Cross-attention batch sizes do not match");
     }
+    Q_ = compute_Q(Q_input);  // Q из декодера
+    K_ = compute_K(KV_input); // K из энкодера
+    V_ = compute_V(KV_input); // V из энкодера
 
-    //  attention_heads
-    attention_heads_ = attention_heads;
-    return attention_heads;
-}
+    compute_attention(Q_, K_, V_, false);
 
-//   
-std::vector<std::vector<std::vector<float>>> MultiHeadAttention::compute_masked_attention(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads, const std::vector<std::vector<std::vector<float>>>& V_heads) {
-    int head_dim_ = embedding_dim_ / num_heads_;
-    std::vector<std::vector<std::vector<float>>> attention_heads(num_heads_, std::vector<std::vector<float>>(Q_heads[0].size(), std::vector<float>(head_dim_)));
+    // Головы уже лежат в concat_ — остаётся линейный слой
+    return W_o_int8_.multiply(concat_, weight_operand(W_o_, W_o_half_));
+}
 
-    //  attention_weights  
-    attention_weights_.resize(num_heads_);
+// Cross-Attention с готовыми проекциями K и V: на шаге генерации проецируются только новые строки Q
+Tensor MultiHeadAttention::forward_mha(const Tensor& Q_input, const Tensor& K, const Tensor& V) {
+    q_layout_ = resolve_layout(BatchLayout(), Q_input.rows());
+    kv_layout_ = resolve_layout(BatchLayout(), K.rows());
+    Q_ = compute_Q(Q_input);
 
-    //  scores
-    compute_scores(Q_heads, K_heads);
+    compute_attention(Q_, K, V, false);
 
-    //     
-    for (int h = 0; h < num_heads_; ++h) {
-        //  :     
-        size_t seq_len = scores_[h].size();
-        for (size_t i = 0; i < seq_len; ++i) {
-            for (size_t j = i + 1; j < scores_[h][0].size(); ++j) {
-                scores_[h][i][j] = -1e9;
-            }
-        }
-
-        attention_weights_[h] = softmax_.forward_softmax(scores_[h]);
-        attention_heads[h] = utils::matrix_multiply(attention_weights_[h], V_heads[h]);
-    }
+    return W_o_int8_.multiply(concat_, weight_operand(W_o_, W_o_half_));
+}
 
-    //  attention_heads
-    attention_heads_ = attention_heads;
-    return attention_heads;
+void MultiHeadAttention::project_kv(const Tensor& KV_input, Tensor& K, Tensor& V) const {
+    K = W_k_int8_.multiply(KV_input, weight_operand(W_k_, W_k_half_));
+    V = W_v_int8_.multiply(KV_input, weight_operand(W_v_, W_v_half_));
 }
 
-//  
-std::vector<std::vector<float>> MultiHeadAttention::concat_heads(const std::vector<std::vector<std::vector<float>>>& heads_output) {
-    size_t seq_len = heads_output[0].size();
+// Пошаговый Masked MHA: новые строки дописываются в кэш K/V, маска учитывает их абсолютные позиции
+Tensor MultiHeadAttention::forward_mha_step(const Tensor& X_new) {
     int head_dim_ = embedding_dim_ / num_heads_;
-    std::vector<std::vector<float>> concat(seq_len, std::vector<float>(embedding_dim_));
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                concat[i][idx] = heads_output[h][i][d];
-            }
-        }
+    size_t new_rows = X_new.rows();
+    size_t first_pos = K_cache_.rows(); // Позиция первой новой строки
+    if (cache_beams_ > 1 && new_rows != cache_beams_) {
+        throw std::invalid_argument("forward_mha_step: число строк X_new должно совпадать с числом лучей кэша");
     }
-    return concat;
-}
-
-//   forward_mha   
-std::vector<std::vector<float>> MultiHeadAttention::forward_mha(const std::vector<std::vector<float>>& X, bool use_mask) {
-    Q_ = compute_Q(X);
-    K_ = compute_K(X);
-    V_ = compute_V(X);
-
-    auto heads = split_heads(Q_, K_, V_);
-    Q_heads_ = heads[0];
-    K_heads_ = heads[1];
-    V_heads_ = heads[2];
 
-    //        use_mask
-    attention_heads_ = use_mask ? compute_masked_attention(Q_heads_, K_heads_, V_heads_) : compute_attention(Q_heads_, K_heads_, V_heads_);
+    Tensor Q = compute_Q(X_new);
+    K_cache_.append_rows(compute_K(X_new));
+    V_cache_.append_rows(compute_V(X_new));
+    size_t total = K_cache_.rows();
 
-    //   
-    concat_ = concat_heads(attention_heads_);
-    auto output = utils::matrix_multiply(concat_, W_o_);
-    return output;
+    float scale = 1.0f / std::sqrt(static_cast<float>(head_dim_));
+    Tensor heads(new_rows, embedding_dim_);
+    if (cache_beams_ > 1) {
+        // Лучи: ключи луча b — строки кэша b, b + beams, ... (представление с шагом beams строк, без копирования);
+        // новая строка — последняя позиция своего луча, маска не нужна
+        size_t length = total / cache_beams_;
+        size_t stride = cache_beams_ * embedding_dim_;
+        for_each_task(cache_beams_ * num_heads_, length * embedding_dim_, [&](size_t task) {
+            size_t b = task / num_heads_;
+            size_t col0 = (task % num_heads_) * head_dim_;
+            size_t offset = b * embedding_dim_ + col0;
+            attention::forward(Q.block(b, col0, 1, head_dim_),
+                ConstTensorView(K_cache_.data() + offset, length, head_dim_, stride),
+                ConstTensorView(V_cache_.data() + offset, length, head_dim_, stride),
+                scale, false, 0, heads.block(b, col0, 1, head_dim_), nullptr);
+        });
+        return W_o_int8_.multiply(heads, weight_operand(W_o_, W_o_half_));
+    }
+    for_each_task(num_heads_, new_rows * total * embedding_dim_, [&](size_t h) {
+        // Маска: строка i видит позиции не дальше first_pos + i
+        attention::forward(Q.block(0, h * head_dim_, new_rows, head_dim_),
+            K_cache_.block(0, h * head_dim_, total, head_dim_), V_cache_.block(0, h * head_dim_, total, head_dim_),
+            scale, true, first_pos, heads.block(0, h * head_dim_, new_rows, head_dim_), nullptr);
+    });
+
+    return W_o_int8_.multiply(heads, weight_operand(W_o_, W_o_half_));
 }
 
-// Cross-Attention
-std::vector<std::vector<float>> MultiHeadAttention::forward_mha(const std::vector<std::vector<float>>& Q_input, const std::vector<std::vector<float>>& KV_input) {
-    Q_ = compute_Q(Q_input);  // Q  
-    K_ = compute_K(KV_input); // K  
-    V_ = compute_V(KV_input); // V  
-
-    auto heads = split_heads(Q_, K_, V_);
-    Q_heads_ = heads[0];
-    K_heads_ = heads[1];
-    V_heads_ = heads[2];
-
-    //        use_mask
-    attention_heads_ = compute_attention(Q_heads_, K_heads_, V_heads_);
-    
-    //   
-    concat_ = concat_heads(attention_heads_);
-    auto output = utils::matrix_multiply(concat_, W_o_);
-    return output;
+void MultiHeadAttention::reset_cache() {
+    K_cache_.resize(0, embedding_dim_);
+    V_cache_.resize(0, embedding_dim_);
+    cache_beams_ = 1;
 }
 
-std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> MultiHeadAttention::backward_mha(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& Q_input, const std::vector<std::vector<float>>& KV_input, float learning_rate) {
-    if (Q_.empty() || K_.empty() || V_.empty()) {
-        throw std::runtime_error("    ");
+void MultiHeadAttention::truncate_cache(size_t length) {
+    if (cache_beams_ != 1 || length > K_cache_.rows()) {
+        throw std::invalid_argument("truncate_cache: кэш разветвлён на лучи или короче length");
     }
+    K_cache_.resize(length, embedding_dim_);
+    V_cache_.resize(length, embedding_dim_);
+}
 
-    int head_dim_ = embedding_dim_ / num_heads_;
-    size_t seq_len_Q = Q_input.size();
-    size_t seq_len_KV = KV_input.size();
-
-    // 1.   W_o
-    auto grad_concat = utils::matrix_multiply(grad_output, utils::transpose(W_o_));
-    auto grad_W_o = utils::matrix_multiply(utils::transpose(concat_), grad_output);
-
-    // 2.    
-    std::vector<std::vector<std::vector<float>>> grad_attention_heads(num_heads_, std::vector<std::vector<float>>(seq_len_Q, std::vector<float>(head_dim_)));
-    for (size_t i = 0; i < seq_len_Q; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                grad_attention_heads[h][i][d] = grad_concat[i][idx];
-            }
+void MultiHeadAttention::reorder_cache(const std::vector<int>& beams) {
+    if (beams.empty()) {
+        throw std::invalid_argument("reorder_cache: нужен хотя бы один луч");
+    }
+    for (int beam : beams) {
+        if (beam < 0 || static_cast<size_t>(beam) >= cache_beams_) {
+            throw std::out_of_range("reorder_cache: номер луча вне диапазона");
         }
     }
+    size_t length = cache_length();
+    size_t row_bytes = embedding_dim_ * sizeof(float);
+    K_reorder_.resize(length * beams.size(), embedding_dim_);
+    V_reorder_.resize(length * beams.size(), embedding_dim_);
+    for (size_t t = 0; t < length; ++t) {
+        for (size_t b = 0; b < beams.size(); ++b) {
+            std::memcpy(K_reorder_[t * beams.size() + b], K_cache_[t * cache_beams_ + beams[b]], row_bytes);
+            std::memcpy(V_reorder_[t * beams.size() + b], V_cache_[t * cache_beams_ + beams[b]], row_bytes);
+        }
+    }
+    std::swap(K_cache_, K_reorder_);
+    std::swap(V_cache_, V_reorder_);
+    cache_beams_ = beams.size();
+}
 
-    // 3.   
-    std::vector<std::vector<std::vector<float>>> grad_Q_heads(num_heads_, std::vector<std::vector<float>>(seq_len_Q, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> grad_V_heads(num_heads_, std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> grad_K_heads(num_heads_, std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(head_dim_)));
+// Обратный проход через внимание всех голов. Градиенты по Q, K, V записываются в столбцы своих голов;
+// строки K/V заполнения в прямом проходе не участвовали, их градиент остаётся нулевым (буферы обнулены).
+// Если пар (последовательность, голова) хватает на все потоки, каждая задача — целая голова.
+// Иначе голова делится по блокам ключей: каждый тайл считается одной задачей, она пишет dK/dV своего блока
+// и вклад в dQ — в свой буфер; буферы затем суммируются в порядке блоков (результат не зависит от потоков)
+void MultiHeadAttention::backward_attention(const Tensor& grad_concat, Tensor& grad_Q, Tensor& grad_K, Tensor& grad_V) {
+    int head_dim_ = embedding_dim_ / num_heads_;
     float scale = 1.0f / std::sqrt(static_cast<float>(head_dim_));
-
-    for (int h = 0; h < num_heads_; ++h) {
-        auto grad_attention_weights = utils::matrix_multiply(grad_attention_heads[h], utils::transpose(V_heads_[h]));
-        grad_V_heads[h] = utils::matrix_multiply(utils::transpose(attention_weights_[h]), grad_attention_heads[h]);
-
-        auto grad_scores = softmax_.backward_softmax(attention_weights_[h], grad_attention_weights);
-        grad_Q_heads[h] = utils::matrix_multiply(grad_scores, K_heads_[h]);
-        for (auto& row : grad_Q_heads[h]) {
-            for (auto& val : row) {
-                val *= scale;
-            }
+    size_t q_rows = q_layout_.max_len;
+    size_t kv_rows = kv_layout_.max_len;
+    size_t pairs = q_layout_.batch_size() * num_heads_;
+    size_t work = Q_.rows() * kv_rows * embedding_dim_;
+
+    // D_i = dO_i . O_i для всех строк и голов
+    Tensor delta(num_heads_, Q_.rows());
+    for_each_task(num_heads_, work, [&](size_t h) {
+        size_t col0 = h * head_dim_;
+        attention::backward_delta(concat_.block(0, col0, concat_.rows(), head_dim_),
+            grad_concat.block(0, col0, grad_concat.rows(), head_dim_), delta[h]);
+    });
+
+    size_t kv_blocks = 1;
+    if (pairs < ThreadPool::instance().num_threads()) {
+        kv_blocks = (kv_rows + attention::kBlockKV - 1) / attention::kBlockKV;
+    }
+    // Вклады блоков ключей в dQ: блок part пары pair — строки [(pair * kv_blocks + part) * q_rows, ... + q_rows)
+    Tensor dQ_parts;
+    if (kv_blocks > 1) dQ_parts.assign(pairs * kv_blocks * q_rows, head_dim_, 0.0f);
+
+    for_each_task(pairs * kv_blocks, work, [&](size_t task) {
+        size_t part = task % kv_blocks;
+        size_t pair = task / kv_blocks;
+        size_t h = pair % num_heads_;
+        size_t b = pair / num_heads_;
+
+        size_t q0 = b * q_rows;
+        size_t k0 = b * kv_rows;
+        size_t kv_len = kv_layout_.lengths[b];
+        size_t col0 = h * head_dim_;
+        ConstTensorView Q_h = Q_.block(q0, col0, q_rows, head_dim_);
+        ConstTensorView K_h = K_.block(k0, col0, kv_len, head_dim_);
+        ConstTensorView V_h = V_.block(k0, col0, kv_len, head_dim_);
+        ConstTensorView dO_h = grad_concat.block(q0, col0, q_rows, head_dim_);
+        TensorView dQ_h = grad_Q.block(q0, col0, q_rows, head_dim_);
+        TensorView dK_h = grad_K.block(k0, col0, kv_len, head_dim_);
+        TensorView dV_h = grad_V.block(k0, col0, kv_len, head_dim_);
+        const float* lse = lse_[h] + q0;
+        const float* D = delta[h] + q0;
+
+        if (kv_blocks == 1) {
+            // Вся голова одной задачей
+            attention::backward_range(Q_h, K_h, V_h, dO_h, lse, D, scale, causal_, 0,
+                0, q_rows, 0, kv_len, dQ_h, dK_h, dV_h);
+            return;
         }
-
-        auto grad_scores_T = utils::transpose(grad_scores);
-        grad_K_heads[h] = utils::matrix_multiply(grad_scores_T, Q_heads_[h]);
-        for (auto& row : grad_K_heads[h]) {
-            for (auto& val : row) {
-                val *= scale;
+        size_t c0 = part * attention::kBlockKV;
+        size_t c1 = std::min(kv_len, c0 + attention::kBlockKV);
+        if (c0 >= c1) return; // Блок целиком в заполнении (его буфер dQ остаётся нулевым)
+        TensorView dQ_part = dQ_parts.block(task * q_rows, 0, q_rows, head_dim_);
+        attention::backward_range(Q_h, K_h, V_h, dO_h, lse, D, scale, causal_, 0,
+            0, q_rows, c0, c1, dQ_part, dK_h, dV_h);
+    });
+    if (kv_blocks == 1) return;
+
+    // dQ = сумма вкладов блоков ключей в порядке блоков
+    for_each_task(pairs, pairs * kv_blocks * q_rows * head_dim_, [&](size_t pair) {
+        size_t h = pair % num_heads_;
+        size_t b = pair / num_heads_;
+        TensorView dQ_h = grad_Q.block(b * q_rows, h * head_dim_, q_rows, head_dim_);
+        for (size_t part = 0; part < kv_blocks; ++part) {
+            ConstTensorView dQ_part = dQ_parts.block((pair * kv_blocks + part) * q_rows, 0, q_rows, head_dim_);
+            for (size_t i = 0; i < q_rows; ++i) {
+                for (int c = 0; c < head_dim_; ++c) dQ_h[i][c] += dQ_part[i][c];
             }
         }
-    }
+    });
+}
 
-    // 4.    
-    auto grad_Q = std::vector<std::vector<float>>(seq_len_Q, std::vector<float>(embedding_dim_, 0.0f));
-    auto grad_K = std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(embedding_dim_, 0.0f));
-    auto grad_V = std::vector<std::vector<float>>(seq_len_KV, std::vector<float>(embedding_dim_, 0.0f));
-    for (size_t i = 0; i < seq_len_Q; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                grad_Q[i][idx] = grad_Q_heads[h][i][d];
-            }
-        }
+std::pair<Tensor, Tensor> MultiHeadAttention::backward_mha(const Tensor& grad_output, const Tensor& Q_input, const Tensor& KV_input, float learning_rate) {
+    if (Q_.empty() || K_.empty() || V_.empty()) {
+        throw std::runtime_error("Прямой проход не был выполнен");
     }
-    for (size_t i = 0; i < seq_len_KV; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                grad_K[i][idx] = grad_K_heads[h][i][d];
-                grad_V[i][idx] = grad_V_heads[h][i][d];
-            }
-        }
+    if (W_o_.empty()) {
+        throw std::runtime_error("MHA: веса загружены только в int8, обратный проход недоступен");
     }
 
-    // 5.   
-    auto grad_W_q = utils::matrix_multiply(utils::transpose(Q_input), grad_Q);
-    auto grad_W_k = utils::matrix_multiply(utils::transpose(KV_input), grad_K);
-    auto grad_W_v = utils::matrix_multiply(utils::transpose(KV_input), grad_V);
+    size_t seq_len_Q = Q_input.rows();
+    size_t seq_len_KV = KV_input.rows();
 
-    // 6.   
-    auto grad_Q_input = utils::matrix_multiply(grad_Q, utils::transpose(W_q_));
-    auto grad_KV_input = utils::add_embeddings(utils::matrix_multiply(grad_K, utils::transpose(W_k_)), utils::matrix_multiply(grad_V, utils::transpose(W_v_)));
+    // 1. Градиент через W_o
+    auto grad_concat = utils::matrix_multiply(grad_output, weight_operand(W_o_, W_o_half_), false, true);
+    auto grad_W_o = utils::matrix_multiply(concat_, grad_output, true, false);
 
-    // 7.  
-    for (int i = 0; i < embedding_dim_; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            W_q_[i][j] -= learning_rate * grad_W_q[i][j];
-            W_k_[i][j] -= learning_rate * grad_W_k[i][j];
-            W_v_[i][j] -= learning_rate * grad_W_v[i][j];
-            W_o_[i][j] -= learning_rate * grad_W_o[i][j];
-        }
-    }
+    // 2-3. Градиент через внимание (головы — столбцы grad_concat); градиенты голов сразу собираются
+    // в общие матрицы, шаг объединения не нужен
+    Tensor grad_Q(seq_len_Q, embedding_dim_);
+    Tensor grad_K(seq_len_KV, embedding_dim_);
+    Tensor grad_V(seq_len_KV, embedding_dim_);
+    backward_attention(grad_concat, grad_Q, grad_K, grad_V);
+
+    // 4. Градиенты по весам
+    auto grad_W_q = utils::matrix_multiply(Q_input, grad_Q, true, false);
+    auto grad_W_k = utils::matrix_multiply(KV_input, grad_K, true, false);
+    auto grad_W_v = utils::matrix_multiply(KV_input, grad_V, true, false);
+
+    // 5. Градиенты по входам (вклад V накапливается в тот же буфер, beta = 1)
+    auto grad_Q_input = utils::matrix_multiply(grad_Q, weight_operand(W_q_, W_q_half_), false, true);
+    auto grad_KV_input = utils::matrix_multiply(grad_K, weight_operand(W_k_, W_k_half_), false, true);
+    utils::gemm(false, true, 1.0f, grad_V, weight_operand(W_v_, W_v_half_), 1.0f, grad_KV_input);
+
+    // 6. Обновление весов (или накопление градиентов)
+    apply_gradients(grad_W_q, grad_W_k, grad_W_v, grad_W_o, learning_rate);
 
     return { grad_Q_input, grad_KV_input };
 }
 
-std::vector<std::vector<float>> MultiHeadAttention::backward_mha(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& X, float learning_rate) {
+Tensor MultiHeadAttention::backward_mha(const Tensor& grad_output, const Tensor& X, float learning_rate) {
     if (Q_.empty() || K_.empty() || V_.empty()) {
-        throw std::runtime_error("    ");
+        throw std::runtime_error("Прямой проход не был выполнен");
+    }
+    if (W_o_.empty()) {
+        throw std::runtime_error("MHA: веса загружены только в int8, обратный проход недоступен");
     }
 
-    int head_dim_ = embedding_dim_ / num_heads_;
-    size_t seq_len = X.size();
-    float scale = 1.0f / std::sqrt(static_cast<float>(head_dim_));
+    size_t seq_len = X.rows();
 
-    // 1.   W_o  
-    auto grad_concat = utils::matrix_multiply(grad_output, utils::transpose(W_o_));
-    auto grad_W_o = utils::matrix_multiply(utils::transpose(concat_), grad_output);
-
-    // 2.    
-    std::vector<std::vector<std::vector<float>>> grad_attention_heads(num_heads_, std::vector<std::vector<float>>(seq_len, std::vector<float>(head_dim_)));
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                grad_attention_heads[h][i][d] = grad_concat[i][idx];
-            }
-        }
-    }
+    // 1. Градиент через W_o и конкатенацию
+    auto grad_concat = utils::matrix_multiply(grad_output, weight_operand(W_o_, W_o_half_), false, true);
+    auto grad_W_o = utils::matrix_multiply(concat_, grad_output, true, false);
 
-    // 3.    
-    std::vector<std::vector<std::vector<float>>> grad_V_heads(num_heads_, std::vector<std::vector<float>>(seq_len, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> grad_Q_heads(num_heads_, std::vector<std::vector<float>>(seq_len, std::vector<float>(head_dim_)));
-    std::vector<std::vector<std::vector<float>>> grad_K_heads(num_heads_, std::vector<std::vector<float>>(seq_len, std::vector<float>(head_dim_)));
+    // 2-3. Градиент через механизм внимания (по головам — столбцам grad_concat)
+    Tensor grad_Q(seq_len, embedding_dim_);
+    Tensor grad_K(seq_len, embedding_dim_);
+    Tensor grad_V(seq_len, embedding_dim_);
+    backward_attention(grad_concat, grad_Q, grad_K, grad_V);
 
-    for (int h = 0; h < num_heads_; ++h) {
-        auto grad_attention_weights = utils::matrix_multiply(grad_attention_heads[h], utils::transpose(V_heads_[h]));
-        grad_V_heads[h] = utils::matrix_multiply(utils::transpose(attention_weights_[h]), grad_attention_heads[h]);
-        auto grad_scores = softmax_.backward_softmax(attention_weights_[h], grad_attention_weights);
-        grad_Q_heads[h] = utils::matrix_multiply(grad_scores, K_heads_[h]);
-        for (auto& row : grad_Q_heads[h]) {
-            for (auto& val : row) {
-                val *= scale;
-            }
-        }
-        auto grad_scores_T = utils::transpose(grad_scores);
-        grad_K_heads[h] = utils::matrix_multiply(grad_scores_T, Q_heads_[h]);
-        for (auto& row : grad_K_heads[h]) {
-            for (auto& val : row) {
-                val *= scale;
-            }
-        }
+    // 4. Градиенты по весам
+    auto grad_W_q = utils::matrix_multiply(X, grad_Q, true, false);
+    auto grad_W_k = utils::matrix_multiply(X, grad_K, true, false);
+    auto grad_W_v = utils::matrix_multiply(X, grad_V, true, false);
+
+    // 5. Градиент по входу X: три вклада накапливаются в одном буфере (beta = 1)
+    auto grad_X = utils::matrix_multiply(grad_Q, weight_operand(W_q_, W_q_half_), false, true);
+    utils::gemm(false, true, 1.0f, grad_K, weight_operand(W_k_, W_k_half_), 1.0f, grad_X);
+    utils::gemm(false, true, 1.0f, grad_V, weight_operand(W_v_, W_v_half_), 1.0f, grad_X);
+
+    // 6. Обновление весов (или накопление градиентов)
+    apply_gradients(grad_W_q, grad_W_k, grad_W_v, grad_W_o, learning_rate);
+
+    return grad_X;
+}
+
+void MultiHeadAttention::apply_gradients(const Tensor& grad_W_q, const Tensor& grad_W_k, const Tensor& grad_W_v, const Tensor& grad_W_o, float learning_rate) {
+    utils::apply_gradient(W_q_.data(), grad_W_q_.data(), grad_W_q.data(), W_q_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(W_k_.data(), grad_W_k_.data(), grad_W_k.data(), W_k_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(W_v_.data(), grad_W_v_.data(), grad_W_v.data(), W_v_.size(), learning_rate, accumulate_gradients_);
+    utils::apply_gradient(W_o_.data(), grad_W_o_.data(), grad_W_o.data(), W_o_.size(), learning_rate, accumulate_gradients_);
+}
+
+void MultiHeadAttention::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    // Уже выделенные буферы не перевыделяются: они могут жить в общей области параметров
+    for (Tensor* grad : { &grad_W_q_, &grad_W_k_, &grad_W_v_, &grad_W_o_ }) {
+        if (!enabled) *grad = Tensor();
+        else if (grad->empty()) grad->assign(embedding_dim_, embedding_dim_, 0.0f);
     }
+}
 
-    // 4.    
-    auto grad_Q = std::vector<std::vector<float>>(seq_len, std::vector<float>(embedding_dim_, 0.0f));
-    auto grad_K = std::vector<std::vector<float>>(seq_len, std::vector<float>(embedding_dim_, 0.0f));
-    auto grad_V = std::vector<std::vector<float>>(seq_len, std::vector<float>(embedding_dim_, 0.0f));
-    for (size_t i = 0; i < seq_len; ++i) {
-        for (int h = 0; h < num_heads_; ++h) {
-            for (int d = 0; d < head_dim_; ++d) {
-                int idx = h * head_dim_ + d;
-                grad_Q[i][idx] = grad_Q_heads[h][i][d];
-                grad_K[i][idx] = grad_K_heads[h][i][d];
-                grad_V[i][idx] = grad_V_heads[h][i][d];
-            }
-        }
+void MultiHeadAttention::set_calibration(bool enabled) {
+    for (Int8Weight* weight : { &W_q_int8_, &W_k_int8_, &W_v_int8_, &W_o_int8_ }) {
+        weight->set_calibration(enabled);
     }
+}
 
-    // 5.   
-    auto grad_W_q = utils::matrix_multiply(utils::transpose(X), grad_Q);
-    auto grad_W_k = utils::matrix_multiply(utils::transpose(X), grad_K);
-    auto grad_W_v = utils::matrix_multiply(utils::transpose(X), grad_V);
+void MultiHeadAttention::quantize_int8() {
+    W_q_int8_.quantize(W_q_);
+    W_k_int8_.quantize(W_k_);
+    W_v_int8_.quantize(W_v_);
+    W_o_int8_.quantize(W_o_);
+}
 
-    // 6.    X
-    auto grad_X_Q = utils::matrix_multiply(grad_Q, utils::transpose(W_q_));
-    auto grad_X_K = utils::matrix_multiply(grad_K, utils::transpose(W_k_));
-    auto grad_X_V = utils::matrix_multiply(grad_V, utils::transpose(W_v_));
-    auto grad_X = utils::add_embeddings(utils::add_embeddings(grad_X_Q, grad_X_K), grad_X_V);
+void MultiHeadAttention::save_quantized(std::ofstream& out) const {
+    for (const Int8Weight* weight : { &W_q_int8_, &W_k_int8_, &W_v_int8_, &W_o_int8_ }) {
+        weight->matrix.save(out);
+    }
+}
 
-    // 7.  
-    for (int i = 0; i < embedding_dim_; ++i) {
-        for (int j = 0; j < embedding_dim_; ++j) {
-            W_q_[i][j] -= learning_rate * grad_W_q[i][j];
-            W_k_[i][j] -= learning_rate * grad_W_k[i][j];
-            W_v_[i][j] -= learning_rate * grad_W_v[i][j];
-            W_o_[i][j] -= learning_rate * grad_W_o[i][j];
-        }
+void MultiHeadAttention::load_quantized(std::ifstream& in) {
+    for (Int8Weight* weight : { &W_q_int8_, &W_k_int8_, &W_v_int8_, &W_o_int8_ }) {
+        weight->matrix.load(in);
+        if ((int)weight->matrix.rows() != embedding_dim_ || (int)weight->matrix.cols() != embedding_dim_)
+            throw std::runtime_error("Неверный размер int8-параметров MHA при загрузке");
     }
+    for (Tensor* W : { &W_q_, &W_k_, &W_v_, &W_o_ }) {
+        *W = Tensor();
+    }
+}
 
-    return grad_X;
+void MultiHeadAttention::collect_parameters(std::vector<ParameterRef>& params) {
+    params.push_back({ &W_q_, &grad_W_q_, &W_q_half_, "W_q" });
+    params.push_back({ &W_k_, &grad_W_k_, &W_k_half_, "W_k" });
+    params.push_back({ &W_v_, &grad_W_v_, &W_v_half_, "W_v" });
+    params.push_back({ &W_o_, &grad_W_o_, &W_o_half_, "W_o" });
 }
 
 // MultiHeadAttention.cpp
@@ -420,7 +473,7 @@ void MultiHeadAttention::load_weights(std::ifstream& in) {
     utils::read_matrix(in, W_k_);
     utils::read_matrix(in, W_v_);
     utils::read_matrix(in, W_o_);
-    // ,   
-    if ((int)W_q_.size() != embedding_dim_ || (int)W_q_[0].size() != embedding_dim_)
-        throw std::runtime_error("  W_q_   MHA");
+    // Проверим, что размеры совпадают
+    if ((int)W_q_.rows() != embedding_dim_ || (int)W_q_.cols() != embedding_dim_)
+        throw std::runtime_error("Неверный размер W_q_ при загрузке MHA");
 }
\ No newline at end of file
@@ -1,54 +1,90 @@
 #pragma once
 #include <vector>
-#include "Softmax.h"
+#include "Tensor.h"
+#include "BatchLayout.h"
+#include "Parameter.h"
+#include "Precision.h"
+#include "Quantization.h"
 #include <fstream>
 
 class MultiHeadAttention {
 public:
-    // :      
+    // Конструктор: принимает количество голов и размерность эмбеддинга
     MultiHeadAttention(int num_heads, int embedding_dim);
 
-    //  :  Multi-Head Attention
-    std::vector<std::vector<float>> forward_mha(const std::vector<std::vector<float>>& X, bool use_mask);
-    //  Cross-Attention (K  V  )
-    std::vector<std::vector<float>> forward_mha(const std::vector<std::vector<float>>& Q_input, const std::vector<std::vector<float>>& KV_input);
-    //    Cross MHA
-    std::pair<std::vector<std::vector<float>>, std::vector<std::vector<float>>> backward_mha(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& Q_input, const std::vector<std::vector<float>>& KV_input, float learning_rate);
-    //    MHA  Masked MHA
-    std::vector<std::vector<float>> backward_mha(const std::vector<std::vector<float>>& grad_output, const std::vector<std::vector<float>>& X, float learning_rate);
+    // Основной метод: выполняет Multi-Head Attention.
+    // layout — разметка мини-батча: позиции заполнения не используются как ключи
+    Tensor forward_mha(const Tensor& X, bool use_mask, const BatchLayout& layout = BatchLayout());
+    // Для Cross-Attention (K и V из энкодера); q_layout и kv_layout — разметки батча декодера и энкодера
+    Tensor forward_mha(const Tensor& Q_input, const Tensor& KV_input,
+        const BatchLayout& q_layout = BatchLayout(), const BatchLayout& kv_layout = BatchLayout());
+    // Cross-Attention с заранее спроецированными K и V (см. project_kv); только для инференса
+    Tensor forward_mha(const Tensor& Q_input, const Tensor& K, const Tensor& V);
+    // Проекции K и V входа энкодера — считаются один раз на запрос
+    void project_kv(const Tensor& KV_input, Tensor& K, Tensor& V) const;
+    // Обратный проход для Cross MHA
+    std::pair<Tensor, Tensor> backward_mha(const Tensor& grad_output, const Tensor& Q_input, const Tensor& KV_input, float learning_rate);
+    // Обратный проход для MHA и Masked MHA
+    Tensor backward_mha(const Tensor& grad_output, const Tensor& X, float learning_rate);
 
-    //  ( ),  ( )    MHA
+    // Пошаговый Masked MHA для генерации: K и V прошлых позиций берутся из кэша,
+    // считаются только проекции новых строк X_new (обычно одного токена).
+    // Если кэш разветвлён на несколько лучей (reorder_cache), X_new — по одной строке на луч:
+    // новые позиции лучей обрабатываются вместе, каждая видит только свой луч
+    Tensor forward_mha_step(const Tensor& X_new);
+    void reset_cache();
+    // Лучевой поиск: новый луч b продолжает прежний луч beams[b] (число лучей может измениться)
+    void reorder_cache(const std::vector<int>& beams);
+    // Откат кэша до первых length позиций (спекулятивное декодирование: отброшенные токены черновика)
+    void truncate_cache(size_t length);
+    size_t cache_length() const { return K_cache_.rows() / cache_beams_; }
+
+    // Инициализация (для обучения), загрузка (для инференса) и сохранение параметров MHA
     void initialize_random();
     void load_weights(std::ifstream& in);
     void save_weights(std::ofstream& out) const;
 
-    //    
-    const std::vector<std::vector<float>>& get_W_q() const { return W_q_; }
-    const std::vector<std::vector<float>>& get_W_k() const { return W_k_; }
-    const std::vector<std::vector<float>>& get_W_v() const { return W_v_; }
-    const std::vector<std::vector<float>>& get_W_o() const { return W_o_; }
+    // Режим накопления: backward_mha складывает градиенты в буферы вместо шага SGD
+    void set_gradient_accumulation(bool enabled);
+    void collect_parameters(std::vector<ParameterRef>& params);
+
+    // Int8-квантование W_q_, W_k_, W_v_, W_o_ для инференса (см. Linear)
+    void set_calibration(bool enabled);
+    void quantize_int8();
+    void save_quantized(std::ofstream& out) const;
+    void load_quantized(std::ifstream& in);
+
+    // Вывод весов для отладки
+    const Tensor& get_W_q() const { return W_q_; }
+    const Tensor& get_W_k() const { return W_k_; }
+    const Tensor& get_W_v() const { return W_v_; }
+    const Tensor& get_W_o() const { return W_o_; }
 
 private:
-    //  
-    std::vector<std::vector<float>> compute_Q(const std::vector<std::vector<float>>& input);
-    std::vector<std::vector<float>> compute_K(const std::vector<std::vector<float>>& input);
-    std::vector<std::vector<float>> compute_V(const std::vector<std::vector<float>>& input);
-    std::vector<std::vector<std::vector<std::vector<float>>>> split_heads(const std::vector<std::vector<float>>& Q, const std::vector<std::vector<float>>& K, const std::vector<std::vector<float>>& V);
-    void compute_scores(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads);
-    std::vector<std::vector<std::vector<float>>> compute_attention(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads, const std::vector<std::vector<std::vector<float>>>& V_heads);
-    std::vector<std::vector<std::vector<float>>> compute_masked_attention(const std::vector<std::vector<std::vector<float>>>& Q_heads, const std::vector<std::vector<std::vector<float>>>& K_heads, const std::vector<std::vector<std::vector<float>>>& V_heads);
-    std::vector<std::vector<float>> concat_heads(const std::vector<std::vector<std::vector<float>>>& attention_heads);
-
-    //  
-    int num_heads_;           //  
-    int embedding_dim_;       //  
-    Softmax softmax_;         //  Softmax
-    std::vector<std::vector<float>> W_q_, W_k_, W_v_, W_o_; //  
-    //     
-    std::vector<std::vector<float>> Q_, K_, V_;
-    std::vector<std::vector<std::vector<float>>> Q_heads_, K_heads_, V_heads_;
-    std::vector<std::vector<std::vector<float>>> scores_;
-    std::vector<std::vector<std::vector<float>>> attention_weights_;
-    std::vector<std::vector<std::vector<float>>> attention_heads_;
-    std::vector<std::vector<float>> concat_;
+    // Вспомогательные методы
+    Tensor compute_Q(const Tensor& input);
+    Tensor compute_K(const Tensor& input);
+    Tensor compute_V(const Tensor& input);
+    std::vector<ConstTensorView> split_heads(const Tensor& M) const;
+    void compute_attention(const Tensor& Q, const Tensor& K, const Tensor& V, bool causal);
+    void backward_attention(const Tensor& grad_concat, Tensor& grad_Q, Tensor& grad_K, Tensor& grad_V);
+    void apply_gradients(const Tensor& grad_W_q, const Tensor& grad_W_k, const Tensor& grad_W_v, const Tensor& grad_W_o, float learning_rate);
+
+    // Члены класса
+    int num_heads_;           // Количество голов
+    int embedding_dim_;       // Размерность эмбеддинга
+    Tensor W_q_, W_k_, W_v_, W_o_; // Матрицы весов
+    HalfView W_q_half_, W_k_half_, W_v_half_, W_o_half_; // 16-битные копии весов (только в режиме пониженной точности)
+    Int8Weight W_q_int8_, W_k_int8_, W_v_int8_, W_o_int8_; // Int8-копии весов (после квантования)
+    Tensor grad_W_q_, grad_W_k_, grad_W_v_, grad_W_o_; // Накопленные градиенты (только в режиме накопления)
+    bool accumulate_gradients_ = false;
+    // Поля для сохранения промежуточных результатов
+    Tensor Q_, K_, V_;
+    Tensor concat_;           // Выходы голов, сложенные по столбцам
+    Tensor lse_;              // Логарифм суммы экспонент softmax по строкам (num_heads x seq_len_Q) для backward
+    bool causal_ = false;     // Была ли маска в последнем прямом проходе
+    BatchLayout q_layout_, kv_layout_; // Разметка батча в последнем прямом проходе
+    Tensor K_cache_, V_cache_; // Кэш ключей и значений для пошаговой генерации: строка t * cache_beams_ + b — позиция t луча b
+    size_t cache_beams_ = 1;
+    Tensor K_reorder_, V_reorder_; // Буферы reorder_cache (переиспользуются между шагами)
 };
\ No newline at end of file
@@ -0,0 +1,272 @@
+﻿#include "Optimizer.h"
+#include "Gemm.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // Скаляры шага, общие для всех кусков области
+    struct StepArgs {
+        float learning_rate;
+        float scale;        // Множитель обрезки градиента (1 — без обрезки)
+        float momentum;
+        float beta1;
+        float beta2;
+        float step_size;    // learning_rate / (1 - beta1^t)
+        float inv_bias2;    // 1 / (1 - beta2^t)
+        float epsilon;
+    };
+
+    // Ядро обновления куска: w — веса, g — градиенты, s1/s2 — состояние оптимизатора
+    using UpdateFn = void (*)(float* w, const float* g, float* s1, float* s2, size_t n, const StepArgs& a);
+    using SumSquaresFn = double (*)(const float* g, size_t n);
+
+    void sgd_scalar(float* w, const float* g, float*, float*, size_t n, const StepArgs& a) {
+        float k = a.learning_rate * a.scale;
+        for (size_t i = 0; i < n; ++i) w[i] -= k * g[i];
+    }
+
+    void momentum_scalar(float* w, const float* g, float* u, float*, size_t n, const StepArgs& a) {
+        for (size_t i = 0; i < n; ++i) {
+            u[i] = a.momentum * u[i] + a.scale * g[i];
+            w[i] -= a.learning_rate * u[i];
+        }
+    }
+
+    void adam_scalar(float* w, const float* g, float* m, float* v, size_t n, const StepArgs& a) {
+        for (size_t i = 0; i < n; ++i) {
+            float grad = a.scale * g[i];
+            m[i] = a.beta1 * m[i] + (1.0f - a.beta1) * grad;
+            v[i] = a.beta2 * v[i] + (1.0f - a.beta2) * grad * grad;
+            w[i] -= a.step_size * m[i] / (std::sqrt(v[i] * a.inv_bias2) + a.epsilon);
+        }
+    }
+
+    double sum_squares_scalar(const float* g, size_t n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) sum += static_cast<double>(g[i]) * g[i];
+        return sum;
+    }
+
+#if SIMD_X86
+    SIMD_TARGET_AVX2
+    void sgd_avx2(float* w, const float* g, float* s1, float* s2, size_t n, const StepArgs& a) {
+        __m256 k = _mm256_set1_ps(-a.learning_rate * a.scale);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(w + i, _mm256_fmadd_ps(k, _mm256_loadu_ps(g + i), _mm256_loadu_ps(w + i)));
+        }
+        sgd_scalar(w + i, g + i, s1, s2, n - i, a);
+    }
+
+    SIMD_TARGET_AVX2
+    void momentum_avx2(float* w, const float* g, float* u, float* s2, size_t n, const StepArgs& a) {
+        __m256 mu = _mm256_set1_ps(a.momentum);
+        __m256 scale = _mm256_set1_ps(a.scale);
+        __m256 lr = _mm256_set1_ps(-a.learning_rate);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 vu = _mm256_fmadd_ps(mu, _mm256_loadu_ps(u + i), _mm256_mul_ps(scale, _mm256_loadu_ps(g + i)));
+            _mm256_storeu_ps(u + i, vu);
+            _mm256_storeu_ps(w + i, _mm256_fmadd_ps(lr, vu, _mm256_loadu_ps(w + i)));
+        }
+        momentum_scalar(w + i, g + i, u + i, s2, n - i, a);
+    }
+
+    SIMD_TARGET_AVX2
+    void adam_avx2(float* w, const float* g, float* m, float* v, size_t n, const StepArgs& a) {
+        __m256 scale = _mm256_set1_ps(a.scale);
+        __m256 b1 = _mm256_set1_ps(a.beta1), c1 = _mm256_set1_ps(1.0f - a.beta1);
+        __m256 b2 = _mm256_set1_ps(a.beta2), c2 = _mm256_set1_ps(1.0f - a.beta2);
+        __m256 step = _mm256_set1_ps(a.step_size), inv_bias2 = _mm256_set1_ps(a.inv_bias2), eps = _mm256_set1_ps(a.epsilon);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 grad = _mm256_mul_ps(scale, _mm256_loadu_ps(g + i));
+            __m256 vm = _mm256_fmadd_ps(b1, _mm256_loadu_ps(m + i), _mm256_mul_ps(c1, grad));
+            __m256 vv = _mm256_fmadd_ps(b2, _mm256_loadu_ps(v + i), _mm256_mul_ps(c2, _mm256_mul_ps(grad, grad)));
+            _mm256_storeu_ps(m + i, vm);
+            _mm256_storeu_ps(v + i, vv);
+            __m256 denom = _mm256_add_ps(_mm256_sqrt_ps(_mm256_mul_ps(vv, inv_bias2)), eps);
+            _mm256_storeu_ps(w + i, _mm256_sub_ps(_mm256_loadu_ps(w + i), _mm256_div_ps(_mm256_mul_ps(step, vm), denom)));
+        }
+        adam_scalar(w + i, g + i, m + i, v + i, n - i, a);
+    }
+
+    SIMD_TARGET_AVX2
+    double sum_squares_avx2(const float* g, size_t n) {
+        // Частичные суммы в float по 8 дорожкам на коротком куске, итог — в double
+        __m256 acc = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 x = _mm256_loadu_ps(g + i);
+            acc = _mm256_fmadd_ps(x, x, acc);
+        }
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, acc);
+        double sum = 0.0;
+        for (float lane : lanes) sum += lane;
+        return sum + sum_squares_scalar(g + i, n - i);
+    }
+
+    SIMD_TARGET_AVX512
+    void sgd_avx512(float* w, const float* g, float* s1, float* s2, size_t n, const StepArgs& a) {
+        __m512 k = _mm512_set1_ps(-a.learning_rate * a.scale);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            _mm512_storeu_ps(w + i, _mm512_fmadd_ps(k, _mm512_loadu_ps(g + i), _mm512_loadu_ps(w + i)));
+        }
+        sgd_scalar(w + i, g + i, s1, s2, n - i, a);
+    }
+
+    SIMD_TARGET_AVX512
+    void momentum_avx512(float* w, const float* g, float* u, float* s2, size_t n, const StepArgs& a) {
+        __m512 mu = _mm512_set1_ps(a.momentum);
+        __m512 scale = _mm512_set1_ps(a.scale);
+        __m512 lr = _mm512_set1_ps(-a.learning_rate);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512 vu = _mm512_fmadd_ps(mu, _mm512_loadu_ps(u + i), _mm512_mul_ps(scale, _mm512_loadu_ps(g + i)));
+            _mm512_storeu_ps(u + i, vu);
+            _mm512_storeu_ps(w + i, _mm512_fmadd_ps(lr, vu, _mm512_loadu_ps(w + i)));
+        }
+        momentum_scalar(w + i, g + i, u + i, s2, n - i, a);
+    }
+
+    SIMD_TARGET_AVX512
+    void adam_avx512(float* w, const float* g, float* m, float* v, size_t n, const StepArgs& a) {
+        __m512 scale = _mm512_set1_ps(a.scale);
+        __m512 b1 = _mm512_set1_ps(a.beta1), c1 = _mm512_set1_ps(1.0f - a.beta1);
+        __m512 b2 = _mm512_set1_ps(a.beta2), c2 = _mm512_set1_ps(1.0f - a.beta2);
+        __m512 step = _mm512_set1_ps(a.step_size), inv_bias2 = _mm512_set1_ps(a.inv_bias2), eps = _mm512_set1_ps(a.epsilon);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512 grad = _mm512_mul_ps(scale, _mm512_loadu_ps(g + i));
+            __m512 vm = _mm512_fmadd_ps(b1, _mm512_loadu_ps(m + i), _mm512_mul_ps(c1, grad));
+            __m512 vv = _mm512_fmadd_ps(b2, _mm512_loadu_ps(v + i), _mm512_mul_ps(c2, _mm512_mul_ps(grad, grad)));
+            _mm512_storeu_ps(m + i, vm);
+            _mm512_storeu_ps(v + i, vv);
+            __m512 denom = _mm512_add_ps(_mm512_sqrt_ps(_mm512_mul_ps(vv, inv_bias2)), eps);
+            _mm512_storeu_ps(w + i, _mm512_sub_ps(_mm512_loadu_ps(w + i), _mm512_div_ps(_mm512_mul_ps(step, vm), denom)));
+        }
+        adam_scalar(w + i, g + i, m + i, v + i, n - i, a);
+    }
+
+    SIMD_TARGET_AVX512
+    double sum_squares_avx512(const float* g, size_t n) {
+        __m512 acc = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512 x = _mm512_loadu_ps(g + i);
+            acc = _mm512_fmadd_ps(x, x, acc);
+        }
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, acc);
+        double sum = 0.0;
+        for (float lane : lanes) sum += lane;
+        return sum + sum_squares_scalar(g + i, n - i);
+    }
+#endif
+
+    UpdateFn select_update(OptimizerType type) {
+#if SIMD_X86
+        switch (gemm::active_isa()) {
+        case gemm::Isa::Avx512:
+            return type == OptimizerType::Adam ? adam_avx512 : type == OptimizerType::Momentum ? momentum_avx512 : sgd_avx512;
+        case gemm::Isa::Avx2:
+            return type == OptimizerType::Adam ? adam_avx2 : type == OptimizerType::Momentum ? momentum_avx2 : sgd_avx2;
+        default:
+            break;
+        }
+#endif
+        return type == OptimizerType::Adam ? adam_scalar : type == OptimizerType::Momentum ? momentum_scalar : sgd_scalar;
+    }
+
+    SumSquaresFn select_sum_squares() {
+#if SIMD_X86
+        switch (gemm::active_isa()) {
+        case gemm::Isa::Avx512: return sum_squares_avx512;
+        case gemm::Isa::Avx2: return sum_squares_avx2;
+        default: break;
+        }
+#endif
+        return sum_squares_scalar;
+    }
+
+    // Операций на элемент для выбора размера куска
+    constexpr size_t kUpdateWork = 8;
+}
+
+Optimizer::Optimizer(const OptimizerConfig& config) : config_(config) {
+    if (config.clip_norm < 0.0f) {
+        throw std::invalid_argument("clip_norm не может быть отрицательным");
+    }
+}
+
+void Optimizer::reset() {
+    state1_ = Tensor();
+    state2_ = Tensor();
+    step_ = 0;
+}
+
+void Optimizer::restore_state(long long steps, Tensor state1, Tensor state2) {
+    // После первого шага буферы есть ровно у тех типов, которым они нужны, и одного размера
+    bool uses_state1 = config_.type != OptimizerType::Sgd;
+    bool uses_state2 = config_.type == OptimizerType::Adam;
+    bool consistent = steps == 0
+        ? state1.empty() && state2.empty()
+        : steps > 0 && state1.empty() != uses_state1 && state2.empty() != uses_state2
+            && (!uses_state2 || state2.size() == state1.size());
+    if (!consistent) {
+        throw std::invalid_argument("Состояние не соответствует типу оптимизатора");
+    }
+    state1_ = std::move(state1);
+    state2_ = std::move(state2);
+    step_ = steps;
+}
+
+float Optimizer::step(float* values, const float* grads, size_t size, float learning_rate) {
+    // Состояние создаётся под размер области при первом шаге
+    if (config_.type != OptimizerType::Sgd && state1_.size() != size) {
+        state1_.assign(1, size, 0.0f);
+    }
+    if (config_.type == OptimizerType::Adam && state2_.size() != size) {
+        state2_.assign(1, size, 0.0f);
+    }
+    ++step_;
+
+    ThreadPool& pool = ThreadPool::instance();
+    size_t grain = ThreadPool::grain_size(size, kUpdateWork);
+
+    StepArgs args{};
+    args.learning_rate = learning_rate;
+    args.scale = 1.0f;
+    args.momentum = config_.momentum;
+    args.beta1 = config_.beta1;
+    args.beta2 = config_.beta2;
+    args.step_size = learning_rate / (1.0f - static_cast<float>(std::pow(config_.beta1, static_cast<double>(step_))));
+    args.inv_bias2 = 1.0f / (1.0f - static_cast<float>(std::pow(config_.beta2, static_cast<double>(step_))));
+    args.epsilon = config_.epsilon;
+
+    // Обрезка по глобальной норме: норма нужна до обновления, поэтому считается отдельной параллельной редукцией
+    float norm = 0.0f;
+    if (config_.clip_norm > 0.0f) {
+        SumSquaresFn sum_squares = select_sum_squares();
+        double sum = pool.parallel_reduce(0, size, grain, 0.0,
+            [&](size_t begin, size_t end) { return sum_squares(grads + begin, end - begin); },
+            [](double a, double b) { return a + b; });
+        norm = static_cast<float>(std::sqrt(sum));
+        if (norm > config_.clip_norm) {
+            args.scale = config_.clip_norm / norm;
+        }
+    }
+
+    UpdateFn update = select_update(config_.type);
+    float* s1 = state1_.data();
+    float* s2 = state2_.data();
+    pool.parallel_for(0, size, grain, [&](size_t begin, size_t end) {
+        update(values + begin, grads + begin, s1 ? s1 + begin : nullptr, s2 ? s2 + begin : nullptr, end - begin, args);
+    });
+    return norm;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+﻿#pragma once
+#include "ParameterArena.h"
+#include "Tensor.h"
+#include <cstddef>
+
+enum class OptimizerType { Sgd, Momentum, Adam };
+
+struct OptimizerConfig {
+    OptimizerType type = OptimizerType::Sgd;
+    float momentum = 0.9f;      // Для Momentum
+    float beta1 = 0.9f;         // Для Adam
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    float clip_norm = 0.0f;     // Порог L2-нормы всего градиента; 0 — без обрезки
+};
+
+// Оптимизатор над плоской областью параметров (см. ParameterArena): обновление всех весов модели —
+// один векторизованный проход (AVX-512 / AVX2 / скалярно, как у GEMM), куски области делятся между потоками пула.
+// Состояние (скорости или моменты Adam) лежит в буферах того же размера, что и область
+class Optimizer {
+public:
+    explicit Optimizer(const OptimizerConfig& config = OptimizerConfig());
+
+    // Шаг: values -= update(grads). При clip_norm > 0 градиент масштабируется до нормы не больше clip_norm
+    // (норма считается отдельной редукцией, масштаб применяется внутри прохода обновления).
+    // Возвращает L2-норму градиента до обрезки или 0, если обрезка выключена
+    float step(float* values, const float* grads, size_t size, float learning_rate);
+    float step(ParameterArena& arena, float learning_rate) { return step(arena.values(), arena.grads(), arena.size(), learning_rate); }
+
+    // Сбрасывает накопленное состояние (скорости, моменты, счётчик шагов)
+    void reset();
+
+    const OptimizerConfig& config() const { return config_; }
+    long long steps() const { return step_; }
+
+    // Состояние для контрольных точек: буферы 1 x size (пустые у SGD и до первого шага) и счётчик шагов.
+    // restore_state заменяет состояние; буферы должны соответствовать типу оптимизатора
+    const Tensor& state1() const { return state1_; }
+    const Tensor& state2() const { return state2_; }
+    void restore_state(long long steps, Tensor state1, Tensor state2);
+
+private:
+    OptimizerConfig config_;
+    Tensor state1_;        // Скорость (Momentum) или первый момент (Adam)
+    Tensor state2_;        // Второй момент (Adam)
+    long long step_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "Tensor.h"
+#include "Precision.h"
+#include <string>
+#include <vector>
+
+// Ссылка на параметр модели: тензор значений и буфер накопленного градиента той же формы.
+// Модули выдают ссылки в фиксированном порядке (порядок save_weights), поэтому списки разных экземпляров
+// одной архитектуры совпадают поэлементно (это используется при сведении градиентов реплик).
+// half — представление 16-битной копии значений для прямого и обратного прохода (у матриц весов и эмбеддингов);
+// его заполняет ParameterArena в режиме пониженной точности.
+// name — имя в файле модели: модуль задаёт локальное имя ("W_q"), содержащие его модули добавляют префиксы
+// ("encoder.0.mha.W_q")
+struct ParameterRef {
+    Tensor* value = nullptr;
+    Tensor* grad = nullptr;
+    HalfView* half = nullptr;
+    std::string name;
+};
+
+// Добавляет prefix к именам параметров params[first..]
+inline void prefix_parameter_names(std::vector<ParameterRef>& params, size_t first, const std::string& prefix) {
+    for (size_t i = first; i < params.size(); ++i) {
+        params[i].name = prefix + params[i].name;
+    }
+}
\ No newline at end of file
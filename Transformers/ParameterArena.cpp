@@ -0,0 +1,75 @@
+﻿#include "ParameterArena.h"
+#include "ThreadPool.h"
+#include <stdexcept>
+
+void ParameterArena::bind(const std::vector<ParameterRef>& params) {
+    const size_t align = Tensor::kAlignment / sizeof(float);
+    std::vector<size_t> offsets;
+    size_t total = 0;
+    size_t with_grads = 0;
+    for (const auto& param : params) {
+        if (!param.value) {
+            throw std::invalid_argument("ParameterArena: пустая ссылка на параметр");
+        }
+        if (param.grad && !param.grad->empty()) {
+            if (param.grad->rows() != param.value->rows() || param.grad->cols() != param.value->cols()) {
+                throw std::invalid_argument("ParameterArena: градиент параметра не совпадает по форме");
+            }
+            ++with_grads;
+        }
+        offsets.push_back(total);
+        total += (param.value->size() + align - 1) / align * align;
+    }
+    if (with_grads != 0 && with_grads != params.size()) {
+        throw std::invalid_argument("ParameterArena: градиенты выделены не у всех параметров");
+    }
+
+    // Новая область заполняется до замены старой: параметры могут быть уже привязаны к ней
+    Tensor values(1, total, 0.0f);
+    Tensor grads;
+    if (with_grads != 0) grads.assign(1, total, 0.0f);
+    for (size_t p = 0; p < params.size(); ++p) {
+        params[p].value->attach_storage(values.data() + offsets[p]);
+        if (with_grads != 0) params[p].grad->attach_storage(grads.data() + offsets[p]);
+    }
+    values_ = std::move(values);
+    grads_ = std::move(grads);
+    params_ = params;
+    offsets_ = std::move(offsets);
+    set_precision(precision_);
+}
+
+void ParameterArena::set_precision(Precision format) {
+    precision_ = format;
+    if (format == Precision::Float32) {
+        half_values_ = std::vector<uint16_t>();
+    }
+    else {
+        half_values_.resize(values_.size());
+        refresh_low_precision();
+    }
+    attach_half_views();
+}
+
+void ParameterArena::refresh_low_precision() {
+    if (precision_ == Precision::Float32 || values_.empty()) {
+        return;
+    }
+    const size_t size = values_.size();
+    ThreadPool::instance().parallel_for(0, size, ThreadPool::grain_size(size, 1), [&](size_t begin, size_t end) {
+        precision::from_float(precision_, values_.data() + begin, half_values_.data() + begin, end - begin);
+    });
+}
+
+void ParameterArena::attach_half_views() {
+    for (size_t p = 0; p < params_.size(); ++p) {
+        HalfView* half = params_[p].half;
+        if (!half) continue;
+        if (precision_ == Precision::Float32) {
+            *half = HalfView();
+            continue;
+        }
+        const Tensor& value = *params_[p].value;
+        *half = HalfView{ half_values_.data() + offsets_[p], value.rows(), value.cols(), value.cols(), precision_ };
+    }
+}
\ No newline at end of file
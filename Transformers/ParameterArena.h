@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "Tensor.h"
+#include "Parameter.h"
+#include "Precision.h"
+#include <cstdint>
+#include <vector>
+
+// Общая область параметров: значения всех параметров модели лежат в одном непрерывном выровненном буфере,
+// градиенты — в другом с теми же смещениями. После bind тензоры модулей работают прямо в этих буферах,
+// поэтому оптимизатор и сведение градиентов проходят по всей модели одним плоским циклом
+class ParameterArena {
+public:
+    // Переносит параметры в область. Каждый параметр начинается с границы 64 байт, промежутки заполнены нулями.
+    // Градиенты либо выделены у всех параметров (режим накопления) и имеют форму значений,
+    // либо не выделены ни у одного (инференс) — тогда области градиентов нет.
+    // Установленная точность сохраняется: 16-битная копия собирается заново
+    void bind(const std::vector<ParameterRef>& params);
+
+    bool empty() const { return values_.empty(); }
+    bool has_grads() const { return !grads_.empty(); }
+    size_t size() const { return values_.size(); }
+    float* values() { return values_.data(); }
+    const float* values() const { return values_.data(); }
+    float* grads() { return grads_.data(); }
+    const float* grads() const { return grads_.data(); }
+
+    void zero_grad() { grads_.fill(0.0f); }
+
+    // Режим пониженной точности: рядом со значениями (float, мастер-копия для оптимизатора) хранится
+    // их копия в bf16/fp16 с теми же смещениями, и представления ParameterRef::half указывают в неё.
+    // Float32 освобождает копию и очищает представления
+    void set_precision(Precision format);
+    Precision precision() const { return precision_; }
+    // Пересчитывает 16-битную копию по значениям; вызывается после каждого изменения весов
+    void refresh_low_precision();
+    uint16_t* low_precision_values() { return half_values_.data(); }
+    const uint16_t* low_precision_values() const { return half_values_.data(); }
+
+private:
+    // Направляет представления half параметров в 16-битную копию (или очищает их)
+    void attach_half_views();
+
+    Tensor values_; // 1 x size
+    Tensor grads_;  // 1 x size (пусто без градиентов)
+    std::vector<ParameterRef> params_;
+    std::vector<size_t> offsets_;
+    Precision precision_ = Precision::Float32;
+    std::vector<uint16_t> half_values_; // size элементов в режиме пониженной точности
+};
\ No newline at end of file
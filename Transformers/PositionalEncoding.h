@@ -1,15 +1,17 @@
 #pragma once
+#include "Tensor.h"
 #include <vector>
 #include <cmath>
 
 class PositionalEncoding {
 public:    
-    // :       
+    // Конструктор: принимает максимальную длину последовательности и размерность эмбеддинга
     PositionalEncoding(int embedding_dim);
     
-    //        
-    std::vector<std::vector<float>> forward_pe(const std::vector<std::vector<float>>& embeddings) const;
+    // Метод для добавления позиционного кодирования к входным эмбеддингам
+    // start_pos — позиция первой строки (для пошаговой генерации)
+    Tensor forward_pe(ConstTensorView embeddings, int start_pos = 0) const;
 
 private:
-    int embedding_dim_;                 //  
+    int embedding_dim_;                 // Размерность эмбеддинга
 };
\ No newline at end of file
@@ -0,0 +1,313 @@
+﻿#include "Precision.h"
+#include "Gemm.h"
+#include "Simd.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace precision {
+    namespace {
+        struct CpuFeatures {
+            bool f16c = false;
+            bool avx512_bf16 = false;
+        };
+
+        CpuFeatures detect() {
+            CpuFeatures features;
+#if SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+            int r[4];
+            __cpuid(r, 0);
+            int max_leaf = r[0];
+            __cpuid(r, 1);
+            features.f16c = (r[2] & (1 << 29)) != 0;
+            if (max_leaf >= 7) {
+                __cpuidex(r, 7, 1);
+                features.avx512_bf16 = (r[0] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            features.f16c = __builtin_cpu_supports("f16c");
+            features.avx512_bf16 = __builtin_cpu_supports("avx512bf16");
+#endif
+            // Без AVX2 (или AVX-512) не будет и поддержки ОС для регистров соответствующей ширины
+            features.f16c = features.f16c && gemm::detected_isa() != gemm::Isa::Scalar;
+            features.avx512_bf16 = features.avx512_bf16 && gemm::detected_isa() == gemm::Isa::Avx512;
+#endif
+            return features;
+        }
+
+        const CpuFeatures& cpu() {
+            static const CpuFeatures features = detect();
+            return features;
+        }
+
+        void check_format(Precision format) {
+            if (format == Precision::Float32) {
+                throw std::invalid_argument("precision: 16-bit format expected");
+            }
+        }
+
+#if SIMD_X86
+        // bf16 -> float: старшие 16 бит float
+        SIMD_TARGET_AVX2
+        size_t bf16_to_float_avx2(const uint16_t* src, float* dst, size_t count) {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+                _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+            }
+            return i;
+        }
+
+        // float -> bf16 с округлением к ближайшему чётному; NaN остаётся (тихим) NaN
+        SIMD_TARGET_AVX2
+        size_t float_to_bf16_avx2(const float* src, uint16_t* dst, size_t count) {
+            const __m256i bias = _mm256_set1_epi32(0x7FFF);
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i abs_mask = _mm256_set1_epi32(0x7FFFFFFF);
+            const __m256i inf = _mm256_set1_epi32(0x7F800000);
+            const __m256i quiet = _mm256_set1_epi32(0x40);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i bits = _mm256_castps_si256(_mm256_loadu_ps(src + i));
+                __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+                __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb)), 16);
+                __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, abs_mask), inf);
+                __m256i nan_value = _mm256_or_si256(_mm256_srli_epi32(bits, 16), quiet);
+                __m256i r = _mm256_blendv_epi8(rounded, nan_value, nan);
+                __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+            }
+            return i;
+        }
+
+        // Аппаратное преобразование AVX512-BF16. Денормализованные числа оно обнуляет, поэтому блоки с ними
+        // (на практике редкие) преобразуются скалярно — результат совпадает с float_to_bf16
+        SIMD_TARGET_AVX512_BF16
+        size_t float_to_bf16_avx512(const float* src, uint16_t* dst, size_t count) {
+            const __m512i exponent = _mm512_set1_epi32(0x7F800000);
+            const __m512i mantissa = _mm512_set1_epi32(0x007FFFFF);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m512 x = _mm512_loadu_ps(src + i);
+                __m512i bits = _mm512_castps_si512(x);
+                if (_mm512_testn_epi32_mask(bits, exponent) & _mm512_test_epi32_mask(bits, mantissa)) {
+                    for (size_t j = i; j < i + 16; ++j) dst[j] = float_to_bf16(src[j]);
+                    continue;
+                }
+                __m256bh h = _mm512_cvtneps_pbh(x);
+                std::memcpy(dst + i, &h, sizeof(h));
+            }
+            return i;
+        }
+
+        SIMD_TARGET_F16C
+        size_t fp16_to_float_f16c(const uint16_t* src, float* dst, size_t count) {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+            }
+            return i;
+        }
+
+        SIMD_TARGET_F16C
+        size_t float_to_fp16_f16c(const float* src, uint16_t* dst, size_t count) {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+            }
+            return i;
+        }
+#endif
+    }
+
+    size_t element_size(Precision format) {
+        return format == Precision::Float32 ? sizeof(float) : sizeof(uint16_t);
+    }
+
+    const char* name(Precision format) {
+        switch (format) {
+        case Precision::BFloat16: return "bf16";
+        case Precision::Float16: return "fp16";
+        default: return "fp32";
+        }
+    }
+
+    bool has_f16c() {
+        return cpu().f16c;
+    }
+
+    bool has_avx512_bf16() {
+        return cpu().avx512_bf16;
+    }
+
+    uint16_t float_to_bf16(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+            return static_cast<uint16_t>((bits >> 16) | 0x40);
+        }
+        bits += 0x7FFFu + ((bits >> 16) & 1u);
+        return static_cast<uint16_t>(bits >> 16);
+    }
+
+    float bf16_to_float(uint16_t value) {
+        uint32_t bits = static_cast<uint32_t>(value) << 16;
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    uint16_t float_to_fp16(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t abs = bits & 0x7FFFFFFFu;
+        if (abs > 0x7F800000u) {
+            // NaN: тихий, со старшими битами полезной нагрузки (как у F16C)
+            return static_cast<uint16_t>(sign | 0x7E00u | ((abs >> 13) & 0x3FFu));
+        }
+        if (abs == 0x7F800000u) {
+            return static_cast<uint16_t>(sign | 0x7C00u);
+        }
+        if (abs >= 0x477FF000u) {
+            // Не меньше 65520 — после округления переполнение
+            return static_cast<uint16_t>(sign | 0x7C00u);
+        }
+        if (abs < 0x38800000u) {
+            // Меньше 2^-14: денормализованное fp16 или ноль
+            if (abs < 0x33000000u) {
+                return static_cast<uint16_t>(sign);
+            }
+            uint32_t exponent = abs >> 23;
+            uint32_t mantissa = (abs & 0x7FFFFFu) | 0x800000u;
+            uint32_t shift = 126 - exponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t middle = 1u << (shift - 1);
+            if (rest > middle || (rest == middle && (half & 1u))) ++half;
+            return static_cast<uint16_t>(sign | half);
+        }
+        uint32_t half = (abs - 0x38000000u) >> 13;
+        uint32_t rest = abs & 0x1FFFu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    float fp16_to_float(uint16_t value) {
+        uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+        uint32_t exponent = (value >> 10) & 0x1Fu;
+        uint32_t mantissa = value & 0x3FFu;
+        uint32_t bits;
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                bits = sign;
+            }
+            else {
+                float result = std::ldexp(static_cast<float>(mantissa), -24);
+                return sign ? -result : result;
+            }
+        }
+        else if (exponent == 31) {
+            // Бесконечность или NaN; NaN становится тихим, как у F16C
+            bits = sign | 0x7F800000u | (mantissa << 13) | (mantissa ? 0x400000u : 0u);
+        }
+        else {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    void from_float(Precision format, const float* src, uint16_t* dst, size_t count) {
+        check_format(format);
+        size_t i = 0;
+#if SIMD_X86
+        gemm::Isa isa = gemm::active_isa();
+        if (format == Precision::BFloat16) {
+            if (isa == gemm::Isa::Avx512 && has_avx512_bf16()) {
+                i = float_to_bf16_avx512(src, dst, count);
+            }
+            else if (isa != gemm::Isa::Scalar) {
+                i = float_to_bf16_avx2(src, dst, count);
+            }
+        }
+        else if (isa != gemm::Isa::Scalar && has_f16c()) {
+            i = float_to_fp16_f16c(src, dst, count);
+        }
+#endif
+        if (format == Precision::BFloat16) {
+            for (; i < count; ++i) dst[i] = float_to_bf16(src[i]);
+        }
+        else {
+            for (; i < count; ++i) dst[i] = float_to_fp16(src[i]);
+        }
+    }
+
+    void to_float(Precision format, const uint16_t* src, float* dst, size_t count) {
+        check_format(format);
+        size_t i = 0;
+#if SIMD_X86
+        gemm::Isa isa = gemm::active_isa();
+        if (format == Precision::BFloat16) {
+            if (isa != gemm::Isa::Scalar) i = bf16_to_float_avx2(src, dst, count);
+        }
+        else if (isa != gemm::Isa::Scalar && has_f16c()) {
+            i = fp16_to_float_f16c(src, dst, count);
+        }
+#endif
+        if (format == Precision::BFloat16) {
+            for (; i < count; ++i) dst[i] = bf16_to_float(src[i]);
+        }
+        else {
+            for (; i < count; ++i) dst[i] = fp16_to_float(src[i]);
+        }
+    }
+}
+
+void HalfTensor::assign(ConstTensorView src, Precision format) {
+    if (format == Precision::Float32) {
+        throw std::invalid_argument("HalfTensor: 16-bit format expected");
+    }
+    rows_ = src.rows();
+    cols_ = src.cols();
+    format_ = format;
+    data_.resize(rows_ * cols_);
+    if (src.is_contiguous()) {
+        precision::from_float(format, src.data(), data_.data(), rows_ * cols_);
+        return;
+    }
+    for (size_t i = 0; i < rows_; ++i) {
+        precision::from_float(format, src[i], data_.data() + i * cols_, cols_);
+    }
+}
+
+void SavedActivation::store(const Tensor& src, Precision format) {
+    is_half_ = format != Precision::Float32;
+    if (is_half_) {
+        half_.assign(src, format);
+        full_.resize(0, 0);
+    }
+    else {
+        full_ = src;
+        half_.clear();
+    }
+}
+
+void SavedActivation::row_to_float(size_t i, float* dst) const {
+    if (is_half_) {
+        half_.view().row_to_float(i, dst);
+    }
+    else {
+        std::memcpy(dst, full_[i], full_.cols() * sizeof(float));
+    }
+}
+
+Tensor HalfTensor::to_float() const {
+    Tensor result(rows_, cols_);
+    if (!empty()) precision::to_float(format_, data_.data(), result.data(), rows_ * cols_);
+    return result;
+}
\ No newline at end of file
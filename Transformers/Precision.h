@@ -0,0 +1,109 @@
+﻿#pragma once
+#include "Tensor.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Формат хранения весов и сохранённых активаций. Вычисления (накопление в GEMM, градиенты, шаг оптимизатора)
+// всегда идут во float32; bf16 и fp16 только уменьшают объём памяти и трафик
+enum class Precision { Float32, BFloat16, Float16 };
+
+namespace precision {
+    size_t element_size(Precision format);
+    const char* name(Precision format);
+
+    // Скалярные преобразования с округлением к ближайшему чётному; NaN остаётся NaN и становится тихим
+    uint16_t float_to_bf16(float value);
+    float bf16_to_float(uint16_t value);
+    uint16_t float_to_fp16(float value);
+    float fp16_to_float(uint16_t value);
+
+    // Преобразование массивов (format — BFloat16 или Float16). Используются AVX512-BF16 и F16C,
+    // если процессор их поддерживает и gemm::active_isa() это позволяет, иначе AVX2 или скалярный код.
+    // Результат побитово совпадает со скалярными функциями
+    void from_float(Precision format, const float* src, uint16_t* dst, size_t count);
+    void to_float(Precision format, const uint16_t* src, float* dst, size_t count);
+
+    bool has_f16c();
+    bool has_avx512_bf16();
+}
+
+// Невладеющее представление 16-битной матрицы (bf16 или fp16), хранение по строкам
+struct HalfView {
+    const uint16_t* data = nullptr;
+    size_t rows = 0;
+    size_t cols = 0;
+    size_t stride = 0;
+    Precision format = Precision::Float32;
+
+    bool empty() const { return data == nullptr || rows == 0 || cols == 0; }
+    const uint16_t* operator[](size_t i) const { return data + i * stride; }
+    // Строка в float
+    void row_to_float(size_t i, float* dst) const { precision::to_float(format, (*this)[i], dst, cols); }
+};
+
+// Владеющая 16-битная матрица: сохранённые активации в режиме пониженной точности
+class HalfTensor {
+public:
+    void assign(ConstTensorView src, Precision format);
+    void clear() { data_.clear(); rows_ = cols_ = 0; }
+    Tensor to_float() const;
+
+    HalfView view() const { return HalfView{ data_.data(), rows_, cols_, cols_, format_ }; }
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+
+private:
+    std::vector<uint16_t> data_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    Precision format_ = Precision::BFloat16;
+};
+
+// Операнд матричного умножения: float-матрица или 16-битная (элементы преобразуются во float при упаковке панелей GEMM)
+struct MatrixOperand {
+    MatrixOperand(ConstTensorView v) : data(v.data()), rows(v.rows()), cols(v.cols()), stride(v.stride()) {}
+    MatrixOperand(TensorView v) : MatrixOperand(ConstTensorView(v)) {}
+    MatrixOperand(const Tensor& t) : MatrixOperand(t.view()) {}
+    MatrixOperand(const HalfView& h) : data(h.data), rows(h.rows), cols(h.cols), stride(h.stride), format(h.format) {}
+    MatrixOperand(const HalfTensor& h) : MatrixOperand(h.view()) {}
+
+    // Подматрица [row0, row0 + rows) x [col0, col0 + cols) того же формата
+    MatrixOperand block(size_t row0, size_t col0, size_t block_rows, size_t block_cols) const {
+        MatrixOperand result = *this;
+        result.data = static_cast<const char*>(data) + (row0 * stride + col0) * precision::element_size(format);
+        result.rows = block_rows;
+        result.cols = block_cols;
+        return result;
+    }
+
+    const void* data;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    Precision format = Precision::Float32;
+};
+
+// Операнд весов: 16-битная копия, если она есть (режим пониженной точности), иначе сами float-веса
+inline MatrixOperand weight_operand(const Tensor& master, const HalfView& half) {
+    return half.empty() ? MatrixOperand(master) : MatrixOperand(half);
+}
+
+// Активация, сохранённая для обратного прохода: во float или (в режиме пониженной точности) в bf16/fp16
+class SavedActivation {
+public:
+    void store(const Tensor& src, Precision format);
+    bool empty() const { return is_half_ ? half_.empty() : full_.empty(); }
+    size_t rows() const { return is_half_ ? half_.rows() : full_.rows(); }
+    size_t cols() const { return is_half_ ? half_.cols() : full_.cols(); }
+    // Операнд для матричного умножения (без преобразования)
+    MatrixOperand operand() const { return is_half_ ? MatrixOperand(half_) : MatrixOperand(full_); }
+    // Строка i во float
+    void row_to_float(size_t i, float* dst) const;
+
+private:
+    Tensor full_;
+    HalfTensor half_;
+    bool is_half_ = false;
+};
\ No newline at end of file
@@ -0,0 +1,370 @@
+﻿#include "Quantization.h"
+#include "Gemm.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace quant {
+    namespace {
+        constexpr size_t kPanel = 16;    // Столбцов в панели
+        constexpr size_t kGroup = 4;     // Строк K в группе (4 байта входа на столбец — одна инструкция VNNI)
+        constexpr size_t kRowBlock = 4;  // Строк входа, обрабатываемых вместе (веса панели читаются один раз)
+        constexpr int32_t kInputShift = 128;
+
+        bool detect_vnni() {
+#if SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+            int r[4];
+            __cpuid(r, 0);
+            if (r[0] < 7) return false;
+            __cpuidex(r, 7, 0);
+            bool vnni = (r[2] & (1 << 11)) != 0;
+#else
+            __builtin_cpu_init();
+            bool vnni = __builtin_cpu_supports("avx512vnni");
+#endif
+            return vnni && gemm::detected_isa() == gemm::Isa::Avx512;
+#else
+            return false;
+#endif
+        }
+
+        struct KernelArgs {
+            const uint8_t* a;           // rows x lda, вход в uint8 со сдвигом 128
+            size_t lda;                 // k_groups * 4
+            size_t rows;                // Не больше kRowBlock
+            const int8_t* packed;
+            size_t k_groups;
+            size_t panels;
+            size_t cols;
+            const float* output_scales;
+            const int32_t* offsets;
+            const float* bias;
+            float* y;
+            size_t ldy;
+        };
+
+        // Деквантизация 16 сумм панели: y = (acc - offset) * scale (+ bias)
+        inline void store_panel(const KernelArgs& args, size_t row, size_t panel, const int32_t* acc) {
+            size_t n0 = panel * kPanel;
+            size_t count = std::min(kPanel, args.cols - n0);
+            float* y = args.y + row * args.ldy + n0;
+            for (size_t j = 0; j < count; ++j) {
+                float value = static_cast<float>(acc[j] - args.offsets[n0 + j]) * args.output_scales[n0 + j];
+                y[j] = args.bias ? value + args.bias[n0 + j] : value;
+            }
+        }
+
+        void kernel_scalar(const KernelArgs& args) {
+            for (size_t r = 0; r < args.rows; ++r) {
+                const uint8_t* a = args.a + r * args.lda;
+                for (size_t p = 0; p < args.panels; ++p) {
+                    const int8_t* w = args.packed + p * args.k_groups * kPanel * kGroup;
+                    int32_t acc[kPanel] = {};
+                    for (size_t g = 0; g < args.k_groups; ++g) {
+                        const uint8_t* a4 = a + g * kGroup;
+                        const int8_t* w4 = w + g * kPanel * kGroup;
+                        for (size_t j = 0; j < kPanel; ++j) {
+                            for (size_t t = 0; t < kGroup; ++t) {
+                                acc[j] += static_cast<int32_t>(a4[t]) * w4[j * kGroup + t];
+                            }
+                        }
+                    }
+                    store_panel(args, r, p, acc);
+                }
+            }
+        }
+
+#if SIMD_X86
+        // AVX2: байты расширяются до int16 и перемножаются _mm256_madd_epi16 (без насыщения, в отличие от maddubs).
+        // Регистр — 4 столбца по 4 элемента K; пары сумм складываются в конце
+        SIMD_TARGET_AVX2
+        void kernel_avx2(const KernelArgs& args) {
+            for (size_t r = 0; r < args.rows; ++r) {
+                const uint8_t* a = args.a + r * args.lda;
+                for (size_t p = 0; p < args.panels; ++p) {
+                    const int8_t* w = args.packed + p * args.k_groups * kPanel * kGroup;
+                    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+                    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+                    for (size_t g = 0; g < args.k_groups; ++g) {
+                        int32_t a4;
+                        std::memcpy(&a4, a + g * kGroup, sizeof(a4));
+                        __m256i av = _mm256_broadcastq_epi64(_mm_cvtepu8_epi16(_mm_cvtsi32_si128(a4)));
+                        const int8_t* w4 = w + g * kPanel * kGroup;
+                        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(av, _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w4)))));
+                        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(av, _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w4 + 16)))));
+                        acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(av, _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w4 + 32)))));
+                        acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(av, _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w4 + 48)))));
+                    }
+                    // В acc по две частичные суммы на столбец: hadd складывает пары, перестановка восстанавливает порядок
+                    alignas(32) int32_t acc[kPanel];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(acc), _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc0, acc1), 0xD8));
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(acc + 8), _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc2, acc3), 0xD8));
+                    store_panel(args, r, p, acc);
+                }
+            }
+        }
+
+        // AVX512-VNNI: vpdpbusd умножает 4 байта входа (uint8) на 4 веса (int8) каждого из 16 столбцов и накапливает в int32.
+        // Тайл R строк x P панелей: на группу K — R рассылок входа, P загрузок весов и R * P инструкций
+        template <size_t R, size_t P>
+        SIMD_TARGET_AVX512_VNNI
+        inline void vnni_tile(const KernelArgs& args, size_t p0) {
+            const size_t panel_stride = args.k_groups * kPanel * kGroup;
+            const int8_t* w = args.packed + p0 * panel_stride;
+            __m512i acc[R][P];
+            SIMD_UNROLL
+            for (size_t r = 0; r < R; ++r) {
+                SIMD_UNROLL
+                for (size_t p = 0; p < P; ++p) acc[r][p] = _mm512_setzero_si512();
+            }
+            for (size_t g = 0; g < args.k_groups; ++g) {
+                __m512i wv[P];
+                SIMD_UNROLL
+                for (size_t p = 0; p < P; ++p) wv[p] = _mm512_loadu_si512(w + p * panel_stride + g * kPanel * kGroup);
+                SIMD_UNROLL
+                for (size_t r = 0; r < R; ++r) {
+                    int32_t a4;
+                    std::memcpy(&a4, args.a + r * args.lda + g * kGroup, sizeof(a4));
+                    __m512i av = _mm512_set1_epi32(a4);
+                    SIMD_UNROLL
+                    for (size_t p = 0; p < P; ++p) acc[r][p] = _mm512_dpbusd_epi32(acc[r][p], av, wv[p]);
+                }
+            }
+            for (size_t p = 0; p < P; ++p) {
+                size_t n0 = (p0 + p) * kPanel;
+                if (n0 + kPanel > args.cols) {
+                    // Неполная последняя панель
+                    for (size_t r = 0; r < R; ++r) {
+                        alignas(64) int32_t sums[kPanel];
+                        _mm512_store_si512(sums, acc[r][p]);
+                        store_panel(args, r, p0 + p, sums);
+                    }
+                    continue;
+                }
+                __m512i offset = _mm512_loadu_si512(args.offsets + n0);
+                __m512 scale = _mm512_loadu_ps(args.output_scales + n0);
+                __m512 bias = args.bias ? _mm512_loadu_ps(args.bias + n0) : _mm512_setzero_ps();
+                for (size_t r = 0; r < R; ++r) {
+                    __m512 value = _mm512_cvtepi32_ps(_mm512_sub_epi32(acc[r][p], offset));
+                    _mm512_storeu_ps(args.y + r * args.ldy + n0, _mm512_fmadd_ps(value, scale, bias));
+                }
+            }
+        }
+
+        template <size_t R>
+        SIMD_TARGET_AVX512_VNNI
+        void vnni_rows(const KernelArgs& args) {
+            size_t p = 0;
+            for (; p + 4 <= args.panels; p += 4) vnni_tile<R, 4>(args, p);
+            for (; p < args.panels; ++p) vnni_tile<R, 1>(args, p);
+        }
+
+        void kernel_vnni(const KernelArgs& args) {
+            switch (args.rows) {
+            case 1: vnni_rows<1>(args); break;
+            case 2: vnni_rows<2>(args); break;
+            case 3: vnni_rows<3>(args); break;
+            default: vnni_rows<4>(args); break;
+            }
+        }
+#endif
+
+        using KernelFn = void (*)(const KernelArgs&);
+
+        KernelFn select_kernel() {
+#if SIMD_X86
+            gemm::Isa isa = gemm::active_isa();
+            if (isa == gemm::Isa::Avx512 && has_avx512_vnni()) return kernel_vnni;
+            if (isa != gemm::Isa::Scalar) return kernel_avx2;
+#endif
+            return kernel_scalar;
+        }
+
+        inline int8_t quantize_value(float value, float inv_scale) {
+            float q = std::nearbyint(value * inv_scale);
+            q = std::min(127.0f, std::max(-127.0f, q));
+            return static_cast<int8_t>(q);
+        }
+    }
+
+    bool has_avx512_vnni() {
+        static const bool vnni = detect_vnni();
+        return vnni;
+    }
+}
+
+void RangeObserver::observe(ConstTensorView X) {
+    float max_abs = max_abs_;
+    for (size_t i = 0; i < X.rows(); ++i) {
+        const float* row = X[i];
+        for (size_t j = 0; j < X.cols(); ++j) {
+            max_abs = std::max(max_abs, std::fabs(row[j]));
+        }
+    }
+    max_abs_ = max_abs;
+}
+
+void QuantizedMatrix::quantize(ConstTensorView W, float input_max_abs) {
+    rows_ = W.rows();
+    cols_ = W.cols();
+    input_scale_ = input_max_abs > 0.0f ? input_max_abs / 127.0f : 1.0f;
+    scales_.assign(cols_, 1.0f);
+    std::vector<int8_t> q(cols_ * rows_);
+    for (size_t n = 0; n < cols_; ++n) {
+        float max_abs = 0.0f;
+        for (size_t k = 0; k < rows_; ++k) {
+            max_abs = std::max(max_abs, std::fabs(W[k][n]));
+        }
+        if (max_abs > 0.0f) scales_[n] = max_abs / 127.0f;
+        float inv_scale = 1.0f / scales_[n];
+        for (size_t k = 0; k < rows_; ++k) {
+            q[n * rows_ + k] = quant::quantize_value(W[k][n], inv_scale);
+        }
+    }
+    pack(q);
+}
+
+void QuantizedMatrix::pack(const std::vector<int8_t>& q) {
+    using namespace quant;
+    k_groups_ = (rows_ + kGroup - 1) / kGroup;
+    panels_ = (cols_ + kPanel - 1) / kPanel;
+    packed_.assign(panels_ * k_groups_ * kPanel * kGroup, 0);
+    offsets_.assign(cols_, 0);
+    output_scales_.resize(cols_);
+    for (size_t n = 0; n < cols_; ++n) {
+        int8_t* panel = packed_.data() + (n / kPanel) * k_groups_ * kPanel * kGroup;
+        size_t j = n % kPanel;
+        int32_t sum = 0;
+        for (size_t k = 0; k < rows_; ++k) {
+            int8_t value = q[n * rows_ + k];
+            panel[(k / kGroup) * kPanel * kGroup + j * kGroup + k % kGroup] = value;
+            sum += value;
+        }
+        offsets_[n] = kInputShift * sum;
+        output_scales_[n] = input_scale_ * scales_[n];
+    }
+}
+
+std::vector<int8_t> QuantizedMatrix::unpack() const {
+    using namespace quant;
+    std::vector<int8_t> q(cols_ * rows_);
+    for (size_t n = 0; n < cols_; ++n) {
+        const int8_t* panel = packed_.data() + (n / kPanel) * k_groups_ * kPanel * kGroup;
+        size_t j = n % kPanel;
+        for (size_t k = 0; k < rows_; ++k) {
+            q[n * rows_ + k] = panel[(k / kGroup) * kPanel * kGroup + j * kGroup + k % kGroup];
+        }
+    }
+    return q;
+}
+
+Tensor QuantizedMatrix::multiply(ConstTensorView X, const float* bias) const {
+    using namespace quant;
+    if (empty() || X.cols() != rows_) {
+        throw std::invalid_argument("QuantizedMatrix: размер входа не совпадает с весами");
+    }
+    const size_t M = X.rows();
+    Tensor Y(M, cols_);
+    if (M == 0) return Y;
+
+    const KernelFn kernel = select_kernel();
+    const size_t lda = k_groups_ * kGroup;
+    const float inv_scale = 1.0f / input_scale_;
+    ThreadPool::instance().parallel_for(0, M, ThreadPool::grain_size(M, rows_ * cols_), [&](size_t first, size_t last) {
+        // Строки входа квантуются в uint8 со сдвигом 128 (хвост до группы — нули)
+        std::vector<uint8_t> a(kRowBlock * lda, static_cast<uint8_t>(kInputShift));
+        for (size_t i0 = first; i0 < last; i0 += kRowBlock) {
+            size_t rows = std::min(kRowBlock, last - i0);
+            for (size_t r = 0; r < rows; ++r) {
+                const float* x = X[i0 + r];
+                uint8_t* dst = a.data() + r * lda;
+                for (size_t k = 0; k < rows_; ++k) {
+                    dst[k] = static_cast<uint8_t>(quantize_value(x[k], inv_scale) + kInputShift);
+                }
+            }
+            KernelArgs args{ a.data(), lda, rows, packed_.data(), k_groups_, panels_, cols_,
+                output_scales_.data(), offsets_.data(), bias, Y[i0], Y.cols() };
+            kernel(args);
+        }
+    });
+    return Y;
+}
+
+Tensor QuantizedMatrix::dequantize() const {
+    std::vector<int8_t> q = unpack();
+    Tensor W(rows_, cols_);
+    for (size_t k = 0; k < rows_; ++k) {
+        for (size_t n = 0; n < cols_; ++n) {
+            W[k][n] = q[n * rows_ + k] * scales_[n];
+        }
+    }
+    return W;
+}
+
+void QuantizedMatrix::save(std::ofstream& out) const {
+    int rows = static_cast<int>(rows_);
+    int cols = static_cast<int>(cols_);
+    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    out.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+    out.write(reinterpret_cast<const char*>(&input_scale_), sizeof(input_scale_));
+    utils::write_vector(out, scales_);
+    std::vector<int8_t> q = unpack();
+    out.write(reinterpret_cast<const char*>(q.data()), q.size());
+}
+
+void QuantizedMatrix::load(std::ifstream& in) {
+    int rows = 0, cols = 0;
+    in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+    in.read(reinterpret_cast<char*>(&input_scale_), sizeof(input_scale_));
+    if (!in || rows <= 0 || cols <= 0 || !(input_scale_ > 0.0f)) {
+        throw std::runtime_error("QuantizedMatrix: повреждённый заголовок матрицы");
+    }
+    rows_ = static_cast<size_t>(rows);
+    cols_ = static_cast<size_t>(cols);
+    utils::read_vector(in, scales_);
+    std::vector<int8_t> q(rows_ * cols_);
+    in.read(reinterpret_cast<char*>(q.data()), q.size());
+    if (!in || scales_.size() != cols_) {
+        throw std::runtime_error("QuantizedMatrix: файл обрезан или масштабы не совпадают по размеру");
+    }
+    pack(q);
+}
+
+Tensor Int8Weight::multiply(const Tensor& X, const MatrixOperand& weights, const float* bias) const {
+    if (calibrating) {
+        input_range.observe(X);
+    }
+    if (!matrix.empty()) {
+        return matrix.multiply(X, bias);
+    }
+    Tensor Y = utils::matrix_multiply(X, weights);
+    if (bias) {
+        for (size_t i = 0; i < Y.rows(); ++i) {
+            float* row = Y[i];
+            for (size_t j = 0; j < Y.cols(); ++j) {
+                row[j] += bias[j];
+            }
+        }
+    }
+    return Y;
+}
+
+void Int8Weight::set_calibration(bool enabled) {
+    if (enabled && !calibrating) {
+        input_range.reset();
+    }
+    calibrating = enabled;
+}
+
+void Int8Weight::quantize(ConstTensorView W) {
+    if (input_range.max_abs() <= 0.0f) {
+        throw std::runtime_error("Int8Weight: нет данных калибровки для квантования");
+    }
+    matrix.quantize(W, input_range.max_abs());
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "Tensor.h"
+#include "Precision.h"
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Post-training квантование в int8 для инференса: веса — симметрично с масштабом на выходной канал (столбец),
+// вход — симметрично со статическим масштабом, найденным при калибровке. Умножение int8 x int8 -> int32
+// (AVX512-VNNI, AVX2 или скалярно; целочисленные суммы точные и совпадают) с деквантизацией в том же проходе
+namespace quant {
+    bool has_avx512_vnni();
+}
+
+// Наблюдатель диапазона входа матричного умножения (калибровка): максимум |x|
+class RangeObserver {
+public:
+    void observe(ConstTensorView X);
+    void reset() { max_abs_ = 0.0f; }
+    float max_abs() const { return max_abs_; }
+
+private:
+    float max_abs_ = 0.0f;
+};
+
+// Матрица весов K x N в int8. Хранится панелями по 16 столбцов, внутри панели — группами по 4 строки
+// ([панель][K/4][16][4]): так AVX512-VNNI за одну инструкцию считает 16 столбцов
+class QuantizedMatrix {
+public:
+    // W — float-веса (K x N), input_max_abs — максимум |x| входа по калибровке
+    void quantize(ConstTensorView W, float input_max_abs);
+    // X (M x K) -> X * W + bias (M x N). Вход квантуется масштабом калибровки (с насыщением),
+    // bias (N элементов) может быть nullptr
+    Tensor multiply(ConstTensorView X, const float* bias = nullptr) const;
+    // Float-веса, восстановленные из int8 (для проверки точности)
+    Tensor dequantize() const;
+
+    // Формат: rows, cols (int), масштаб входа (float), масштабы столбцов (как write_vector), int8 по столбцам (N x K)
+    void save(std::ofstream& out) const;
+    void load(std::ifstream& in);
+
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+
+private:
+    // Раскладывает веса q (N x K, по столбцам W) в панели и считает поправки
+    void pack(const std::vector<int8_t>& q);
+    std::vector<int8_t> unpack() const;
+
+    size_t rows_ = 0;                  // K
+    size_t cols_ = 0;                  // N
+    size_t k_groups_ = 0;              // ceil(K / 4)
+    size_t panels_ = 0;                // ceil(N / 16)
+    float input_scale_ = 1.0f;
+    std::vector<float> scales_;        // Масштаб столбца
+    std::vector<float> output_scales_; // input_scale_ * scales_[n]
+    std::vector<int32_t> offsets_;     // 128 * сумма весов столбца: вход хранится в uint8 со сдвигом 128
+    std::vector<int8_t> packed_;
+};
+
+// Квантуемая матрица весов модуля: int8-копия и наблюдатель диапазона её входа
+struct Int8Weight {
+    QuantizedMatrix matrix;
+    mutable RangeObserver input_range;
+    bool calibrating = false;
+
+    // X * W (+ bias): через int8, если матрица квантована, иначе через weights (float или bf16/fp16).
+    // При калибровке записывает диапазон X
+    Tensor multiply(const Tensor& X, const MatrixOperand& weights, const float* bias = nullptr) const;
+    void set_calibration(bool enabled);
+    // Квантует W по собранному диапазону; без калибровки — исключение
+    void quantize(ConstTensorView W);
+};
\ No newline at end of file
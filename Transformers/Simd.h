@@ -0,0 +1,35 @@
+﻿#pragma once
+
+// Общие макросы для SIMD-ядер (GEMM, оптимизатор): наличие x86-интринсиков и атрибуты target.
+// Нужный набор инструкций выбирается во время выполнения (см. gemm::active_isa)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+// Полная развёртка циклов с постоянными границами (аккумуляторы-массивы тогда живут в регистрах)
+#if defined(__GNUC__)
+#define SIMD_UNROLL _Pragma("GCC unroll 16")
+#else
+#define SIMD_UNROLL
+#endif
+
+// MSVC разрешает интринсики AVX без ключей компиляции; GCC/Clang требуют атрибут target на функции
+#if SIMD_X86 && !(defined(_MSC_VER) && !defined(__clang__))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#define SIMD_TARGET_F16C __attribute__((target("avx2,fma,f16c")))
+#define SIMD_TARGET_AVX512_BF16 __attribute__((target("avx512f,avx512bf16")))
+#define SIMD_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512vnni")))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#define SIMD_TARGET_F16C
+#define SIMD_TARGET_AVX512_BF16
+#define SIMD_TARGET_AVX512_VNNI
+#endif
\ No newline at end of file
@@ -1,11 +1,12 @@
 #include "Softmax.h"
-#include <algorithm> //  std::max_element
-#include <cmath>     //  std::exp
+#include "ThreadPool.h"
+#include <algorithm> // Для std::max_element
+#include <cmath>     // Для std::exp
 #include <stdexcept>
 #include <iostream>
 
 Softmax::Softmax() {
-    //   probabilities_ ,   
+    // По умолчанию probabilities_ пустой, ничего не делаем
 }
 
 void Softmax::check_forward_executed() const {
@@ -14,50 +15,53 @@ void Softmax::check_forward_executed() const {
     }
 }
 
-void Softmax::check_dimensions(const std::vector<std::vector<float>>& other, const std::string& name) const {
+void Softmax::check_dimensions(ConstTensorView other, const std::string& name) const {
     check_forward_executed();
-    if (other.size() != rows_ || other[0].size() != cols_) {
+    if (other.rows() != rows_ || other.cols() != cols_) {
         throw std::invalid_argument(name + " dimensions do not match probabilities");
     }
 }
 
-//  
-std::vector<std::vector<float>> Softmax::forward_softmax(const std::vector<std::vector<float>>& logits) {
+// Прямой проход
+const Tensor& Softmax::forward_softmax(ConstTensorView logits) {
     if (logits.empty()) {
         throw std::invalid_argument("Logits cannot be empty");
     }
 
-    rows_ = logits.size();
-    cols_ = logits[0].size();
+    rows_ = logits.rows();
+    cols_ = logits.cols();
 
-    probabilities_.clear();
-    probabilities_.resize(rows_, std::vector<float>(cols_));
+    probabilities_.resize(rows_, cols_);
 
-    for (size_t i = 0; i < rows_; ++i) {
-        float max_val = *std::max_element(logits[i].begin(), logits[i].end());
-        float sum_exp = 0.0f;
-        for (size_t j = 0; j < cols_; ++j) {
-            probabilities_[i][j] = std::exp(logits[i][j] - max_val);
-            sum_exp += probabilities_[i][j];
-        }
-        for (size_t j = 0; j < cols_; ++j) {
-            probabilities_[i][j] /= sum_exp;
+    // Строки независимы и делятся между потоками
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallel_for(0, rows_, ThreadPool::grain_size(rows_, 16 * cols_), [&](size_t row_begin, size_t row_end) {
+        for (size_t i = row_begin; i < row_end; ++i) {
+            float max_val = *std::max_element(logits[i], logits[i] + cols_);
+            float sum_exp = 0.0f;
+            for (size_t j = 0; j < cols_; ++j) {
+                probabilities_[i][j] = std::exp(logits[i][j] - max_val);
+                sum_exp += probabilities_[i][j];
+            }
+            for (size_t j = 0; j < cols_; ++j) {
+                probabilities_[i][j] /= sum_exp;
+            }
         }
-    }
+    });
     return probabilities_;
 }
 
-//     
-std::vector<std::vector<float>> Softmax::compute_grad_output_model(const std::vector<std::vector<float>>& target_one_hot) {
+// Расчет градиента по выходу модели
+Tensor Softmax::compute_grad_output_model(ConstTensorView target_one_hot) {
     check_forward_executed();
     check_dimensions(target_one_hot, "target_one_hot");
 
-    std::vector<std::vector<float>> d_p(rows_, std::vector<float>(cols_, 0.0f));
-    const float epsilon = 1e-8; //     
+    Tensor d_p(rows_, cols_, 0.0f);
+    const float epsilon = 1e-8; // Для предотвращения деления на ноль
 
     for (size_t i = 0; i < rows_; ++i) {
         for (size_t j = 0; j < cols_; ++j) {
-            if (target_one_hot[i][j] != 0.0f) { //    
+            if (target_one_hot[i][j] != 0.0f) { // Учитываем только ненулевые элементы
                 d_p[i][j] = -target_one_hot[i][j] / (probabilities_[i][j] + epsilon);
             }
         }
@@ -66,12 +70,53 @@ std::vector<std::vector<float>> Softmax::compute_grad_output_model(const std::ve
     return d_p;
 }
 
-//  
-std::vector<std::vector<float>> Softmax::backward_softmax(const std::vector<std::vector<float>>& probabilities, const std::vector<std::vector<float>>& d_p) {
+// Градиент cross-entropy по логитам для целочисленных меток: сразу (p - y), без one-hot и деления на p
+Tensor Softmax::backward_cross_entropy(const std::vector<int>& labels, float scale) const {
+    check_forward_executed();
+    if (labels.size() != rows_) {
+        throw std::invalid_argument("labels size does not match probabilities");
+    }
+
+    Tensor grad_logits(rows_, cols_, 0.0f);
+    for (size_t i = 0; i < rows_; ++i) {
+        int label = labels[i];
+        if (label < 0) {
+            continue;
+        }
+        if (label >= static_cast<int>(cols_)) {
+            throw std::out_of_range("label is out of vocabulary range");
+        }
+        for (size_t j = 0; j < cols_; ++j) {
+            grad_logits[i][j] = probabilities_[i][j] * scale;
+        }
+        grad_logits[i][label] -= scale;
+    }
+    return grad_logits;
+}
+
+// Градиент cross-entropy по логитам для целевых распределений: backward_softmax(p, -y / p) в замкнутом виде
+Tensor Softmax::backward_cross_entropy(ConstTensorView targets) const {
+    check_dimensions(targets, "targets");
+
+    Tensor grad_logits(rows_, cols_);
+    for (size_t i = 0; i < rows_; ++i) {
+        float target_sum = 0.0f;
+        for (size_t j = 0; j < cols_; ++j) {
+            target_sum += targets[i][j];
+        }
+        for (size_t j = 0; j < cols_; ++j) {
+            grad_logits[i][j] = probabilities_[i][j] * target_sum - targets[i][j];
+        }
+    }
+    return grad_logits;
+}
+
+// Обратный проход
+Tensor Softmax::backward_softmax(ConstTensorView probabilities, ConstTensorView d_p) {
     check_forward_executed();
     check_dimensions(d_p, "d_p");
 
-    std::vector<std::vector<float>> grad_logits(rows_, std::vector<float>(cols_, 0.0f));
+    Tensor grad_logits(rows_, cols_);
 
     for (size_t i = 0; i < rows_; ++i) {
         float sum_p_d_p = 0.0f;
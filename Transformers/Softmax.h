@@ -1,18 +1,22 @@
 #pragma once
+#include "Tensor.h"
 #include <vector>
 #include <string>
 
 class Softmax {
 public:
-    Softmax(); // 
-    std::vector<std::vector<float>> forward_softmax(const std::vector<std::vector<float>>& logits); //  :  
-    std::vector<std::vector<float>> backward_softmax(const std::vector<std::vector<float>>& probabilities, const std::vector<std::vector<float>>& d_p); //  :    
-    std::vector<std::vector<float>> compute_grad_output_model(const std::vector<std::vector<float>>& target_one_hot); //          softmax (  )
+    Softmax(); // Конструктор
+    const Tensor& forward_softmax(ConstTensorView logits); // Прямой проход: вычисляет вероятности
+    Tensor backward_softmax(ConstTensorView probabilities, ConstTensorView d_p); // Обратный проход: вычисляет градиент по логитам
+    Tensor compute_grad_output_model(ConstTensorView target_one_hot); //Вычисление градиента по выходу модели для расчета градиента по входу softmax (на выходе модели)
+    Tensor backward_cross_entropy(const std::vector<int>& labels, float scale) const; // Градиент cross-entropy по логитам: (p - y) * scale; метка < 0 — строка заполнения, градиент нулевой
+    Tensor backward_cross_entropy(ConstTensorView targets) const; // То же для целевых распределений (one-hot): p * sum(y) - y, без деления на p
+    const Tensor& probabilities() const { return probabilities_; } // Результат последнего forward_softmax
     
 private:
-    std::vector<std::vector<float>> probabilities_; //    backward
-    size_t rows_ = 0; //   
-    size_t cols_ = 0; //   
+    Tensor probabilities_; // Сохранение вероятностей для backward
+    size_t rows_ = 0; // Храним количество строк
+    size_t cols_ = 0; // Храним количество столбцов
     void check_forward_executed() const;
-    void check_dimensions(const std::vector<std::vector<float>>& other, const std::string& name) const;
+    void check_dimensions(ConstTensorView other, const std::string& name) const;
 };
\ No newline at end of file
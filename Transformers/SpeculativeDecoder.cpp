@@ -0,0 +1,96 @@
+﻿#include "SpeculativeDecoder.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    std::unique_ptr<Transformer> load_draft(const std::string& path) {
+        auto draft = std::make_unique<Transformer>(model_file::read_config(path));
+        draft->load_weights(path);
+        return draft;
+    }
+}
+
+SpeculativeDecoder::SpeculativeDecoder(Transformer& model, const std::string& draft_path, const SpeculativeConfig& config)
+    : SpeculativeDecoder(model, load_draft(draft_path), config) {
+}
+
+SpeculativeDecoder::SpeculativeDecoder(Transformer& model, std::unique_ptr<Transformer> draft, const SpeculativeConfig& config)
+    : model_(model), draft_(std::move(draft)), config_(config) {
+    if (!draft_) {
+        throw std::invalid_argument("Модель-черновик не задана");
+    }
+    if (config.draft_tokens <= 0 || config.max_length <= 0) {
+        throw std::invalid_argument("draft_tokens и max_length должны быть положительными");
+    }
+    if (draft_->config().vocab_size != model_.config().vocab_size) {
+        throw std::invalid_argument("Словари модели-черновика и основной модели не совпадают");
+    }
+}
+
+std::vector<int> SpeculativeDecoder::generate(const std::vector<int>& source_tokens, const std::vector<int>& prefix, int eos_id) {
+    if (prefix.empty()) {
+        throw std::invalid_argument("Префикс спекулятивного декодирования не может быть пустым");
+    }
+    EncoderMemory memory = model_.encode(source_tokens);
+    EncoderMemory draft_memory = draft_->encode(source_tokens);
+    model_.reset_decode_cache();
+    draft_->reset_decode_cache();
+
+    // Токены, уже известные, но ещё не прошедшие через декодер модели (последний из них — вход следующего шага)
+    std::vector<int> pending = prefix;
+    std::vector<int> draft_pending = prefix;
+    std::vector<int> generated;
+
+    while (static_cast<int>(generated.size()) < config_.max_length) {
+        // Черновик: k токенов жадно, но не дальше max_length (основная модель добавит ещё один) и не после EOS
+        int k = std::min(config_.draft_tokens, config_.max_length - static_cast<int>(generated.size()) - 1);
+        const int draft_base = draft_->decode_length();
+        std::vector<int> drafts;
+        if (k > 0) {
+            drafts.push_back(draft_->decode_steps_greedy(draft_pending, draft_memory).back());
+            while (static_cast<int>(drafts.size()) < k && drafts.back() != eos_id) {
+                drafts.push_back(draft_->decode_step_greedy(drafts.back(), draft_memory));
+            }
+        }
+
+        // Проверка: один проход основной модели по pending + черновик. verified[i] — argmax основной модели
+        // после pending и первых i токенов черновика
+        const int model_base = model_.decode_length();
+        std::vector<int> input = pending;
+        input.insert(input.end(), drafts.begin(), drafts.end());
+        std::vector<int> predictions = model_.decode_steps_greedy(input, memory);
+        std::vector<int> verified(predictions.end() - drafts.size() - 1, predictions.end());
+
+        size_t accepted = 0;
+        while (accepted < drafts.size() && drafts[accepted] == verified[accepted]) {
+            ++accepted;
+        }
+        ++stats_.rounds;
+        stats_.drafted += drafts.size();
+        stats_.accepted += accepted;
+
+        // Принятые токены черновика и токен основной модели (после EOS ничего не добавляется)
+        std::vector<int> new_tokens(drafts.begin(), drafts.begin() + accepted);
+        bool finished = accepted > 0 && new_tokens.back() == eos_id;
+        if (!finished) {
+            new_tokens.push_back(verified[accepted]);
+            finished = new_tokens.back() == eos_id;
+        }
+        generated.insert(generated.end(), new_tokens.begin(), new_tokens.end());
+        stats_.generated += new_tokens.size();
+        if (finished) break;
+
+        // Откат кэшей: в основной модели остаются pending и принятые токены
+        model_.truncate_decode_cache(model_base + static_cast<int>(pending.size() + accepted));
+        pending = { new_tokens.back() };
+        if (drafts.empty()) {
+            draft_pending.insert(draft_pending.end(), new_tokens.begin(), new_tokens.end());
+            continue;
+        }
+        // Черновик пропустил через декодер draft_pending и все свои токены, кроме последнего: из них остаются принятые
+        size_t draft_fed = std::min(accepted, drafts.size() - 1);
+        draft_->truncate_decode_cache(draft_base + static_cast<int>(draft_pending.size() + draft_fed));
+        draft_pending.assign(new_tokens.begin() + draft_fed, new_tokens.end());
+    }
+    return generated;
+}
\ No newline at end of file
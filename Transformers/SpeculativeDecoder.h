@@ -0,0 +1,46 @@
+﻿#pragma once
+#include "Transformer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct SpeculativeConfig {
+    int draft_tokens = 4;    // k — токенов черновика на один проход основной модели
+    int max_length = 200;    // Число порождаемых токенов (без префикса)
+};
+
+// Статистика принятия черновиков (накапливается по вызовам generate)
+struct SpeculativeStats {
+    size_t rounds = 0;       // Проходов основной модели
+    size_t drafted = 0;      // Предложено токенов черновика
+    size_t accepted = 0;     // Из них принято
+    size_t generated = 0;    // Порождено токенов всего (принятые + по одному от основной модели за проход)
+
+    double acceptance_rate() const { return drafted ? static_cast<double>(accepted) / drafted : 0.0; }
+    double tokens_per_pass() const { return rounds ? static_cast<double>(generated) / rounds : 0.0; }
+};
+
+// Спекулятивное жадное декодирование: малая модель-черновик (меньше слоёв или embedding_dim, тот же словарь)
+// предлагает k токенов, основная модель проверяет их все одним проходом декодера по k + 1 позициям.
+// Принимается самый длинный префикс черновика, совпадающий с argmax основной модели, и к нему добавляется
+// токен основной модели на первой позиции расхождения (или следующий после всех k). Результат совпадает
+// с жадным выводом основной модели, отклонённые позиции откатываются в кэшах K/V обеих моделей
+class SpeculativeDecoder {
+public:
+    // Черновик загружается из файла модели (архитектура берётся из заголовка)
+    SpeculativeDecoder(Transformer& model, const std::string& draft_path, const SpeculativeConfig& config = SpeculativeConfig());
+    SpeculativeDecoder(Transformer& model, std::unique_ptr<Transformer> draft, const SpeculativeConfig& config = SpeculativeConfig());
+
+    // Порождённые токены после prefix (обычно { <BOS> }); EOS включается, если порождён
+    std::vector<int> generate(const std::vector<int>& source_tokens, const std::vector<int>& prefix, int eos_id);
+
+    const SpeculativeStats& stats() const { return stats_; }
+    void reset_stats() { stats_ = SpeculativeStats(); }
+    Transformer& draft() { return *draft_; }
+
+private:
+    Transformer& model_;
+    std::unique_ptr<Transformer> draft_;
+    SpeculativeConfig config_;
+    SpeculativeStats stats_;
+};
\ No newline at end of file
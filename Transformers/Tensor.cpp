@@ -0,0 +1,168 @@
+﻿#include "Tensor.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+
+Tensor::Tensor(size_t rows, size_t cols, float value) {
+    assign(rows, cols, value);
+}
+
+Tensor::Tensor(ConstTensorView src) {
+    assign(src);
+}
+
+Tensor::Tensor(const Tensor& other) {
+    assign(other.view());
+}
+
+Tensor::Tensor(Tensor&& other) noexcept
+    : data_(other.data_), rows_(other.rows_), cols_(other.cols_), capacity_(other.capacity_), owns_(other.owns_) {
+    other.data_ = nullptr;
+    other.rows_ = other.cols_ = other.capacity_ = 0;
+    other.owns_ = true;
+}
+
+Tensor& Tensor::operator=(const Tensor& other) {
+    if (this != &other) {
+        assign(other.view());
+    }
+    return *this;
+}
+
+Tensor& Tensor::operator=(Tensor&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = other.data_;
+        rows_ = other.rows_;
+        cols_ = other.cols_;
+        capacity_ = other.capacity_;
+        owns_ = other.owns_;
+        other.data_ = nullptr;
+        other.rows_ = other.cols_ = other.capacity_ = 0;
+        other.owns_ = true;
+    }
+    return *this;
+}
+
+Tensor::~Tensor() {
+    release();
+}
+
+void Tensor::reserve(size_t count) {
+    if (count <= capacity_) {
+        return;
+    }
+    release();
+    // Округляем до целой кэш-линии, чтобы SIMD-ядра могли безопасно читать хвост
+    size_t bytes = (count * sizeof(float) + kAlignment - 1) / kAlignment * kAlignment;
+    data_ = static_cast<float*>(::operator new(bytes, std::align_val_t(kAlignment)));
+    capacity_ = bytes / sizeof(float);
+    owns_ = true;
+}
+
+void Tensor::release() {
+    if (data_ && owns_) {
+        ::operator delete(data_, std::align_val_t(kAlignment));
+    }
+    data_ = nullptr;
+    capacity_ = 0;
+    owns_ = true;
+}
+
+void Tensor::attach_storage(float* storage) {
+    if (storage == data_) {
+        return;
+    }
+    if (!empty()) std::memcpy(storage, data_, size() * sizeof(float));
+    release();
+    data_ = storage;
+    capacity_ = size();
+    owns_ = false;
+}
+
+void Tensor::wrap_storage(float* storage, size_t rows, size_t cols) {
+    release();
+    data_ = storage;
+    rows_ = rows;
+    cols_ = cols;
+    capacity_ = rows * cols;
+    owns_ = false;
+}
+
+void Tensor::resize(size_t rows, size_t cols) {
+    reserve(rows * cols);
+    rows_ = rows;
+    cols_ = cols;
+}
+
+void Tensor::assign(size_t rows, size_t cols, float value) {
+    resize(rows, cols);
+    fill(value);
+}
+
+void Tensor::assign(ConstTensorView src) {
+    // Представление памяти самого тензора (например, его подматрица): resize меняет шаг строк до копирования,
+    // поэтому такое представление сначала копируется во временный тензор
+    if (overlaps(src)) {
+        Tensor copy(src.rows(), src.cols());
+        for (size_t i = 0; i < src.rows(); ++i) {
+            std::memcpy(copy[i], src[i], src.cols() * sizeof(float));
+        }
+        assign(copy.view());
+        return;
+    }
+    resize(src.rows(), src.cols());
+    if (src.is_contiguous()) {
+        if (!empty()) std::memcpy(data_, src.data(), size() * sizeof(float));
+        return;
+    }
+    for (size_t i = 0; i < rows_; ++i) {
+        std::memcpy((*this)[i], src[i], cols_ * sizeof(float));
+    }
+}
+
+bool Tensor::overlaps(ConstTensorView src) const {
+    if (src.empty() || !data_ || capacity_ == 0) {
+        return false;
+    }
+    const float* src_begin = src.data();
+    const float* src_end = src[src.rows() - 1] + src.cols();
+    std::less<const float*> less;
+    return less(src_begin, data_ + capacity_) && less(data_, src_end);
+}
+
+void Tensor::append_rows(ConstTensorView src) {
+    if (empty()) {
+        assign(src);
+        return;
+    }
+    if (src.cols() != cols_) {
+        throw std::invalid_argument("append_rows: column count mismatch");
+    }
+    // Строки самого тензора: рост памяти освободил бы их до копирования
+    if (overlaps(src)) {
+        Tensor copy(src);
+        append_rows(copy.view());
+        return;
+    }
+    size_t old_rows = rows_;
+    size_t needed = (rows_ + src.rows()) * cols_;
+    if (needed > capacity_) {
+        Tensor grown;
+        grown.reserve(std::max(needed, 2 * capacity_));
+        std::memcpy(grown.data_, data_, size() * sizeof(float));
+        std::swap(data_, grown.data_);
+        std::swap(capacity_, grown.capacity_);
+        std::swap(owns_, grown.owns_);
+    }
+    rows_ += src.rows();
+    for (size_t i = 0; i < src.rows(); ++i) {
+        std::memcpy((*this)[old_rows + i], src[i], cols_ * sizeof(float));
+    }
+}
+
+void Tensor::fill(float value) {
+    std::fill(data_, data_ + size(), value);
+}
\ No newline at end of file
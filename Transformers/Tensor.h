@@ -0,0 +1,107 @@
+﻿#pragma once
+#include <cstddef>
+#include <type_traits>
+
+// Невладеющее представление двумерного блока памяти (row-major) с шагом строки.
+// Позволяет брать подматрицы (например, отдельные головы внимания) без копирования.
+template <typename T>
+class BasicTensorView {
+public:
+    BasicTensorView() = default;
+    BasicTensorView(T* data, size_t rows, size_t cols, size_t stride)
+        : data_(data), rows_(rows), cols_(cols), stride_(stride) {}
+
+    // Неявное преобразование TensorView -> ConstTensorView
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    BasicTensorView(const BasicTensorView<U>& other)
+        : data_(other.data()), rows_(other.rows()), cols_(other.cols()), stride_(other.stride()) {}
+
+    T* operator[](size_t i) const { return data_ + i * stride_; }
+    T* data() const { return data_; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t stride() const { return stride_; }
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    bool is_contiguous() const { return stride_ == cols_; }
+
+    // Подматрица [row0, row0 + rows) x [col0, col0 + cols)
+    BasicTensorView block(size_t row0, size_t col0, size_t rows, size_t cols) const {
+        return BasicTensorView(data_ + row0 * stride_ + col0, rows, cols, stride_);
+    }
+    BasicTensorView row_range(size_t row0, size_t rows) const { return block(row0, 0, rows, cols_); }
+
+private:
+    T* data_ = nullptr;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    size_t stride_ = 0;
+};
+
+using TensorView = BasicTensorView<float>;
+using ConstTensorView = BasicTensorView<const float>;
+
+// Владеющая матрица float: одна непрерывная выровненная (64 байта) аллокация, хранение по строкам.
+// Индексация M[i][j] сохранена: operator[] возвращает указатель на строку.
+class Tensor {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    Tensor() = default;
+    Tensor(size_t rows, size_t cols, float value = 0.0f);
+    explicit Tensor(ConstTensorView src);
+    Tensor(const Tensor& other);
+    Tensor(Tensor&& other) noexcept;
+    Tensor& operator=(const Tensor& other);
+    Tensor& operator=(Tensor&& other) noexcept;
+    ~Tensor();
+
+    // Меняет форму; память переиспользуется, если её хватает. Содержимое не инициализируется
+    void resize(size_t rows, size_t cols);
+    // Меняет форму и заполняет значением
+    void assign(size_t rows, size_t cols, float value);
+    // Копирует содержимое представления (с переиспользованием памяти); представление может указывать
+    // в память самого тензора
+    void assign(ConstTensorView src);
+    // Дописывает строки в конец с геометрическим ростом памяти (содержимое сохраняется)
+    void append_rows(ConstTensorView src);
+    void fill(float value);
+    // Переносит содержимое во внешнюю память storage (не меньше size() элементов) и дальше работает в ней,
+    // не владея ею (например, в общей области параметров). Изменение формы в пределах size() память сохраняет;
+    // больший resize, append_rows или перемещающее присваивание снова переводят тензор на собственную память
+    void attach_storage(float* storage);
+    // Работает во внешней памяти storage (rows * cols элементов) как есть, без копирования и не владея ею —
+    // например, в отображённом в память файле модели. Правила для resize те же, что у attach_storage
+    void wrap_storage(float* storage, size_t rows, size_t cols);
+    bool owns_storage() const { return owns_; }
+
+    float* operator[](size_t i) { return data_ + i * cols_; }
+    const float* operator[](size_t i) const { return data_ + i * cols_; }
+    float* data() { return data_; }
+    const float* data() const { return data_; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t size() const { return rows_ * cols_; }
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+
+    TensorView view() { return TensorView(data_, rows_, cols_, cols_); }
+    ConstTensorView view() const { return ConstTensorView(data_, rows_, cols_, cols_); }
+    operator TensorView() { return view(); }
+    operator ConstTensorView() const { return view(); }
+
+    TensorView block(size_t row0, size_t col0, size_t rows, size_t cols) { return view().block(row0, col0, rows, cols); }
+    ConstTensorView block(size_t row0, size_t col0, size_t rows, size_t cols) const { return view().block(row0, col0, rows, cols); }
+    TensorView row_range(size_t row0, size_t rows) { return view().row_range(row0, rows); }
+    ConstTensorView row_range(size_t row0, size_t rows) const { return view().row_range(row0, rows); }
+
+private:
+    void reserve(size_t count);
+    void release();
+    // Представление пересекается с памятью тензора
+    bool overlaps(ConstTensorView src) const;
+
+    float* data_ = nullptr;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    size_t capacity_ = 0;
+    bool owns_ = true;
+};
\ No newline at end of file
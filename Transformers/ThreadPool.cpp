@@ -0,0 +1,197 @@
+﻿#include "ThreadPool.h"
+#include <algorithm>
+
+namespace {
+    // Поток уже выполняет задачу пула: вложенный parallel_for идёт последовательно
+    thread_local bool in_pool_task = false;
+
+    size_t default_threads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+    uint64_t pack(uint32_t first, uint32_t last) {
+        return (static_cast<uint64_t>(first) << 32) | last;
+    }
+    uint32_t first_of(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+    uint32_t last_of(uint64_t range) { return static_cast<uint32_t>(range); }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(default_threads());
+    return pool;
+}
+
+void ThreadPool::set_num_threads(size_t num_threads) {
+    ThreadPool& pool = instance();
+    std::lock_guard<std::mutex> submit(pool.submit_mutex_);
+    pool.stop();
+    pool.start(num_threads == 0 ? default_threads() : num_threads);
+}
+
+size_t ThreadPool::grain_size(size_t count, size_t work_per_item) {
+    if (count == 0) {
+        return 1;
+    }
+    work_per_item = std::max<size_t>(work_per_item, 1);
+    size_t threads = instance().num_threads();
+    if (threads == 1 || count * work_per_item < 2 * kMinChunkWork) {
+        return count;
+    }
+    size_t min_grain = (kMinChunkWork + work_per_item - 1) / work_per_item;
+    size_t balanced = (count + threads * kChunksPerThread - 1) / (threads * kChunksPerThread);
+    return std::min(count, std::max(min_grain, balanced));
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    start(num_threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::start(size_t num_threads) {
+    stopping_ = false;
+    num_threads_.store(num_threads, std::memory_order_relaxed);
+    slots_.reset(new Slot[num_threads]);
+    // Новый поток не должен принять уже выполненное задание за новое, поэтому получает текущее поколение
+    for (size_t i = 1; i < num_threads; ++i) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i, generation_);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void ThreadPool::worker_loop(size_t slot, unsigned long long seen) {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+        lock.unlock();
+
+        run_chunks(slot);
+
+        lock.lock();
+        if (--active_workers_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+// Владелец берёт первый кусок своего отрезка
+bool ThreadPool::pop_chunk(size_t slot, size_t& chunk) {
+    std::atomic<uint64_t>& range = slots_[slot].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (first_of(current) < last_of(current)) {
+        if (range.compare_exchange_weak(current, pack(first_of(current) + 1, last_of(current)), std::memory_order_acq_rel)) {
+            chunk = first_of(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Кража: у первого найденного потока с работой забирается вторая половина его отрезка
+bool ThreadPool::steal(size_t slot) {
+    size_t n = num_threads();
+    for (size_t k = 1; k < n; ++k) {
+        std::atomic<uint64_t>& victim = slots_[(slot + k) % n].range;
+        uint64_t current = victim.load(std::memory_order_acquire);
+        while (first_of(current) < last_of(current)) {
+            uint32_t first = first_of(current);
+            uint32_t last = last_of(current);
+            uint32_t split = last - std::max<uint32_t>(1, (last - first) / 2);
+            if (victim.compare_exchange_weak(current, pack(first, split), std::memory_order_acq_rel)) {
+                slots_[slot].range.store(pack(split, last), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run_chunks(size_t slot) {
+    in_pool_task = true;
+    do {
+        size_t chunk;
+        while (pop_chunk(slot, chunk)) {
+            size_t chunk_begin = job_begin_ + chunk * job_grain_;
+            size_t chunk_end = std::min(job_end_, chunk_begin + job_grain_);
+            try {
+                (*job_)(chunk_begin, chunk_end);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+    } while (steal(slot));
+    in_pool_task = false;
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) grain = 1;
+    size_t chunks = (end - begin + grain - 1) / grain;
+
+    // workers_ читается только после захвата submit_mutex_: set_num_threads пересоздаёт рабочих под ним
+    std::unique_lock<std::mutex> submit(submit_mutex_, std::defer_lock);
+    if (chunks == 1 || in_pool_task || !submit.try_lock() || workers_.empty()) {
+        for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += grain) {
+            fn(chunk_begin, std::min(end, chunk_begin + grain));
+        }
+        return;
+    }
+
+    // Начальное распределение: потоку p — отрезок кусков [chunks * p / n, chunks * (p + 1) / n)
+    size_t n = num_threads();
+    for (size_t p = 0; p < n; ++p) {
+        slots_[p].range.store(pack(static_cast<uint32_t>(chunks * p / n), static_cast<uint32_t>(chunks * (p + 1) / n)),
+            std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_begin_ = begin;
+        job_end_ = end;
+        job_grain_ = grain;
+        active_workers_ = workers_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+    wake_cv_.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return active_workers_ == 0; });
+    job_ = nullptr;
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+    parallel_for(0, count, 1, [&](size_t chunk_begin, size_t chunk_end) {
+        for (size_t i = chunk_begin; i < chunk_end; ++i) fn(i);
+    });
+}
\ No newline at end of file
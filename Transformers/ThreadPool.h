@@ -0,0 +1,97 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Общий для процесса пул потоков с кражей работы (work stealing).
+// Диапазон делится на куски по grain; куски сначала раздаются потокам поровну непрерывными отрезками,
+// поток, закончивший свой отрезок, забирает половину оставшегося у другого.
+// Вызывающий поток тоже выполняет куски, поэтому пул из N потоков держит N - 1 рабочих
+class ThreadPool {
+public:
+    // Пул процесса; по умолчанию число потоков равно числу ядер
+    static ThreadPool& instance();
+    // Меняет число потоков (0 — по числу ядер). Ждёт завершения parallel_for, идущего в других потоках;
+    // из задачи пула вызывать нельзя
+    static void set_num_threads(size_t num_threads);
+
+    size_t num_threads() const { return num_threads_.load(std::memory_order_relaxed); }
+
+    // Размер куска для count элементов по work_per_item операций: на кусок не меньше kMinChunkWork операций
+    // и не больше kChunksPerThread кусков на поток. Если вся работа мала — один кусок (выполнение в текущем потоке)
+    static size_t grain_size(size_t count, size_t work_per_item);
+
+    // Вызывает fn(chunk_begin, chunk_end) для кусков [begin, end) с границами, кратными grain (от begin), и ждёт завершения.
+    // Вложенные вызовы и вызовы из других потоков, пока пул занят, выполняются последовательно
+    void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn);
+    // Вариант по одному индексу: fn(i) для i из [0, count)
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+    // Свёртка: map(chunk_begin, chunk_end) для каждого куска, частичные результаты объединяются combine
+    // в порядке кусков, поэтому при одинаковом grain результат не зависит от распределения по потокам
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, Map map, Combine combine) {
+        if (begin >= end) {
+            return identity;
+        }
+        if (grain == 0) grain = 1;
+        std::vector<T> partial((end - begin + grain - 1) / grain, identity);
+        parallel_for(begin, end, grain, [&](size_t chunk_begin, size_t chunk_end) {
+            partial[(chunk_begin - begin) / grain] = map(chunk_begin, chunk_end);
+        });
+        T result = std::move(identity);
+        for (auto& p : partial) {
+            result = combine(std::move(result), std::move(p));
+        }
+        return result;
+    }
+
+    ~ThreadPool();
+
+    static constexpr size_t kMinChunkWork = 16 * 1024;
+    static constexpr size_t kChunksPerThread = 8;
+
+private:
+    explicit ThreadPool(size_t num_threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Отрезок кусков [first, last) одного потока, упакованный в одно слово: владелец берёт куски спереди,
+    // воры отрезают половину сзади, обе операции — CAS
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{ 0 };
+    };
+
+    void start(size_t num_threads);
+    void stop();
+    void worker_loop(size_t slot, unsigned long long seen);
+    void run_chunks(size_t slot);
+    bool pop_chunk(size_t slot, size_t& chunk);
+    bool steal(size_t slot);
+
+    std::vector<std::thread> workers_;   // Меняется и читается только под submit_mutex_
+    std::atomic<size_t> num_threads_{ 1 }; // Читается без блокировки (grain_size, воры); меняется до запуска рабочих
+    std::unique_ptr<Slot[]> slots_;
+    std::mutex submit_mutex_;            // Один parallel_for на пул одновременно
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+
+    // Текущее задание
+    const std::function<void(size_t, size_t)>* job_ = nullptr;
+    size_t job_begin_ = 0;
+    size_t job_end_ = 0;
+    size_t job_grain_ = 1;
+    size_t active_workers_ = 0;
+    unsigned long long generation_ = 0;
+    std::exception_ptr error_;
+    bool stopping_ = false;
+};
\ No newline at end of file
@@ -1,7 +1,12 @@
 #include "TrainModel.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "Dataset.h"
+#include "BatchLoader.h"
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <filesystem>
 
 //int paramCount = 0;
 
@@ -10,10 +15,128 @@ void glfw_error_callback(int error, const char* description)
     std::fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
 
+// Адаптивный softmax окупается только на больших словарях: голова из 1024 самых частых токенов,
+// хвостовые кластеры вчетверо больше предыдущего. Пусто — обычный выходной слой
+static std::vector<int> adaptive_cutoffs(int vocab_size)
+{
+    const int min_vocab_size = 8192;
+    std::vector<int> cutoffs;
+    if (vocab_size < min_vocab_size) return cutoffs;
+    for (int cutoff = 1024; cutoff < vocab_size; cutoff *= 4) {
+        cutoffs.push_back(cutoff);
+    }
+    return cutoffs;
+}
+
+// Текст из id токенов: BPE-метка "</w>" — конец слова, <NL> — перевод строки, <BOS>/<EOS> не печатаются
+static std::string tokens_to_text(BPETokenizer& tokenizer, const std::vector<int>& ids)
+{
+    std::string text;
+    for (auto& t : tokenizer.decode(ids)) {
+        if (t == "<BOS>" || t == "<EOS>") continue;
+
+        if (t == "<NL>") {
+            text += '\n';
+            continue;
+        }
+
+        if (t.size() >= 4 && t.substr(t.size() - 4) == "</w>")
+            text += t.substr(0, t.size() - 4) + " ";
+        else
+            text += t;
+    }
+    if (!text.empty() && text.back() == ' ')
+        text.pop_back();
+    return text;
+}
+
+// Набор и словарь собраны из текущих source.txt / target.txt: тексты и словарь не новее индекса набора
+static bool dataset_up_to_date(const std::string& dataset_dir)
+{
+    namespace fs = std::filesystem;
+    const std::string index = dataset::index_path(dataset_dir);
+    if (!fs::exists(index) || !fs::exists("vocab.bin")) return false;
+    const auto built = fs::last_write_time(index);
+    for (const char* path : { "source.txt", "target.txt", "vocab.bin" }) {
+        if (fs::exists(path) && fs::last_write_time(path) > built) return false;
+    }
+    return true;
+}
+
+// Сборка набора: BPE по source.txt / target.txt, токенизация пар строк, словарь в vocab.txt и vocab.bin,
+// пары в шарды dataset_dir
+static void build_dataset(const std::string& dataset_dir)
+{
+    // Корпус отображается в память: токенизация идёт по string_view без копии файла
+    MappedFile source_file("source.txt");
+    MappedFile target_file("target.txt");
+    std::string_view source_text(source_file.data(), source_file.size());
+    std::string_view target_text(target_file.data(), target_file.size());
+    BPETrainer trainer;
+    const std::vector<std::string_view> corpus_texts = { source_text, target_text };
+    trainer.train(corpus_texts, 5);
+    trainer.add_special_tokens({ "<BOS>", "<EOS>", "<NL>" });
+    auto vocab = trainer.get_vocab();
+    std::cout << "Словарь BPE: " << vocab.size() << " токенов\n";
+
+    // Пары строк source/target с одинаковым номером (строки токенизируются параллельно).
+    // Если число строк не совпадает, весь текст — одна пара, как раньше
+    auto source_lines = corpus::split_lines(source_text);
+    auto target_lines = corpus::split_lines(target_text);
+    if (source_lines.size() != target_lines.size() || source_lines.empty()) {
+        source_lines = { source_text };
+        target_lines = { target_text };
+    }
+
+    DataPreparer preparer(vocab);
+    auto sources = preparer.prepare_source_lines(source_lines);
+    auto targets = preparer.prepare_target_lines(target_lines, "<BOS>", "<EOS>");
+
+    const int vocab_size = static_cast<int>(vocab.size());
+    if (!adaptive_cutoffs(vocab_size).empty()) {
+        // Адаптивному softmax нужны id по убыванию частоты: перенумеровываем словарь и подготовленные пары.
+        // Частоты считаются по source и меткам (target без <BOS>)
+        std::vector<std::vector<int>> all_sequences = sources;
+        for (const auto& target : targets) {
+            all_sequences.emplace_back(target.begin() + 1, target.end());
+        }
+        std::vector<int> new_id = AdaptiveSoftmax::frequency_order(all_sequences, vocab_size);
+        for (auto* sequences : { &sources, &targets }) {
+            for (auto& sequence : *sequences) {
+                for (int& token : sequence) token = new_id[token];
+            }
+        }
+        trainer.remap_ids(new_id);
+    }
+
+    //Сохранение словаря 
+    trainer.save_vocab("vocab.txt");
+    trainer.save_vocab_binary("vocab.bin");
+
+    // Строки из одних пробелов дают пустые последовательности: такие пары пропускаются
+    // (<BOS> и <EOS> в словаре всегда, поэтому пустой target — это ровно два токена)
+    DatasetWriter writer(dataset_dir, vocab_size);
+    size_t skipped = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].empty() || targets[i].size() <= 2) {
+            ++skipped;
+            continue;
+        }
+        writer.add(sources[i], targets[i]);
+    }
+    if (writer.size() == 0) {
+        throw std::runtime_error("В source.txt / target.txt нет непустых пар строк");
+    }
+    writer.finish();
+    if (skipped > 0) {
+        std::cout << "Пропущено пустых пар: " << skipped << "\n";
+    }
+}
+
 void TrainingModel::RunTrain() {
     setlocale(LC_ALL, "Russian");
 
-    // ======== 1)  GLFW +  ========
+    // ======== 1) Инициализация GLFW + окно ========
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         std::exit(-1);
@@ -31,7 +154,7 @@ void TrainingModel::RunTrain() {
     // ======== 2) GLEW ========
     glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
-        std::cerr << "   GLEW\n";
+        std::cerr << "Не удалось инициализировать GLEW\n";
         std::exit(-1);
     }
 
@@ -43,41 +166,80 @@ void TrainingModel::RunTrain() {
     ImGui_ImplOpenGL3_Init("#version 330");
     ImGui::StyleColorsDark();
 
-    // ======== 4)    ========
-    TextReader reader;
-    std::string source_text = reader.read_filename("source.txt");
-    std::string target_text = reader.read_filename("target.txt");
-    BPETrainer trainer;
-    trainer.train(source_text + " " + target_text, 5);
-    trainer.add_special_tokens({ "<BOS>", "<EOS>", "<NL>" });
-    auto vocab = trainer.get_vocab();
-    for (auto& p : vocab)
-        std::cout << ": " << p.first << ", ID: " << p.second << "\n";
+    // ======== 4) Данные и модель ========
+    // Набор пар собирается один раз (BPE, токенизация, шарды) и переиспользуется, пока тексты не изменились
+    const std::string dataset_dir = "dataset";
+    if (!dataset_up_to_date(dataset_dir)) {
+        build_dataset(dataset_dir);
+    }
+    // Словарь отображается в память как есть: токенизатор и декодер работают прямо с ним
+    Vocabulary vocab = Vocabulary::open("vocab.bin");
+    Dataset data(dataset_dir);
+    if (data.vocab_size() != static_cast<int>(vocab.size())) {
+        throw std::runtime_error("Набор данных собран с другим словарём: удалите каталог " + dataset_dir);
+    }
+    std::cout << "Набор данных: " << data.size() << " пар в " << data.shard_count() << " шардах\n";
 
-    //  
-    trainer.save_vocab("vocab.txt");
+    ModelConfig config;
+    config.vocab_size = static_cast<int>(vocab.size());
+    config.embedding_dim = 32;
+    config.num_layers = 2;
+    config.num_heads = 4;
+    config.hidden_dim = 64;
+    config.adaptive_cutoffs = adaptive_cutoffs(config.vocab_size);
+    const size_t batch_size = 32;
 
-    DataPreparer preparer(vocab);
-    auto source_tokens = preparer.prepare_source(source_text);
-    auto full_target = preparer.prepare_target(target_text, "<BOS>", "<EOS>");
-    std::vector<int> target_tokens(full_target.begin(), full_target.end() - 1);
-    std::vector<int> labels(full_target.begin() + 1, full_target.end());
-    auto target_one_hot = utils::one_hot_encode(labels, vocab.size());
-
-    Transformer model(vocab.size(), 32, 2, 4, 64);
-    model.initialize_random();
+    // Реплики по числу потоков, но не больше размера батча
+    int num_replicas = static_cast<int>(std::min({ ThreadPool::instance().num_threads(), batch_size, data.size() }));
+    DataParallelTrainer parallel_trainer(config, num_replicas);
+    parallel_trainer.initialize_random();
+    // Adam сходится за меньшее число эпох, чем SGD с lr = 0.01
+    OptimizerConfig optimizer_config;
+    optimizer_config.type = OptimizerType::Adam;
+    optimizer_config.clip_norm = 1.0f;
+    parallel_trainer.set_optimizer(optimizer_config);
+    Transformer& model = parallel_trainer.model();
+    std::cout << "Реплик для обучения: " << parallel_trainer.num_replicas() << "\n";
     const int num_epochs = 800;
-    const float lr = 0.01f;
+    const float lr = 0.001f;
+
+    // Контрольные точки: раз в 5 минут снимок весов и состояния Adam пишется в фоне, обучение не останавливается.
+    // Если точка осталась от прерванного запуска, обучение продолжается с неё
+    const std::string checkpoint_path = "checkpoint.bin";
+    int start_epoch = 0;
+    if (std::filesystem::exists(checkpoint_path)) {
+        try {
+            start_epoch = static_cast<int>(parallel_trainer.load_checkpoint(checkpoint_path));
+            std::cout << "Обучение продолжается с эпохи " << start_epoch << "\n";
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Контрольная точка не загружена (" << e.what() << "), обучение с начала\n";
+            parallel_trainer.initialize_random();
+        }
+    }
+    CheckpointWriter checkpoints(checkpoint_path, std::chrono::minutes(5));
 
-    // ======== 5)  ========
+    // ======== 5) График ========
     ErrorPlot lossPlot;
 
-    // ======== 6)    GUI ========
-    for (int epoch = 0; epoch < num_epochs && !glfwWindowShouldClose(window); ++epoch) {
-        model.forward_propagation(source_tokens, target_tokens);
-        const auto& probs = model.get_probabilities();
-        model.backward_propagation(target_one_hot, lr);
-        lossPlot.ComputeAndAddLoss(probs, target_one_hot);
+    // ======== 6) Цикл обучения с GUI ========
+    // Батчи готовит поток загрузчика: чтение шардов и перемешивание идут параллельно с шагами обучения
+    BatchLoaderConfig loader_config;
+    loader_config.batch_size = batch_size;
+    loader_config.first_epoch = start_epoch;
+    loader_config.num_epochs = num_epochs;
+    BatchLoader loader(data, loader_config);
+    Batch batch;
+    int epoch = start_epoch; // Число завершённых эпох
+    while (!glfwWindowShouldClose(window) && loader.next(batch)) {
+        float loss = parallel_trainer.train_step(batch.source, batch.target, batch.labels, lr);
+        lossPlot.AddLoss(loss);
+        if (batch.last_in_epoch) {
+            epoch = static_cast<int>(batch.epoch) + 1;
+        }
+        if (checkpoints.due()) {
+            parallel_trainer.save_checkpoint(checkpoints, epoch);
+        }
 
         glfwPollEvents();
         ImGui_ImplOpenGL3_NewFrame();
@@ -107,50 +269,37 @@ void TrainingModel::RunTrain() {
         glfwSwapBuffers(window);
     }
 
-    // ======== 7)       ========
-    model.forward_propagation(source_tokens, target_tokens);
-    const auto& final_prop = model.get_probabilities();
+    // ======== 7) Финальный прямой проход и вывод текста ========
     model.save_weights("model.bin");
-
-    // ---   
-    //std::cout << "Total parameters: " << paramCount << "\n";
-
-    std::cout << "  (one-hot):\n";
-    for (auto& row : target_one_hot) {
-        for (float v : row) std::cout << v << ' ';
-        std::cout << "\n";
+    // Обучение прервано (окно закрыто) — сохраняем точку для продолжения; после всех эпох она не нужна
+    if (epoch < num_epochs) {
+        parallel_trainer.save_checkpoint(checkpoints, epoch);
+        checkpoints.wait();
     }
-
-    std::cout << "\n :\n";
-    for (auto& row : final_prop) {
-        for (float p : row) std::cout << p << ' ';
-        std::cout << "\n";
+    else {
+        checkpoints.wait();
+        std::filesystem::remove(checkpoint_path);
     }
 
-    std::vector<int> predicted_tokens = utils::probs_to_tokens(final_prop);
-    BPETokenizer tokenizer(vocab);
-    auto decoded = tokenizer.decode(predicted_tokens);
+    // --- Число параметров модели
+    std::cout << "Total parameters: " << parallel_trainer.parameter_count() << "\n";
 
-    std::string predicted_text;
-    for (auto& t : decoded) {
-        if (t == "<BOS>" || t == "<EOS>") continue;
-
-        if (t == "<NL>") {
-            predicted_text += '\n';
-            continue;
-        }
+    // Первые пары набора: вход и предсказание модели
+    BPETokenizer tokenizer(vocab);
+    const size_t shown_pairs = std::min<size_t>(data.size(), 8);
+    std::vector<int> source, full_target;
+    for (size_t pair = 0; pair < shown_pairs; ++pair) {
+        data.read_pair(pair, source, full_target);
+        std::vector<int> target(full_target.begin(), full_target.end() - 1);
+        model.forward_propagation(source, target);
+        const auto& final_prop = model.get_probabilities();
 
-        if (t.size() >= 4 && t.substr(t.size() - 4) == "</w>")
-            predicted_text += t.substr(0, t.size() - 4) + " ";
-        else
-            predicted_text += t;
+        std::vector<int> predicted_tokens = utils::probs_to_tokens(final_prop);
+        std::cout << "Вход: " << tokens_to_text(tokenizer, source) << "\n";
+        std::cout << "Декодированный текст: " << "\n" << tokens_to_text(tokenizer, predicted_tokens) << "\n";
     }
-    if (!predicted_text.empty() && predicted_text.back() == ' ')
-        predicted_text.pop_back();
-
-    std::cout << " : " << "\n" << predicted_text << "\n";
 
-    // ======== 8)    ========
+    // ======== 8) Оставить окно открытым ========
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
         ImGui_ImplOpenGL3_NewFrame();
@@ -174,7 +323,7 @@ void TrainingModel::RunTrain() {
         glfwSwapBuffers(window);
     }
 
-    // ======== 9)  ========
+    // ======== 9) Очистка ========
     ImPlot::DestroyContext();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
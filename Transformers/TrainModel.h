@@ -5,6 +5,7 @@
 #include "bpe_tokenizer.h"
 #include "data_preparer.h"
 #include "Transformer.h"
+#include "DataParallelTrainer.h"
 #include "utils.h"
 #include "ErrorPlot.h"
 
@@ -15,13 +16,13 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <implot.h>
 
-static void glfw_error_callback(int error, const char* description);
+void glfw_error_callback(int error, const char* description);
 
-/// -,   
-/// , , GUI   
+/// Класс-«приложение», в котором происходит
+/// инициализация, тренировка, GUI и финальный просмотр
 class TrainingModel {
 public:
-	///   19   main
-	/// (, ,    ).
+	/// Запускает цикл „1…9“ из вашего main
+	/// (инициализация, тренировка, финальный просмотр и очистка).
 	void RunTrain();
 };
\ No newline at end of file
@@ -1,68 +1,286 @@
 #include "Transformer.h"
 #include "utils.h"
 #include <fstream>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 Transformer::Transformer(int vocab_size, int embedding_dim, int num_layers, int num_heads, int hidden_dim)
-    : embedding_(vocab_size, embedding_dim),
-    positional_encoding_(embedding_dim),
-    encoder_(num_layers, num_heads, embedding_dim, hidden_dim),
-    decoder_(num_layers, num_heads, embedding_dim, hidden_dim),
-    linear_(embedding_dim, vocab_size) {}
+    : Transformer(ModelConfig::make(vocab_size, embedding_dim, num_layers, num_heads, hidden_dim)) {
+}
+
+Transformer::Transformer(const ModelConfig& config)
+    : config_(config),
+    embedding_(config.vocab_size, config.embedding_dim),
+    positional_encoding_(config.embedding_dim),
+    encoder_(config.num_layers, config.num_heads, config.embedding_dim, config.hidden_dim),
+    decoder_(config.num_layers, config.num_heads, config.embedding_dim, config.hidden_dim),
+    linear_(config.embedding_dim, config.adaptive_cutoffs.empty() ? config.vocab_size : 0) {
+    if (!config.adaptive_cutoffs.empty()) {
+        adaptive_ = std::make_unique<AdaptiveSoftmax>(config.embedding_dim, config.vocab_size, config.adaptive_cutoffs, config.adaptive_shrink);
+    }
+}
 
 void Transformer::forward_propagation(const std::vector<int>& source_tokens, const std::vector<int>& target_tokens) {
     source_tokens_ = source_tokens;
     target_tokens_ = target_tokens;
 
-    // 
-    auto source_embedded = embedding_.forward_emd(source_tokens_);
-    auto target_embedded = embedding_.forward_emd(target_tokens_);
-
-    //  
-    auto source_pe = positional_encoding_.forward_pe(source_embedded);
-    auto target_pe = positional_encoding_.forward_pe(target_embedded);
+    source_layout_ = BatchLayout();
+    target_layout_ = BatchLayout();
 
-    //     
-    input_embeddings = utils::add_embeddings(source_embedded, source_pe);
-    output_embeddings = utils::add_embeddings(target_embedded, target_pe);
+    // Эмбеддинги с позиционным кодированием
+    input_embeddings = embed(source_tokens_);
+    output_embeddings = embed(target_tokens_);
 
-    // 
+    // Энкодер
     encoder_output = encoder_.forward_encoder(input_embeddings);
 
-    // 
-    auto decoder_output = decoder_.forward_decoder(output_embeddings, encoder_output);
+    // Декодер
+    decoder_output_ = decoder_.forward_decoder(output_embeddings, encoder_output);
 
-    //  
+    // Линейный слой и Softmax
+    output_probabilities(decoder_output_);
+}
+
+const Tensor& Transformer::output_probabilities(const Tensor& decoder_output) {
+    if (adaptive_) {
+        adaptive_probabilities_ = adaptive_->probabilities(decoder_output);
+        return adaptive_probabilities_;
+    }
     auto logits = linear_.forward_linear(decoder_output);
+    return softmax_.forward_softmax(logits);
+}
+
+Tensor Transformer::embed(const std::vector<int>& tokens, int start_pos) {
+    auto embedded = embedding_.forward_emd(tokens);
+    auto pe = positional_encoding_.forward_pe(embedded, start_pos);
+    return utils::add_embeddings(embedded, pe);
+}
+
+Tensor Transformer::embed(const std::vector<int>& tokens, const BatchLayout& layout) {
+    auto embedded = embedding_.forward_emd(tokens);
+    // Позиционное кодирование одинаково для всех последовательностей батча
+    auto pe = positional_encoding_.forward_pe(embedded.row_range(0, layout.max_len));
+    for (int b = 0; b < layout.batch_size(); ++b) {
+        for (int pos = 0; pos < layout.max_len; ++pos) {
+            float* row = embedded[b * layout.max_len + pos];
+            for (size_t j = 0; j < embedded.cols(); ++j) {
+                row[j] += pe[pos][j];
+            }
+        }
+    }
+    return embedded;
+}
+
+EncoderMemory Transformer::encode(const std::vector<int>& source_tokens) {
+    EncoderMemory memory;
+    memory.encoder_output = encoder_.forward_encoder(embed(source_tokens));
+    decoder_.project_memory(memory);
+    return memory;
+}
+
+const Tensor& Transformer::decode(const std::vector<int>& target_tokens, const EncoderMemory& memory) {
+    auto decoder_output = decoder_.forward_decoder(embed(target_tokens), memory);
+    return output_probabilities(decoder_output);
+}
+
+void Transformer::reset_decode_cache() {
+    decoder_.reset_cache();
+    decode_pos_ = 0;
+}
+
+const Tensor& Transformer::decode_step(int token, const EncoderMemory& memory) {
+    auto token_input = embed({ token }, decode_pos_);
+    ++decode_pos_;
+
+    auto decoder_output = decoder_.forward_decoder_step(token_input, memory);
+    return output_probabilities(decoder_output);
+}
+
+const Tensor& Transformer::decode_beam_step(const std::vector<int>& tokens, const EncoderMemory& memory) {
+    if (tokens.empty()) {
+        throw std::invalid_argument("decode_beam_step: нужен хотя бы один луч");
+    }
+    // У всех лучей одна и та же позиция decode_pos_
+    auto token_input = embedding_.forward_emd(tokens);
+    auto pe = positional_encoding_.forward_pe(token_input.row_range(0, 1), decode_pos_);
+    for (size_t b = 0; b < token_input.rows(); ++b) {
+        for (size_t j = 0; j < token_input.cols(); ++j) {
+            token_input[b][j] += pe[0][j];
+        }
+    }
+    ++decode_pos_;
+
+    auto decoder_output = decoder_.forward_decoder_step(token_input, memory);
+    return output_probabilities(decoder_output);
+}
+
+void Transformer::reorder_decode_cache(const std::vector<int>& beams) {
+    decoder_.reorder_cache(beams);
+}
+
+int Transformer::decode_step_greedy(int token, const EncoderMemory& memory) {
+    return decode_steps_greedy({ token }, memory)[0];
+}
+
+std::vector<int> Transformer::decode_steps_greedy(const std::vector<int>& tokens, const EncoderMemory& memory) {
+    if (tokens.empty()) {
+        throw std::invalid_argument("decode_steps_greedy: нужен хотя бы один токен");
+    }
+    auto token_input = embed(tokens, decode_pos_);
+    decode_pos_ += static_cast<int>(tokens.size());
+
+    auto decoder_output = decoder_.forward_decoder_step(token_input, memory);
+    if (adaptive_) {
+        return adaptive_->predict(decoder_output);
+    }
+    const Tensor& probabilities = output_probabilities(decoder_output);
+    std::vector<int> next(probabilities.rows());
+    for (size_t i = 0; i < probabilities.rows(); ++i) {
+        next[i] = static_cast<int>(std::max_element(probabilities[i], probabilities[i] + probabilities.cols()) - probabilities[i]);
+    }
+    return next;
+}
 
-    // Softmax
-    probabilities_ = softmax_.forward_softmax(logits);
+void Transformer::truncate_decode_cache(int length) {
+    if (length < 0 || length > decode_pos_) {
+        throw std::invalid_argument("truncate_decode_cache: длина вне диапазона");
+    }
+    decoder_.truncate_cache(static_cast<size_t>(length));
+    decode_pos_ = length;
+}
+
+void Transformer::backward_propagation(const Tensor& target_one_hot, float learning_rate) {
+    if (adaptive_) {
+        // Адаптивный softmax обучается по меткам: one-hot строка -> индекс её единицы (нулевая строка — без метки)
+        std::vector<int> labels(target_one_hot.rows(), -1);
+        for (size_t i = 0; i < target_one_hot.rows(); ++i) {
+            const float* row = target_one_hot[i];
+            const float* it = std::max_element(row, row + target_one_hot.cols());
+            if (*it > 0.0f) labels[i] = static_cast<int>(it - row);
+        }
+        if (optimizer_) {
+            arena_.zero_grad();
+        }
+        Tensor grad_decoder_output;
+        adaptive_->cross_entropy(decoder_output_, labels, 1.0f, learning_rate, grad_decoder_output);
+        backward_from_decoder_output(grad_decoder_output, learning_rate);
+        return;
+    }
+    // Градиент cross-entropy по входу Softmax сразу (p - y), без промежуточного -y / p
+    auto grad_logits = softmax_.backward_cross_entropy(target_one_hot);
+
+    backward_from_logits(grad_logits, learning_rate);
+}
+
+void Transformer::forward_batch(const std::vector<std::vector<int>>& source_batch, const std::vector<std::vector<int>>& target_batch) {
+    if (source_batch.empty() || source_batch.size() != target_batch.size()) {
+        throw std::invalid_argument("source_batch и target_batch должны быть непустыми и одного размера");
+    }
+    std::vector<int> source_lengths, target_lengths;
+    for (size_t b = 0; b < source_batch.size(); ++b) {
+        if (source_batch[b].empty() || target_batch[b].empty()) {
+            throw std::invalid_argument("Последовательности батча не могут быть пустыми");
+        }
+        source_lengths.push_back(static_cast<int>(source_batch[b].size()));
+        target_lengths.push_back(static_cast<int>(target_batch[b].size()));
+    }
+    source_layout_ = BatchLayout::from_lengths(source_lengths);
+    target_layout_ = BatchLayout::from_lengths(target_lengths);
+
+    // Заполнение — токен 0: его строки не влияют на реальные позиции и получают нулевой градиент
+    source_tokens_ = pad_batch(source_batch, source_layout_, 0);
+    target_tokens_ = pad_batch(target_batch, target_layout_, 0);
+
+    input_embeddings = embed(source_tokens_, source_layout_);
+    output_embeddings = embed(target_tokens_, target_layout_);
+
+    encoder_output = encoder_.forward_encoder(input_embeddings, source_layout_);
+    // Проекция в словарь и softmax — в backward_batch, потоково (см. Linear::cross_entropy_head)
+    decoder_output_ = decoder_.forward_decoder(output_embeddings, encoder_output, target_layout_, source_layout_);
+}
+
+float Transformer::backward_batch(const std::vector<std::vector<int>>& label_batch, float learning_rate) {
+    if (target_layout_.empty()) {
+        throw std::runtime_error("forward_batch не был выполнен");
+    }
+    if (label_batch.size() != target_layout_.lengths.size()) {
+        throw std::invalid_argument("label_batch не совпадает по размеру с батчем forward_batch");
+    }
+    for (size_t b = 0; b < label_batch.size(); ++b) {
+        if (static_cast<int>(label_batch[b].size()) != target_layout_.lengths[b]) {
+            throw std::invalid_argument("Длина меток не совпадает с длиной целевой последовательности");
+        }
+    }
+
+    // Метка -1 отмечает заполнение: такие строки не дают ни loss, ни градиента
+    auto labels = pad_batch(label_batch, target_layout_, -1);
+
+    int real_tokens = static_cast<int>(std::count_if(labels.begin(), labels.end(), [](int label) { return label >= 0; }));
+
+    if (optimizer_) {
+        arena_.zero_grad();
+    }
+    // Нет ни одного реального токена: loss и градиенты нулевые, шаг оптимизатора не делается
+    // (иначе моменты Adam/SGD с инерцией сдвинули бы веса на пустом батче)
+    if (real_tokens == 0) {
+        return 0.0f;
+    }
+    Tensor grad_decoder_output;
+    float scale = 1.0f / label_batch.size();
+    float loss = adaptive_ ? adaptive_->cross_entropy(decoder_output_, labels, scale, learning_rate, grad_decoder_output)
+        : linear_.cross_entropy_head(decoder_output_, labels, scale, learning_rate, grad_decoder_output);
+    backward_from_decoder_output(grad_decoder_output, learning_rate);
+
+    // loss — сумма по реальным токенам без множителя scale; градиент нормирован на B, возвращаемое значение — на токены
+    return loss / real_tokens;
+}
+
+std::vector<int> Transformer::pad_batch(const std::vector<std::vector<int>>& batch, const BatchLayout& layout, int pad_value) {
+    std::vector<int> padded(layout.rows(), pad_value);
+    for (size_t b = 0; b < batch.size(); ++b) {
+        std::copy(batch[b].begin(), batch[b].end(), padded.begin() + b * layout.max_len);
+    }
+    return padded;
 }
 
-void Transformer::backward_propagation(const std::vector<std::vector<float>>& target_one_hot, float learning_rate) {
-    //     Softmax
-    auto d_p = softmax_.compute_grad_output_model(target_one_hot);
-    
-    //    Softmax
-    auto grad_logits = softmax_.backward_softmax(probabilities_, d_p);
+void Transformer::backward_from_logits(const Tensor& grad_logits, float learning_rate) {
+    if (optimizer_) {
+        arena_.zero_grad();
+    }
 
-    //  
-    auto grad_decoder_output = linear_.backward_linear(grad_logits, learning_rate); //     Linear (  )
+    // Линейный слой
+    auto grad_decoder_output = linear_.backward_linear(grad_logits, learning_rate); // Градиенты по входу блока Linear (по выходу декодера)
+    backward_from_decoder_output(grad_decoder_output, learning_rate);
+}
 
-    // 
+void Transformer::backward_from_decoder_output(const Tensor& grad_decoder_output, float learning_rate) {
+    // Декодер
     auto [grad_masked_mha_input, grad_encoder_output] = decoder_.backward_decoder(grad_decoder_output, encoder_output, learning_rate);
 
-    // 
+    // Энкодер
     auto grad_mha_input = encoder_.backward_encoder(grad_encoder_output, learning_rate);
 
-    //    (embeddings_   )
+    // Корректировка матрицы эмбеддингов (embeddings_ изначально инициализирован случайно)
     embedding_.backward_emd(target_tokens_, grad_masked_mha_input, learning_rate);
     embedding_.backward_emd(source_tokens_, grad_mha_input, learning_rate);
+
+    if (optimizer_) {
+        optimizer_->step(arena_, learning_rate);
+    }
+    // Веса изменились (шаг оптимизатора или SGD в backward) — обновляем их 16-битную копию
+    if (optimizer_ || !accumulate_gradients_) {
+        arena_.refresh_low_precision();
+    }
 }
 
 void Transformer::initialize_random() {
-    //     
+    if (quantized_) {
+        throw std::runtime_error("Модель квантована в int8: новые веса загружаются в новый экземпляр");
+    }
+    // Раздаем случайную инициализацию каждому блоку
     embedding_.initialize_random();
 
     for (auto& layer : encoder_.get_layers())
@@ -71,11 +289,221 @@ void Transformer::initialize_random() {
         layer.initialize_random();
 
     linear_.initialize_random();
+    if (adaptive_) adaptive_->initialize_random();
+    rebind_parameter_arena();
+}
+
+void Transformer::set_gradient_accumulation(bool enabled) {
+    accumulate_gradients_ = enabled;
+    embedding_.set_gradient_accumulation(enabled);
+    for (auto& layer : encoder_.get_layers())
+        layer.set_gradient_accumulation(enabled);
+    for (auto& layer : decoder_.get_layers())
+        layer.set_gradient_accumulation(enabled);
+    linear_.set_gradient_accumulation(enabled);
+    if (adaptive_) adaptive_->set_gradient_accumulation(enabled);
+}
+
+std::vector<ParameterRef> Transformer::parameters() {
+    std::vector<ParameterRef> params;
+    embedding_.collect_parameters(params);
+    prefix_parameter_names(params, 0, "embedding.");
+    auto& encoder_layers = encoder_.get_layers();
+    for (size_t i = 0; i < encoder_layers.size(); ++i) {
+        size_t first = params.size();
+        encoder_layers[i].collect_parameters(params);
+        prefix_parameter_names(params, first, "encoder." + std::to_string(i) + ".");
+    }
+    auto& decoder_layers = decoder_.get_layers();
+    for (size_t i = 0; i < decoder_layers.size(); ++i) {
+        size_t first = params.size();
+        decoder_layers[i].collect_parameters(params);
+        prefix_parameter_names(params, first, "decoder." + std::to_string(i) + ".");
+    }
+    size_t first = params.size();
+    if (adaptive_) {
+        adaptive_->collect_parameters(params);
+        prefix_parameter_names(params, first, "adaptive.");
+    }
+    else {
+        linear_.collect_parameters(params);
+        prefix_parameter_names(params, first, "linear.");
+    }
+    return params;
+}
+
+void Transformer::build_parameter_arena() {
+    set_gradient_accumulation(true);
+    arena_.bind(parameters());
+}
+
+void Transformer::rebind_parameter_arena() {
+    if (arena_.empty()) {
+        return;
+    }
+    arena_.bind(parameters());
+    if (optimizer_) {
+        optimizer_->reset();
+    }
+}
+
+void Transformer::set_optimizer(const OptimizerConfig& config) {
+    build_parameter_arena();
+    optimizer_ = std::make_unique<Optimizer>(config);
+}
+
+void Transformer::set_precision(Precision format) {
+    for (auto& layer : encoder_.get_layers())
+        layer.set_activation_precision(format);
+    for (auto& layer : decoder_.get_layers())
+        layer.set_activation_precision(format);
+    linear_.set_activation_precision(format);
+
+    if (arena_.empty() && format != Precision::Float32) {
+        arena_.bind(parameters());
+        mapped_weights_.reset(); // Веса скопированы в область
+    }
+    arena_.set_precision(format);
+}
+
+void Transformer::set_calibration(bool enabled) {
+    for (auto& layer : encoder_.get_layers())
+        layer.set_calibration(enabled);
+    for (auto& layer : decoder_.get_layers())
+        layer.set_calibration(enabled);
+    linear_.set_calibration(enabled);
+}
+
+void Transformer::quantize_int8(const std::vector<std::vector<int>>& source_samples, const std::vector<std::vector<int>>& target_samples) {
+    if (quantized_) {
+        throw std::runtime_error("Модель уже квантована");
+    }
+    if (source_samples.empty() || source_samples.size() != target_samples.size()) {
+        throw std::invalid_argument("Калибровке нужны непустые source_samples и target_samples одного размера");
+    }
+    // Калибровка идёт тем же путём, что и инференс: encode (с проекциями K/V) и decode
+    set_calibration(true);
+    for (size_t i = 0; i < source_samples.size(); ++i) {
+        EncoderMemory memory = encode(source_samples[i]);
+        decode(target_samples[i], memory);
+    }
+    set_calibration(false);
+
+    for (auto& layer : encoder_.get_layers())
+        layer.quantize_int8();
+    for (auto& layer : decoder_.get_layers())
+        layer.quantize_int8();
+    // Адаптивный softmax остаётся во float32: его матрицы и так малы, а голова определяет выбор кластера
+    if (!adaptive_) linear_.quantize_int8();
+    quantized_ = true;
+}
+
+// Заголовок файла int8-модели: сигнатура, версия и архитектура (в версии 1 архитектуры не было)
+static const char kQuantizedMagic[4] = { 'T', 'Q', '8', '\0' };
+static const int kQuantizedVersion = 2;
+
+static void write_int32(std::ostream& out, int value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static int read_int32(std::istream& in) {
+    int value = 0;
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+// Читает заголовок и оставляет поток на первом блоке весов
+static ModelConfig read_quantized_header(std::istream& in, const std::string& path) {
+    char magic[sizeof(kQuantizedMagic)];
+    in.read(magic, sizeof(magic));
+    const int version = read_int32(in);
+    if (!in || std::memcmp(magic, kQuantizedMagic, sizeof(magic)) != 0 || version != kQuantizedVersion) {
+        throw std::runtime_error("Файл не является int8-моделью поддерживаемой версии: " + path);
+    }
+    ModelConfig config;
+    config.vocab_size = read_int32(in);
+    config.embedding_dim = read_int32(in);
+    config.num_layers = read_int32(in);
+    config.num_heads = read_int32(in);
+    config.hidden_dim = read_int32(in);
+    config.adaptive_shrink = read_int32(in);
+    const int cutoff_count = read_int32(in);
+    if (!in || cutoff_count < 0 || cutoff_count > config.vocab_size) {
+        throw std::runtime_error("Повреждённый заголовок int8-модели: " + path);
+    }
+    config.adaptive_cutoffs.resize(cutoff_count);
+    for (int& cutoff : config.adaptive_cutoffs) cutoff = read_int32(in);
+    if (!in) throw std::runtime_error("Повреждённый заголовок int8-модели: " + path);
+    return config;
+}
+
+ModelConfig Transformer::read_quantized_config(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
+    return read_quantized_header(in, path);
+}
+
+void Transformer::save_quantized(const std::string& path) const {
+    if (!quantized_) {
+        throw std::runtime_error("Модель не квантована: сначала вызовите quantize_int8");
+    }
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+
+    out.write(kQuantizedMagic, sizeof(kQuantizedMagic));
+    write_int32(out, kQuantizedVersion);
+    write_int32(out, config_.vocab_size);
+    write_int32(out, config_.embedding_dim);
+    write_int32(out, config_.num_layers);
+    write_int32(out, config_.num_heads);
+    write_int32(out, config_.hidden_dim);
+    write_int32(out, config_.adaptive_shrink);
+    write_int32(out, static_cast<int>(config_.adaptive_cutoffs.size()));
+    for (int cutoff : config_.adaptive_cutoffs) write_int32(out, cutoff);
+    embedding_.save_weights(out);
+    for (const auto& layer : encoder_.get_layers()) {
+        layer.save_quantized(out);
+    }
+    for (const auto& layer : decoder_.get_layers()) {
+        layer.save_quantized(out);
+    }
+    if (adaptive_) adaptive_->save_weights(out);
+    else linear_.save_quantized(out);
+}
+
+void Transformer::load_quantized(const std::string& path) {
+    if (quantized_) {
+        throw std::runtime_error("Модель квантована в int8: новые веса загружаются в новый экземпляр");
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
+
+    if (read_quantized_header(in, path) != config_) {
+        throw std::runtime_error("Архитектура int8-модели не совпадает с конфигурацией модели: " + path);
+    }
+    embedding_.load_weights(in);
+    for (auto& layer : encoder_.get_layers()) {
+        layer.load_quantized(in);
+    }
+    for (auto& layer : decoder_.get_layers()) {
+        layer.load_quantized(in);
+    }
+    if (adaptive_) adaptive_->load_weights(in);
+    else linear_.load_quantized(in);
+    quantized_ = true;
+    rebind_parameter_arena();
 }
 
 void Transformer::load_weights(const std::string& path) {
+    if (quantized_) {
+        throw std::runtime_error("Модель квантована в int8: новые веса загружаются в новый экземпляр");
+    }
+    if (model_file::is_model_file(path)) {
+        map_weights(path);
+        return;
+    }
     std::ifstream in(path, std::ios::binary);
-    if (!in) throw std::runtime_error("     : " + path);
+    if (!in) throw std::runtime_error("Не удалось открыть файл для чтения: " + path);
 
     embedding_.load_weights(in);
     for (auto& layer : encoder_.get_layers()) {
@@ -84,28 +512,54 @@ void Transformer::load_weights(const std::string& path) {
     for (auto& layer : decoder_.get_layers()) {
         layer.load_weights(in);
     }
-    linear_.load_weights(in);
+    if (adaptive_) adaptive_->load_weights(in);
+    else linear_.load_weights(in);
 
     in.close();
+    rebind_parameter_arena();
 }
 
 void Transformer::save_weights(const std::string& path) const {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) throw std::runtime_error("     : " + path);
-
-    // 1) Embedding
-    embedding_.save_weights(out);
+    // parameters() выдаёт неконстантные ссылки, но здесь значения только читаются
+    std::vector<ParameterRef> params = const_cast<Transformer*>(this)->parameters();
+    for (const auto& param : params) {
+        if (param.value->empty()) {
+            throw std::runtime_error("Float-веса не загружены (модель загружена из int8-файла)");
+        }
+    }
+    model_file::save(path, config_, params);
+}
 
-    // 2) Encoder
-    for (const auto& layer : encoder_.get_layers()) {
-        layer.save_weights(out);
+void Transformer::map_weights(const std::string& path) {
+    model_file::MappedModel model = model_file::open(path);
+    if (model.config != config_) {
+        const ModelConfig& c = model.config;
+        throw std::runtime_error("Архитектура в файле модели (vocab " + std::to_string(c.vocab_size)
+            + ", embedding " + std::to_string(c.embedding_dim) + ", layers " + std::to_string(c.num_layers)
+            + ", heads " + std::to_string(c.num_heads) + ", hidden " + std::to_string(c.hidden_dim)
+            + ", adaptive clusters " + std::to_string(c.adaptive_cutoffs.size()) + ") не совпадает с архитектурой модели: " + path);
     }
-    // 3) Decoder
-    for (const auto& layer : decoder_.get_layers()) {
-        layer.save_weights(out);
+    std::vector<ParameterRef> params = parameters();
+    if (model.tensors.size() != params.size()) {
+        throw std::runtime_error("Число тензоров в файле модели не совпадает с числом параметров: " + path);
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+        const model_file::TensorEntry& entry = model.tensors[i];
+        const Tensor& value = *params[i].value;
+        bool shape_matches = value.empty() || (value.rows() == entry.rows && value.cols() == entry.cols);
+        if (entry.name != params[i].name || !shape_matches) {
+            throw std::runtime_error("Тензор '" + entry.name + "' в файле модели не соответствует параметру '"
+                + params[i].name + "': " + path);
+        }
+    }
+    // Проверено всё — только теперь переводим параметры на отображённую память
+    for (size_t i = 0; i < params.size(); ++i) {
+        const model_file::TensorEntry& entry = model.tensors[i];
+        params[i].value->wrap_storage(model.data(entry), entry.rows, entry.cols);
+    }
+    mapped_weights_ = model.file;
+    rebind_parameter_arena();
+    if (!arena_.empty()) {
+        mapped_weights_.reset(); // Веса скопированы в область
     }
-    // 4) Linear
-    linear_.save_weights(out);
-
-    out.close();
 }
\ No newline at end of file
@@ -5,40 +5,156 @@
 #include "Decoder.h"
 #include "Linear.h"
 #include "Softmax.h"
+#include "AdaptiveSoftmax.h"
+#include "ParameterArena.h"
+#include "Optimizer.h"
+#include "ModelFile.h"
+#include <memory>
 #include <vector>
 
 class Transformer {
 public:
     Transformer(int vocab_size, int embedding_dim, int num_layers, int num_heads, int hidden_dim);
+    // config.adaptive_cutoffs не пусто — выходной слой AdaptiveSoftmax вместо Linear + Softmax
+    // (id токенов должны идти по убыванию частоты, см. AdaptiveSoftmax::frequency_order)
+    explicit Transformer(const ModelConfig& config);
     void forward_propagation(const std::vector<int>& source_tokens, const std::vector<int>& target_tokens);
-    void backward_propagation(const std::vector<std::vector<float>>& target_one_hot, float learning_rate);
+    void backward_propagation(const Tensor& target_one_hot, float learning_rate);
 
-    ///  ( ),  ( )    
+    // Мини-батч из B пар (source, target) разной длины: последовательности дополняются до общей длины,
+    // позиции заполнения маскируются как ключи во всех видах внимания.
+    // Прямой проход заканчивается выходом декодера: вероятности по словарю не считаются и get_probabilities()
+    // не обновляется (проекция в словарь и softmax выполняются в backward_batch)
+    void forward_batch(const std::vector<std::vector<int>>& source_batch, const std::vector<std::vector<int>>& target_batch);
+    // label_batch[b] — метки для target_batch[b] той же длины. Loss и градиент считаются потоково кусками словаря
+    // без матриц seq x vocab (см. Linear::cross_entropy_head, AdaptiveSoftmax::cross_entropy); веса обновляются один раз.
+    // Нормировка у градиента и возвращаемого значения разная:
+    //  - градиент — от суммы cross-entropy по реальным токенам всех последовательностей, делённой на B
+    //    (при B = 1 совпадает с backward_propagation);
+    //  - возвращается средний loss на реальный токен (та же сумма, делённая на число реальных токенов).
+    // Если все метки < 0, возвращает 0, градиенты остаются нулевыми, а веса и оптимизатор не меняются
+    float backward_batch(const std::vector<std::vector<int>>& label_batch, float learning_rate);
+
+    // Инференс: encode один раз прогоняет энкодер и проецирует K/V cross-attention всех слоёв декодера,
+    // decode считает вероятности для всей целевой последовательности (target_len x vocab_size)
+    EncoderMemory encode(const std::vector<int>& source_tokens);
+    const Tensor& decode(const std::vector<int>& target_tokens, const EncoderMemory& memory);
+
+    // Пошаговая генерация с кэшем K/V: reset_decode_cache начинает новую последовательность,
+    // decode_step добавляет токен и возвращает вероятности следующего (1 x vocab_size)
+    void reset_decode_cache();
+    const Tensor& decode_step(int token, const EncoderMemory& memory);
+    // То же для жадной генерации: возвращает argmax следующего токена. С адаптивным softmax полное
+    // распределение не строится — хвостовые кластеры считаются только если могут содержать argmax
+    int decode_step_greedy(int token, const EncoderMemory& memory);
+    // Несколько токенов за один проход декодера (позиции подряд, причинная маска): для каждого — argmax
+    // следующего. Используется для проверки черновика в спекулятивном декодировании (см. SpeculativeDecoder)
+    std::vector<int> decode_steps_greedy(const std::vector<int>& tokens, const EncoderMemory& memory);
+    // Число позиций в кэше декодера и откат кэша до первых length позиций
+    int decode_length() const { return decode_pos_; }
+    void truncate_decode_cache(int length);
+    // Лучевой поиск (см. BeamSearch): все лучи проходят декодер одним батчем за шаг. tokens[b] — последний токен
+    // луча b, возвращаются вероятности следующего токена каждого луча (tokens.size() x vocab_size).
+    // reorder_decode_cache переставляет кэш K/V: новый луч b продолжает луч beams[b]
+    const Tensor& decode_beam_step(const std::vector<int>& tokens, const EncoderMemory& memory);
+    void reorder_decode_cache(const std::vector<int>& beams);
+
+    /// Инициализация (для обучения), загрузка (для инференса) и сохранение параметров модели.
+    // save_weights пишет файл модели (ModelFile.h) с архитектурой и таблицей тензоров; load_weights отображает
+    // такой файл в память и работает с весами на месте, без копирования (архитектура должна совпадать).
+    // Файлы прежнего формата (потоком, без заголовка) по-прежнему читаются
     void initialize_random();
     void load_weights(const std::string &path);
     void save_weights(const std::string& path) const;
+    const ModelConfig& config() const { return config_; }
+
+    // Режим накопления: backward_propagation / backward_batch не обновляют веса, а складывают градиенты
+    // в буферы параметров (обнуляет и применяет их вызывающий, см. DataParallelTrainer)
+    void set_gradient_accumulation(bool enabled);
+    // Все параметры модели в порядке save_weights
+    std::vector<ParameterRef> parameters();
+    // Включает накопление и переносит все параметры и их градиенты в одну непрерывную область.
+    // initialize_random и load_weights после этого заново собирают область (формы весов могут измениться)
+    void build_parameter_arena();
+    ParameterArena& parameter_arena() { return arena_; }
+    // Оптимизатор для backward_propagation / backward_batch: градиенты накапливаются в области параметров,
+    // затем делается один шаг Optimizer по всей области. Без вызова веса обновляются SGD прямо в backward
+    void set_optimizer(const OptimizerConfig& config);
+    // Режим смешанной точности: веса для прямого и обратного прохода берутся из bf16/fp16-копии в области
+    // параметров (создаётся при необходимости, без градиентов, если накопление выключено), входы линейных слоёв
+    // и нормализованные входы AddNorm сохраняются для backward в том же формате. Накопление в GEMM, градиенты,
+    // мастер-веса и шаг оптимизатора остаются во float32; копия обновляется после каждого изменения весов.
+    // Float32 — обычный режим
+    void set_precision(Precision format);
+    Precision precision() const { return arena_.precision(); }
 
-    //    
+    // Post-training int8-квантование для инференса: калибровочные пары (source, target) прогоняются через
+    // encode/decode, затем матрицы весов всех MHA, FeedForward и выходного Linear переводятся в int8
+    // (масштаб на выходной канал, статический масштаб входа по калибровке). Обучение после этого недоступно
+    void quantize_int8(const std::vector<std::vector<int>>& source_samples, const std::vector<std::vector<int>>& target_samples);
+    bool is_quantized() const { return quantized_; }
+    // Файл int8-модели: заголовок с архитектурой и блоки в порядке save_weights с int8-матрицами вместо float.
+    // load_quantized отвергает файл другой архитектуры и не хранит float-копии квантованных матриц
+    void save_quantized(const std::string& path) const;
+    void load_quantized(const std::string& path);
+    // Архитектура из заголовка файла int8-модели (исключение, если файл не int8-модель текущей версии)
+    static ModelConfig read_quantized_config(const std::string& path);
+
+    // Вывод весов для отладки
     const Embedding& get_embedding() const { return embedding_; }
     const Encoder& get_encoder() const { return encoder_; }
     const Decoder& get_decoder() const { return decoder_; }
     const Linear& get_linear() const { return linear_; }
+    const AdaptiveSoftmax* get_adaptive_softmax() const { return adaptive_.get(); }
 
-    const std::vector<std::vector<float>>& get_probabilities() const {return probabilities_; }
+    const Tensor& get_probabilities() const { return adaptive_ ? adaptive_probabilities_ : softmax_.probabilities(); }
 
 private:
+    // Эмбеддинги токенов с позиционным кодированием; start_pos — позиция первого токена
+    Tensor embed(const std::vector<int>& tokens, int start_pos = 0);
+    // То же для батча: позиции отсчитываются от начала каждой последовательности
+    Tensor embed(const std::vector<int>& tokens, const BatchLayout& layout);
+    // Склеивает последовательности в один вектор с заполнением до layout.max_len
+    static std::vector<int> pad_batch(const std::vector<std::vector<int>>& batch, const BatchLayout& layout, int pad_value);
+    // Пересобирает область параметров, если она уже была создана
+    void rebind_parameter_arena();
+    // Включает/выключает сбор диапазонов входов во всех квантуемых модулях
+    void set_calibration(bool enabled);
+    // Вероятности по словарю для выхода декодера (выходной слой Linear + Softmax или AdaptiveSoftmax)
+    const Tensor& output_probabilities(const Tensor& decoder_output);
+    // Общая часть обратного прохода от градиента по логитам
+    void backward_from_logits(const Tensor& grad_logits, float learning_rate);
+    // Обратный проход от градиента по выходу декодера: декодер, энкодер, эмбеддинги, шаг оптимизатора
+    void backward_from_decoder_output(const Tensor& grad_decoder_output, float learning_rate);
+    // Переводит параметры на веса отображённого в память файла модели
+    void map_weights(const std::string& path);
+
+    ModelConfig config_;
+
     Embedding embedding_;
     PositionalEncoding positional_encoding_;
     Encoder encoder_;
     Decoder decoder_;
-    Linear linear_;
+    Linear linear_;         // При адаптивном softmax — пустой (0 выходов)
     Softmax softmax_;
+    std::unique_ptr<AdaptiveSoftmax> adaptive_;
+    Tensor adaptive_probabilities_; // Результат output_probabilities при адаптивном softmax
 
-    //     backward
-    std::vector<std::vector<float>> probabilities_;
+    // Сохранение промежуточных результатов для backward
     std::vector<int> source_tokens_;
     std::vector<int> target_tokens_;
-    std::vector<std::vector<float>> input_embeddings;
-    std::vector<std::vector<float>> output_embeddings;
-    std::vector<std::vector<float>> encoder_output;
+    Tensor input_embeddings;
+    Tensor output_embeddings;
+    Tensor encoder_output;
+    Tensor decoder_output_; // Выход декодера forward_propagation / forward_batch (вход обучающей головы)
+    BatchLayout source_layout_;
+    BatchLayout target_layout_;
+    int decode_pos_ = 0; // Количество токенов, уже прошедших через decode_step
+
+    ParameterArena arena_;
+    std::unique_ptr<Optimizer> optimizer_;
+    bool accumulate_gradients_ = false;
+    bool quantized_ = false;
+    // Отображение файла модели, в котором лежат веса после load_weights (пока они не перенесены в область параметров)
+    std::shared_ptr<MappedFile> mapped_weights_;
 };
\ No newline at end of file
@@ -0,0 +1,250 @@
+﻿#include "Vocabulary.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    const char kMagic[4] = { 'T', 'F', 'V', 'C' };
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t token_count;
+        uint32_t bucket_count;
+        uint64_t seed;
+        uint64_t offsets_offset;        // Смещения разделов — от начала файла
+        uint64_t displacements_offset;
+        uint64_t slots_offset;
+        uint64_t strings_offset;
+        uint64_t file_size;             // Для проверки целостности (обрезанный файл)
+    };
+    static_assert(sizeof(FileHeader) == 64, "Заголовок словаря занимает 64 байта");
+
+    // Средний размер корзины: меньшие корзины быстрее размещаются, но таблица сдвигов больше
+    constexpr size_t kKeysPerBucket = 4;
+    // Сдвигов, перебираемых для одной корзины, прежде чем сменить затравку и начать заново
+    constexpr uint32_t kMaxDisplacement = 1u << 24;
+
+    uint64_t finalize(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // 64-битный хэш строки (FNV-1a с перемешиванием): старшая половина выбирает корзину
+    uint64_t hash_token(std::string_view token, uint64_t seed) {
+        uint64_t h = 0xcbf29ce484222325ull ^ seed;
+        for (char c : token) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ull;
+        }
+        return finalize(h);
+    }
+
+    size_t bucket_of(uint64_t hash, size_t bucket_count) {
+        return static_cast<size_t>((hash >> 32) % bucket_count);
+    }
+
+    size_t slot_of(uint64_t hash, uint32_t displacement, size_t slot_count) {
+        return static_cast<size_t>(finalize(hash + (displacement + 1ull) * 0x9e3779b97f4a7c15ull) % slot_count);
+    }
+
+    uint64_t align8(uint64_t value) {
+        return (value + 7) / 8 * 8;
+    }
+
+    // Подбирает сдвиги корзин так, чтобы ключи заняли слоты 0..n-1 взаимно однозначно.
+    // Корзины размещаются от больших к меньшим: у больших меньше шансов найти свободные слоты в конце.
+    // false — для какой-то корзины сдвиг не нашёлся (нужна другая затравка)
+    bool place_buckets(const std::vector<uint64_t>& hashes, size_t bucket_count,
+        std::vector<uint32_t>& displacements, std::vector<uint32_t>& slot_ids) {
+        const size_t n = hashes.size();
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (size_t id = 0; id < n; ++id) {
+            buckets[bucket_of(hashes[id], bucket_count)].push_back(static_cast<uint32_t>(id));
+        }
+        std::vector<uint32_t> order(bucket_count);
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+        displacements.assign(bucket_count, 0);
+        slot_ids.assign(n, 0);
+        std::vector<bool> taken(n, false);
+        std::vector<size_t> slots;
+        for (uint32_t bucket : order) {
+            const auto& keys = buckets[bucket];
+            if (keys.empty()) break;
+            bool placed = false;
+            for (uint32_t d = 0; d < kMaxDisplacement && !placed; ++d) {
+                slots.clear();
+                placed = true;
+                for (uint32_t id : keys) {
+                    size_t slot = slot_of(hashes[id], d, n);
+                    if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                        placed = false;
+                        break;
+                    }
+                    slots.push_back(slot);
+                }
+                if (placed) {
+                    displacements[bucket] = d;
+                    for (size_t k = 0; k < keys.size(); ++k) {
+                        taken[slots[k]] = true;
+                        slot_ids[slots[k]] = keys[k];
+                    }
+                }
+            }
+            if (!placed) return false;
+        }
+        return true;
+    }
+}
+
+Vocabulary::Vocabulary(const std::unordered_map<std::string, int>& vocab) {
+    const size_t n = vocab.size();
+    std::vector<const std::string*> tokens(n, nullptr);
+    for (const auto& [token, id] : vocab) {
+        if (id < 0 || static_cast<size_t>(id) >= n || tokens[id]) {
+            throw std::invalid_argument("Vocabulary: id токенов должны занимать 0.." + std::to_string(n) + "-1 без пропусков");
+        }
+        tokens[id] = &token;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.token_count = static_cast<uint32_t>(n);
+    header.bucket_count = static_cast<uint32_t>(n / kKeysPerBucket + 1);
+
+    std::vector<uint32_t> displacements, slot_ids;
+    std::vector<uint64_t> hashes(n);
+    for (uint64_t attempt = 0;; ++attempt) {
+        header.seed = finalize(attempt + 1);
+        for (size_t id = 0; id < n; ++id) {
+            hashes[id] = hash_token(*tokens[id], header.seed);
+        }
+        if (place_buckets(hashes, header.bucket_count, displacements, slot_ids)) break;
+        if (attempt == 16) {
+            throw std::runtime_error("Vocabulary: не удалось построить совершенную хэш-функцию (повторяющиеся токены?)");
+        }
+    }
+
+    uint64_t string_bytes = 0;
+    for (const std::string* token : tokens) string_bytes += token->size();
+    header.offsets_offset = sizeof(FileHeader);
+    header.displacements_offset = header.offsets_offset + (n + 1) * sizeof(uint64_t);
+    header.slots_offset = header.displacements_offset + header.bucket_count * sizeof(uint32_t);
+    header.strings_offset = header.slots_offset + n * sizeof(uint32_t);
+    header.file_size = header.strings_offset + string_bytes;
+
+    const size_t words = static_cast<size_t>(align8(header.file_size) / sizeof(uint64_t));
+    std::shared_ptr<uint64_t[]> buffer(new uint64_t[words]());
+    char* base = reinterpret_cast<char*>(buffer.get());
+    std::memcpy(base, &header, sizeof(header));
+    uint64_t* offsets = reinterpret_cast<uint64_t*>(base + header.offsets_offset);
+    char* strings = base + header.strings_offset;
+    offsets[0] = 0;
+    for (size_t id = 0; id < n; ++id) {
+        std::memcpy(strings + offsets[id], tokens[id]->data(), tokens[id]->size());
+        offsets[id + 1] = offsets[id] + tokens[id]->size();
+    }
+    std::memcpy(base + header.displacements_offset, displacements.data(), displacements.size() * sizeof(uint32_t));
+    std::memcpy(base + header.slots_offset, slot_ids.data(), slot_ids.size() * sizeof(uint32_t));
+
+    buffer_ = std::move(buffer);
+    attach(base, static_cast<size_t>(header.file_size), "словарь в памяти");
+}
+
+Vocabulary Vocabulary::open(const std::string& path) {
+    Vocabulary vocabulary;
+    vocabulary.file_ = std::make_shared<MappedFile>(path);
+    vocabulary.attach(vocabulary.file_->data(), vocabulary.file_->size(), path);
+    return vocabulary;
+}
+
+bool Vocabulary::is_vocabulary_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    return in && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+void Vocabulary::attach(const char* base, size_t bytes, const std::string& source) {
+    FileHeader header;
+    if (bytes < sizeof(header)) {
+        throw std::runtime_error("Файл не является словарём: " + source);
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        throw std::runtime_error("Файл не является словарём поддерживаемой версии: " + source);
+    }
+    const uint64_t n = header.token_count;
+    const bool layout_ok = header.file_size == bytes && header.bucket_count > 0
+        && header.offsets_offset == sizeof(FileHeader)
+        && header.displacements_offset == header.offsets_offset + (n + 1) * sizeof(uint64_t)
+        && header.slots_offset == header.displacements_offset + uint64_t(header.bucket_count) * sizeof(uint32_t)
+        && header.strings_offset == header.slots_offset + n * sizeof(uint32_t)
+        && header.strings_offset <= header.file_size;
+    if (!layout_ok) {
+        throw std::runtime_error("Размер словаря не совпадает с заголовком (файл повреждён): " + source);
+    }
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + header.offsets_offset);
+    const uint32_t* slot_ids = reinterpret_cast<const uint32_t*>(base + header.slots_offset);
+    // Смещения не убывают и не выходят за блок строк, id слотов в пределах словаря: дальше они не проверяются
+    bool valid = offsets[0] == 0 && offsets[n] == header.file_size - header.strings_offset;
+    for (uint64_t id = 0; valid && id < n; ++id) {
+        valid = offsets[id] <= offsets[id + 1] && slot_ids[id] < n;
+    }
+    if (!valid) {
+        throw std::runtime_error("Повреждённые разделы словаря: " + source);
+    }
+
+    base_ = base;
+    bytes_ = bytes;
+    size_ = static_cast<size_t>(n);
+    bucket_count_ = header.bucket_count;
+    seed_ = header.seed;
+    offsets_ = offsets;
+    displacements_ = reinterpret_cast<const uint32_t*>(base + header.displacements_offset);
+    slot_ids_ = slot_ids;
+    strings_ = base + header.strings_offset;
+}
+
+void Vocabulary::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+    if (base_) {
+        out.write(base_, bytes_);
+    }
+    else {
+        // Пустой словарь по умолчанию сохраняется как построенный из пустой таблицы
+        Vocabulary empty_vocabulary{ std::unordered_map<std::string, int>() };
+        out.write(empty_vocabulary.base_, empty_vocabulary.bytes_);
+    }
+    out.close();
+    if (!out) throw std::runtime_error("Ошибка записи словаря: " + path);
+}
+
+int Vocabulary::find(std::string_view token) const {
+    if (size_ == 0) return -1;
+    const uint64_t hash = hash_token(token, seed_);
+    const uint32_t displacement = displacements_[bucket_of(hash, bucket_count_)];
+    const int id = static_cast<int>(slot_ids_[slot_of(hash, displacement, size_)]);
+    // Совершенная хэш-функция без коллизий только на токенах словаря: чужая строка попадает в чей-то слот
+    return this->token(id) == token ? id : -1;
+}
+
+std::unordered_map<std::string, int> Vocabulary::to_map() const {
+    std::unordered_map<std::string, int> vocab;
+    vocab.reserve(size_);
+    for (size_t id = 0; id < size_; ++id) {
+        vocab.emplace(token(static_cast<int>(id)), static_cast<int>(id));
+    }
+    return vocab;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+﻿#pragma once
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Неизменяемый словарь BPE: токены по id в одной таблице строк и минимальная совершенная хэш-функция
+// (hash and displace) для поиска токен -> id. Раскладка в памяти совпадает с файлом, поэтому файл
+// отображается в память и используется на месте, без разбора и построения хэш-таблиц:
+//   заголовок (64 байта: сигнатура "TFVC", версия, число токенов, число корзин, затравка хэша, смещения разделов, размер файла);
+//   смещения строк (uint64, токенов + 1): токен id — байты [offsets[id], offsets[id + 1]) блока строк;
+//   сдвиги корзин (uint32): корзина ключа выбирает сдвиг, который переводит её ключи в свободные слоты;
+//   id по слоту (uint32, токенов): слотов ровно столько, сколько токенов;
+//   блок строк (байты токенов подряд, без разделителей).
+// Копия разделяет то же хранилище. Числа — little-endian, как и в остальных бинарных файлах проекта
+class Vocabulary {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    Vocabulary() = default;
+    // Из словаря обучения; id должны занимать 0..n-1 без пропусков
+    explicit Vocabulary(const std::unordered_map<std::string, int>& vocab);
+
+    // Отображает файл словаря в память (заголовок и разделы проверяются)
+    static Vocabulary open(const std::string& path);
+    // Файл начинается с сигнатуры двоичного словаря (у текстового vocab.txt её нет)
+    static bool is_vocabulary_file(const std::string& path);
+    void save(const std::string& path) const;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // id токена или -1, если его нет в словаре: одно вычисление хэша и одно сравнение строк
+    int find(std::string_view token) const;
+    bool contains(std::string_view token) const { return find(token) >= 0; }
+    // Токен по id — обращение к таблице по индексу; id должен быть в [0, size())
+    std::string_view token(int id) const {
+        return std::string_view(strings_ + offsets_[id], static_cast<size_t>(offsets_[id + 1] - offsets_[id]));
+    }
+
+    // Словарь токен -> id (для BPETrainer и кода, которому нужна изменяемая таблица)
+    std::unordered_map<std::string, int> to_map() const;
+
+private:
+    // Указатели на разделы хранилища base (раскладка файла), с проверкой границ
+    void attach(const char* base, size_t bytes, const std::string& source);
+
+    std::shared_ptr<MappedFile> file_;              // Хранилище открытого файла
+    std::shared_ptr<const uint64_t[]> buffer_;      // Или построенное в памяти (выравнивание 8 байт)
+    const char* base_ = nullptr;
+    size_t bytes_ = 0;
+
+    size_t size_ = 0;
+    uint32_t bucket_count_ = 0;
+    uint64_t seed_ = 0;
+    const uint64_t* offsets_ = nullptr;
+    const uint32_t* displacements_ = nullptr;
+    const uint32_t* slot_ids_ = nullptr;
+    const char* strings_ = nullptr;
+};
\ No newline at end of file
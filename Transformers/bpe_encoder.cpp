@@ -0,0 +1,117 @@
+﻿#include "bpe_encoder.h"
+#include <algorithm>
+#include <utility>
+
+BPEEncoder::BPEEncoder(const Vocabulary& vocab) {
+    // Дерево строится со списками рёбер у каждого узла, затем упаковывается в плоские массивы
+    std::vector<std::vector<std::pair<unsigned char, int>>> children(1);
+    std::vector<int> tokens(1, -1);
+    for (int id = 0; id < static_cast<int>(vocab.size()); ++id) {
+        std::string_view token = vocab.token(id);
+        int node = 0;
+        for (char ch : token) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            auto& edges = children[node];
+            auto it = std::find_if(edges.begin(), edges.end(), [c](const auto& edge) { return edge.first == c; });
+            if (it != edges.end()) {
+                node = it->second;
+                continue;
+            }
+            int next = static_cast<int>(children.size());
+            edges.emplace_back(c, next);
+            children.emplace_back();
+            tokens.push_back(-1);
+            node = next;
+        }
+        tokens[node] = id;
+    }
+
+    edge_begin_.reserve(children.size() + 1);
+    for (auto& edges : children) {
+        std::sort(edges.begin(), edges.end());
+        edge_begin_.push_back(static_cast<uint32_t>(edge_label_.size()));
+        for (const auto& [c, next] : edges) {
+            edge_label_.push_back(c);
+            edge_target_.push_back(next);
+        }
+    }
+    edge_begin_.push_back(static_cast<uint32_t>(edge_label_.size()));
+    token_ = std::move(tokens);
+}
+
+int BPEEncoder::child(int node, unsigned char c) const {
+    auto first = edge_label_.begin() + edge_begin_[node];
+    auto last = edge_label_.begin() + edge_begin_[node + 1];
+    auto it = std::lower_bound(first, last, c);
+    return it != last && *it == c ? edge_target_[it - edge_label_.begin()] : -1;
+}
+
+size_t BPEEncoder::encode_word(std::string_view word, std::vector<int>& ids, std::string* unknown) const {
+    // Слово разбирается вместе с меткой конца "</w>", как в обучении; строка word + "</w>" не строится
+    static const std::string_view kEndOfWord = "</w>";
+    const size_t length = word.size() + kEndOfWord.size();
+    auto byte_at = [&](size_t i) {
+        return static_cast<unsigned char>(i < word.size() ? word[i] : kEndOfWord[i - word.size()]);
+    };
+
+    size_t skipped = 0;
+    size_t start = 0;
+    while (start < length) {
+        // Самый длинный токен с началом в start: спуск по дереву, пока есть рёбра
+        int best_token = -1;
+        size_t best_end = start;
+        int node = 0;
+        for (size_t i = start; i < length; ++i) {
+            node = child(node, byte_at(i));
+            if (node < 0) break;
+            if (token_[node] >= 0) {
+                best_token = token_[node];
+                best_end = i + 1;
+            }
+        }
+        if (best_token >= 0) {
+            ids.push_back(best_token);
+            start = best_end;
+        }
+        else {
+            if (unknown) unknown->push_back(static_cast<char>(byte_at(start)));
+            ++skipped;
+            ++start;
+        }
+    }
+    return skipped;
+}
+
+BPEWordCache::BPEWordCache(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {
+}
+
+BPEWordCache& BPEWordCache::operator=(const BPEWordCache& other) {
+    capacity_ = other.capacity_;
+    index_.clear();
+    entries_.clear();
+    return *this;
+}
+
+const std::vector<int>* BPEWordCache::find(std::string_view word) {
+    auto it = index_.find(word);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+}
+
+void BPEWordCache::insert(std::string_view word, std::vector<int> ids) {
+    auto it = index_.find(word);
+    if (it != index_.end()) {
+        it->second->second = std::move(ids);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    entries_.emplace_front(std::string(word), std::move(ids));
+    index_.emplace(entries_.front().first, entries_.begin());
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+﻿#pragma once
+#include "Vocabulary.h"
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Разбиение слова на токены словаря жадным самым длинным совпадением (как BPETokenizer) по префиксному дереву
+// байтов токенов: один проход по слову от каждой позиции, без построения строк-кандидатов и поиска их в хэш-таблице.
+// Дерево хранится плоскими массивами (рёбра узла — отсортированный непрерывный диапазон), только для чтения:
+// один экземпляр можно использовать из нескольких потоков
+class BPEEncoder {
+public:
+    explicit BPEEncoder(const Vocabulary& vocab);
+
+    // Дописывает в ids токены слова word + "</w>". Байт, с которого не начинается ни один токен словаря,
+    // пропускается и дописывается в unknown (если задан). Возвращает число пропущенных байтов
+    size_t encode_word(std::string_view word, std::vector<int>& ids, std::string* unknown = nullptr) const;
+
+private:
+    // Потомок узла node по байту c или -1
+    int child(int node, unsigned char c) const;
+
+    std::vector<uint32_t> edge_begin_;      // Рёбра узла i — [edge_begin_[i], edge_begin_[i + 1])
+    std::vector<unsigned char> edge_label_;
+    std::vector<int> edge_target_;
+    std::vector<int> token_;                // id токена, который заканчивается в узле, или -1
+};
+
+// LRU-кэш слово -> id токенов: повторяющиеся слова не разбираются заново. Не потокобезопасен —
+// у каждого потока токенизации свой кэш
+class BPEWordCache {
+public:
+    explicit BPEWordCache(size_t capacity = 1 << 16);
+    // Копия — пустой кэш той же ёмкости: ключи index_ указывают на строки своего списка
+    BPEWordCache(const BPEWordCache& other) : capacity_(other.capacity_) {}
+    BPEWordCache& operator=(const BPEWordCache& other);
+    BPEWordCache(BPEWordCache&&) = default;
+    BPEWordCache& operator=(BPEWordCache&&) = default;
+
+    // Токены слова или nullptr; найденное слово становится самым свежим
+    const std::vector<int>* find(std::string_view word);
+    // Добавляет слово, вытесняя самое давнее при переполнении
+    void insert(std::string_view word, std::vector<int> ids);
+    size_t size() const { return entries_.size(); }
+
+private:
+    using Entry = std::pair<std::string, std::vector<int>>;
+    size_t capacity_;
+    std::list<Entry> entries_;              // От самого свежего к самому давнему
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_; // Ключи указывают на строки в entries_
+};
\ No newline at end of file
@@ -0,0 +1,204 @@
+﻿#include "bpe_incremental.h"
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+
+namespace bpe {
+    namespace {
+        using PairKey = uint64_t;
+
+        PairKey make_key(int a, int b) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+        }
+        int key_first(PairKey key) { return static_cast<int>(key >> 32); }
+        int key_second(PairKey key) { return static_cast<int>(key & 0xffffffffu); }
+
+        // Сравнение строк "a1 a2" < "b1 b2" без их построения (порядок пар при равной частоте)
+        bool joined_less(const std::string& a1, const std::string& a2, const std::string& b1, const std::string& b2) {
+            size_t a_size = a1.size() + 1 + a2.size();
+            size_t b_size = b1.size() + 1 + b2.size();
+            auto at = [](const std::string& first, const std::string& second, size_t i) {
+                if (i < first.size()) return first[i];
+                if (i == first.size()) return ' ';
+                return second[i - first.size() - 1];
+            };
+            for (size_t i = 0; i < a_size && i < b_size; ++i) {
+                char ca = at(a1, a2, i), cb = at(b1, b2, i);
+                if (ca != cb) return static_cast<unsigned char>(ca) < static_cast<unsigned char>(cb);
+            }
+            return a_size < b_size;
+        }
+
+        struct HeapEntry {
+            long long count;
+            PairKey key;
+        };
+
+        class Trainer {
+        public:
+            explicit Trainer(const std::vector<std::string_view>& texts) {
+                // Ключи указывают в сами тексты: слова не копируются
+                std::unordered_map<std::string_view, int> word_index;
+                for (std::string_view text : texts) {
+                    build_words(text, word_index);
+                }
+            }
+
+            MergeResult run(int num_merges);
+
+        private:
+            int intern(const std::string& symbol) {
+                auto it = symbol_ids_.find(symbol);
+                if (it != symbol_ids_.end()) return it->second;
+                int id = static_cast<int>(result_.symbols.size());
+                result_.symbols.push_back(symbol);
+                symbol_ids_.emplace(symbol, id);
+                return id;
+            }
+
+            // Уникальные слова с частотами; символы интернируются в порядке первого вхождения
+            void build_words(std::string_view text, std::unordered_map<std::string_view, int>& word_index) {
+                auto add_word = [&](std::string_view word, bool newline) {
+                    auto it = word_index.find(word);
+                    if (it != word_index.end()) {
+                        ++frequencies_[it->second];
+                        return;
+                    }
+                    std::vector<int> symbols;
+                    if (newline) {
+                        symbols.push_back(intern("<NL>"));
+                    }
+                    else {
+                        for (char c : word) symbols.push_back(intern(std::string(1, c)));
+                        symbols.push_back(intern("</w>"));
+                    }
+                    word_index.emplace(word, static_cast<int>(words_.size()));
+                    words_.push_back(std::move(symbols));
+                    frequencies_.push_back(1);
+                };
+                // Ключ "<NL>"-слова не может совпасть с обычным словом: в обычных словах нет '\n'
+                const std::string_view newline_key("\n");
+                size_t start = 0;
+                for (size_t i = 0; i < text.size(); ++i) {
+                    char c = text[i];
+                    if (c != ' ' && c != '\n') continue;
+                    if (i > start) add_word(text.substr(start, i - start), false);
+                    if (c == '\n') add_word(newline_key, true);
+                    start = i + 1;
+                }
+                if (start < text.size()) add_word(text.substr(start), false);
+            }
+
+            bool heap_less(const HeapEntry& a, const HeapEntry& b) const {
+                if (a.count != b.count) return a.count < b.count;
+                const auto& s = result_.symbols;
+                // Меньшая строка пары — выше в куче
+                return joined_less(s[key_first(b.key)], s[key_second(b.key)], s[key_first(a.key)], s[key_second(a.key)]);
+            }
+
+            void add_pairs(int word, long long sign, std::vector<PairKey>& changed) {
+                const std::vector<int>& symbols = words_[word];
+                for (size_t i = 0; i + 1 < symbols.size(); ++i) {
+                    PairKey key = make_key(symbols[i], symbols[i + 1]);
+                    pair_counts_[key] += sign * frequencies_[word];
+                    changed.push_back(key);
+                }
+            }
+
+            // Слияние (a, b) -> merged слева направо без перекрытий, как BPETrainer::merge_pair
+            static void merge_word(std::vector<int>& symbols, int a, int b, int merged) {
+                size_t out = 0;
+                for (size_t i = 0; i < symbols.size(); ++i) {
+                    if (i + 1 < symbols.size() && symbols[i] == a && symbols[i + 1] == b) {
+                        symbols[out++] = merged;
+                        ++i;
+                    }
+                    else {
+                        symbols[out++] = symbols[i];
+                    }
+                }
+                symbols.resize(out);
+            }
+
+            MergeResult result_;
+            std::unordered_map<std::string, int> symbol_ids_;
+            std::vector<std::vector<int>> words_;
+            std::vector<long long> frequencies_;
+            std::unordered_map<PairKey, long long> pair_counts_;
+            std::unordered_map<PairKey, std::vector<int>> pair_words_; // Слова, где пара встречалась (возможны устаревшие и повторы)
+        };
+
+        MergeResult Trainer::run(int num_merges) {
+            auto less = [this](const HeapEntry& a, const HeapEntry& b) { return heap_less(a, b); };
+            std::priority_queue<HeapEntry, std::vector<HeapEntry>, decltype(less)> heap(less);
+
+            std::vector<PairKey> changed;
+            for (int w = 0; w < static_cast<int>(words_.size()); ++w) {
+                add_pairs(w, 1, changed);
+                for (size_t i = 0; i + 1 < words_[w].size(); ++i) {
+                    pair_words_[make_key(words_[w][i], words_[w][i + 1])].push_back(w);
+                }
+            }
+            for (const auto& [key, count] : pair_counts_) {
+                heap.push({ count, key });
+            }
+
+            std::vector<int> visited(words_.size(), -1); // Номер слияния, на котором слово уже пересчитано
+            for (int merge = 0; merge < num_merges; ++merge) {
+                // Записи кучи с устаревшей частотой пропускаются (актуальная запись добавлена при изменении)
+                while (!heap.empty()) {
+                    auto it = pair_counts_.find(heap.top().key);
+                    if (it != pair_counts_.end() && it->second == heap.top().count && it->second > 0) break;
+                    heap.pop();
+                }
+                if (heap.empty() || heap.top().count <= 1) break;
+                PairKey best = heap.top().key;
+                heap.pop();
+
+                int a = key_first(best), b = key_second(best);
+                result_.merges.emplace_back(result_.symbols[a], result_.symbols[b]);
+                int merged = intern(result_.symbols[a] + result_.symbols[b]);
+
+                changed.clear();
+                std::vector<int> affected = std::move(pair_words_[best]);
+                pair_words_.erase(best);
+                for (int w : affected) {
+                    if (visited[w] == merge) continue;
+                    visited[w] = merge;
+                    add_pairs(w, -1, changed);
+                    merge_word(words_[w], a, b, merged);
+                    add_pairs(w, 1, changed);
+                    const std::vector<int>& symbols = words_[w];
+                    for (size_t i = 0; i + 1 < symbols.size(); ++i) {
+                        if (symbols[i] == merged || symbols[i + 1] == merged) {
+                            pair_words_[make_key(symbols[i], symbols[i + 1])].push_back(w);
+                        }
+                    }
+                }
+
+                std::sort(changed.begin(), changed.end());
+                changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+                for (PairKey key : changed) {
+                    auto it = pair_counts_.find(key);
+                    if (it->second == 0) {
+                        pair_counts_.erase(it);
+                    }
+                    else {
+                        heap.push({ it->second, key });
+                    }
+                }
+            }
+            return std::move(result_);
+        }
+    }
+
+    MergeResult train_incremental(std::string_view text, int num_merges) {
+        return train_incremental(std::vector<std::string_view>{ text }, num_merges);
+    }
+
+    MergeResult train_incremental(const std::vector<std::string_view>& texts, int num_merges) {
+        return Trainer(texts).run(num_merges);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+﻿#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Инкрементальное обучение BPE на целочисленных id символов.
+// Слова корпуса (как в BPETrainer: разделители ' ' и '\n', символы — байты, в конце слова "</w>", перевод строки —
+// отдельное слово "<NL>") хранятся один раз с частотой. Для каждой пары соседних символов известны её частота
+// и слова, где она встречается; после слияния пересчитываются только эти слова, лучшая пара берётся из max-кучи.
+// Результат совпадает с BPETrainer::train_naive: на каждом шаге сливается самая частая пара (частоты с учётом
+// перекрывающихся вхождений), при равной частоте — с меньшей строкой "a b"; обучение останавливается,
+// когда самая частая пара встречается не больше одного раза
+namespace bpe {
+    struct MergeResult {
+        // Токены в порядке появления: начальные символы по первому вхождению в текст, затем новые токены слияний
+        std::vector<std::string> symbols;
+        // Слияния по порядку (пара токенов, склеиваемая в новый)
+        std::vector<std::pair<std::string, std::string>> merges;
+    };
+
+    MergeResult train_incremental(std::string_view text, int num_merges);
+    // Корпус из нескольких текстов без склейки в одну строку (например, куски отображённых в память файлов):
+    // то же, что train_incremental по текстам, соединённым через ' '. Тексты должны жить до конца вызова
+    MergeResult train_incremental(const std::vector<std::string_view>& texts, int num_merges);
+}
\ No newline at end of file
@@ -1,5 +1,9 @@
 ﻿#pragma once
 
+#include "bpe_encoder.h"
+#include <atomic>
+#include <cstdint>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -7,67 +11,59 @@
 
 class BPETokenizer {
 public:
-    // Конструктор, принимающий обученный словарь
-    BPETokenizer(const std::unordered_map<std::string, int>& vocab) : vocab(vocab) {
-        // Создаем обратный словарь для декодирования
-        for (const auto& [token, id] : vocab) {
-            reverse_vocab[id] = token;
-        }
-    }
+    // Конструктор, принимающий обученный словарь. Vocabulary разделяет хранилище (например, отображённый vocab.bin):
+    // ни копии таблицы, ни обратного словаря не строится
+    BPETokenizer(const Vocabulary& vocab)
+        : vocabulary_(vocab), encoder(vocab), nl_id(vocab.find("<NL>")), instance_id(next_instance_id()) {}
+    BPETokenizer(const std::unordered_map<std::string, int>& vocab) : BPETokenizer(Vocabulary(vocab)) {}
+
+    const Vocabulary& vocabulary() const { return vocabulary_; }
 
-    // Токенизирует текст, возвращая вектор идентификаторов токенов
+    // Токенизирует текст, возвращая вектор идентификаторов токенов. Кэш слов свой у каждого потока
+    // (thread_local) и переживает вызовы, пока поток токенизирует тем же токенизатором (или его копией);
+    // при смене токенизатора кэш очищается. Общего изменяемого состояния нет: tokenize потокобезопасен
     std::vector<int> tokenize(const std::string& text) const {
+        struct ThreadCache {
+            uint64_t owner = 0;
+            BPEWordCache words;
+        };
+        thread_local ThreadCache thread_cache;
+        if (thread_cache.owner != instance_id) {
+            thread_cache.owner = instance_id;
+            thread_cache.words = BPEWordCache();
+        }
         std::vector<int> token_ids;
-        std::string word;
-        for (char c : text) {
-            if (c == ' ' || c == '\n') {
-                if (!word.empty()) {
-                    auto tokens = split_word(word + "</w>"); // Добавляем </w> как в обучении
-                    for (const auto& token : tokens) {
-                        if (vocab.find(token) != vocab.end()) {
-                            token_ids.push_back(vocab.at(token));
-                        }
-                        else {
-                            std::cerr << "Токен '" << token << "' не найден в словаре\n";
-                        }
-                    }
-                    word.clear();
-                }
-                if (c == '\n') {
-                    // добавляем специальный токен переноса строки, если он есть в словаре
-                    auto itnl = vocab.find("<NL>");
-                    if (itnl != vocab.end()) token_ids.push_back(itnl->second);
-                    else {
-                        // если <NL> нет — можно проигнорировать или логировать
-                        std::cerr << "Предупреждение: токен '<NL>' не найден в словаре (строка)\n";
-                    }
-                }
-            }
+        tokenize_into(text, token_ids, thread_cache.words);
+        return token_ids;
+    }
 
-            else {
-                word += c;
+    // То же с внешним кэшем слов (у каждого потока свой, см. BPEWordCache): id дописываются в token_ids
+    void tokenize_into(std::string_view text, std::vector<int>& token_ids, BPEWordCache& word_cache) const {
+        size_t start = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i < text.size() && text[i] != ' ' && text[i] != '\n') continue;
+            if (i > start) {
+                append_word(text.substr(start, i - start), token_ids, word_cache);
             }
-        }
-        if (!word.empty()) {
-            auto tokens = split_word(word + "</w>");
-            for (const auto& token : tokens) {
-                if (vocab.find(token) != vocab.end()) {
-                    token_ids.push_back(vocab.at(token));
-                }
+            if (i < text.size() && text[i] == '\n') {
+                // добавляем специальный токен переноса строки, если он есть в словаре
+                if (nl_id >= 0) token_ids.push_back(nl_id);
                 else {
-                    std::cerr << "Токен '" << token << "' не найден в словаре\n";
+                    // если <NL> нет — можно проигнорировать или логировать
+                    std::cerr << "Предупреждение: токен '<NL>' не найден в словаре (строка)\n";
                 }
             }
+            start = i + 1;
         }
-        return token_ids;
     }
 
-    // Декодирует вектор идентификаторов токенов обратно в текст
-    std::vector<std::string> decode(const std::vector<int>& tokens) {
+    // Декодирует вектор идентификаторов токенов обратно в текст (токен по id — индекс в таблице строк словаря)
+    std::vector<std::string> decode(const std::vector<int>& tokens) const {
         std::vector<std::string> decoded;
+        decoded.reserve(tokens.size());
         for (int id : tokens) {
-            if (reverse_vocab.find(id) != reverse_vocab.end()) {
-                decoded.push_back(reverse_vocab.at(id));
+            if (id >= 0 && static_cast<size_t>(id) < vocabulary_.size()) {
+                decoded.emplace_back(vocabulary_.token(id));
             }
             else {
                 std::cerr << "Идентификатор " << id << " не найден в словаре\n";
@@ -78,33 +74,34 @@ public:
     }
 
 private:
-    std::unordered_map<std::string, int> vocab;           // Словарь токенов и их идентификаторов
-    std::unordered_map<int, std::string> reverse_vocab;   // Обратный словарь для декодирования
+    Vocabulary vocabulary_;                               // Словарь: токен -> id и id -> токен
+    BPEEncoder encoder;                                   // Префиксное дерево токенов словаря
+    int nl_id = -1;                                       // id токена <NL> (-1 — нет в словаре)
+    uint64_t instance_id = 0;                             // Привязка кэша tokenize к словарю (у копий — общий)
 
-    // Разбивает слово на токены, соответствующие словарю
-    std::vector<std::string> split_word(const std::string& word) const {
-        std::vector<std::string> tokens;
-        size_t start = 0;
-        while (start < word.size()) {
-            std::string longest_token;
-            // Ищем самый длинный токен, начиная с текущей позиции
-            for (size_t end = word.size(); end > start; --end) {
-                std::string candidate = word.substr(start, end - start);
-                if (vocab.find(candidate) != vocab.end()) {
-                    longest_token = candidate;
-                    break;
-                }
-            }
-            if (!longest_token.empty()) {
-                tokens.push_back(longest_token);
-                start += longest_token.size();
-            }
-            else {
-                // Если токен не найден, добавляем первый символ и продолжаем
-                tokens.push_back(std::string(1, word[start]));
-                ++start;
+    // Номера не повторяются: кэш потока не может достаться токенизатору с другим словарём по тому же адресу
+    static uint64_t next_instance_id() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Дописывает токены слова (с меткой "</w>", как в обучении): из кэша или разбором самым длинным совпадением
+    void append_word(std::string_view word, std::vector<int>& token_ids, BPEWordCache& word_cache) const {
+        if (const std::vector<int>* cached = word_cache.find(word)) {
+            token_ids.insert(token_ids.end(), cached->begin(), cached->end());
+            return;
+        }
+        std::vector<int> ids;
+        std::string unknown;
+        if (encoder.encode_word(word, ids, &unknown) > 0) {
+            for (char c : unknown) {
+                std::cerr << "Токен '" << c << "' не найден в словаре\n";
             }
         }
-        return tokens;
+        else {
+            // Слова с неизвестными символами не кэшируются: сообщение об ошибке выводится при каждом вхождении
+            word_cache.insert(word, ids);
+        }
+        token_ids.insert(token_ids.end(), ids.begin(), ids.end());
     }
 };
\ No newline at end of file
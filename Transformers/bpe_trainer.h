@@ -1,8 +1,12 @@
 ﻿#pragma once
 
+#include "bpe_incremental.h"
+#include "Vocabulary.h"
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <iostream>
 
@@ -11,8 +15,26 @@ public:
     // Конструктор
     BPETrainer() {}
 
-    // Обучает словарь BPE на основе текста с заданным числом объединений
+    // Обучает словарь BPE на основе текста с заданным числом объединений.
+    // Инкрементально на id символов (см. bpe::train_incremental), результат тот же, что у train_naive
     void train(const std::string& text, int num_merges) {
+        train(std::vector<std::string_view>{ text }, num_merges);
+    }
+
+    // То же по нескольким текстам без их склейки (как по текстам, соединённым через ' ')
+    void train(const std::vector<std::string_view>& texts, int num_merges) {
+        bpe::MergeResult result = bpe::train_incremental(texts, num_merges);
+        for (const auto& token : result.symbols) {
+            if (vocab.find(token) == vocab.end()) {
+                vocab[token] = vocab.size();
+            }
+        }
+        merges.insert(merges.end(), result.merges.begin(), result.merges.end());
+    }
+
+    // Исходный алгоритм: на каждом объединении частоты всех пар пересчитываются по всему корпусу строк.
+    // O(число объединений x размер корпуса) — оставлен как эталон для проверки train
+    void train_naive(const std::string& text, int num_merges) {
         std::vector<std::vector<std::string>> corpus = build_corpus(text);
 
         // Инициализируем словарь начальными символами
@@ -38,7 +60,8 @@ public:
             int max_count = 0;
             for (const auto& [pair, count] : pairs) {
                 //std::cout << pair << " " << count << " " << "\n";
-                if (count > max_count) {
+                // При равной частоте — меньшая строка пары (порядок обхода unordered_map не определён)
+                if (count > max_count || (count == max_count && pair < max_pair)) {
                     max_count = count;
                     max_pair = pair;
                     //std::cout << max_pair << " ";
@@ -48,6 +71,7 @@ public:
             merge_pair(corpus, max_pair);
             // Добавляем новый токен в словарь
             size_t space_pos = max_pair.find(' ');
+            merges.emplace_back(max_pair.substr(0, space_pos), max_pair.substr(space_pos + 1));
             std::string merged = max_pair.substr(0, space_pos) + max_pair.substr(space_pos + 1);
             if (vocab.find(merged) == vocab.end()) {
                 vocab[merged] = vocab.size();
@@ -60,21 +84,51 @@ public:
         return vocab;
     }
 
-    // Сохраняет словарь в файл
+    // Словарь в неизменяемом виде для токенизатора и декодера (см. Vocabulary)
+    Vocabulary get_vocabulary() const {
+        return Vocabulary(vocab);
+    }
+
+    // Объединения в порядке обучения (ранг объединения — его номер)
+    const std::vector<std::pair<std::string, std::string>>& get_merges() const {
+        return merges;
+    }
+
+    // Перенумеровывает токены: id -> new_id[id] (например, по убыванию частоты, см. AdaptiveSoftmax::frequency_order)
+    void remap_ids(const std::vector<int>& new_id) {
+        for (auto& [token, id] : vocab) {
+            id = new_id.at(id);
+        }
+    }
+
+    // Сохраняет словарь в текстовый файл (строки "токен id" по возрастанию id)
     void save_vocab(const std::string& filename) const {
         std::ofstream out(filename);
         if (!out.is_open()) {
             std::cerr << "Ошибка: не удалось открыть файл " << filename << std::endl;
             return;
         }
-        for (const auto& [token, id] : vocab) {
-            out << token << " " << id << "\n";
+        std::vector<const std::pair<const std::string, int>*> by_id;
+        by_id.reserve(vocab.size());
+        for (const auto& entry : vocab) by_id.push_back(&entry);
+        std::sort(by_id.begin(), by_id.end(), [](const auto* a, const auto* b) { return a->second < b->second; });
+        for (const auto* entry : by_id) {
+            out << entry->first << " " << entry->second << "\n";
         }
         out.close();
     }
 
-    // Загружает словарь из файла
+    // Сохраняет словарь в двоичном формате Vocabulary (отображается в память при загрузке)
+    void save_vocab_binary(const std::string& filename) const {
+        get_vocabulary().save(filename);
+    }
+
+    // Загружает словарь из файла: двоичного (Vocabulary) или текстового
     void load_vocab(const std::string& filename) {
+        if (Vocabulary::is_vocabulary_file(filename)) {
+            vocab = Vocabulary::open(filename).to_map();
+            return;
+        }
         std::ifstream in(filename);
         if (!in.is_open()) {
             std::cerr << "Ошибка: не удалось открыть файл " << filename << std::endl;
@@ -100,6 +154,7 @@ public:
 
 private:
     std::unordered_map<std::string, int> vocab; // Словарь токенов и их идентификаторов
+    std::vector<std::pair<std::string, std::string>> merges; // Объединения в порядке обучения
 
     // Строит начальный корпус из текста, разбивая на символы
     std::vector<std::vector<std::string>> build_corpus(const std::string& text) {
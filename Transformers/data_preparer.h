@@ -1,6 +1,7 @@
 #pragma once
 
 #include "bpe_tokenizer.h"
+#include "CorpusTokenizer.h"
 
 #include <vector>
 #include <string>
@@ -8,45 +9,68 @@
 
 class DataPreparer {
 public:
-    // ,    
+    // Конструктор, принимающий словарь (общий с токенизатором)
+    DataPreparer(const Vocabulary& vocab)
+        : tokenizer(vocab) {}
     DataPreparer(const std::unordered_map<std::string, int>& vocab)
-        : tokenizer(vocab), vocab(vocab) {}
+        : tokenizer(vocab) {}
 
-    //  source_tokens:   
-    std::vector<int> prepare_source(const std::string& text) {
-        return tokenizer.tokenize(text);
+    // Подготовка source_tokens: просто токенизация текста (большой текст — параллельно, см. CorpusTokenizer.h)
+    std::vector<int> prepare_source(std::string_view text) {
+        return corpus::tokenize(tokenizer, text);
     }
 
-    //  target_tokens:     <BOS>  <EOS>
-    std::vector<int> prepare_target(const std::string& text,
+    // Каждая строка (см. corpus::split_lines) — отдельная последовательность source
+    std::vector<std::vector<int>> prepare_source_lines(const std::vector<std::string_view>& lines) {
+        return corpus::tokenize_lines(tokenizer, lines);
+    }
+
+    // Подготовка target_tokens: токенизация текста и добавление <BOS> и <EOS>
+    std::vector<int> prepare_target(std::string_view text,
+        const std::string& bos_token,
+        const std::string& eos_token) {
+        return add_bos_eos(corpus::tokenize(tokenizer, text), bos_token, eos_token);
+    }
+
+    // То же для каждой строки
+    std::vector<std::vector<int>> prepare_target_lines(const std::vector<std::string_view>& lines,
         const std::string& bos_token,
         const std::string& eos_token) {
-        std::vector<int> tokens = tokenizer.tokenize(text);
+        std::vector<std::vector<int>> token_ids = corpus::tokenize_lines(tokenizer, lines);
+        for (auto& tokens : token_ids) {
+            tokens = add_bos_eos(std::move(tokens), bos_token, eos_token);
+        }
+        return token_ids;
+    }
+
+private:
+    BPETokenizer tokenizer; // Создание токенизатора (словарь — tokenizer.vocabulary())
+
+    std::vector<int> add_bos_eos(std::vector<int> tokens,
+        const std::string& bos_token,
+        const std::string& eos_token) {
+        const Vocabulary& vocab = tokenizer.vocabulary();
         std::vector<int> result;
 
-        //  <BOS>,       
-        if (!bos_token.empty() && vocab.find(bos_token) != vocab.end()) {
-            result.push_back(vocab.at(bos_token));
+        // Добавляем <BOS>, если он указан и есть в словаре
+        if (!bos_token.empty() && vocab.contains(bos_token)) {
+            result.push_back(vocab.find(bos_token));
         }
         else if (!bos_token.empty()) {
-            std::cerr << ":  '" << bos_token << "'    .\n";
+            std::cerr << "Предупреждение: токен '" << bos_token << "' не найден в словаре.\n";
         }
 
-        //   
+        // Добавляем токены текста
         result.insert(result.end(), tokens.begin(), tokens.end());
 
-        //  <EOS>,       
-        if (!eos_token.empty() && vocab.find(eos_token) != vocab.end()) {
-            result.push_back(vocab.at(eos_token));
+        // Добавляем <EOS>, если он указан и есть в словаре
+        if (!eos_token.empty() && vocab.contains(eos_token)) {
+            result.push_back(vocab.find(eos_token));
         }
         else if (!eos_token.empty()) {
-            std::cerr << ":  '" << eos_token << "'    .\n";
+            std::cerr << "Предупреждение: токен '" << eos_token << "' не найден в словаре.\n";
         }
 
         return result;
     }
-
-private:
-    BPETokenizer tokenizer; //  
-    const std::unordered_map<std::string, int>& vocab; //   
 };
\ No newline at end of file
@@ -1,45 +1,52 @@
 #include "utils.h"
+#include "Gemm.h"
+#include "ThreadPool.h"
 #include <algorithm>
 
 namespace utils {
-    std::vector<std::vector<float>> add_embeddings(const std::vector<std::vector<float>>& input_emb,
-        const std::vector<std::vector<float>>& pos_enc) {
-        if (input_emb.size() != pos_enc.size() || input_emb[0].size() != pos_enc[0].size()) {
+    Tensor add_embeddings(ConstTensorView input_emb, ConstTensorView pos_enc) {
+        if (input_emb.rows() != pos_enc.rows() || input_emb.cols() != pos_enc.cols()) {
             throw std::invalid_argument("Input Embedding and Positional Encoding must have the same dimensions");
         }
-        std::vector<std::vector<float>> sum(input_emb.size(), std::vector<float>(input_emb[0].size()));
-        for (size_t i = 0; i < input_emb.size(); ++i) {
-            for (size_t j = 0; j < input_emb[i].size(); ++j) {
+        Tensor sum(input_emb.rows(), input_emb.cols());
+        for (size_t i = 0; i < input_emb.rows(); ++i) {
+            for (size_t j = 0; j < input_emb.cols(); ++j) {
                 sum[i][j] = input_emb[i][j] + pos_enc[i][j];
             }
         }
         return sum;
     }
 
-    std::vector<std::vector<float>> matrix_multiply(const std::vector<std::vector<float>>& A,
-        const std::vector<std::vector<float>>& B) {
-        size_t m = A.size();
-        size_t n = A[0].size();
-        size_t p = B[0].size();
-        if (n != B.size()) {
+    Tensor matrix_multiply(const MatrixOperand& A, const MatrixOperand& B, bool transpose_a, bool transpose_b) {
+        Tensor C(transpose_a ? A.cols : A.rows, transpose_b ? B.rows : B.cols);
+        gemm(transpose_a, transpose_b, 1.0f, A, B, 0.0f, C);
+        return C;
+    }
+
+    void matrix_multiply(const MatrixOperand& A, const MatrixOperand& B, TensorView C) {
+        gemm(false, false, 1.0f, A, B, 0.0f, C);
+    }
+
+    void gemm(bool transpose_a, bool transpose_b, float alpha, const MatrixOperand& A, const MatrixOperand& B, float beta, TensorView C) {
+        size_t m = transpose_a ? A.cols : A.rows;
+        size_t n = transpose_a ? A.rows : A.cols;
+        size_t p = transpose_b ? B.rows : B.cols;
+        if (n != (transpose_b ? B.cols : B.rows)) {
             throw std::invalid_argument("Matrix dimensions do not match for multiplication");
         }
-        std::vector<std::vector<float>> C(m, std::vector<float>(p, 0.0f));
-        for (size_t i = 0; i < m; ++i) {
-            for (size_t j = 0; j < p; ++j) {
-                for (size_t k = 0; k < n; ++k) {
-                    C[i][j] += A[i][k] * B[k][j];
-                }
-            }
+        if (C.rows() != m || C.cols() != p) {
+            throw std::invalid_argument("Output matrix has wrong dimensions");
         }
-        return C;
+        // Блочное SIMD-умножение (см. Gemm.h)
+        gemm::sgemm(transpose_a, transpose_b, m, p, n, alpha,
+            gemm::Operand{ A.data, A.stride, A.format }, gemm::Operand{ B.data, B.stride, B.format }, beta, C.data(), C.stride());
     }
 
-    //  :  
-    std::vector<std::vector<float>> transpose(const std::vector<std::vector<float>>& M) {
-        size_t rows = M.size();
-        size_t cols = M[0].size();
-        std::vector<std::vector<float>> M_T(cols, std::vector<float>(rows));
+    // Вспомогательная функция: транспонирование матрицы
+    Tensor transpose(ConstTensorView M) {
+        size_t rows = M.rows();
+        size_t cols = M.cols();
+        Tensor M_T(cols, rows);
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
                 M_T[j][i] = M[i][j];
@@ -48,8 +55,38 @@ namespace utils {
         return M_T;
     }
 
-    //     one hot   
-    std::vector<std::vector<float>> one_hot_encode(const std::vector<int>& tokens, int vocab_size) {
+    // Суммы по столбцам для градиентов смещений
+    std::vector<float> column_sums(ConstTensorView M) {
+        size_t rows = M.rows();
+        size_t cols = M.cols();
+        ThreadPool& pool = ThreadPool::instance();
+        return pool.parallel_reduce(0, rows, ThreadPool::grain_size(rows, cols), std::vector<float>(cols, 0.0f),
+            [&](size_t row_begin, size_t row_end) {
+                std::vector<float> partial(cols, 0.0f);
+                for (size_t i = row_begin; i < row_end; ++i) {
+                    for (size_t j = 0; j < cols; ++j) {
+                        partial[j] += M[i][j];
+                    }
+                }
+                return partial;
+            },
+            [](std::vector<float> acc, const std::vector<float>& partial) {
+                for (size_t j = 0; j < acc.size(); ++j) acc[j] += partial[j];
+                return acc;
+            });
+    }
+
+    void apply_gradient(float* value, float* grad_sum, const float* grad, size_t count, float learning_rate, bool accumulate) {
+        if (accumulate) {
+            for (size_t i = 0; i < count; ++i) grad_sum[i] += grad[i];
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) value[i] -= learning_rate * grad[i];
+        }
+    }
+
+    // Преобразование целевой последовательности в one hot матрицу для обучения
+    Tensor one_hot_encode(const std::vector<int>& tokens, int vocab_size) {
         if (tokens.empty()) {
             throw std::invalid_argument("Tokens vector cannot be empty");
         }
@@ -58,47 +95,52 @@ namespace utils {
                 throw std::out_of_range("Token index out of range");
             }
         }
-        std::vector<std::vector<float>> one_hot(tokens.size(), std::vector<float>(vocab_size, 0.0f));
+        Tensor one_hot(tokens.size(), vocab_size, 0.0f);
         for (size_t i = 0; i < tokens.size(); ++i) {
             one_hot[i][tokens[i]] = 1.0f;
         }
         return one_hot;
     }
 
-    //      
-    std::vector<int> probs_to_tokens(const std::vector<std::vector<float>>& probs) {
-        if (probs.empty()) {
+    // Преобразование матрицы вероятностей в вектор токенов
+    std::vector<int> probs_to_tokens(ConstTensorView probs) {
+        if (probs.rows() == 0) {
             throw std::invalid_argument("Probabilities matrix cannot be empty");
         }
+        if (probs.cols() == 0) {
+            throw std::invalid_argument("Probability row cannot be empty");
+        }
         std::vector<int> tokens;
-        for (const auto& prob_row : probs) {
-            if (prob_row.empty()) {
-                throw std::invalid_argument("Probability row cannot be empty");
-            }
-            //    
-            auto max_it = std::max_element(prob_row.begin(), prob_row.end());
-            int token_id = std::distance(prob_row.begin(), max_it);
+        for (size_t i = 0; i < probs.rows(); ++i) {
+            // Находим индекс максимальной вероятности
+            const float* prob_row = probs[i];
+            const float* max_it = std::max_element(prob_row, prob_row + probs.cols());
+            int token_id = int(max_it - prob_row);
             tokens.push_back(token_id);
         }
         return tokens;
     }
 
-    void write_matrix(std::ofstream& out, const std::vector<std::vector<float>>& M) {
-        int rows = (int)M.size();
-        int cols = rows ? (int)M[0].size() : 0;
+    void write_matrix(std::ofstream& out, ConstTensorView M) {
+        int rows = (int)M.rows();
+        int cols = (int)M.cols();
         out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
         out.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
-        for (auto& row : M)
-            out.write(reinterpret_cast<const char*>(row.data()), sizeof(float) * cols);
+        if (M.is_contiguous()) {
+            out.write(reinterpret_cast<const char*>(M.data()), sizeof(float) * rows * cols);
+            return;
+        }
+        for (int i = 0; i < rows; ++i)
+            out.write(reinterpret_cast<const char*>(M[i]), sizeof(float) * cols);
     }
 
-    void read_matrix(std::ifstream& in, std::vector<std::vector<float>>& M) {
+    void read_matrix(std::ifstream& in, Tensor& M) {
         int rows, cols;
         in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
         in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
-        M.assign(rows, std::vector<float>(cols));
-        for (auto& row : M)
-            in.read(reinterpret_cast<char*>(row.data()), sizeof(float) * cols);
+        M.resize(rows, cols);
+        // Матрица непрерывна — читаем одним вызовом
+        in.read(reinterpret_cast<char*>(M.data()), sizeof(float) * rows * cols);
     }
 
     void write_vector(std::ofstream& out, const std::vector<float>& v) {
@@ -113,4 +155,17 @@ namespace utils {
         v.resize(n);
         in.read(reinterpret_cast<char*>(v.data()), sizeof(float) * n);
     }
+
+    void write_vector(std::ofstream& out, const Tensor& v) {
+        int n = (int)v.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(v.data()), sizeof(float) * n);
+    }
+
+    void read_vector(std::ifstream& in, Tensor& v) {
+        int n;
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        v.resize(1, n);
+        in.read(reinterpret_cast<char*>(v.data()), sizeof(float) * n);
+    }
 }
\ No newline at end of file
@@ -1,18 +1,34 @@
 #pragma once
+#include "Tensor.h"
+#include "Precision.h"
 #include <vector>
 #include <stdexcept>
 #include <fstream>
 
 namespace utils {
-    //  
-    std::vector<std::vector<float>> add_embeddings(const std::vector<std::vector<float>>& input_emb, const std::vector<std::vector<float>>& pos_enc);
-    std::vector<std::vector<float>> matrix_multiply(const std::vector<std::vector<float>>& A, const std::vector<std::vector<float>>& B);
-    std::vector<std::vector<float>> transpose(const std::vector<std::vector<float>>& M);
-    std::vector<std::vector<float>> one_hot_encode(const std::vector<int>& tokens, int vocab_size);
-    std::vector<int> probs_to_tokens(const std::vector<std::vector<float>>& probs);
+    // Объявления функций
+    Tensor add_embeddings(ConstTensorView input_emb, ConstTensorView pos_enc);
+    // op(A) * op(B), где op — транспонирование по флагу; транспонированная копия не создаётся.
+    // Операнды могут быть float или bf16/fp16 (см. Precision.h), результат и накопление — float
+    Tensor matrix_multiply(const MatrixOperand& A, const MatrixOperand& B, bool transpose_a = false, bool transpose_b = false);
+    // C = A * B с записью результата в уже выделенную память (например, в блок другой матрицы)
+    void matrix_multiply(const MatrixOperand& A, const MatrixOperand& B, TensorView C);
+    // C = alpha * op(A) * op(B) + beta * C (в стиле BLAS)
+    void gemm(bool transpose_a, bool transpose_b, float alpha, const MatrixOperand& A, const MatrixOperand& B, float beta, TensorView C);
+    Tensor transpose(ConstTensorView M);
+    // Суммы по столбцам (градиент смещения): строки делятся между потоками, частичные суммы складываются по порядку
+    std::vector<float> column_sums(ConstTensorView M);
+    // Градиент параметра из count элементов: при accumulate складывается в grad_sum (шаг сделает тренер
+    // после сведения градиентов), иначе сразу шаг SGD value -= learning_rate * grad
+    void apply_gradient(float* value, float* grad_sum, const float* grad, size_t count, float learning_rate, bool accumulate);
+    Tensor one_hot_encode(const std::vector<int>& tokens, int vocab_size);
+    std::vector<int> probs_to_tokens(ConstTensorView probs);
 
-    void write_matrix(std::ofstream& out, const std::vector<std::vector<float>>& M);
-    void read_matrix(std::ifstream& in, std::vector<std::vector<float>>& M);
+    void write_matrix(std::ofstream& out, ConstTensorView M);
+    void read_matrix(std::ifstream& in, Tensor& M);
     void write_vector(std::ofstream& out, const std::vector<float>& v);
     void read_vector(std::ifstream& in, std::vector<float>& v);
+    // Вектор-строка 1 x n в том же формате, что и std::vector<float>
+    void write_vector(std::ofstream& out, const Tensor& v);
+    void read_vector(std::ifstream& in, Tensor& v);
 }
\ No newline at end of file
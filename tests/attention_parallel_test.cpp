@@ -0,0 +1,99 @@
+﻿#include "MultiHeadAttention.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Обратный проход внимания делит голову по блокам ключей, когда пар (последовательность, голова) меньше,
+// чем потоков: вклады блоков в dQ суммируются в порядке блоков. Проверка: при 1 потоке (голова целиком)
+// и при 5 и 8 потоках (2 последовательности x 2 головы — деление) выходы и все градиенты совпадают побитно
+
+static const int kEmbedding = 32, kHeads = 2;
+static const float kLearningRate = 0.0f;
+
+static void fill_normal(Tensor& t, std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    for (size_t i = 0; i < t.size(); ++i) t.data()[i] = normal(rng);
+}
+
+// Градиент по строкам заполнения нулевой: в loss они не входят
+static Tensor padded_gradient(const BatchLayout& layout, std::mt19937& rng) {
+    Tensor grad(layout.rows(), kEmbedding);
+    fill_normal(grad, rng);
+    for (int b = 0; b < layout.batch_size(); ++b) {
+        for (int t = layout.lengths[b]; t < layout.max_len; ++t) {
+            for (int j = 0; j < kEmbedding; ++j) grad[b * layout.max_len + t][j] = 0.0f;
+        }
+    }
+    return grad;
+}
+
+// Выход, градиенты по входам и накопленные градиенты весов одного прямого и обратного прохода
+struct PassResult {
+    std::vector<Tensor> tensors;
+};
+
+static void copy_weights(MultiHeadAttention& target, MultiHeadAttention& source) {
+    std::vector<ParameterRef> to, from;
+    target.collect_parameters(to);
+    source.collect_parameters(from);
+    for (size_t p = 0; p < to.size(); ++p) *to[p].value = *from[p].value;
+}
+
+static PassResult run_pass(MultiHeadAttention& reference, bool cross, const Tensor& X, const Tensor& KV,
+    const BatchLayout& q_layout, const BatchLayout& kv_layout, const Tensor& grad) {
+    MultiHeadAttention mha(kHeads, kEmbedding);
+    mha.set_gradient_accumulation(true);
+    copy_weights(mha, reference);
+    PassResult result;
+    if (cross) {
+        result.tensors.push_back(mha.forward_mha(X, KV, q_layout, kv_layout));
+        auto grads = mha.backward_mha(grad, X, KV, kLearningRate);
+        result.tensors.push_back(grads.first);
+        result.tensors.push_back(grads.second);
+    }
+    else {
+        result.tensors.push_back(mha.forward_mha(X, true, q_layout));
+        result.tensors.push_back(mha.backward_mha(grad, X, kLearningRate));
+    }
+    std::vector<ParameterRef> params;
+    mha.collect_parameters(params);
+    for (const ParameterRef& param : params) result.tensors.push_back(*param.grad);
+    return result;
+}
+
+int main() {
+    std::mt19937 rng(9);
+    const BatchLayout q_layout = BatchLayout::from_lengths({ 300, 170 });
+    const BatchLayout kv_layout = BatchLayout::from_lengths({ 130, 200 });
+    Tensor X(q_layout.rows(), kEmbedding), KV(kv_layout.rows(), kEmbedding);
+    fill_normal(X, rng);
+    fill_normal(KV, rng);
+    const Tensor grad = padded_gradient(q_layout, rng);
+    MultiHeadAttention reference(kHeads, kEmbedding);
+    reference.initialize_random();
+
+    int failures = 0;
+    for (bool cross : { false, true }) {
+        const char* name = cross ? "cross-attention" : "causal self-attention";
+        ThreadPool::set_num_threads(1);
+        PassResult serial = run_pass(reference, cross, X, KV, q_layout, kv_layout, grad);
+        for (size_t threads : { 5, 8 }) {
+            ThreadPool::set_num_threads(threads);
+            PassResult parallel = run_pass(reference, cross, X, KV, q_layout, kv_layout, grad);
+            for (size_t i = 0; i < serial.tensors.size(); ++i) {
+                double difference = max_difference(serial.tensors[i], parallel.tensors[i]);
+                if (difference != 0.0) {
+                    std::printf("FAIL %s, %zu threads: result %zu differs from one thread by %g\n", name, threads, i, difference);
+                    ++failures;
+                }
+            }
+        }
+    }
+    std::printf("attention_parallel_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
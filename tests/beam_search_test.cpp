@@ -0,0 +1,123 @@
+﻿#include "BeamSearch.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static const int kBos = 0, kEos = 1;
+
+// Сумма log p токенов tokens после prefix по полному (без кэша K/V) проходу decode
+static double full_log_prob(Transformer& model, const EncoderMemory& memory, const std::vector<int>& prefix,
+    const std::vector<int>& tokens) {
+    std::vector<int> input = prefix;
+    input.insert(input.end(), tokens.begin(), tokens.end() - 1);
+    const Tensor& probabilities = model.decode(input, memory);
+    double log_prob = 0.0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        log_prob += std::log(static_cast<double>(probabilities[prefix.size() - 1 + i][tokens[i]]));
+    }
+    return log_prob;
+}
+
+// log p гипотез лучевого поиска совпадают с полным проходом decode; ширина 1 — жадный вывод
+static int check_against_decode(std::mt19937& rng) {
+    Transformer model(ModelConfig::make(30, 32, 2, 4, 64));
+    model.initialize_random();
+    std::vector<int> source(9);
+    for (int& token : source) token = rng() % 30;
+    const std::vector<int> prefix = { kBos };
+    EncoderMemory memory = model.encode(source);
+    int failures = 0;
+
+    BeamSearchConfig config;
+    config.beam_width = 4;
+    config.max_length = 12;
+    double worst = 0.0;
+    for (const BeamHypothesis& hypothesis : BeamSearch(config).search(model, memory, prefix, kEos)) {
+        double expected = full_log_prob(model, memory, prefix, hypothesis.tokens);
+        worst = std::max(worst, std::fabs(hypothesis.log_prob - expected) / std::max(1.0, std::fabs(expected)));
+    }
+    if (!(worst < 1e-4)) {
+        std::printf("FAIL beam log-probabilities differ from the full decode by %g (relative)\n", worst);
+        ++failures;
+    }
+
+    config.beam_width = 1;
+    std::vector<int> beam = BeamSearch(config).search(model, memory, prefix, kEos).front().tokens;
+    std::vector<int> greedy;
+    model.reset_decode_cache();
+    int token = prefix.back();
+    for (int step = 0; step < config.max_length && token != kEos; ++step) {
+        token = model.decode_step_greedy(token, memory);
+        greedy.push_back(token);
+    }
+    if (beam != greedy) {
+        std::printf("FAIL beam width 1 differs from greedy decoding (%zu vs %zu tokens)\n", beam.size(), greedy.size());
+        ++failures;
+    }
+    return failures;
+}
+
+// Малый словарь и длина: лучевой поиск с шириной не меньше числа всех живых префиксов
+// находит ту же лучшую гипотезу, что полный перебор последовательностей
+static int check_exhaustive(std::mt19937& rng) {
+    const int vocab = 4, max_length = 3;
+    Transformer model(ModelConfig::make(vocab, 16, 1, 2, 32));
+    model.initialize_random();
+    std::vector<int> source(5);
+    for (int& token : source) token = rng() % vocab;
+    const std::vector<int> prefix = { kBos };
+    EncoderMemory memory = model.encode(source);
+
+    // Перебор: последовательности, закончившиеся EOS, и незаконченные длины max_length
+    double best = -INFINITY;
+    std::vector<int> best_tokens;
+    std::vector<int> tokens;
+    std::function<void()> extend = [&] {
+        for (int token = 0; token < vocab; ++token) {
+            tokens.push_back(token);
+            if (token == kEos || static_cast<int>(tokens.size()) == max_length) {
+                double log_prob = full_log_prob(model, memory, prefix, tokens);
+                if (log_prob > best) {
+                    best = log_prob;
+                    best_tokens = tokens;
+                }
+            }
+            else {
+                extend();
+            }
+            tokens.pop_back();
+        }
+    };
+    extend();
+
+    BeamSearchConfig config;
+    config.beam_width = 64;
+    config.max_length = max_length;
+    config.length_penalty = 0.0f;
+    BeamHypothesis found = BeamSearch(config).search(model, memory, prefix, kEos).front();
+    if (found.tokens != best_tokens || !(std::fabs(found.log_prob - best) < 1e-4)) {
+        std::printf("FAIL beam search found log p %g (%zu tokens), exhaustive optimum %g (%zu tokens)\n",
+            found.log_prob, found.tokens.size(), best, best_tokens.size());
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    std::mt19937 rng(11);
+    int failures = 0;
+    for (int trial = 0; trial < 3; ++trial) {
+        failures += check_against_decode(rng);
+        failures += check_exhaustive(rng);
+    }
+    std::printf("beam_search_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+﻿#include "bpe_encoder.h"
+#include "bpe_tokenizer.h"
+#include <memory>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Эталон — прежний разбор BPETokenizer::split_word: от каждой позиции самая длинная подстрока из словаря
+// (перебор длин через substr); байт, с которого не начинается ни один токен, пропускается
+static void reference_split(const std::unordered_map<std::string, int>& vocab, const std::string& word,
+    std::vector<int>& ids, std::string& unknown) {
+    size_t start = 0;
+    while (start < word.size()) {
+        bool found = false;
+        for (size_t end = word.size(); end > start; --end) {
+            auto it = vocab.find(word.substr(start, end - start));
+            if (it != vocab.end()) {
+                ids.push_back(it->second);
+                start = end;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            unknown += word[start];
+            ++start;
+        }
+    }
+}
+
+static std::string random_string(std::mt19937& rng, const std::vector<std::string>& pieces, int max_pieces) {
+    std::string string;
+    const int count = 1 + static_cast<int>(rng() % max_pieces);
+    for (int i = 0; i < count; ++i) string += pieces[rng() % pieces.size()];
+    return string;
+}
+
+// Кэш слов tokenize живёт между вызовами в потоке: токенизаторы с разными словарями по очереди
+// (и новый токенизатор, возможно, по адресу удалённого) не должны получать разборы чужого словаря
+static int check_tokenizer_cache() {
+    const std::string text = "abc ab\nba abc cab";
+    const std::unordered_map<std::string, int> first_vocab = { { "a", 0 }, { "b", 1 }, { "c", 2 }, { "ab", 3 }, { "abc</w>", 4 },
+        { "<NL>", 5 }, { "</w>", 6 } };
+    const std::unordered_map<std::string, int> second_vocab = { { "</w>", 0 }, { "c", 1 }, { "b", 2 }, { "a", 3 }, { "<NL>", 4 } };
+    auto expected = [&](const BPETokenizer& tokenizer) {
+        std::vector<int> ids;
+        BPEWordCache fresh;
+        tokenizer.tokenize_into(text, ids, fresh);
+        return ids;
+    };
+    int failures = 0;
+    auto first = std::make_unique<BPETokenizer>(first_vocab);
+    const BPETokenizer second(second_vocab);
+    for (int round = 0; round < 3; ++round) {
+        if (first->tokenize(text) != expected(*first) || first->tokenize(text) != expected(*first)
+            || second.tokenize(text) != expected(second)) {
+            std::printf("FAIL tokenize with a persistent cache differs from a fresh cache (round %d)\n", round);
+            ++failures;
+        }
+        first = std::make_unique<BPETokenizer>(round % 2 ? first_vocab : second_vocab);
+    }
+    return failures;
+}
+
+int main() {
+    std::mt19937 rng(8);
+    // В словарь попадают только куски из vocab_pieces; слова собираются и из байтов, которых в словаре нет
+    const std::vector<std::string> vocab_pieces = { "a", "b", "c", "o", "\xd0\xbf", "\xd1\x80", "<", "/", "w", ">" };
+    std::vector<std::string> word_pieces = vocab_pieces;
+    for (const char* missing : { "x", "\xd0\xb6", "\xff", "\x01" }) word_pieces.push_back(missing);
+
+    int failures = 0, words_with_unknown = 0;
+    for (int trial = 0; trial < 200; ++trial) {
+        // Словарь: одиночные куски (не все), случайные склейки, часть — с меткой конца слова "</w>"
+        std::unordered_map<std::string, int> vocab;
+        auto add = [&](const std::string& token) { vocab.emplace(token, static_cast<int>(vocab.size())); };
+        for (const std::string& piece : vocab_pieces) {
+            if (rng() % 4 != 0) add(piece);
+        }
+        const int merged = static_cast<int>(rng() % 60);
+        for (int i = 0; i < merged; ++i) {
+            std::string token = random_string(rng, vocab_pieces, 4);
+            if (rng() % 2 == 0) token += "</w>";
+            add(token);
+        }
+        if (rng() % 2 == 0) add("</w>");
+        const Vocabulary vocabulary(vocab);
+        const BPEEncoder encoder(vocabulary);
+
+        for (int w = 0; w < 50; ++w) {
+            const std::string word = random_string(rng, word_pieces, 8);
+            std::vector<int> expected_ids, ids = { -7 };
+            std::string expected_unknown, unknown;
+            reference_split(vocab, word + "</w>", expected_ids, expected_unknown);
+            const size_t skipped = encoder.encode_word(word, ids, &unknown);
+            ids.erase(ids.begin()); // encode_word дописывает, а не перезаписывает
+            words_with_unknown += !expected_unknown.empty();
+            if (ids != expected_ids || unknown != expected_unknown || skipped != expected_unknown.size()) {
+                std::printf("FAIL trial %d word '%s': %zu ids (%zu skipped) instead of %zu (%zu skipped)\n",
+                    trial, word.c_str(), ids.size(), skipped, expected_ids.size(), expected_unknown.size());
+                ++failures;
+            }
+        }
+    }
+    failures += check_tokenizer_cache();
+    if (words_with_unknown == 0) {
+        std::printf("FAIL no word contained bytes missing from the vocabulary\n");
+        ++failures;
+    }
+    std::printf("bpe_encoder_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+﻿#include "bpe_trainer.h"
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Случайный текст из слогов (в том числе многобайтовых UTF-8 и знаков препинания) с одиночными и двойными
+// пробелами и переводами строк
+static std::string random_text(std::mt19937& rng, bool full_alphabet) {
+    static const std::vector<std::string> syllables = {
+        "ka", "to", "ri", "ma", "na", "a", "aa", "b", "\xd0\xbf\xd1\x80", "\xd0\xb8", ".", ","
+    };
+    const size_t alphabet = full_alphabet ? syllables.size() : 4;
+    std::string text;
+    int words = 50 + rng() % 400;
+    for (int w = 0; w < words; ++w) {
+        int length = 1 + rng() % 4;
+        for (int i = 0; i < length; ++i) text += syllables[rng() % alphabet];
+        int separator = rng() % 10;
+        text += separator == 0 ? "\n" : separator == 1 ? "  " : separator == 2 ? "\n\n" : " ";
+    }
+    return text;
+}
+
+// Обучение по нескольким текстам без склейки (куски отображённого корпуса) совпадает с обучением
+// по тем же текстам, соединённым через ' ' (в том числе когда текст не заканчивается разделителем)
+static int check_text_views(std::mt19937& rng) {
+    int failures = 0;
+    for (int trial = 0; trial < 20; ++trial) {
+        std::string first = random_text(rng, true), second = random_text(rng, true);
+        if (trial % 2 == 1) first.pop_back();
+        std::vector<std::string_view> texts = { first, second };
+        bpe::MergeResult joined = bpe::train_incremental(first + " " + second, 60);
+        bpe::MergeResult views = bpe::train_incremental(texts, 60);
+        if (joined.symbols != views.symbols || joined.merges != views.merges) {
+            std::printf("FAIL trial %d: training on text views differs from training on the joined text\n", trial);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// BPETrainer::train (инкрементально на id символов) совпадает с эталоном train_naive: те же словарь и слияния,
+// включая порядок при равной частоте и остановку, когда пары перестают повторяться
+int main() {
+    std::mt19937 rng(7);
+    int failures = 0;
+    for (int trial = 0; trial < 40; ++trial) {
+        std::string text = random_text(rng, trial % 2 == 1);
+        if (trial % 3 == 0) text += "tail";
+        int merges = 1 + rng() % 200;
+
+        BPETrainer incremental, naive;
+        // train_naive печатает отладочный вывод
+        std::ostringstream sink;
+        std::streambuf* console = std::cout.rdbuf(sink.rdbuf());
+        incremental.train(text, merges);
+        naive.train_naive(text, merges);
+        std::cout.rdbuf(console);
+
+        if (incremental.get_vocab() != naive.get_vocab() || incremental.get_merges() != naive.get_merges()) {
+            std::printf("FAIL trial %d: %zu merges vs %zu in train_naive\n", trial, incremental.get_merges().size(), naive.get_merges().size());
+            ++failures;
+        }
+    }
+    failures += check_text_views(rng);
+    std::printf("bpe_trainer_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
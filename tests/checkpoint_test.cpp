@@ -0,0 +1,113 @@
+﻿#include "Checkpoint.h"
+#include "DataParallelTrainer.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+using Batch = std::vector<std::vector<int>>;
+
+static const int kVocab = 60, kEmbedding = 32, kLayers = 2, kHeads = 4, kHidden = 64;
+static const char* kPath = "checkpoint_test.bin";
+
+static OptimizerConfig adam_config() {
+    OptimizerConfig config;
+    config.type = OptimizerType::Adam;
+    config.clip_norm = 1.0f;
+    return config;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    std::mt19937 rng(1);
+    Batch source, target, labels;
+    for (int b = 0; b < 4; ++b) {
+        std::vector<int> s(6 + b), t(5 + b);
+        for (int& token : s) token = rng() % kVocab;
+        for (int& token : t) token = rng() % kVocab;
+        source.push_back(s);
+        target.emplace_back(t.begin(), t.end() - 1);
+        labels.emplace_back(t.begin() + 1, t.end());
+    }
+    std::filesystem::remove(kPath);
+    int failures = 0;
+
+    // Непрерывные 10 шагов с фоновой контрольной точкой после 5-го; продолжение с неё должно дать те же веса
+    DataParallelTrainer uninterrupted(kVocab, kEmbedding, kLayers, kHeads, kHidden, 2);
+    uninterrupted.initialize_random();
+    uninterrupted.set_optimizer(adam_config());
+    {
+        CheckpointWriter writer(kPath, std::chrono::seconds(0));
+        for (int epoch = 0; epoch < 10; ++epoch) {
+            uninterrupted.train_step(source, target, labels, 0.001f);
+            if (epoch == 4) uninterrupted.save_checkpoint(writer, 5);
+        }
+        writer.wait();
+    }
+
+    DataParallelTrainer resumed(kVocab, kEmbedding, kLayers, kHeads, kHidden, 2);
+    resumed.set_optimizer(adam_config());
+    long long epoch = resumed.load_checkpoint(kPath);
+    for (long long e = epoch; e < 10; ++e) {
+        resumed.train_step(source, target, labels, 0.001f);
+    }
+    const ParameterArena& a = uninterrupted.model().parameter_arena();
+    const ParameterArena& b = resumed.model().parameter_arena();
+    double difference = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference = std::max(difference, static_cast<double>(std::fabs(a.values()[i] - b.values()[i])));
+    }
+    if (epoch != 5 || difference != 0.0) {
+        std::printf("FAIL resume: epoch %lld, max weight difference vs uninterrupted run %g\n", epoch, difference);
+        ++failures;
+    }
+
+    // Точка не подходит: другой тип оптимизатора, другая архитектура, обрезанный файл
+    if (!throws([] {
+        DataParallelTrainer other(kVocab, kEmbedding, kLayers, kHeads, kHidden, 1);
+        other.set_optimizer(OptimizerConfig());
+        other.load_checkpoint(kPath);
+    })) {
+        std::printf("FAIL checkpoint with another optimizer type was accepted\n");
+        ++failures;
+    }
+    if (!throws([] {
+        DataParallelTrainer other(kVocab, kEmbedding, kLayers, 2, kHidden, 1);
+        other.set_optimizer(adam_config());
+        other.load_checkpoint(kPath);
+    })) {
+        std::printf("FAIL checkpoint of another architecture was accepted\n");
+        ++failures;
+    }
+    std::filesystem::resize_file(kPath, std::filesystem::file_size(kPath) - 4);
+    if (!throws([] {
+        DataParallelTrainer other(kVocab, kEmbedding, kLayers, kHeads, kHidden, 1);
+        other.set_optimizer(adam_config());
+        other.load_checkpoint(kPath);
+    })) {
+        std::printf("FAIL truncated checkpoint was accepted\n");
+        ++failures;
+    }
+
+    // Ошибка фоновой записи доходит до вызывающего
+    {
+        CheckpointWriter writer("missing_directory/checkpoint.bin", std::chrono::seconds(0));
+        uninterrupted.save_checkpoint(writer, 1);
+        if (!throws([&] { writer.wait(); })) {
+            std::printf("FAIL background write error was not reported\n");
+            ++failures;
+        }
+    }
+
+    std::printf("checkpoint_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+﻿#include "Linear.h"
+#include "Softmax.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Linear::cross_entropy_head (куски словаря, онлайн log-sum-exp) против плотного пути: логиты rows x vocab,
+// Softmax, backward_cross_entropy и backward_linear. Словарь — несколько кусков с неполным последним,
+// логиты крупные (проверка устойчивости log-sum-exp), часть строк — заполнение
+static int check_head(bool accumulate, std::mt19937& rng) {
+    const int rows = 300, dim = 64, vocab = 2000;
+    const float scale = 0.25f, learning_rate = 0.1f;
+    std::normal_distribution<float> normal;
+
+    Linear dense(dim, vocab), streamed(dim, vocab);
+    dense.initialize_random();
+    std::vector<ParameterRef> dense_params, streamed_params;
+    dense.collect_parameters(dense_params);
+    streamed.collect_parameters(streamed_params);
+    for (size_t p = 0; p < dense_params.size(); ++p) {
+        *streamed_params[p].value = *dense_params[p].value;
+    }
+    dense.set_gradient_accumulation(accumulate);
+    streamed.set_gradient_accumulation(accumulate);
+
+    Tensor X(rows, dim);
+    for (size_t i = 0; i < X.size(); ++i) X.data()[i] = 3.0f * normal(rng);
+    std::vector<int> labels(rows);
+    for (int i = 0; i < rows; ++i) labels[i] = i % 7 == 0 ? -1 : static_cast<int>(rng() % vocab);
+
+    Softmax softmax;
+    const Tensor& probabilities = softmax.forward_softmax(dense.forward_linear(X));
+    double expected_loss = 0.0;
+    for (int i = 0; i < rows; ++i) {
+        if (labels[i] >= 0) expected_loss -= std::log(static_cast<double>(probabilities[i][labels[i]]));
+    }
+    Tensor expected_grad_input = dense.backward_linear(softmax.backward_cross_entropy(labels, scale), learning_rate);
+
+    Tensor grad_input;
+    float loss = streamed.cross_entropy_head(X, labels, scale, learning_rate, grad_input);
+
+    double loss_error = std::fabs(loss - expected_loss) / expected_loss;
+    double input_error = max_difference(grad_input, expected_grad_input);
+    double param_error = 0.0;
+    for (size_t p = 0; p < dense_params.size(); ++p) {
+        param_error = std::max(param_error, accumulate ? max_difference(*dense_params[p].grad, *streamed_params[p].grad)
+            : max_difference(*dense_params[p].value, *streamed_params[p].value));
+    }
+    // Суммы по строкам идут в другом порядке, поэтому сравнение с допуском float
+    if (!(loss_error < 1e-5) || !(input_error < 1e-4) || !(param_error < 1e-4)) {
+        std::printf("FAIL cross_entropy_head accumulate=%d: loss %g vs %g, grad_input error %g, %s error %g\n",
+            accumulate, loss, expected_loss, input_error, accumulate ? "gradient" : "weight", param_error);
+        return 1;
+    }
+    return 0;
+}
+
+// Softmax::backward_cross_entropy по распределению совпадает с прежним составным путём через якобиан softmax
+static int check_softmax_targets(std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    Softmax softmax;
+    Tensor logits(5, 11);
+    for (size_t i = 0; i < logits.size(); ++i) logits.data()[i] = normal(rng);
+    softmax.forward_softmax(logits);
+    Tensor one_hot(5, 11, 0.0f);
+    for (int i = 0; i < 5; ++i) one_hot[i][i] = 1.0f;
+    Tensor composite = softmax.backward_softmax(softmax.probabilities(), softmax.compute_grad_output_model(one_hot));
+    double error = max_difference(composite, softmax.backward_cross_entropy(one_hot));
+    if (!(error < 1e-6)) {
+        std::printf("FAIL backward_cross_entropy(targets): error %g\n", error);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    std::mt19937 rng(3);
+    int failures = check_head(false, rng) + check_head(true, rng) + check_softmax_targets(rng);
+    std::printf("cross_entropy_head_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+﻿#include "DataParallelTrainer.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+using Batch = std::vector<std::vector<int>>;
+
+static const int kVocab = 40, kEmbedding = 16, kLayers = 2, kHeads = 4, kHidden = 32;
+static const float kLearningRate = 0.05f;
+static const char* kInitialWeights = "data_parallel_init.bin";
+
+// Эталон: одна модель, градиент backward_batch по всему батчу и шаг SGD вручную
+static float reference_steps(Transformer& model, const Batch& source, const Batch& target, const Batch& labels, int steps) {
+    model.set_gradient_accumulation(true);
+    auto params = model.parameters();
+    float loss = 0.0f;
+    for (int step = 0; step < steps; ++step) {
+        for (auto& param : params) param.grad->fill(0.0f);
+        model.forward_batch(source, target);
+        loss = model.backward_batch(labels, kLearningRate);
+        for (auto& param : params) {
+            for (size_t i = 0; i < param.value->size(); ++i) {
+                param.value->data()[i] -= kLearningRate * param.grad->data()[i];
+            }
+        }
+    }
+    return loss;
+}
+
+// Любое число реплик (больше и меньше батча) даёт те же веса и loss, что эталон
+static int check_matches_single_model(const Batch& source, const Batch& target, const Batch& labels, const char* name) {
+    Transformer reference(kVocab, kEmbedding, kLayers, kHeads, kHidden);
+    reference.load_weights(kInitialWeights);
+    float reference_loss = reference_steps(reference, source, target, labels, 3);
+    auto reference_params = reference.parameters();
+
+    int failures = 0;
+    for (int replicas : { 1, 2, 3, 7, 9 }) {
+        DataParallelTrainer trainer(kVocab, kEmbedding, kLayers, kHeads, kHidden, replicas);
+        trainer.load_weights(kInitialWeights);
+        float loss = 0.0f;
+        for (int step = 0; step < 3; ++step) {
+            loss = trainer.train_step(source, target, labels, kLearningRate);
+        }
+        double difference = max_difference(reference_params, trainer.model().parameters());
+        if (!(difference < 1e-5) || !(std::fabs(loss - reference_loss) < 1e-4f)) {
+            std::printf("FAIL %s replicas=%d: max weight difference %g, loss %g vs %g\n", name, replicas, difference, loss, reference_loss);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Батч без реальных токенов: loss 0, шага оптимизатора нет (Adam сдвинул бы веса и на нулевом градиенте)
+static int check_padding_only_batch(const Batch& source, const Batch& target) {
+    int failures = 0;
+    DataParallelTrainer trainer(kVocab, kEmbedding, kLayers, kHeads, kHidden, 2);
+    OptimizerConfig adam;
+    adam.type = OptimizerType::Adam;
+    trainer.set_optimizer(adam);
+    trainer.load_weights(kInitialWeights);
+
+    Batch padding;
+    for (const auto& sequence : target) padding.emplace_back(sequence.size(), -1);
+    Transformer initial(kVocab, kEmbedding, kLayers, kHeads, kHidden);
+    initial.load_weights(kInitialWeights);
+
+    float loss = trainer.train_step(source, target, padding, kLearningRate);
+    double difference = max_difference(initial.parameters(), trainer.model().parameters());
+    if (loss != 0.0f || difference != 0.0) {
+        std::printf("FAIL padding-only batch: loss %g, max weight difference %g\n", loss, difference);
+        ++failures;
+    }
+
+    size_t expected_count = 0;
+    for (const auto& param : initial.parameters()) expected_count += param.value->size();
+    if (trainer.parameter_count() != expected_count) {
+        std::printf("FAIL parameter_count %zu, expected %zu\n", trainer.parameter_count(), expected_count);
+        ++failures;
+    }
+    return failures;
+}
+
+int main() {
+    ThreadPool::set_num_threads(4);
+    std::mt19937 rng(5);
+    Batch source, target, labels;
+    for (int b = 0; b < 7; ++b) {
+        std::vector<int> s(3 + rng() % 9), t(2 + rng() % 8), l(t.size());
+        for (int& token : s) token = 1 + rng() % (kVocab - 1);
+        for (int& token : t) token = 1 + rng() % (kVocab - 1);
+        for (int& token : l) token = 1 + rng() % (kVocab - 1);
+        source.push_back(s);
+        target.push_back(t);
+        labels.push_back(l);
+    }
+    {
+        Transformer initial(kVocab, kEmbedding, kLayers, kHeads, kHidden);
+        initial.initialize_random();
+        initial.save_weights(kInitialWeights);
+    }
+
+    int failures = check_matches_single_model(source, target, labels, "full batch");
+    // Последовательности без реальных токенов (у части реплик нет ни одного)
+    Batch partly_padded = labels;
+    for (int b : { 0, 1, 5 }) {
+        std::fill(partly_padded[b].begin(), partly_padded[b].end(), -1);
+    }
+    failures += check_matches_single_model(source, target, partly_padded, "partly padded batch");
+    failures += check_padding_only_batch(source, target);
+
+    std::printf("data_parallel_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
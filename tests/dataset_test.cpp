@@ -0,0 +1,199 @@
+﻿#include "BatchLoader.h"
+#include "Dataset.h"
+#include "test_util.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+using Pair = std::pair<std::vector<int>, std::vector<int>>;
+
+static const int kVocab = 50;
+static const size_t kPairsPerShard = 100;
+static const char* kDirectory = "dataset_test_data";
+
+static void write_dataset(const std::vector<Pair>& pairs, size_t count) {
+    DatasetWriter writer(kDirectory, kVocab, kPairsPerShard);
+    for (size_t i = 0; i < count; ++i) {
+        writer.add(pairs[i].first, pairs[i].second);
+    }
+    writer.finish();
+}
+
+// target целиком из батча: вход декодера и последняя метка
+static std::vector<int> full_target(const Batch& batch, size_t k) {
+    std::vector<int> target = batch.target[k];
+    target.push_back(batch.labels[k].back());
+    return target;
+}
+
+// Загрузчик: каждая эпоха проходит каждую пару ровно один раз, метки — target со сдвигом на один токен,
+// last_in_epoch отмечает конец каждой эпохи по порядку; эпохи перемешаны по-разному,
+// продолжение с first_epoch повторяет порядок непрерывного прохода
+static int check_loader(const Dataset& data, const std::vector<Pair>& pairs) {
+    int failures = 0;
+    BatchLoaderConfig config;
+    config.batch_size = 32;
+    config.num_epochs = 3;
+    config.seed = 7;
+
+    std::vector<std::vector<std::vector<int>>> order(config.num_epochs);
+    {
+        BatchLoader loader(data, config);
+        Batch batch;
+        long long last_finished = -1;
+        while (loader.next(batch)) {
+            for (size_t k = 0; k < batch.source.size(); ++k) {
+                std::vector<int> target = full_target(batch, k);
+                if (std::vector<int>(target.begin() + 1, target.end()) != batch.labels[k]) {
+                    std::printf("FAIL labels are not the target shifted by one token\n");
+                    ++failures;
+                }
+                order[batch.epoch].push_back(target);
+            }
+            if (batch.last_in_epoch) {
+                if (batch.epoch != last_finished + 1) {
+                    std::printf("FAIL epoch %lld finished out of order\n", batch.epoch);
+                    ++failures;
+                }
+                last_finished = batch.epoch;
+            }
+        }
+        if (last_finished != config.num_epochs - 1) {
+            std::printf("FAIL last finished epoch %lld\n", last_finished);
+            ++failures;
+        }
+    }
+
+    std::map<std::vector<int>, int> expected_counts;
+    for (const Pair& pair : pairs) ++expected_counts[pair.second];
+    for (long long epoch = 0; epoch < config.num_epochs; ++epoch) {
+        std::map<std::vector<int>, int> counts;
+        for (const auto& target : order[epoch]) ++counts[target];
+        if (counts != expected_counts) {
+            std::printf("FAIL epoch %lld does not cover every pair exactly once\n", epoch);
+            ++failures;
+        }
+    }
+    if (order[0] == order[1]) {
+        std::printf("FAIL epochs 0 and 1 have the same order\n");
+        ++failures;
+    }
+
+    BatchLoaderConfig resumed_config = config;
+    resumed_config.first_epoch = 2;
+    BatchLoader resumed(data, resumed_config);
+    Batch batch;
+    std::vector<std::vector<int>> resumed_order;
+    while (resumed.next(batch)) {
+        for (size_t k = 0; k < batch.source.size(); ++k) resumed_order.push_back(full_target(batch, k));
+    }
+    if (resumed_order != order[2]) {
+        std::printf("FAIL resumed epoch order differs from the uninterrupted run\n");
+        ++failures;
+    }
+
+    // Загрузчик разрушается, не дойдя до конца эпох
+    BatchLoaderConfig endless = config;
+    endless.num_epochs = 1000000;
+    endless.batch_size = 1;
+    BatchLoader early(data, endless);
+    early.next(batch);
+    return failures;
+}
+
+int main() {
+    std::filesystem::remove_all(kDirectory);
+    std::mt19937 rng(3);
+    std::vector<Pair> pairs;
+    for (int i = 0; i < 1003; ++i) {
+        std::vector<int> source(1 + rng() % 7), target(2 + rng() % 6);
+        for (int& token : source) token = rng() % kVocab;
+        for (int& token : target) token = rng() % kVocab;
+        target[0] = i % kVocab;
+        pairs.emplace_back(source, target);
+    }
+    int failures = 0;
+
+    write_dataset(pairs, pairs.size());
+    {
+        Dataset data(kDirectory);
+        if (data.size() != pairs.size() || data.shard_count() != (pairs.size() + kPairsPerShard - 1) / kPairsPerShard) {
+            std::printf("FAIL dataset has %zu pairs in %zu shards\n", data.size(), data.shard_count());
+            ++failures;
+        }
+        std::vector<int> source, target;
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            data.read_pair(i, source, target);
+            if (source != pairs[i].first || target != pairs[i].second) {
+                std::printf("FAIL pair %zu differs after the round trip\n", i);
+                ++failures;
+                break;
+            }
+        }
+        failures += check_loader(data, pairs);
+    }
+
+    // Пары, из которых не получится ни входа, ни меток, не записываются
+    {
+        DatasetWriter writer(kDirectory, kVocab, kPairsPerShard);
+        if (!throws([&] { writer.add({}, { 1, 2, 3 }); }) || !throws([&] { writer.add({ 1 }, { 2 }); })
+            || !throws([&] { writer.add({ 1 }, { 2, kVocab }); })) {
+            std::printf("FAIL DatasetWriter accepted an empty source, a one-token target or an out-of-vocabulary id\n");
+            ++failures;
+        }
+        writer.add(pairs[0].first, pairs[0].second);
+        writer.finish();
+        std::vector<int> source, target;
+        Dataset data(kDirectory);
+        data.read_pair(0, source, target);
+        if (data.size() != 1 || source != pairs[0].first || target != pairs[0].second) {
+            std::printf("FAIL rejected pairs left data in the shard\n");
+            ++failures;
+        }
+    }
+
+    // Обрезанный шард не открывается; id вне словаря всплывает ошибкой в next
+    write_dataset(pairs, pairs.size());
+    const std::string shard = dataset::shard_path(kDirectory, 3);
+    std::filesystem::resize_file(shard, std::filesystem::file_size(shard) - 4);
+    if (!throws([] { Dataset data(kDirectory); })) {
+        std::printf("FAIL truncated shard was accepted\n");
+        ++failures;
+    }
+    write_dataset(pairs, pairs.size());
+    {
+        const std::string first_shard = dataset::shard_path(kDirectory, 0);
+        std::fstream file(first_shard, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(std::filesystem::file_size(first_shard) - sizeof(int32_t));
+        int32_t bad_token = 999;
+        file.write(reinterpret_cast<const char*>(&bad_token), sizeof(bad_token));
+    }
+    {
+        Dataset data(kDirectory);
+        BatchLoaderConfig config;
+        BatchLoader loader(data, config);
+        Batch batch;
+        if (!throws([&] { while (loader.next(batch)) {} })) {
+            std::printf("FAIL out-of-vocabulary token was not reported by the loader\n");
+            ++failures;
+        }
+    }
+
+    // Меньший набор на месте прежнего удаляет лишние шарды
+    write_dataset(pairs, 150);
+    if (std::filesystem::exists(dataset::shard_path(kDirectory, 2)) || Dataset(kDirectory).size() != 150) {
+        std::printf("FAIL stale shards remain after a smaller rewrite\n");
+        ++failures;
+    }
+
+    std::printf("dataset_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
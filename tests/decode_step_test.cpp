@@ -0,0 +1,51 @@
+﻿#include "Transformer.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Пошаговый вывод с кэшем K/V против полного пересчёта: вероятности decode_step для каждого префикса
+// цели совпадают со строками forward_propagation по всей цели (маска не даёт позиции видеть следующие)
+static int check_steps(const char* name, const ModelConfig& config, std::mt19937& rng) {
+    Transformer model(config);
+    model.initialize_random();
+    std::vector<int> source(11), target(9);
+    for (int& token : source) token = rng() % config.vocab_size;
+    for (int& token : target) token = rng() % config.vocab_size;
+
+    model.forward_propagation(source, target);
+    const Tensor full = model.get_probabilities();
+
+    EncoderMemory memory = model.encode(source);
+    model.reset_decode_cache();
+    double worst = 0.0;
+    for (size_t i = 0; i < target.size(); ++i) {
+        const Tensor& step = model.decode_step(target[i], memory);
+        Tensor row(1, full.cols());
+        for (size_t j = 0; j < full.cols(); ++j) row[0][j] = full[i][j];
+        worst = std::max(worst, max_difference(step, row));
+    }
+    if (!(worst < 1e-6)) {
+        std::printf("FAIL %s: decode_step differs from forward_propagation by %g\n", name, worst);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    std::mt19937 rng(6);
+    int failures = 0;
+    failures += check_steps("linear head", ModelConfig::make(70, 32, 2, 4, 64), rng);
+    ModelConfig adaptive = ModelConfig::make(300, 32, 2, 4, 64);
+    adaptive.adaptive_cutoffs = { 30, 120 };
+    adaptive.adaptive_shrink = 2;
+    failures += check_steps("adaptive head", adaptive, rng);
+    std::printf("decode_step_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+﻿#include "Gemm.h"
+#include "ThreadPool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Эталон: C = alpha * op(A) * op(B) + beta * C с накоплением в double
+static void reference_gemm(bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+    float alpha, const float* A, size_t lda, const float* B, size_t ldb, float beta, float* C, size_t ldc) {
+    for (size_t i = 0; i < M; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            double sum = 0.0;
+            for (size_t k = 0; k < K; ++k) {
+                double a = trans_a ? A[k * lda + i] : A[i * lda + k];
+                double b = trans_b ? B[j * ldb + k] : B[k * ldb + j];
+                sum += a * b;
+            }
+            // При beta == 0 прежнее содержимое C не читается (может быть NaN)
+            double previous = beta == 0.0f ? 0.0 : static_cast<double>(beta) * C[i * ldc + j];
+            C[i * ldc + j] = static_cast<float>(alpha * sum + previous);
+        }
+    }
+}
+
+// Случайные размеры (в том числе не кратные микроядру и шире одной панели), все сочетания транспонирования,
+// шаги строк с запасом, alpha/beta. Столбцы C за пределами N не должны меняться
+static int check_sgemm(std::mt19937& rng, int trials) {
+    std::normal_distribution<float> normal;
+    int failures = 0;
+    for (int trial = 0; trial < trials; ++trial) {
+        size_t M = 1 + rng() % 130, N = 1 + rng() % 140, K = 1 + rng() % 600;
+        if (trial % 7 == 0) N = 3100 + rng() % 50;
+        bool trans_a = trial & 1, trans_b = trial & 2;
+        size_t lda = (trans_a ? M : K) + rng() % 3;
+        size_t ldb = (trans_b ? K : N) + rng() % 3;
+        size_t ldc = N + rng() % 3;
+        float alpha = trial % 3 == 0 ? 1.0f : 0.5f;
+        float beta = trial % 4 == 0 ? 0.0f : (trial % 4 == 1 ? 1.0f : -0.7f);
+
+        std::vector<float> A((trans_a ? K : M) * lda), B((trans_b ? N : K) * ldb), C(M * ldc);
+        for (float& x : A) x = normal(rng);
+        for (float& x : B) x = normal(rng);
+        for (float& x : C) x = normal(rng);
+        std::vector<float> expected = C;
+        if (beta == 0.0f) {
+            for (size_t i = 0; i < M; ++i) C[i * ldc] = NAN;
+        }
+
+        gemm::sgemm(trans_a, trans_b, M, N, K, alpha, A.data(), lda, B.data(), ldb, beta, C.data(), ldc);
+        reference_gemm(trans_a, trans_b, M, N, K, alpha, A.data(), lda, B.data(), ldb, beta, expected.data(), ldc);
+
+        double max_error = 0.0;
+        bool padding_changed = false;
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                double error = std::fabs(static_cast<double>(C[i * ldc + j]) - expected[i * ldc + j]);
+                if (!(error <= max_error)) max_error = error; // NaN тоже ошибка
+            }
+            for (size_t j = N; j < ldc; ++j) {
+                padding_changed |= C[i * ldc + j] != expected[i * ldc + j];
+            }
+        }
+        if (!(max_error <= 1e-3 * std::sqrt(static_cast<double>(K))) || padding_changed) {
+            std::printf("FAIL sgemm isa=%s trans=%d%d M=%zu N=%zu K=%zu alpha=%g beta=%g error=%g padding_changed=%d\n",
+                gemm::isa_name(gemm::active_isa()), trans_a, trans_b, M, N, K, alpha, beta, max_error, padding_changed);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// utils::matrix_multiply с флагами транспонирования и подматрицами (шаг строки больше ширины)
+static int check_matrix_multiply(std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    int failures = 0;
+    for (int trial = 0; trial < 40; ++trial) {
+        size_t M = 1 + rng() % 50, N = 1 + rng() % 50, K = 1 + rng() % 70;
+        bool trans_a = trial & 1, trans_b = trial & 2;
+        Tensor A_full(trans_a ? K : M, (trans_a ? M : K) + 5), B_full(trans_b ? N : K, (trans_b ? K : N) + 3);
+        for (size_t i = 0; i < A_full.size(); ++i) A_full.data()[i] = normal(rng);
+        for (size_t i = 0; i < B_full.size(); ++i) B_full.data()[i] = normal(rng);
+        ConstTensorView A = A_full.block(0, 2, A_full.rows(), A_full.cols() - 5);
+        ConstTensorView B = B_full.block(0, 1, B_full.rows(), B_full.cols() - 3);
+
+        Tensor C = utils::matrix_multiply(A, B, trans_a, trans_b);
+        std::vector<float> expected(M * N);
+        reference_gemm(trans_a, trans_b, M, N, K, 1.0f, A.data(), A.stride(), B.data(), B.stride(), 0.0f, expected.data(), N);
+
+        double max_error = 0.0;
+        bool shape_ok = C.rows() == M && C.cols() == N;
+        for (size_t i = 0; shape_ok && i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                max_error = std::max(max_error, std::fabs(static_cast<double>(C[i][j]) - expected[i * N + j]));
+            }
+        }
+        if (!shape_ok || max_error > 1e-3 * std::sqrt(static_cast<double>(K))) {
+            std::printf("FAIL matrix_multiply trans=%d%d M=%zu N=%zu K=%zu error=%g\n", trans_a, trans_b, M, N, K, max_error);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    int failures = 0;
+    // Каждый набор инструкций, доступный процессору (set_isa не поднимается выше detected_isa),
+    // в одном потоке и с разбиением C на панели между потоками
+    for (size_t threads : { 1, 4 }) {
+        ThreadPool::set_num_threads(threads);
+        for (gemm::Isa isa : { gemm::Isa::Scalar, gemm::Isa::Avx2, gemm::Isa::Avx512 }) {
+            gemm::set_isa(isa);
+            if (gemm::active_isa() != isa) continue;
+            failures += check_sgemm(rng, 120);
+            failures += check_matrix_multiply(rng);
+        }
+    }
+    std::printf("gemm_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+﻿#include "FeedForward.h"
+#include "Linear.h"
+#include "MultiHeadAttention.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Обратные проходы слоёв умножают на транспонированные операнды флагами GEMM, без транспонированных копий.
+// Проверка: градиенты по входам и накопленные градиенты весов против центральных разностей
+// функции L = sum(forward() .* R) для случайной R
+
+static void fill_normal(Tensor& t, std::mt19937& rng, float scale) {
+    std::normal_distribution<float> normal(0.0f, scale);
+    for (size_t i = 0; i < t.size(); ++i) t.data()[i] = normal(rng);
+}
+
+static double weighted_sum(const Tensor& out, const Tensor& weights) {
+    double sum = 0.0;
+    for (size_t i = 0; i < out.size(); ++i) sum += static_cast<double>(out.data()[i]) * weights.data()[i];
+    return sum;
+}
+
+// inputs — входы слоя, analytic_inputs — градиенты по ним из backward; params — веса с накопленными градиентами.
+// В каждом тензоре проверяется несколько случайных элементов
+static int check_gradients(const char* name, std::mt19937& rng, const std::function<Tensor()>& forward, const Tensor& R,
+    const std::vector<Tensor*>& inputs, const std::vector<Tensor>& analytic_inputs, const std::vector<ParameterRef>& params) {
+    const float h = 1e-2f;
+    int failures = 0, checked = 0, skipped = 0;
+    double max_error = 0.0;
+    const double base = weighted_sum(forward(), R);
+    auto check = [&](Tensor& value, const Tensor& analytic, const char* what) {
+        for (int sample = 0; sample < 12; ++sample) {
+            size_t index = rng() % value.size();
+            float saved = value.data()[index];
+            value.data()[index] = saved + h;
+            double plus = weighted_sum(forward(), R);
+            value.data()[index] = saved - h;
+            double minus = weighted_sum(forward(), R);
+            value.data()[index] = saved;
+            double numeric = (plus - minus) / (2.0 * h);
+            // Излом ReLU внутри [x - h, x + h]: односторонние разности расходятся, центральная не годится
+            if (std::fabs((plus - base) - (base - minus)) / h > 1e-2 * std::max(1.0, std::fabs(numeric))) {
+                ++skipped;
+                continue;
+            }
+            ++checked;
+            double error = std::fabs(numeric - analytic.data()[index]) / std::max(1.0, std::fabs(numeric));
+            max_error = std::max(max_error, error);
+            if (!(error < 5e-3)) {
+                std::printf("FAIL %s %s[%zu]: analytic %g numeric %g\n", name, what, index, analytic.data()[index], numeric);
+                ++failures;
+            }
+        }
+    };
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        check(*inputs[i], analytic_inputs[i], "input");
+    }
+    for (const ParameterRef& param : params) {
+        check(*param.value, *param.grad, param.name.c_str());
+    }
+    if (skipped > checked) {
+        std::printf("FAIL %s: %d of %d samples skipped at ReLU kinks\n", name, skipped, skipped + checked);
+        ++failures;
+    }
+    std::printf("%-24s max relative error %.2e (%d samples, %d skipped)\n", name, max_error, checked, skipped);
+    return failures;
+}
+
+// initialize_random берёт зерно из std::random_device: веса задаются заново от зерна теста,
+// чтобы прогоны были воспроизводимы
+static void seed_parameters(const std::vector<ParameterRef>& params, std::mt19937& rng) {
+    for (const ParameterRef& param : params) fill_normal(*param.value, rng, 0.3f);
+}
+
+static void zero_grads(const std::vector<ParameterRef>& params) {
+    for (const ParameterRef& param : params) param.grad->fill(0.0f);
+}
+
+int main() {
+    std::mt19937 rng(7);
+    int failures = 0;
+    const int dim = 16, rows = 7, memory_rows = 5;
+
+    {
+        Linear layer(dim, 11);
+        layer.initialize_random();
+        layer.set_gradient_accumulation(true);
+        std::vector<ParameterRef> params;
+        layer.collect_parameters(params);
+        seed_parameters(params, rng);
+        Tensor X(rows, dim), R(rows, 11);
+        fill_normal(X, rng, 1.0f);
+        fill_normal(R, rng, 1.0f);
+        auto forward = [&] { return layer.forward_linear(X); };
+        forward();
+        zero_grads(params);
+        Tensor grad_X = layer.backward_linear(R, 0.0f);
+        failures += check_gradients("Linear", rng, forward, R, { &X }, { grad_X }, params);
+    }
+    {
+        FeedForward layer(dim, 24);
+        layer.initialize_random();
+        layer.set_gradient_accumulation(true);
+        std::vector<ParameterRef> params;
+        layer.collect_parameters(params);
+        seed_parameters(params, rng);
+        Tensor X(rows, dim), R(rows, dim);
+        fill_normal(X, rng, 1.0f);
+        fill_normal(R, rng, 1.0f);
+        auto forward = [&] { return layer.forward_ff(X); };
+        forward();
+        zero_grads(params);
+        Tensor grad_X = layer.backward_ff(R, 0.0f);
+        failures += check_gradients("FeedForward", rng, forward, R, { &X }, { grad_X }, params);
+    }
+    for (bool use_mask : { false, true }) {
+        MultiHeadAttention layer(4, dim);
+        layer.initialize_random();
+        layer.set_gradient_accumulation(true);
+        std::vector<ParameterRef> params;
+        layer.collect_parameters(params);
+        seed_parameters(params, rng);
+        Tensor X(rows, dim), R(rows, dim);
+        fill_normal(X, rng, 0.5f);
+        fill_normal(R, rng, 1.0f);
+        auto forward = [&] { return layer.forward_mha(X, use_mask); };
+        forward();
+        zero_grads(params);
+        Tensor grad_X = layer.backward_mha(R, X, 0.0f);
+        failures += check_gradients(use_mask ? "MHA self (causal)" : "MHA self", rng, forward, R, { &X }, { grad_X }, params);
+    }
+    {
+        MultiHeadAttention layer(4, dim);
+        layer.initialize_random();
+        layer.set_gradient_accumulation(true);
+        std::vector<ParameterRef> params;
+        layer.collect_parameters(params);
+        seed_parameters(params, rng);
+        Tensor Q(rows, dim), KV(memory_rows, dim), R(rows, dim);
+        fill_normal(Q, rng, 0.5f);
+        fill_normal(KV, rng, 0.5f);
+        fill_normal(R, rng, 1.0f);
+        auto forward = [&] { return layer.forward_mha(Q, KV); };
+        forward();
+        zero_grads(params);
+        auto [grad_Q, grad_KV] = layer.backward_mha(R, Q, KV, 0.0f);
+        failures += check_gradients("MHA cross", rng, forward, R, { &Q, &KV }, { grad_Q, grad_KV }, params);
+    }
+
+    std::printf("layer_grad_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+﻿#include "ModelFile.h"
+#include "Transformer.h"
+#include "test_util.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static const char* kPath = "model_file_test.bin";
+static const char* kCorruptedPath = "model_file_test_corrupted.bin";
+
+// Смещения полей архитектуры в заголовке файла модели (см. FileHeader в ModelFile.cpp)
+static const std::streamoff kVocabOffset = 16, kEmbeddingOffset = 20, kLayersOffset = 24, kHeadsOffset = 28,
+    kHiddenOffset = 32, kCutoffCountOffset = 56;
+
+// Копия файла модели с полем заголовка, заменённым на value
+static void write_corrupted(std::streamoff offset, int32_t value) {
+    std::filesystem::copy_file(kPath, kCorruptedPath, std::filesystem::copy_options::overwrite_existing);
+    std::fstream file(kCorruptedPath, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+int main() {
+    int failures = 0;
+    Transformer model(ModelConfig::make(50, 32, 2, 4, 64));
+    model.initialize_random();
+    model.save_weights(kPath);
+    if (model_file::read_config(kPath) != model.config()) {
+        std::printf("FAIL configuration read from the header differs from the saved model\n");
+        ++failures;
+    }
+
+    // Заголовок, по которому нельзя построить модель, отвергается при чтении архитектуры и при отображении
+    struct Corruption {
+        const char* name;
+        std::streamoff offset;
+        int32_t value;
+    };
+    const Corruption corruptions[] = {
+        { "zero heads", kHeadsOffset, 0 },
+        { "embedding_dim not divisible by heads", kHeadsOffset, 3 },
+        { "negative vocab_size", kVocabOffset, -1 },
+        { "zero embedding_dim", kEmbeddingOffset, 0 },
+        { "zero layers", kLayersOffset, 0 },
+        { "negative hidden_dim", kHiddenOffset, -64 },
+        { "cutoff count not below vocab_size", kCutoffCountOffset, 50 },
+    };
+    for (const Corruption& corruption : corruptions) {
+        write_corrupted(corruption.offset, corruption.value);
+        if (!throws([] { model_file::read_config(kCorruptedPath); }) || !throws([] { model_file::open(kCorruptedPath); })) {
+            std::printf("FAIL header with %s was accepted\n", corruption.name);
+            ++failures;
+        }
+    }
+    std::filesystem::remove(kPath);
+    std::filesystem::remove(kCorruptedPath);
+
+    std::printf("model_file_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
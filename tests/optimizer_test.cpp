@@ -0,0 +1,109 @@
+﻿#include "Gemm.h"
+#include "Optimizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+// Размер области не кратен ширине векторов, чтобы проходили и хвосты ядер
+static const size_t kSize = 1003;
+static const int kSteps = 6;
+static const float kLearningRate = 0.01f;
+
+// Эталон оптимизатора в double: те же формулы, что в Optimizer.h, без векторизации и разбиения на куски
+struct ReferenceOptimizer {
+    OptimizerConfig config;
+    std::vector<double> state1, state2;
+    long long steps = 0;
+
+    // Возвращает норму градиента до обрезки (0 без обрезки), как Optimizer::step
+    double step(std::vector<double>& w, const std::vector<float>& g, double lr) {
+        state1.resize(w.size(), 0.0);
+        state2.resize(w.size(), 0.0);
+        ++steps;
+        double scale = 1.0, norm = 0.0;
+        if (config.clip_norm > 0.0f) {
+            for (float x : g) norm += static_cast<double>(x) * x;
+            norm = std::sqrt(norm);
+            if (norm > config.clip_norm) scale = config.clip_norm / norm;
+        }
+        double bias1 = 1.0 - std::pow(static_cast<double>(config.beta1), static_cast<double>(steps));
+        double bias2 = 1.0 - std::pow(static_cast<double>(config.beta2), static_cast<double>(steps));
+        for (size_t i = 0; i < w.size(); ++i) {
+            double grad = scale * g[i];
+            switch (config.type) {
+            case OptimizerType::Sgd:
+                w[i] -= lr * grad;
+                break;
+            case OptimizerType::Momentum:
+                state1[i] = config.momentum * state1[i] + grad;
+                w[i] -= lr * state1[i];
+                break;
+            case OptimizerType::Adam:
+                state1[i] = config.beta1 * state1[i] + (1.0 - config.beta1) * grad;
+                state2[i] = config.beta2 * state2[i] + (1.0 - config.beta2) * grad * grad;
+                w[i] -= lr / bias1 * state1[i] / (std::sqrt(state2[i] / bias2) + config.epsilon);
+                break;
+            }
+        }
+        return norm;
+    }
+};
+
+// Несколько шагов со свежими градиентами: веса и возвращаемая норма должны совпасть с эталоном.
+// grad_scale задаёт величину градиента, чтобы обрезка по clip_norm срабатывала или нет
+static int check_optimizer(const char* name, const OptimizerConfig& config, float grad_scale, std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    std::vector<float> weights(kSize), grads(kSize);
+    for (float& x : weights) x = normal(rng);
+    std::vector<double> expected(weights.begin(), weights.end());
+
+    Optimizer optimizer(config);
+    ReferenceOptimizer reference;
+    reference.config = config;
+    double worst_weight = 0.0, worst_norm = 0.0;
+    for (int step = 0; step < kSteps; ++step) {
+        for (float& x : grads) x = grad_scale * normal(rng);
+        double norm = optimizer.step(weights.data(), grads.data(), kSize, kLearningRate);
+        double expected_norm = reference.step(expected, grads, kLearningRate);
+        worst_norm = std::max(worst_norm, std::fabs(norm - expected_norm) / std::max(1.0, expected_norm));
+        for (size_t i = 0; i < kSize; ++i) {
+            worst_weight = std::max(worst_weight, std::fabs(weights[i] - expected[i]));
+        }
+    }
+    if (!(worst_weight < 1e-5) || !(worst_norm < 1e-5) || optimizer.steps() != kSteps) {
+        std::printf("FAIL %s isa=%s clip=%g: weight error %g, norm error %g\n",
+            name, gemm::isa_name(gemm::active_isa()), config.clip_norm, worst_weight, worst_norm);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    std::mt19937 rng(12);
+    int failures = 0;
+    // Каждый набор инструкций, доступный процессору (set_isa не поднимается выше detected_isa)
+    for (gemm::Isa isa : { gemm::Isa::Scalar, gemm::Isa::Avx2, gemm::Isa::Avx512 }) {
+        gemm::set_isa(isa);
+        if (gemm::active_isa() != isa) continue;
+        for (OptimizerType type : { OptimizerType::Sgd, OptimizerType::Momentum, OptimizerType::Adam }) {
+            const char* name = type == OptimizerType::Adam ? "adam" : type == OptimizerType::Momentum ? "momentum" : "sgd";
+            OptimizerConfig config;
+            config.type = type;
+            failures += check_optimizer(name, config, 1.0f, rng);
+            // Норма градиента около 32: обрезка до 1 срабатывает на каждом шаге
+            config.clip_norm = 1.0f;
+            failures += check_optimizer(name, config, 1.0f, rng);
+            // Градиент меньше порога: обрезка считает норму, но не меняет шаг
+            failures += check_optimizer(name, config, 0.01f, rng);
+        }
+    }
+    std::printf("optimizer_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+﻿#include "Gemm.h"
+#include "Precision.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static float from_bits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t to_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+struct Case {
+    uint32_t input;     // Биты float
+    uint16_t expected;  // Биты результата
+};
+
+// Граничные случаи скалярных преобразований float -> bf16/fp16: округление к ближайшему чётному
+// (в том числе у денормализованных чисел), переполнение в бесконечность, NaN остаётся тихим NaN
+static int check_scalar_cases() {
+    static const Case bf16_cases[] = {
+        { 0x3F800000, 0x3F80 },     // 1
+        { 0x3F808000, 0x3F80 },     // Ровно посередине, младший бит чётный — вниз
+        { 0x3F818000, 0x3F82 },     // Посередине, младший бит нечётный — вверх
+        { 0x3F808001, 0x3F81 },     // Чуть больше середины — вверх
+        { 0xBF818000, 0xBF82 },     // То же для отрицательных
+        { 0x7F7FFFFF, 0x7F80 },     // FLT_MAX округляется в бесконечность
+        { 0x7F800000, 0x7F80 },     // +inf
+        { 0xFF800000, 0xFF80 },     // -inf
+        { 0x00010000, 0x0001 },     // Денормализованное, точно представимое
+        { 0x00008000, 0x0000 },     // Денормализованное посередине — к чётному нулю
+        { 0x00018000, 0x0002 },     // Денормализованное посередине — к чётному вверх
+        { 0x007FFFFF, 0x0080 },     // Наибольшее денормализованное округляется в наименьшее нормализованное
+        { 0x80000000, 0x8000 },     // -0
+        { 0x7F800001, 0x7FC0 },     // Сигнальный NaN с младшими битами: не превращается в бесконечность
+        { 0xFF800001, 0xFFC0 },
+        { 0x7FC00000, 0x7FC0 },     // Тихий NaN
+    };
+    static const Case fp16_cases[] = {
+        { 0x3F800000, 0x3C00 },     // 1
+        { 0x3F801000, 0x3C00 },     // 1 + 2^-11: посередине, к чётному вниз
+        { 0x3F803000, 0x3C02 },     // 1 + 3 * 2^-11: посередине, к чётному вверх
+        { 0x3F801001, 0x3C01 },
+        { 0x477FE000, 0x7BFF },     // 65504 — наибольшее конечное fp16
+        { 0x477FEFFF, 0x7BFF },     // Чуть меньше 65520 — ещё конечное
+        { 0x477FF000, 0x7C00 },     // 65520 — переполнение в бесконечность
+        { 0xC77FF000, 0xFC00 },
+        { 0x7F7FFFFF, 0x7C00 },     // FLT_MAX
+        { 0x7F800000, 0x7C00 },
+        { 0x38800000, 0x0400 },     // 2^-14 — наименьшее нормализованное
+        { 0x387FFFFF, 0x0400 },     // Чуть меньше — округляется в наименьшее нормализованное
+        { 0x33800000, 0x0001 },     // 2^-24 — наименьшее денормализованное
+        { 0x33000000, 0x0000 },     // 2^-25: посередине между 0 и 2^-24 — к чётному нулю
+        { 0x33000001, 0x0001 },
+        { 0x33C00000, 0x0002 },     // 3 * 2^-25: посередине между 1 и 2 ulp — к чётному вверх
+        { 0x32FFFFFF, 0x0000 },
+        { 0x80000001, 0x8000 },     // Денормализованное float — в -0
+        { 0x7FC00000, 0x7E00 },     // Тихий NaN
+        { 0x7F800001, 0x7E00 },     // Сигнальный NaN с младшими битами: остаётся NaN
+        { 0xFFA00000, 0xFF00 },     // Сигнальный NaN: старшие биты полезной нагрузки сохраняются, NaN становится тихим
+    };
+    int failures = 0;
+    for (const Case& c : bf16_cases) {
+        uint16_t result = precision::float_to_bf16(from_bits(c.input));
+        if (result != c.expected) {
+            std::printf("FAIL float_to_bf16(0x%08X) = 0x%04X, expected 0x%04X\n", c.input, result, c.expected);
+            ++failures;
+        }
+    }
+    for (const Case& c : fp16_cases) {
+        uint16_t result = precision::float_to_fp16(from_bits(c.input));
+        if (result != c.expected) {
+            std::printf("FAIL float_to_fp16(0x%08X) = 0x%04X, expected 0x%04X\n", c.input, result, c.expected);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Все 16-битные значения: обратное преобразование во float точное (NaN — тихий NaN с той же нагрузкой),
+// и float -> 16 бит возвращает исходное значение
+static int check_round_trip() {
+    int failures = 0;
+    for (uint32_t h = 0; h <= 0xFFFF; ++h) {
+        uint16_t value = static_cast<uint16_t>(h);
+        bool fp16_nan = (value & 0x7C00) == 0x7C00 && (value & 0x03FF) != 0;
+        bool bf16_nan = (value & 0x7F80) == 0x7F80 && (value & 0x007F) != 0;
+        uint16_t fp16_back = precision::float_to_fp16(precision::fp16_to_float(value));
+        uint16_t bf16_back = precision::float_to_bf16(precision::bf16_to_float(value));
+        uint16_t fp16_expected = fp16_nan ? static_cast<uint16_t>(value | 0x0200) : value;
+        uint16_t bf16_expected = bf16_nan ? static_cast<uint16_t>(value | 0x0040) : value;
+        if (fp16_back != fp16_expected) {
+            std::printf("FAIL fp16 round trip 0x%04X -> 0x%04X\n", value, fp16_back);
+            ++failures;
+        }
+        if (bf16_back != bf16_expected) {
+            std::printf("FAIL bf16 round trip 0x%04X -> 0x%04X\n", value, bf16_back);
+            ++failures;
+        }
+        // Денормализованные fp16 — точные кратные 2^-24
+        uint16_t magnitude = value & 0x7FFF;
+        if (magnitude < 0x0400 && precision::fp16_to_float(magnitude) != magnitude * from_bits(0x33800000)) {
+            std::printf("FAIL fp16_to_float(0x%04X) subnormal value\n", value);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Векторные пути from_float/to_float (AVX2, F16C, AVX512-BF16) побитово совпадают со скалярными функциями.
+// Вход — граничные значения и случайные битовые шаблоны всех классов; длина не кратна ширине векторов
+static int check_vector_paths(std::mt19937& rng) {
+    std::vector<float> input;
+    for (const uint32_t bits : { 0x00000000u, 0x80000000u, 0x00000001u, 0x007FFFFFu, 0x00008000u, 0x00018000u,
+            0x3F808000u, 0x3F818000u, 0x3F801000u, 0x3F803000u, 0x477FF000u, 0x477FEFFFu, 0x7F7FFFFFu,
+            0x7F800000u, 0xFF800000u, 0x7F800001u, 0xFFA00000u, 0x7FC00000u, 0x33000000u, 0x33C00000u, 0x387FFFFFu }) {
+        input.push_back(from_bits(bits));
+    }
+    std::uniform_int_distribution<uint32_t> any_bits;
+    std::uniform_int_distribution<uint32_t> exponent(0, 255);
+    while (input.size() < 20011) {
+        uint32_t bits = any_bits(rng);
+        // Половина — с показателем около диапазона fp16, где сосредоточены ветви округления
+        if (input.size() % 2) bits = (bits & 0x807FFFFFu) | ((exponent(rng) % 40 + 97) << 23);
+        else if (input.size() % 7 == 0) bits &= 0x807FFFFFu;    // Денормализованные
+        input.push_back(from_bits(bits));
+    }
+    std::vector<uint16_t> all_halves(0x10000 + 5);
+    for (size_t i = 0; i < all_halves.size(); ++i) all_halves[i] = static_cast<uint16_t>(i);
+
+    int failures = 0;
+    for (gemm::Isa isa : { gemm::Isa::Scalar, gemm::Isa::Avx2, gemm::Isa::Avx512 }) {
+        gemm::set_isa(isa);
+        if (gemm::active_isa() != isa) continue;
+        for (Precision format : { Precision::BFloat16, Precision::Float16 }) {
+            bool bf16 = format == Precision::BFloat16;
+            std::vector<uint16_t> halves(input.size());
+            precision::from_float(format, input.data(), halves.data(), input.size());
+            for (size_t i = 0; i < input.size(); ++i) {
+                uint16_t expected = bf16 ? precision::float_to_bf16(input[i]) : precision::float_to_fp16(input[i]);
+                if (halves[i] != expected) {
+                    std::printf("FAIL from_float %s isa=%s: 0x%08X -> 0x%04X, scalar 0x%04X\n",
+                        precision::name(format), gemm::isa_name(isa), to_bits(input[i]), halves[i], expected);
+                    ++failures;
+                    break;
+                }
+            }
+            std::vector<float> floats(all_halves.size());
+            precision::to_float(format, all_halves.data(), floats.data(), all_halves.size());
+            for (size_t i = 0; i < all_halves.size(); ++i) {
+                float expected = bf16 ? precision::bf16_to_float(all_halves[i]) : precision::fp16_to_float(all_halves[i]);
+                if (to_bits(floats[i]) != to_bits(expected)) {
+                    std::printf("FAIL to_float %s isa=%s: 0x%04X -> 0x%08X, scalar 0x%08X\n",
+                        precision::name(format), gemm::isa_name(isa), all_halves[i], to_bits(floats[i]), to_bits(expected));
+                    ++failures;
+                    break;
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+int main() {
+    std::mt19937 rng(13);
+    int failures = 0;
+    failures += check_scalar_cases();
+    failures += check_round_trip();
+    failures += check_vector_paths(rng);
+    std::printf("precision_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+﻿#include "Transformer.h"
+#include "ThreadPool.h"
+#include "test_util.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static const char* kPath = "quantized_model_test.bin";
+
+// Квантует модель, сохраняет и загружает int8-файл: заголовок хранит архитектуру, загрузка в модель
+// той же архитектуры даёт те же вероятности, в модель другой архитектуры — отвергается
+static int check_round_trip(const char* name, const ModelConfig& config, const ModelConfig& other) {
+    std::mt19937 rng(5);
+    std::vector<std::vector<int>> sources, targets;
+    for (int i = 0; i < 3; ++i) {
+        std::vector<int> s(5 + i), t(4 + i);
+        for (int& token : s) token = rng() % config.vocab_size;
+        for (int& token : t) token = rng() % config.vocab_size;
+        sources.push_back(s);
+        targets.push_back(t);
+    }
+    int failures = 0;
+    Transformer model(config);
+    model.initialize_random();
+    model.quantize_int8({ sources[0], sources[1] }, { targets[0], targets[1] });
+    model.save_quantized(kPath);
+
+    if (Transformer::read_quantized_config(kPath) != config) {
+        std::printf("FAIL %s: configuration in the int8 header differs from the model\n", name);
+        ++failures;
+    }
+    Transformer loaded(config);
+    loaded.load_quantized(kPath);
+    model.forward_propagation(sources[2], targets[2]);
+    loaded.forward_propagation(sources[2], targets[2]);
+    const double difference = max_difference(model.get_probabilities(), loaded.get_probabilities());
+    if (difference != 0.0) {
+        std::printf("FAIL %s: reloaded int8 model differs by %g\n", name, difference);
+        ++failures;
+    }
+    if (!throws([&] { Transformer mismatched(other); mismatched.load_quantized(kPath); })) {
+        std::printf("FAIL %s: int8 model of another architecture was accepted\n", name);
+        ++failures;
+    }
+    return failures;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    int failures = 0;
+
+    const ModelConfig plain = ModelConfig::make(60, 32, 2, 4, 64);
+    failures += check_round_trip("plain", plain, ModelConfig::make(60, 32, 2, 4, 32));
+    ModelConfig adaptive = ModelConfig::make(200, 32, 2, 4, 64);
+    adaptive.adaptive_cutoffs = { 20, 80 };
+    adaptive.adaptive_shrink = 2;
+    ModelConfig other_cutoffs = adaptive;
+    other_cutoffs.adaptive_cutoffs = { 40, 80 };
+    failures += check_round_trip("adaptive", adaptive, other_cutoffs);
+
+    // Файл прежней версии (без архитектуры в заголовке) не читается
+    {
+        std::ofstream out(kPath, std::ios::binary);
+        const char magic[4] = { 'T', 'Q', '8', '\0' };
+        const int version = 1;
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    if (!throws([] { Transformer::read_quantized_config(kPath); })) {
+        std::printf("FAIL int8 file of version 1 was accepted\n");
+        ++failures;
+    }
+    std::filesystem::remove(kPath);
+
+    std::printf("quantized_model_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
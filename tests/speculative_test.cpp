@@ -0,0 +1,84 @@
+﻿#include "SpeculativeDecoder.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static const char* kMainWeights = "speculative_main.bin";
+
+// Обычный жадный вывод основной модели пошагово через кэш K/V
+static std::vector<int> greedy(Transformer& model, const std::vector<int>& source, const std::vector<int>& prefix, int eos_id, int max_length) {
+    EncoderMemory memory = model.encode(source);
+    model.reset_decode_cache();
+    for (size_t i = 0; i + 1 < prefix.size(); ++i) {
+        model.decode_step(prefix[i], memory);
+    }
+    std::vector<int> output;
+    int token = prefix.back();
+    for (int i = 0; i < max_length; ++i) {
+        token = model.decode_step_greedy(token, memory);
+        output.push_back(token);
+        if (token == eos_id) break;
+    }
+    return output;
+}
+
+// Вывод спекулятивного декодера совпадает с жадным выводом основной модели при любом черновике
+static int check_model(bool adaptive) {
+    const char* name = adaptive ? "adaptive softmax" : "linear head";
+    int failures = 0;
+    ModelConfig config = ModelConfig::make(50, 32, 2, 4, 64);
+    if (adaptive) config.adaptive_cutoffs = { 10, 25 };
+    Transformer model(config);
+    model.initialize_random();
+    model.save_weights(kMainWeights);
+    const ModelConfig draft_config = ModelConfig::make(50, 16, 1, 2, 32);
+
+    // Случайный черновик: почти всё отклоняется, но результат тот же
+    for (int draft_tokens : { 1, 3, 5 }) {
+        SpeculativeConfig speculative;
+        speculative.draft_tokens = draft_tokens;
+        speculative.max_length = 37;
+        SpeculativeDecoder decoder(model, std::make_unique<Transformer>(draft_config), speculative);
+        decoder.draft().initialize_random();
+        for (int s = 0; s < 5; ++s) {
+            std::vector<int> source = { s, s + 3, 7, 9, 11 }, prefix = { 1, s + 2 };
+            if (greedy(model, source, prefix, -1, 37) != decoder.generate(source, prefix, -1)) {
+                std::printf("FAIL %s k=%d source %d: output differs from greedy decoding\n", name, draft_tokens, s);
+                ++failures;
+            }
+        }
+    }
+
+    // Черновик — та же модель: принимается всё
+    SpeculativeConfig speculative;
+    speculative.draft_tokens = 4;
+    speculative.max_length = 40;
+    SpeculativeDecoder self(model, kMainWeights, speculative);
+    const std::vector<int> source = { 3, 4, 5 };
+    std::vector<int> expected = greedy(model, source, { 1 }, -1, 40);
+    if (expected != self.generate(source, { 1 }, -1) || self.stats().acceptance_rate() != 1.0) {
+        std::printf("FAIL %s self-draft: output differs or acceptance %g\n", name, self.stats().acceptance_rate());
+        ++failures;
+    }
+
+    // Вывод обрывается на EOS так же, как у жадного декодирования
+    int eos_id = expected[5];
+    SpeculativeDecoder with_eos(model, std::make_unique<Transformer>(draft_config), speculative);
+    with_eos.draft().initialize_random();
+    if (greedy(model, source, { 1 }, eos_id, 40) != with_eos.generate(source, { 1 }, eos_id)) {
+        std::printf("FAIL %s: output with EOS differs from greedy decoding\n", name);
+        ++failures;
+    }
+    return failures;
+}
+
+int main() {
+    ThreadPool::set_num_threads(2);
+    int failures = check_model(false) + check_model(true);
+    std::printf("speculative_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+﻿#pragma once
+#include "Parameter.h"
+#include "Tensor.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <vector>
+
+// Общие проверки тестов
+
+// Ожидаемое исключение: true, если вызов бросил std::exception
+template <typename F>
+inline bool throws(F&& f) {
+    try {
+        f();
+    }
+    catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Наибольшая поэлементная разность; при разных формах — бесконечность
+inline double max_difference(const Tensor& a, const Tensor& b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) return INFINITY;
+    double result = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        result = std::max(result, static_cast<double>(std::fabs(a.data()[i] - b.data()[i])));
+    }
+    return result;
+}
+
+// То же по значениям всех параметров (списки одной модели или моделей одной архитектуры)
+inline double max_difference(const std::vector<ParameterRef>& a, const std::vector<ParameterRef>& b) {
+    if (a.size() != b.size()) return INFINITY;
+    double result = 0.0;
+    for (size_t p = 0; p < a.size(); ++p) {
+        result = std::max(result, max_difference(*a[p].value, *b[p].value));
+    }
+    return result;
+}
\ No newline at end of file
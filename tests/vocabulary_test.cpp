@@ -0,0 +1,131 @@
+﻿#include "Vocabulary.h"
+#include "test_util.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Счётчик параметров слоёв (в приложении определён в InferenceModel.cpp)
+int paramCount = 0;
+
+static const char* kPath = "vocabulary_test.bin";
+static const char* kCorruptedPath = "vocabulary_test_corrupted.bin";
+
+// Смещения полей заголовка словаря (см. FileHeader в Vocabulary.cpp)
+static const std::streamoff kVersionOffset = 4, kOffsetsOffset = 24, kSlotsOffset = 40;
+
+// Случайный токен: латиница, байты UTF-8 кириллицы, часть — с меткой конца слова
+static std::string random_token(std::mt19937& rng) {
+    static const char* pieces[] = { "a", "b", "e", "k", "o", "t", "\xd0\xbf", "\xd1\x80", "\xd0\xb8", ".", "<", ">" };
+    std::string token;
+    const int length = 1 + static_cast<int>(rng() % 6);
+    for (int i = 0; i < length; ++i) token += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+    if (rng() % 3 == 0) token += "</w>";
+    return token;
+}
+
+// Каждый токен находится под своим id, строки не из словаря дают -1
+static int check_lookups(const char* name, const Vocabulary& vocabulary, const std::unordered_map<std::string, int>& tokens,
+    const std::vector<std::string>& absent) {
+    int failures = 0;
+    if (vocabulary.size() != tokens.size()) {
+        std::printf("FAIL %s: %zu tokens instead of %zu\n", name, vocabulary.size(), tokens.size());
+        return 1;
+    }
+    for (size_t id = 0; id < vocabulary.size(); ++id) {
+        const std::string_view token = vocabulary.token(static_cast<int>(id));
+        auto it = tokens.find(std::string(token));
+        if (it == tokens.end() || it->second != static_cast<int>(id) || vocabulary.find(token) != static_cast<int>(id)) {
+            std::printf("FAIL %s: token %zu is not found under its id\n", name, id);
+            ++failures;
+        }
+    }
+    for (const std::string& string : absent) {
+        if (vocabulary.find(string) != -1) {
+            std::printf("FAIL %s: string '%s' outside the vocabulary was found\n", name, string.c_str());
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+static uint64_t read_u64(const char* path, std::streamoff offset) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(offset);
+    uint64_t value = 0;
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+// Копия файла словаря с байтами value по смещению offset
+template <typename T>
+static void write_corrupted(std::streamoff offset, T value) {
+    std::filesystem::copy_file(kPath, kCorruptedPath, std::filesystem::copy_options::overwrite_existing);
+    std::fstream file(kCorruptedPath, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+int main() {
+    std::mt19937 rng(4);
+    std::unordered_map<std::string, int> tokens;
+    while (tokens.size() < 3000) {
+        tokens.emplace(random_token(rng), static_cast<int>(tokens.size()));
+    }
+    std::vector<std::string> absent = { "", "</w>", "zzz", "a</w></w>" };
+    while (absent.size() < 2000) {
+        std::string string = random_token(rng) + random_token(rng);
+        if (!tokens.count(string)) absent.push_back(string);
+    }
+
+    int failures = 0;
+    const Vocabulary vocabulary(tokens);
+    failures += check_lookups("built", vocabulary, tokens, absent);
+    if (Vocabulary().find("a") != -1) {
+        std::printf("FAIL empty vocabulary found a token\n");
+        ++failures;
+    }
+
+    vocabulary.save(kPath);
+    failures += check_lookups("reopened", Vocabulary::open(kPath), tokens, absent);
+
+    // Обрезанный или повреждённый файл отвергается при открытии
+    const uint64_t size = std::filesystem::file_size(kPath);
+    const uint64_t slots = read_u64(kPath, kSlotsOffset);
+    const uint64_t offsets = read_u64(kPath, kOffsetsOffset);
+    std::filesystem::copy_file(kPath, kCorruptedPath, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(kCorruptedPath, size - 1);
+    if (!throws([] { Vocabulary::open(kCorruptedPath); })) {
+        std::printf("FAIL truncated vocabulary was accepted\n");
+        ++failures;
+    }
+    std::filesystem::resize_file(kCorruptedPath, 16);
+    if (!throws([] { Vocabulary::open(kCorruptedPath); })) {
+        std::printf("FAIL vocabulary shorter than its header was accepted\n");
+        ++failures;
+    }
+    write_corrupted(kVersionOffset, Vocabulary::kVersion + 1);
+    if (!throws([] { Vocabulary::open(kCorruptedPath); })) {
+        std::printf("FAIL vocabulary of an unknown version was accepted\n");
+        ++failures;
+    }
+    write_corrupted(static_cast<std::streamoff>(slots + 5 * sizeof(uint32_t)), static_cast<uint32_t>(tokens.size()));
+    if (!throws([] { Vocabulary::open(kCorruptedPath); })) {
+        std::printf("FAIL vocabulary with a slot id out of range was accepted\n");
+        ++failures;
+    }
+    write_corrupted(static_cast<std::streamoff>(offsets + 7 * sizeof(uint64_t)), uint64_t(1) << 40);
+    if (!throws([] { Vocabulary::open(kCorruptedPath); })) {
+        std::printf("FAIL vocabulary with decreasing string offsets was accepted\n");
+        ++failures;
+    }
+    std::filesystem::remove(kPath);
+    std::filesystem::remove(kCorruptedPath);
+
+    std::printf("vocabulary_test: %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file